@@ -47,6 +47,12 @@ MQTT_URL := $(MQTT_URL)$(MQTT_HOST):$(MQTT_PORT)
 # OTA (update) URL. Only change the host name (and port).
 OTA_URL = http://ota.host.net/ota.php?uid=
 
+## Telemetry
+# Interval in milliseconds at which sensor readings are published as a single
+# batch message on 'nsa/batch'. Set to 0 to publish each reading on its own 
+# topic, for services which don't decode batches.
+TELEMETRY_INTERVAL = 30000
+
 # Pass flags to compiler
 USER_CFLAGS := $(USER_CFLAGS) -DWIFI_SSID="\"$(WIFI_SSID)"\"
 USER_CFLAGS := $(USER_CFLAGS) -DWIFI_PWD="\"$(WIFI_PWD)"\"
@@ -59,4 +65,5 @@ USER_CFLAGS := $(USER_CFLAGS) -DMQTT_PWD="\"$(MQTT_PWD)"\"
 ifdef USE_MQTT_PASSWORD
 USER_CFLAGS := $(USER_CFLAGS) -DUSE_MQTT_PASSWORD="\"$(USE_MQTT_PASSWORD)"\"
 endif
-USER_CFLAGS := $(USER_CFLAGS) -DMQTT_PREFIX="\"$(MQTT_PREFIX)"\"
\ No newline at end of file
+USER_CFLAGS := $(USER_CFLAGS) -DMQTT_PREFIX="\"$(MQTT_PREFIX)"\"
+USER_CFLAGS := $(USER_CFLAGS) -DTELEMETRY_INTERVAL=$(TELEMETRY_INTERVAL)
\ No newline at end of file
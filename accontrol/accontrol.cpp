@@ -56,12 +56,24 @@ int main(int argc, char* argv[]) {
 	
 	cout << "Created listener, entering loop...\n";
 	
-	// Initialise the Nodes class.
+	// Initialise the Nodes class. A single 'host' is used if no list of 'hosts'
+	// is given.
 	string influx_host = config->getString("Influx.host", "localhost");
+	string influx_hosts = config->getString("Influx.hosts", influx_host);
 	int influx_port = config->getInt("Influx.port", 8086);
 	string influx_sec = config->getString("Influx.secure", "false");
 	string influx_db = config->getString("Influx.db", "test");
-	Nodes::init(influx_host, influx_port, influx_db, influx_sec, &listener);
+	InfluxCluster influx(influx_hosts, influx_port, influx_db, influx_sec == "true",
+											config->getInt("Influx.pool_size", 4),
+											config->getInt("Influx.replication", 1));
+	if (influx.size() == 0) {
+		cerr << "No Influx hosts configured.\n";
+		return 1;
+	}
+	
+	influx.setBreaker(config->getInt("Influx.breaker_threshold", 5), 
+											config->getInt("Influx.breaker_cooldown", 10000));
+	Nodes::init(&influx, &listener);
 	
 	// Initialise the HTTP server.
 	UInt16 port = config->getInt("HTTP.port", 8081);
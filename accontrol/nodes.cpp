@@ -13,6 +13,9 @@
 #include "nodes.h"
 
 #include <iostream>
+#include <map>
+#include <algorithm>
+#include <cctype>
 
 using namespace std;
 
@@ -32,11 +35,10 @@ using namespace Poco::Data::Keywords;
 
 // Static initialisations.
 Data::Session* Nodes::session;
+mutex Nodes::sessionMutex;
 bool Nodes::initialized = false;
-HTTPClientSession* Nodes::influxClient;
-string Nodes::influxDb;
+InfluxCluster* Nodes::influx;
 Listener* Nodes::listener;
-bool Nodes::secure;
 Timer* Nodes::tempTimer;
 Timer* Nodes::nodesTimer;
 Timer* Nodes::switchTimer;
@@ -44,23 +46,31 @@ Nodes* Nodes::selfRef;
 //vector<string> Nodes::uids;
 
 
+// Constants
+// Number of UIDs queried per request when refreshing current temperatures.
+const unsigned int tempQueryChunk = 250;
+
+
+// --- REGEX ESCAPE ---
+// Escape a string for literal use in an InfluxQL regular expression.
+static string regexEscape(const string &str) {
+	string out;
+	for (unsigned int i = 0; i < str.length(); ++i) {
+		if (!isalnum((unsigned char) str[i]) && str[i] != '_' && str[i] != '-') { out += '\\'; }
+		out += str[i];
+	}
+	
+	return out;
+}
+
+
 // --- INIT ---
 // Initialise the static class.
-void Nodes::init(string influxHost, int influxPort, string influxDb, 
-									string influx_sec, Listener* listener) {
+// The Influx cluster is owned by the caller.
+void Nodes::init(InfluxCluster* influx, Listener* listener) {
 	// Assign parameters.
 	Nodes::listener = listener;
-	Nodes::influxDb = influxDb;
-	if (influx_sec == "true") { 
-		cout << "Connecting with HTTPS..." << std::endl;
-		influxClient = new HTTPSClientSession(influxHost, influxPort);
-		secure = true; 
-	} 
-	else {
-		cout << "Connecting with HTTP..." << std::endl;
-		influxClient = new HTTPClientSession(influxHost, influxPort);
-		secure = false; 
-	}
+	Nodes::influx = influx;
 	
 	// Set up SQLite database link.
 	Data::SQLite::Connector::registerConnector();
@@ -147,7 +157,6 @@ void Nodes::stop() {
 	nodesTimer->stop();
 	delete tempTimer;
 	delete nodesTimer;
-	delete influxClient;
 	delete session;
 	delete selfRef;
 }
@@ -160,6 +169,7 @@ bool Nodes::getNodeInfo(string uid, NodeInfo &info) {
 	
 	cout << "Getting node info for UID: " << uid << endl;
 	
+	lock_guard<mutex> lk(sessionMutex);
 	Data::Statement select(*session);
 	info.uid = uid;
 	select << "SELECT posx, posy, current, target, ch0_state, ch0_duty, \
@@ -193,6 +203,7 @@ bool Nodes::getValveInfo(string uid, ValveInfo &info) {
 	
 	cout << "Getting valve info for UID: " << uid << endl;
 	
+	lock_guard<mutex> lk(sessionMutex);
 	Data::Statement select(*session);
 	info.uid = uid;
 	select << "SELECT ch0_valve, ch1_valve, ch2_valve, ch3_valve FROM valves WHERE uid=?",
@@ -215,6 +226,7 @@ bool Nodes::getSwitchInfo(string uid, SwitchInfo &info) {
 	
 	cout << "Getting switch info for UID: " << uid << endl;
 	
+	lock_guard<mutex> lk(sessionMutex);
 	Data::Statement select(*session);
 	info.uid = uid;
 	select << "SELECT state FROM switches WHERE uid=?",
@@ -264,6 +276,7 @@ bool Nodes::setTargetTemperature(string uid, float temp) {
 	
 	cout << "Setting target temperature for UID: " << uid << endl;
 	
+	lock_guard<mutex> lk(sessionMutex);
 	Data::Statement update(*session);
 	update << "UPDATE nodes SET target = ? WHERE uid = ?",
 			use(temp),
@@ -282,6 +295,7 @@ bool Nodes::setCurrentTemperature(string uid, float temp) {
 	cout << "Updating current temperature for node " << uid << " to " 
 			<< temp << endl;
 	
+	lock_guard<mutex> lk(sessionMutex);
 	Data::Statement update(*session);
 	update << "UPDATE nodes SET current = ? WHERE uid = ?",
 			use(temp),
@@ -292,6 +306,44 @@ bool Nodes::setCurrentTemperature(string uid, float temp) {
 }
 
 
+// --- SET CURRENT TEMPERATURES ---
+// Set the current temperature for a set of nodes in a single transaction.
+bool Nodes::setCurrentTemperatures(const map<string, float> &temps) {
+	if (!initialized) { return false; }
+	if (temps.empty()) { return true; }
+	
+	cout << "Updating current temperature for " << temps.size() << " nodes." << endl;
+	
+	lock_guard<mutex> lk(sessionMutex);
+	
+	try {
+		string uid;
+		float temp;
+		session->begin();
+		Data::Statement update(*session);
+		update << "UPDATE nodes SET current = ? WHERE uid = ?",
+				use(temp),
+				use(uid);
+		
+		map<string, float>::const_iterator it;
+		for (it = temps.begin(); it != temps.end(); ++it) {
+			uid = it->first;
+			temp = it->second;
+			update.execute();
+		}
+		
+		session->commit();
+	}
+	catch (Exception &exc) {
+		cerr << "Failed to update current temperatures: " << exc.displayText() << endl;
+		if (session->isTransaction()) { session->rollback(); }
+		return false;
+	}
+	
+	return true;
+}
+
+
 // --- SET DUTY ---
 // Update the duty for the specified node.
 bool Nodes::setDuty(string uid, UInt8 ch0, UInt8 ch1, UInt8 ch2, UInt8 ch3) {
@@ -299,6 +351,7 @@ bool Nodes::setDuty(string uid, UInt8 ch0, UInt8 ch1, UInt8 ch2, UInt8 ch3) {
 	
 	cout << "Setting duty for UID: " << uid << endl;
 	
+	lock_guard<mutex> lk(sessionMutex);
 	Data::Statement update(*session);
 	update << "UPDATE nodes SET ch0_duty = ?, ch1_duty = ?, ch2_duty = ?, ch3_duty = ? WHERE uid = ?",
 			use(ch0),
@@ -319,6 +372,7 @@ bool Nodes::setValves(string uid, bool ch0, bool ch1, bool ch2, bool ch3) {
 	
 	cout << "Setting valve state for UID: " << uid << endl;
 	
+	lock_guard<mutex> lk(sessionMutex);
 	Data::Statement update(*session);
 	update << "UPDATE valves SET ch0_valve = ?, ch1_valve = ?, ch2_valve = ?, ch3_valve = ? WHERE uid = ?",
 			use(ch0),
@@ -339,6 +393,7 @@ bool Nodes::setSwitch(string uid, bool state) {
 	
 	cout << "Setting switch state for UID: " << uid << " to " << state << endl;
 	
+	lock_guard<mutex> lk(sessionMutex);
 	Data::Statement update(*session);
 	update << "UPDATE switches SET state = ? WHERE uid = ?",
 			use(state),
@@ -351,75 +406,65 @@ bool Nodes::setSwitch(string uid, bool state) {
 
 // --- UPDATE CURRENT TEMPERATURES ---
 // Request the current temperatures from the Influx database using the MACs.
+// The last value of every node is fetched with a single grouped query per chunk
+// of UIDs, after which all nodes are updated in one transaction.
 void Nodes::updateCurrentTemperatures(Timer& /*timer*/) {
 	if (!initialized) { return; }
 	
-	cout << "Updating current temperatures...\n";
+	cout << "Updating current temperatures..." << endl;
 	
 	// Get the UIDs.
 	std::vector<string> uids;
 	if (!getUIDs(uids)) { 
-		cerr << "UpdateCurrentTemperatures: Failed to get the UIDs.\n";
+		cerr << "UpdateCurrentTemperatures: Failed to get the UIDs." << endl;
 		return; 
 	}
 	
-	cout << "Contacting Influx database...\n";
-	
-	int uidsl = uids.size();
-	string responseStr;
-	for (unsigned int i = 0; i < uidsl; ++i) {
-		// Send message.
-		string query = "SELECT%20\"value\"%20FROM%20\"temperature\"%20WHERE%20\"location\"='"
-							+ uids[i] + "'%20ORDER%20BY%20time%20DESC%20LIMIT%201";
-		try {			
-			HTTPRequest request(HTTPRequest::HTTP_GET, "/query?db=" + influxDb + 
-										"&q=" + query, HTTPMessage::HTTP_1_1);
-										
-			//cout << "Request: " << request.getURI() << endl;
-												
-			influxClient->sendRequest(request);
-			
-			HTTPResponse response;
-			istream &rs = influxClient->receiveResponse(response);
-			HTTPResponse::HTTPStatus status = response.getStatus();
-			if (status != HTTPResponse::HTTP_OK/*  && 
-					status != HTTPResponse::HTTP_NO_CONTENT */) {
-				cerr << "Received InfluxDB error: " << response.getReason() << "\n";
-				cerr << "Aborting temperature update loop.\n";
-				break;
-			}
-			
-			StreamCopier::copyToString(rs, responseStr);
-		}
-		catch (Exception& exc) {
-			cout << "Exception caught while attempting to connect." << endl;
-			cerr << exc.displayText() << endl;
-			return;
-		}
-		
-		//cout << "Influx response: " << responseStr << endl;
-		
-		// Process response.
-		// Write the obtained temperature for each node to the database.
-		Parser parser;
-		Dynamic::Var result = parser.parse(responseStr);
-		Object::Ptr object = result.extract<Object::Ptr>();
-		if (object->has("error")) { // Error occurred.
-			string err = object->getValue<string>("error");
-			cerr << "Error from Influx DB for current temperature: " << err << endl;
-			continue;
+	cout << "Contacting Influx database..." << endl;
+	
+	map<string, float> temps;
+	InfluxParser parser([&temps](const InfluxSeries &series, const InfluxRow &row) {
+		if (row.size() > 1 && row[1].isNumber()) {
+			temps[series.getTag("location")] = row[1].number;
 		}
 		
-		if (!object->isArray("results")) {
-			cerr << "Results content wasn't an array. Skipping.\n";
-			continue;
+		return true;
+	});
+	
+	// Series are sharded over the Influx endpoints, so group the UIDs by the
+	// endpoint holding their temperature series.
+	map<InfluxClient*, vector<string> > shards;
+	for (unsigned int i = 0; i < uids.size(); ++i) {
+		shards[influx->reader("temperature", uids[i])].push_back(uids[i]);
+	}
+	
+	map<InfluxClient*, vector<string> >::iterator it;
+	for (it = shards.begin(); it != shards.end(); ++it) {
+		const vector<string> &shardUids = it->second;
+		for (unsigned int i = 0; i < shardUids.size(); i += tempQueryChunk) {
+			// Match this chunk of UIDs with an anchored regular expression.
+			unsigned int end = min(i + tempQueryChunk, (unsigned int) shardUids.size());
+			string query = "SELECT last(\"value\") FROM \"temperature\" WHERE \"location\" =~ /^(";
+			for (unsigned int j = i; j < end; ++j) {
+				if (j > i) { query += "|"; }
+				query += regexEscape(shardUids[j]);
+			}
+			
+			query += ")$/ GROUP BY \"location\"";
+			
+			// Each node is returned as its own series, tagged with its location 
+			// (UID). The response is parsed straight off the HTTP stream. On 
+			// failure, still apply whatever the other chunks returned.
+			it->first->query(query, [&parser](std::istream &rs) {
+				if (!parser.parse(rs)) {
+					cerr << "Error from Influx DB for current temperature: " 
+							<< parser.getError() << endl;
+				}
+			});
 		}
-		
-		Array::Ptr results = object->getArray("results");
-		Dynamic::Array da = *results;
-		float newTemp = da[0]["series"][0]["values"][0][1];
-		setCurrentTemperature(uids[i], newTemp);
 	}
+	
+	setCurrentTemperatures(temps);
 }
 
 
@@ -454,6 +499,7 @@ bool Nodes::getUIDs(std::vector<string> &uids) {
 	
 	//std::vector<string> temp;
 	
+	lock_guard<mutex> lk(sessionMutex);
 	Data::Statement select(*session);
 	string uid;
 	select << "SELECT uid FROM nodes", into (uid), range(0, 1);
@@ -484,6 +530,7 @@ bool Nodes::getSwitchUIDs(std::vector<string> &uids) {
 	
 	uids.clear();
 	
+	lock_guard<mutex> lk(sessionMutex);
 	Data::Statement select(*session);
 	string uid;
 	select << "SELECT uid FROM switches", into (uid), range(0, 1);
@@ -16,17 +16,19 @@
 
 #include <string>
 #include <vector>
+#include <map>
+#include <mutex>
 
 using namespace std;
 
 #include <Poco/Data/Session.h>
 #include <Poco/Data/SQLite/Connector.h>
 
-#include <Poco/Net/HTTPClientSession.h>
-#include <Poco/Net/HTTPSClientSession.h>
-
 #include <Poco/Timer.h>
 
+#include "influxcluster.h"
+#include "influxparser.h"
+
 using namespace Poco;
 using namespace Poco::Net;
 
@@ -75,10 +77,9 @@ struct SwitchInfo {
 
 class Nodes {
 	static Data::Session* session;
+	static mutex sessionMutex;		// Serialises all use of 'session'.
 	static bool initialized;
-	static HTTPClientSession* influxClient;
-	static string influxDb;
-	static bool secure;
+	static InfluxCluster* influx;
 	static Listener* listener;
 	static Timer* tempTimer;
 	static Timer* nodesTimer;
@@ -87,7 +88,7 @@ class Nodes {
 	//static vector<string> uids;
 	
 public:
-	static void init(string influxHost, int influxPort, string influxDb, string influx_sec, Listener* listener);
+	static void init(InfluxCluster* influx, Listener* listener);
 	static void stop();
 	static bool getNodeInfo(string uid, NodeInfo &info);
 	static bool getValveInfo(string uid, ValveInfo &info);
@@ -95,6 +96,7 @@ public:
 	//static bool getNodesInfo(vector<NodeInfo> &info);
 	static bool setTargetTemperature(string uid, float temp);
 	static bool setCurrentTemperature(string uid, float temp);
+	static bool setCurrentTemperatures(const map<string, float> &temps);
 	static bool setDuty(string uid, UInt8 ch0, UInt8 ch1, UInt8 ch2, UInt8 ch3);
 	static bool setValves(string uid, bool ch0, bool ch1, bool ch2, bool ch3);
 	static bool setSwitch(string uid, bool state);
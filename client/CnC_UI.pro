@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += core gui
+QT       += core gui network
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -17,13 +17,15 @@ SOURCES += main.cpp\
     mqttlistener.cpp \
     nodetextitem.cpp \
     firmwaredialogue.cpp \
-    nodefirmwaredialogue.cpp
+    nodefirmwaredialogue.cpp \
+    mapscene.cpp
 
 HEADERS  += mainwindow.h \
     mqttlistener.h \
     nodetextitem.h \
     firmwaredialogue.h \
-    nodefirmwaredialogue.h
+    nodefirmwaredialogue.h \
+    mapscene.h
 
 FORMS    += mainwindow.ui \
     firmwaredialogue.ui \
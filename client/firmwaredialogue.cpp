@@ -2,10 +2,16 @@
 #include "ui_firmwaredialogue.h"
 
 #include <QFileDialog>
+#include <QFileInfo>
+#include <QFile>
+#include <QInputDialog>
+#include <QMessageBox>
+#include <QCryptographicHash>
 
 FirmwareDialogue::FirmwareDialogue(QWidget *parent) :
         QDialog(parent), ui(new Ui::FirmwareDialogue) {
     ui->setupUi(this);
+    chunkSize = 0;
     
     // Connections.
     connect(ui->uploadButton, SIGNAL(pressed()), this, SLOT(uploadFirmware()));
@@ -25,10 +31,18 @@ FirmwareDialogue::~FirmwareDialogue() {
 // --- UPDATE LIST ---
 void FirmwareDialogue::updateList(QString list) {
     // Split the list using the ';' separators, then fill the list widget with
-    // the names.
+    // the names. Each entry is 'name,version,size,hash,uploaded'.
+    ui->listWidget->clear();
     QStringList listParts = list.split(';', QString::SkipEmptyParts);
     for (int i = 0; i < listParts.size(); ++i) {
-        new QListWidgetItem(listParts[i], ui->listWidget);
+        QStringList fields = listParts[i].split(',');
+        QString text = fields[0];
+        if (fields.size() >= 3) {
+            if (!fields[1].isEmpty()) { text += " " + fields[1]; }
+            text += " (" + fields[2] + " bytes)";
+        }
+        
+        new QListWidgetItem(text, ui->listWidget);
     }
 }
 
@@ -54,7 +68,87 @@ void FirmwareDialogue::uploadFirmware() {
     QString filename = QFileDialog::getOpenFileName(this, tr("New firmware image"));
     if (filename.isEmpty()) { return; }
     
-    //
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        QMessageBox::warning(this, tr("Upload failed"), tr("Couldn't read the firmware image."));
+        return;
+    }
+    
+    image = file.readAll();
+    imageName = QFileInfo(filename).fileName();
+    imageHash = QCryptographicHash::hash(image, QCryptographicHash::Sha256).toHex();
+    imageVersion = QInputDialog::getText(this, tr("Firmware version"), 
+                                        tr("Version of ") + imageName + tr(" (optional):"));
+    beginUpload();
+}
+
+
+// --- BEGIN UPLOAD ---
+// Start the upload of the image, or resume it. The server replies with the
+// chunks it still needs.
+void FirmwareDialogue::beginUpload() {
+    string message = "begin;" + imageName.toStdString() + ";" + imageVersion.toStdString() + ";" + 
+                    QString::number(image.size()).toStdString() + ";" + imageHash.toStdString();
+    emit newMessage("cc/firmware", message);
+}
+
+
+// --- SEND CHUNKS ---
+// Send the chunks in the comma-separated list of indices and ranges (e.g.
+// '0-15,18'), then ask which chunks are still missing.
+void FirmwareDialogue::sendChunks(QString ranges) {
+    if (chunkSize <= 0) { return; }
+    
+    QStringList parts = ranges.split(',', QString::SkipEmptyParts);
+    for (int i = 0; i < parts.size(); ++i) {
+        QStringList bounds = parts[i].split('-');
+        int first = bounds[0].toInt();
+        int last = (bounds.size() > 1) ? bounds[1].toInt() : first;
+        for (int index = first; index <= last; ++index) {
+            int offset = index * chunkSize;
+            if (offset >= image.size()) { break; }
+            int length = qMin(chunkSize, image.size() - offset);
+            string message = "chunk;" + imageHash.toStdString() + ";" + 
+                            QString::number(index).toStdString() + ";" + 
+                            string(image.constData() + offset, length);
+            emit newMessage("cc/firmware", message);
+        }
+    }
+    
+    emit newMessage("cc/firmware", "status;" + imageHash.toStdString());
+}
+
+
+// --- UPLOAD REPLY ---
+// Replies by the server are '<status>;<hash>;...', with the status being one
+// of 'ready', 'missing', 'done', 'failed' or 'unknown'.
+void FirmwareDialogue::uploadReply(QString reply) {
+    QStringList parts = reply.split(';');
+    if (parts.size() < 2 || imageHash.isEmpty() || parts[1] != imageHash) { return; }
+    
+    if (parts[0] == "ready" && parts.size() >= 4) {
+        chunkSize = parts[2].toInt();
+        sendChunks(parts[3]);
+    }
+    else if (parts[0] == "missing" && parts.size() >= 3) {
+        // Resend lost chunks. The upload completes with the last chunk.
+        if (!parts[2].isEmpty()) { sendChunks(parts[2]); }
+    }
+    else if (parts[0] == "done") {
+        image.clear();
+        imageHash.clear();
+        QMessageBox::information(this, tr("Upload complete"), imageName + tr(" was uploaded."));
+        refreshList();
+    }
+    else if (parts[0] == "failed") {
+        image.clear();
+        imageHash.clear();
+        QMessageBox::warning(this, tr("Upload failed"), parts.value(2));
+    }
+    else if (parts[0] == "unknown") {
+        // The server lost the upload, e.g. after a restart. Start it again.
+        beginUpload();
+    }
 }
 
 
@@ -2,6 +2,7 @@
 #define FIRMWAREDIALOGUE_H
 
 #include <QDialog>
+#include <QByteArray>
 
 #include <string>
 
@@ -22,6 +23,16 @@ public:
 private:
     Ui::FirmwareDialogue *ui;
     
+    // Image being uploaded.
+    QByteArray image;
+    QString imageName;
+    QString imageVersion;
+    QString imageHash;
+    int chunkSize;
+    
+    void beginUpload();
+    void sendChunks(QString ranges);
+    
 private slots:    
     void slotOk();
     void slotCancel();
@@ -30,6 +41,7 @@ private slots:
 public slots:
     void updateList(QString list);
     void refreshList();
+    void uploadReply(QString reply);
     
 signals:
     void newMessage(string topic, string message);
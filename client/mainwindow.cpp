@@ -11,6 +11,9 @@
 #include <QSettings>
 #include <QThread>
 #include <QFile>
+#include <QFileDialog>
+#include <QBuffer>
+#include <QImage>
 
 #include <iostream>
 
@@ -24,6 +27,7 @@ MainWindow::MainWindow(QWidget *parent) :  QMainWindow(parent), ui(new Ui::MainW
     // UI connections.
     connect(ui->actionQuit, SIGNAL(triggered()), this, SLOT(quit()));
     connect(ui->actionConnect, SIGNAL(triggered()), this, SLOT(connectRemote()));
+    connect(ui->actionUpload_map, SIGNAL(triggered()), this, SLOT(uploadMap()));
     connect(ui->actionImages, SIGNAL(triggered()), this, SLOT(showFirmwareDialogue()));
     connect(ui->actionNodes, SIGNAL(triggered()), this, SLOT(showNodeFirmwareDialogue()));
     connect(ui->saveNodeButton, SIGNAL(pressed()), this, SLOT(saveNode()));
@@ -57,10 +61,19 @@ MainWindow::MainWindow(QWidget *parent) :  QMainWindow(parent), ui(new Ui::MainW
     
     // Add toolbar actions.
     ui->mainToolBar->addAction("New node", this, SLOT(registerNode()));
+    ui->mainToolBar->addSeparator();
+    floorBox = new QComboBox(this);
+    floorBox->setMinimumContentsLength(12);
+    ui->mainToolBar->addWidget(floorBox);
+    ui->mainToolBar->addAction("Zoom in", this, SLOT(zoomIn()));
+    ui->mainToolBar->addAction("Zoom out", this, SLOT(zoomOut()));
+    ui->mainToolBar->addAction("Fit", this, SLOT(zoomFit()));
+    connect(floorBox, SIGNAL(currentIndexChanged(int)), this, SLOT(showFloor(int)));
     
     // Defaults.
     mqtt = 0;
     nodeItem = 0;
+    mapScene = 0;
     connected = false;
     savedNode = false;
     
@@ -68,6 +81,8 @@ MainWindow::MainWindow(QWidget *parent) :  QMainWindow(parent), ui(new Ui::MainW
     qRegisterMetaType<NodeTextItem*>();
     qRegisterMetaType<QVector<Node> >();
     qRegisterMetaType<Node>();
+    qRegisterMetaType<MapFloor>();
+    qRegisterMetaType<QVector<MapFloor> >();
 }
 
 
@@ -81,9 +96,9 @@ MainWindow::~MainWindow() {
 // --- UPDATE MAP ---
 // Update the displayed map for the remote C&C server.
 void MainWindow::updateMap() {
-    // Publish the MQTT request for the map data.
+    // Publish the MQTT request for the tiled floor maps.
     connected = true;
-    mqtt->publishMessage("cc/ui/config", "map");
+    mqtt->publishMessage("cc/ui/config", "floors");
 }
 
 
@@ -347,6 +362,137 @@ void MainWindow::setMap(QPixmap map) {
 }
 
 
+// --- SET FLOORS ---
+// Fill the floor selection with the floors of the remote C&C server, keeping
+// the current floor selected if it still exists. Servers without tiled maps
+// are asked for the single map image instead.
+void MainWindow::setFloors(QString url, QVector<MapFloor> floors) {
+    cout << "Received " << floors.size() << " floor maps...\n";
+    
+    if (floors.isEmpty()) {
+        mqtt->publishMessage("cc/ui/config", "map");
+        return;
+    }
+    
+    QString current = floorBox->currentText();
+    mapUrl = url;
+    this->floors = floors;
+    
+    floorBox->blockSignals(true);
+    floorBox->clear();
+    int index = 0;
+    for (int i = 0; i < floors.size(); ++i) {
+        floorBox->addItem(floors[i].name);
+        if (floors[i].name == current) { index = i; }
+    }
+    
+    floorBox->setCurrentIndex(index);
+    floorBox->blockSignals(false);
+    showFloor(index);
+}
+
+
+// --- SHOW FLOOR ---
+// Show the map of a floor. Only the tiles visible at the current zoom are
+// fetched, starting with the whole floor fitted in the view.
+void MainWindow::showFloor(int index) {
+    if (index < 0 || index >= floors.size()) { return; }
+    
+    bool newScene = false;
+    if (!mapScene) { mapScene = new MapScene(this); }
+    if (ui->graphicsView->scene() != mapScene) {
+        ui->graphicsView->setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform);
+        ui->graphicsView->setScene(mapScene);
+        ui->graphicsView->setBackgroundBrush(Qt::NoBrush);
+        ui->graphicsView->setViewportUpdateMode(QGraphicsView::BoundingRectViewportUpdate);
+        ui->graphicsView->show();
+        newScene = true;
+    }
+    
+    bool resized = mapScene->currentFloor().width != floors[index].width || 
+                   mapScene->currentFloor().height != floors[index].height;
+    mapScene->setFloor(mapUrl, floors[index]);
+    ui->graphicsView->setSceneRect(mapScene->sceneRect());
+    if (newScene || resized) { zoomFit(); }
+    
+    // Request node data.
+    if (newScene) { updateNodes(); }
+}
+
+
+// --- UPLOAD MAP ---
+// Upload an image as the map of a floor. The image is converted to PNG, which
+// the C&C server cuts into tiles.
+void MainWindow::uploadMap() {
+    if (!connected) {
+        QMessageBox::warning(this, tr("Not connected"), tr("Not connected to MQTT server."));
+        return;
+    }
+    
+    QString file = QFileDialog::getOpenFileName(this, tr("Select map image"), QString(),
+                                                tr("Images (*.png *.jpg *.jpeg *.bmp *.gif)"));
+    if (file.isEmpty()) { return; }
+    
+    QString name = QInputDialog::getText(this, tr("Floor"), 
+                                         tr("Name of the floor (letters, digits, '-' and '_')"),
+                                         QLineEdit::Normal, floorBox->currentText());
+    if (name.isEmpty()) { return; }
+    
+    QImage image;
+    if (!image.load(file)) {
+        QMessageBox::warning(this, tr("Invalid image"), tr("Failed to load the image."));
+        return;
+    }
+    
+    QByteArray png;
+    QBuffer buffer(&png);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "PNG");
+    
+    mqtt->publishMessage("cc/ui/map", name.toStdString() + ";" + string(png.constData(), png.size()));
+    ui->statusBar->showMessage(tr("Uploading map of floor %1...").arg(name));
+}
+
+
+// --- MAP UPLOADED ---
+// Reply to a map upload: 'ok;<floor>' or 'error;<floor>;<reason>'. The new list
+// of floors follows a successful upload.
+void MainWindow::mapUploaded(QString reply) {
+    QStringList parts = reply.split(';');
+    if (parts.size() < 2) { return; }
+    if (parts[0] == "ok") {
+        ui->statusBar->showMessage(tr("Map of floor %1 updated.").arg(parts[1]), 5000);
+        return;
+    }
+    
+    ui->statusBar->clearMessage();
+    QMessageBox::warning(this, tr("Map upload failed"), 
+                         tr("Failed to update the map of floor %1: %2").arg(parts[1])
+                         .arg(parts.mid(2).join(';')));
+}
+
+
+// --- ZOOM IN ---
+void MainWindow::zoomIn() {
+    ui->graphicsView->scale(1.25, 1.25);
+}
+
+
+// --- ZOOM OUT ---
+void MainWindow::zoomOut() {
+    ui->graphicsView->scale(0.8, 0.8);
+}
+
+
+// --- ZOOM FIT ---
+// Fit the whole map in the view.
+void MainWindow::zoomFit() {
+    if (!ui->graphicsView->scene()) { return; }
+    
+    ui->graphicsView->fitInView(ui->graphicsView->sceneRect(), Qt::KeepAspectRatio);
+}
+
+
 // --- DELETE NODE ---
 // Check whether a node has been selected, then confirm deleting it.
 // After sending the MQTT command, clear the removed node from the UI.
@@ -514,6 +660,9 @@ void MainWindow::connectRemote() {
     connect(mqtt, SIGNAL(connected()), this, SLOT(updateMap()));
     connect(mqtt, SIGNAL(failed(QString)), this, SLOT(errorHandler(QString)));
     connect(mqtt, SIGNAL(receivedMap(QPixmap)), this, SLOT(setMap(QPixmap)));
+    connect(mqtt, SIGNAL(receivedFloors(QString,QVector<MapFloor>)), 
+            this, SLOT(setFloors(QString,QVector<MapFloor>)));
+    connect(mqtt, SIGNAL(receivedMapReply(QString)), this, SLOT(mapUploaded(QString)));
     connect(mqtt, SIGNAL(receivedNodes(QVector<Node>)), this, SLOT(setNodes(QVector<Node>)));
     connect(thread, SIGNAL(started()), mqtt, SLOT(connectBroker()));
     connect(mqtt, SIGNAL(finished()), thread, SLOT(quit()));
@@ -540,6 +689,7 @@ void MainWindow::showFirmwareDialogue() {
     FirmwareDialogue* dialogue = new FirmwareDialogue(this);
     connect(dialogue, SIGNAL(newMessage(string,string)), this, SLOT(sendMessage(string,string)));
     connect(mqtt, SIGNAL(receivedFirmwareList(QString)), dialogue, SLOT(updateList(QString)));
+    connect(mqtt, SIGNAL(receivedUploadReply(QString)), dialogue, SLOT(uploadReply(QString)));
     dialogue->exec();
 }
 
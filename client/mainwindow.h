@@ -7,11 +7,16 @@
 
 #include "mqttlistener.h"
 #include "nodetextitem.h"
+#include "mapscene.h"
+
+#include <QComboBox>
 
 
 Q_DECLARE_METATYPE(NodeTextItem*)
 Q_DECLARE_METATYPE(Node)
 Q_DECLARE_METATYPE(QVector<Node>)
+Q_DECLARE_METATYPE(MapFloor)
+Q_DECLARE_METATYPE(QVector<MapFloor>)
 
 
 namespace Ui {
@@ -31,6 +36,13 @@ private slots:
     void updateNode();
     void nodeSelected(NodeTextItem* nodeTextItem);
     void setMap(QPixmap map);
+    void setFloors(QString url, QVector<MapFloor> floors);
+    void showFloor(int index);
+    void uploadMap();
+    void mapUploaded(QString reply);
+    void zoomIn();
+    void zoomOut();
+    void zoomFit();
     void setNodes(QVector<Node> nodes);
     void deleteNode();
     void errorHandler(QString err);
@@ -67,6 +79,10 @@ private:
     int remotePort;
     MqttListener* mqtt;
     NodeTextItem* nodeItem;
+    MapScene* mapScene;
+    QComboBox* floorBox;
+    QString mapUrl;
+    QVector<MapFloor> floors;
     string ca, cert, key;
     bool savedNode;
 };
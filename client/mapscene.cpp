@@ -0,0 +1,153 @@
+#include "mapscene.h"
+
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <QNetworkDiskCache>
+#include <QStandardPaths>
+#include <QtMath>
+
+#include <iostream>
+
+using namespace std;
+
+
+// --- CONSTRUCTOR ---
+// Tiles never change for a given map version, and are kept in a disk cache
+// between sessions, as well as in memory (up to 64 MB) while displayed.
+MapScene::MapScene(QObject* parent) : QGraphicsScene(parent), tiles(64 * 1024) {
+    network = new QNetworkAccessManager(this);
+    QNetworkDiskCache* cache = new QNetworkDiskCache(this);
+    cache->setCacheDirectory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + 
+                             "/tiles");
+    network->setCache(cache);
+    connect(network, SIGNAL(finished(QNetworkReply*)), this, SLOT(tileReceived(QNetworkReply*)));
+    
+    floor.width = 0;
+    floor.height = 0;
+    floor.levels = 0;
+}
+
+
+// --- SET FLOOR ---
+// Show the map of a floor. The whole floor in a single tile is fetched right
+// away, so that there's always something to show while zooming in.
+void MapScene::setFloor(QString baseUrl, MapFloor floor) {
+    this->baseUrl = baseUrl;
+    this->floor = floor;
+    setSceneRect(0, 0, floor.width, floor.height);
+    if (floor.levels > 0) { requestTile(tilePath(0, 0, 0)); }
+    invalidate(sceneRect(), QGraphicsScene::BackgroundLayer);
+}
+
+
+// --- TILE PATH ---
+QString MapScene::tilePath(int level, int x, int y) {
+    return QString("%1/%2/%3/%4_%5.png").arg(floor.name).arg(floor.version).arg(level)
+                                         .arg(x).arg(y);
+}
+
+
+// --- TILE RECT ---
+// Area of the scene covered by a tile, with a scene unit being a pixel of the
+// map at full resolution.
+QRectF MapScene::tileRect(int level, int x, int y, const QPixmap &tile) {
+    qreal scale = 1 << (floor.levels - 1 - level);
+    return QRectF(x * mapTileSize * scale, y * mapTileSize * scale, 
+                  tile.width() * scale, tile.height() * scale);
+}
+
+
+// --- REQUEST TILE ---
+void MapScene::requestTile(const QString &path) {
+    if (pending.contains(path) || tiles.contains(path)) { return; }
+    
+    pending.insert(path);
+    QNetworkRequest request(QUrl(baseUrl + path));
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, 
+                         QNetworkRequest::PreferCache);
+    QNetworkReply* reply = network->get(request);
+    reply->setProperty("tile", path);
+}
+
+
+// --- TILE RECEIVED ---
+void MapScene::tileReceived(QNetworkReply* reply) {
+    QString path = reply->property("tile").toString();
+    pending.remove(path);
+    reply->deleteLater();
+    if (reply->error() != QNetworkReply::NoError) {
+        cerr << "Failed to fetch map tile " << path.toStdString() << ": " 
+             << reply->errorString().toStdString() << "\n";
+        return;
+    }
+    
+    QPixmap* tile = new QPixmap;
+    if (!tile->loadFromData(reply->readAll(), "PNG")) {
+        cerr << "Failed to parse map tile " << path.toStdString() << ".\n";
+        delete tile;
+        return;
+    }
+    
+    tiles.insert(path, tile, tile->width() * tile->height() * 4 / 1024);
+    invalidate(sceneRect(), QGraphicsScene::BackgroundLayer);
+}
+
+
+// --- DRAW BACKGROUND ---
+// Draw the tiles in 'rect' at the level matching the zoom of the view, that is
+// the coarsest level with at least one map pixel per screen pixel.
+void MapScene::drawBackground(QPainter* painter, const QRectF &rect) {
+    QGraphicsScene::drawBackground(painter, rect);
+    if (floor.levels == 0) { return; }
+    
+    qreal zoom = QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
+    int level = floor.levels - 1;
+    if (zoom > 0 && zoom < 1) { level -= qFloor(qLn(1 / zoom) / qLn(2)); }
+    if (level < 0) { level = 0; }
+    
+    // Size of the level, halving the size of the map (rounded up) per level.
+    int columns = floor.width;
+    int rows = floor.height;
+    for (int i = level; i < floor.levels - 1; ++i) {
+        columns = (columns + 1) / 2;
+        rows = (rows + 1) / 2;
+    }
+    
+    columns = (columns + mapTileSize - 1) / mapTileSize;
+    rows = (rows + mapTileSize - 1) / mapTileSize;
+    
+    qreal size = mapTileSize * (1 << (floor.levels - 1 - level));
+    QRectF visible = rect.intersected(sceneRect());
+    if (visible.isEmpty()) { return; }
+    
+    int left = qFloor(visible.left() / size);
+    int top = qFloor(visible.top() / size);
+    int right = qMin(qFloor(visible.right() / size), columns - 1);
+    int bottom = qMin(qFloor(visible.bottom() / size), rows - 1);
+    for (int y = top; y <= bottom; ++y) {
+        for (int x = left; x <= right; ++x) {
+            QString path = tilePath(level, x, y);
+            QPixmap* tile = tiles.object(path);
+            if (tile) {
+                painter->drawPixmap(tileRect(level, x, y, *tile), *tile, tile->rect());
+                continue;
+            }
+            
+            requestTile(path);
+            
+            // Show the nearest coarser tile which has arrived, cut to this tile.
+            for (int parent = level - 1; parent >= 0; --parent) {
+                int shift = level - parent;
+                QPixmap* cover = tiles.object(tilePath(parent, x >> shift, y >> shift));
+                if (!cover) { continue; }
+                
+                painter->save();
+                painter->setClipRect(QRectF(x * size, y * size, size, size), Qt::IntersectClip);
+                painter->drawPixmap(tileRect(parent, x >> shift, y >> shift, *cover), *cover, 
+                                    cover->rect());
+                painter->restore();
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef MAPSCENE_H
+#define MAPSCENE_H
+
+
+#include "mqttlistener.h"
+
+#include <QGraphicsScene>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QCache>
+#include <QSet>
+#include <QPixmap>
+
+
+// Width and height of a map tile, as generated by the C&C server.
+const int mapTileSize = 256;
+
+
+// Scene with the tiled map of a floor as background. Only the tiles visible at
+// the current zoom level are fetched from the C&C server. Until a tile has
+// arrived, the part of a coarser tile covering it is shown instead.
+class MapScene : public QGraphicsScene {
+    Q_OBJECT
+    
+    QNetworkAccessManager* network;
+    QCache<QString, QPixmap> tiles;     // By URL path relative to the base URL.
+    QSet<QString> pending;
+    QString baseUrl;
+    MapFloor floor;
+    
+    QString tilePath(int level, int x, int y);
+    QRectF tileRect(int level, int x, int y, const QPixmap &tile);
+    void requestTile(const QString &path);
+    
+public:
+    explicit MapScene(QObject* parent = 0);
+    
+    void setFloor(QString baseUrl, MapFloor floor);
+    MapFloor currentFloor() { return floor; }
+    
+protected:
+    void drawBackground(QPainter* painter, const QRectF &rect);
+    
+private slots:
+    void tileReceived(QNetworkReply* reply);
+};
+
+#endif // MAPSCENE_H
@@ -6,6 +6,7 @@ using namespace std;
 
 #include <QDataStream>
 #include <QVector>
+#include <QStringList>
 
 
 // --- CONSTRUCTOR ---
@@ -103,10 +104,16 @@ void MqttListener::on_connect(int rc) {
         // Subscribe to topics.
         string topic = "cc/ui/config/map";
         subscribe(0, topic.c_str());
+        topic = "cc/ui/config/floors";
+        subscribe(0, topic.c_str());
+        topic = "cc/ui/map/upload";
+        subscribe(0, topic.c_str());
         topic = "cc/nodes/all";
         subscribe(0, topic.c_str());
         topic = "cc/firmware/list";
         subscribe(0, topic.c_str());
+        topic = "cc/firmware/upload";
+        subscribe(0, topic.c_str());
         
         emit connected();
     }
@@ -141,6 +148,34 @@ void MqttListener::on_message(const mosquitto_message *message) {
         // Send the image to the UI.
         emit receivedMap(img);
     }
+    else if (topic == "cc/ui/config/floors") {
+        // The base URL of the map tiles, followed by the floors, separated by
+        // semi-colons. Each floor is 'name,width,height,levels,version'. A URL
+        // starting with ':' is on the MQTT broker's host.
+        QStringList parts = QString::fromStdString(payload).split(';');
+        QString url = parts.takeFirst();
+        if (url.startsWith(':')) { url = "http://" + host + url; }
+        
+        QVector<MapFloor> floors;
+        for (int i = 0; i < parts.size(); ++i) {
+            QStringList fields = parts[i].split(',');
+            if (fields.size() != 5) { continue; }
+            
+            MapFloor floor;
+            floor.name = fields[0];
+            floor.width = fields[1].toInt();
+            floor.height = fields[2].toInt();
+            floor.levels = fields[3].toInt();
+            floor.version = fields[4];
+            floors.append(floor);
+        }
+        
+        emit receivedFloors(url, floors);
+    }
+    else if (topic == "cc/ui/map/upload") {
+        // Result of a map upload: 'ok;<floor>' or 'error;<floor>;<reason>'.
+        emit receivedMapReply(QString::fromStdString(payload));
+    }
     else if (topic == "cc/nodes/all") {
         cout << "Received nodes message from the server.\n";
         
@@ -221,6 +256,11 @@ void MqttListener::on_message(const mosquitto_message *message) {
         // We should have received a semi-colon-separated list of firmware
         // filenames. Pass it on to any subscribing slots.
         QString msgList = QString::fromStdString(payload);
+        emit receivedFirmwareList(msgList);
+    }
+    else if (topic == "cc/firmware/upload") {
+        // Reply to a firmware upload command.
+        emit receivedUploadReply(QString::fromStdString(payload));
     }
 }
 
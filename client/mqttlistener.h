@@ -36,6 +36,16 @@ struct Node {
 };
 
 
+// Tiled map of a floor, as published by the C&C server.
+struct MapFloor {
+    QString name;
+    int width;
+    int height;
+    int levels;
+    QString version;
+};
+
+
 class MqttListener : public QObject, mosqpp::mosquittopp {
     Q_OBJECT
     
@@ -59,7 +69,10 @@ signals:
     void failed(QString err);
     void receivedNodes(QVector<Node> nodes);
     void receivedMap(QPixmap image);
+    void receivedFloors(QString url, QVector<MapFloor> floors);
+    void receivedMapReply(QString reply);
     void receivedFirmwareList(QString list);
+    void receivedUploadReply(QString reply);
     void finished();
     
 public slots:
@@ -0,0 +1,128 @@
+/*
+	dedupwindow.cpp - Implementation of the duplicate message filter.
+	
+	Revision 0
+	
+	Notes:
+			- Each hash is looked up in a few consecutive slots of one stripe.
+				Slots older than the window count as free.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#include "dedupwindow.h"
+
+#include <iostream>
+
+
+// Consecutive slots looked at for a hash.
+static const uint32_t probeLength = 4;
+
+static const uint64_t fnvOffset = 14695981039346656037ull;
+static const uint64_t fnvPrime = 1099511628211ull;
+
+
+// --- FNV ---
+static uint64_t fnv(uint64_t hash, const char* data, size_t len) {
+	for (size_t i = 0; i < len; ++i) {
+		hash ^= (unsigned char) data[i];
+		hash *= fnvPrime;
+	}
+	
+	return hash;
+}
+
+
+// --- CONSTRUCTOR ---
+// The capacity (number of messages remembered) is spread over the stripes,
+// each getting a power of two of slots.
+DedupWindow::DedupWindow(uint32_t windowMs, uint32_t capacity, uint32_t stripeCount) {
+	window = windowMs;
+	if (stripeCount == 0) { stripeCount = 1; }
+	uint32_t slots = probeLength;
+	while (slots * stripeCount < capacity) { slots <<= 1; }
+	slotMask = slots - 1;
+	for (uint32_t i = 0; i < stripeCount; ++i) {
+		stripes.push_back(new Stripe);
+		Slot empty = { 0, 0 };
+		stripes.back()->slots.assign(slots, empty);
+	}
+	
+	statChecked = 0;
+	statDuplicates = 0;
+	lastChecked = 0;
+	lastDuplicates = 0;
+}
+
+
+// --- DECONSTRUCTOR ---
+DedupWindow::~DedupWindow() {
+	for (unsigned int i = 0; i < stripes.size(); ++i) {
+		delete stripes[i];
+	}
+}
+
+
+// --- HASH ---
+// 64-bit FNV-1a of topic and payload, with a final avalanche step. The length
+// of the topic is included, so that the split between both matters. Never 0.
+uint64_t DedupWindow::hash(const char* topic, size_t topicLen, const char* payload,
+																size_t payloadLen) {
+	uint64_t h = fnv(fnvOffset, topic, topicLen);
+	h = fnv(h, (const char*) &topicLen, sizeof(topicLen));
+	h = fnv(h, payload, payloadLen);
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ull;
+	h ^= h >> 33;
+	return h ? h : 1;
+}
+
+
+// --- DUPLICATE ---
+// Check whether the message was seen within the window before the given time
+// (ms), remembering it if not.
+bool DedupWindow::duplicate(const char* topic, size_t topicLen, const char* payload,
+															size_t payloadLen, uint64_t time) {
+	++statChecked;
+	uint64_t h = hash(topic, topicLen, payload, payloadLen);
+	Stripe &stripe = *stripes[(h >> 32) % stripes.size()];
+	std::lock_guard<std::mutex> lk(stripe.lock);
+	Slot* oldest = 0;
+	for (uint32_t i = 0; i < probeLength; ++i) {
+		Slot &slot = stripe.slots[(h + i) & slotMask];
+		
+		// Messages are handled by several workers, so times can be slightly out
+		// of order.
+		uint64_t age = (time > slot.time) ? time - slot.time : slot.time - time;
+		if (slot.hash == h && age < window) {
+			++statDuplicates;
+			return true;
+		}
+		
+		// Unused slots have time 0, so are replaced first.
+		if (!oldest || slot.time < oldest->time) { oldest = &slot; }
+	}
+	
+	oldest->hash = h;
+	oldest->time = time;
+	return false;
+}
+
+
+// --- REPORT ---
+// Report the duplicate rate over the past interval (in seconds).
+void DedupWindow::report(uint32_t interval, const std::string &name) {
+	if (interval == 0) { interval = 1; }
+	uint64_t checked = statChecked;
+	uint64_t duplicates = statDuplicates;
+	uint64_t count = checked - lastChecked;
+	uint64_t dropped = duplicates - lastDuplicates;
+	std::cout << name << ": " << dropped / interval << " duplicates/s dropped ("
+				<< ((count > 0) ? dropped * 100.0 / count : 0.0) << "% of messages), "
+				<< duplicates << " in total.\n";
+	lastChecked = checked;
+	lastDuplicates = duplicates;
+}
@@ -0,0 +1,74 @@
+/*
+	dedupwindow.h - Header file for the duplicate message filter.
+	
+	Revision 0
+	
+	Notes:
+			- Sensor readings are published with QoS 1, so after a reconnect
+				the broker may deliver a message again. A message whose topic
+				and payload were already seen less than the window length ago
+				is considered a duplicate.
+			- The window has to be shorter than the interval at which nodes
+				publish, or a reading repeating the previous value would be
+				dropped as well.
+			- Messages are remembered by a 64-bit hash of topic and payload in
+				a fixed-size table, so memory use doesn't depend on the number
+				of series. Once the table is full, the oldest of the slots a
+				message maps to is replaced, which can only let a duplicate through, never drop
+				a new message.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#ifndef DEDUPWINDOW_H
+#define DEDUPWINDOW_H
+
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+
+class DedupWindow {
+	struct Slot {
+		uint64_t hash;		// 0 if unused.
+		uint64_t time;		// ms
+	};
+	
+	struct Stripe {
+		std::mutex lock;
+		std::vector<Slot> slots;
+	};
+	
+	uint64_t window;
+	uint32_t slotMask;
+	std::vector<Stripe*> stripes;
+	std::atomic<uint64_t> statChecked;
+	std::atomic<uint64_t> statDuplicates;
+	uint64_t lastChecked;
+	uint64_t lastDuplicates;
+	
+	DedupWindow(const DedupWindow&);
+	DedupWindow& operator=(const DedupWindow&);
+
+public:
+	DedupWindow(uint32_t windowMs, uint32_t capacity = 65536, uint32_t stripeCount = 16);
+	~DedupWindow();
+	
+	static uint64_t hash(const char* topic, size_t topicLen, const char* payload, size_t payloadLen);
+	
+	bool duplicate(const char* topic, size_t topicLen, const char* payload, size_t payloadLen,
+																uint64_t time);
+	bool duplicate(const std::string &topic, const std::string &payload, uint64_t time) {
+		return duplicate(topic.data(), topic.length(), payload.data(), payload.length(), time);
+	}
+	
+	uint64_t getChecked() const { return statChecked; }
+	uint64_t getDuplicates() const { return statDuplicates; }
+	void report(uint32_t interval, const std::string &name);
+};
+
+#endif
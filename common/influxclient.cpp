@@ -0,0 +1,492 @@
+/*
+	influxclient.cpp - Implementation of the shared InfluxDB HTTP client.
+	
+	Revision 0
+	
+	Notes:
+			- Poco's HTTPClientSession does not support HTTP pipelining, so
+				concurrency comes from running requests in parallel over the
+				pooled keep-alive sessions instead.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#include "influxclient.h"
+
+#include <iostream>
+#include <sstream>
+
+#include <Poco/Net/HTTPSClientSession.h>
+#include <Poco/Net/HTTPResponse.h>
+#include <Poco/StreamCopier.h>
+#include <Poco/NullStream.h>
+#include <Poco/Timespan.h>
+#include <Poco/URI.h>
+#include <Poco/Exception.h>
+
+using namespace Poco;
+using namespace Poco::Net;
+
+
+// --- CONSTRUCTOR ---
+InfluxClient::InfluxClient(std::string host, int port, std::string db, bool secure,
+							uint32_t maxSessions) {
+	this->host = host;
+	this->port = port;
+	this->db = db;
+	this->secure = secure;
+	this->maxSessions = (maxSessions > 0) ? maxSessions : 1;
+	sessionCount = 0;
+	acquireTimeout = 5000;
+	requestTimeout = 10;
+	keepAliveTimeout = 30;
+	breakerThreshold = 5;
+	breakerCooldown = 10000;
+	failureCount = 0;
+	breakerOpen = false;
+	probing = false;
+	closedAfter = 0;
+	statRequests = 0;
+	statFailures = 0;
+	statRejected = 0;
+	statShortCircuits = 0;
+	statReconnects = 0;
+	
+	std::cout << "Influx client for " << host << ":" << port << (secure ? " (HTTPS)" : " (HTTP)")
+				<< ", " << this->maxSessions << " sessions." << std::endl;
+}
+
+
+// --- DECONSTRUCTOR ---
+InfluxClient::~InfluxClient() {
+	std::lock_guard<std::mutex> lk(poolMutex);
+	for (uint32_t i = 0; i < idle.size(); ++i) {
+		delete idle[i];
+	}
+	
+	idle.clear();
+}
+
+
+// --- SET TIMEOUTS ---
+// Only affects sessions created after this call.
+void InfluxClient::setTimeouts(uint32_t requestSec, uint32_t keepAliveSec, uint32_t acquireMs) {
+	std::lock_guard<std::mutex> lk(poolMutex);
+	requestTimeout = requestSec;
+	keepAliveTimeout = keepAliveSec;
+	acquireTimeout = acquireMs;
+}
+
+
+// --- SET BREAKER ---
+// A threshold of zero disables the circuit breaker.
+void InfluxClient::setBreaker(uint32_t threshold, uint32_t cooldownMs) {
+	std::lock_guard<std::mutex> lk(breakerMutex);
+	breakerThreshold = threshold;
+	breakerCooldown = cooldownMs;
+}
+
+
+// --- ACQUIRE ---
+// Take an idle session from the pool, create a new one if below the limit, or
+// wait for one to be released. Returns null on timeout.
+HTTPClientSession* InfluxClient::acquire() {
+	std::unique_lock<std::mutex> lk(poolMutex);
+	if (!poolCv.wait_for(lk, std::chrono::milliseconds(acquireTimeout), [this] {
+				return !idle.empty() || sessionCount < maxSessions;
+			})) {
+		return 0;
+	}
+	
+	if (!idle.empty()) {
+		HTTPClientSession* session = idle.back();
+		idle.pop_back();
+		return session;
+	}
+	
+	HTTPClientSession* session;
+	if (secure) { session = new HTTPSClientSession(host, port); }
+	else { session = new HTTPClientSession(host, port); }
+	
+	session->setKeepAlive(true);
+	session->setKeepAliveTimeout(Timespan(keepAliveTimeout, 0));
+	session->setTimeout(Timespan(requestTimeout, 0));
+	++sessionCount;
+	
+	return session;
+}
+
+
+// --- RELEASE ---
+// Return a session to the pool. Sessions in an unknown state (after an error,
+// or with unread response data) are reset so the next user reconnects.
+void InfluxClient::release(HTTPClientSession* session, bool reusable) {
+	if (!reusable) {
+		session->reset();
+		++statReconnects;
+	}
+	
+	{
+		std::lock_guard<std::mutex> lk(poolMutex);
+		idle.push_back(session);
+	}
+	
+	poolCv.notify_one();
+}
+
+
+// --- ALLOW REQUEST ---
+// Circuit breaker gate. While open, requests fail fast. Once the cooldown has
+// expired a single probe request is allowed through to test the waters.
+bool InfluxClient::allowRequest() {
+	std::lock_guard<std::mutex> lk(breakerMutex);
+	if (!breakerOpen) { return true; }
+	if (probing) { return false; }
+	
+	std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - openedAt;
+	if (elapsed < std::chrono::milliseconds(breakerCooldown)) { return false; }
+	
+	probing = true;
+	return true;
+}
+
+
+// --- REPORT RESULT ---
+void InfluxClient::reportResult(bool success) {
+	std::lock_guard<std::mutex> lk(breakerMutex);
+	probing = false;
+	if (success) {
+		if (breakerOpen) {
+			std::cout << "Influx: connection to " << host << " restored. Closing circuit." << std::endl;
+		}
+		
+		failureCount = 0;
+		breakerOpen = false;
+		closedAfter = 0;
+		return;
+	}
+	
+	++failureCount;
+	if (breakerThreshold > 0 && failureCount >= breakerThreshold) {
+		if (!breakerOpen) {
+			std::cerr << "Influx: " << failureCount << " consecutive failures on " << host
+						<< ". Opening circuit." << std::endl;
+		}
+		
+		breakerOpen = true;
+		openedAt = std::chrono::steady_clock::now();
+		closedAfter = std::chrono::duration_cast<std::chrono::milliseconds>(
+								openedAt.time_since_epoch()).count() + breakerCooldown;
+	}
+}
+
+
+// Stream buffer between the response stream and the caller's reader. Records
+// a failure to read from the network, so that it can be told apart from the
+// errors of the reader itself, and ends the body for the reader at that point.
+class ResponseBuf : public std::streambuf {
+	std::istream &in;
+	char buffer[4096];
+	
+	int_type underflow() {
+		if (failed) { return traits_type::eof(); }
+		std::streamsize n = 0;
+		try {
+			in.read(buffer, sizeof(buffer));
+			n = in.gcount();
+			if (in.bad()) {
+				failed = true;
+				error = "Reading the response body failed.";
+			}
+		}
+		catch (Exception &exc) {
+			failed = true;
+			error = exc.displayText();
+		}
+		catch (std::exception &exc) {
+			failed = true;
+			error = exc.what();
+		}
+		
+		if (n <= 0) { return traits_type::eof(); }
+		setg(buffer, buffer, buffer + n);
+		return traits_type::to_int_type(buffer[0]);
+	}
+	
+public:
+	bool failed;
+	std::string error;
+	
+	ResponseBuf(std::istream &in) : in(in), failed(false) { }
+};
+
+
+// --- READ RESPONSE ---
+// Run the caller's reader on the response body. Failing to read the body from
+// the network (e.g. a truncated chunked response) means Influx is unavailable,
+// whatever the reader made of it. A reader stopping with InfluxAbort aborts the
+// request. Any other exception of the reader, such as a parse error or a failed
+// write to its own client, means the response was rejected, which doesn't count
+// against the circuit breaker.
+InfluxStatus InfluxClient::readResponse(const InfluxReader &reader, std::istream &rs, 
+															std::string* error) {
+	ResponseBuf buf(rs);
+	std::istream body(&buf);
+	bool thrown = false;
+	bool aborted = false;
+	std::string msg;
+	try {
+		reader(body);
+	}
+	catch (InfluxAbort &exc) {
+		aborted = true;
+		msg = exc.what();
+	}
+	catch (Exception &exc) {
+		thrown = true;
+		msg = exc.displayText();
+	}
+	catch (std::exception &exc) {
+		thrown = true;
+		msg = exc.what();
+	}
+	
+	if (buf.failed) {
+		std::cerr << "Reading Influx response failed: " << buf.error << std::endl;
+		if (error) { *error = buf.error; }
+		return INFLUX_UNAVAILABLE;
+	}
+	
+	if (aborted) {
+		if (error) { *error = msg; }
+		return INFLUX_ABORTED;
+	}
+	
+	if (thrown) {
+		std::cerr << "Influx response handling failed: " << msg << std::endl;
+		if (error) { *error = msg; }
+		return INFLUX_REJECTED;
+	}
+	
+	return INFLUX_OK;
+}
+
+
+// --- SET OBSERVER ---
+// Set a callback which is informed of the result and duration of each request,
+// e.g. for metrics. Call before the client is used.
+void InfluxClient::setObserver(const InfluxObserver &observer) {
+	this->observer = observer;
+}
+
+
+// --- EXECUTE ---
+// Send a request over a pooled session. A stale keep-alive session gets a
+// single retry on a fresh connection.
+InfluxStatus InfluxClient::execute(HTTPRequest &request, const std::string &body,
+							const InfluxReader &reader, std::string* error) {
+	if (!allowRequest()) {
+		++statShortCircuits;
+		if (error) { *error = "Circuit open."; }
+		return INFLUX_UNAVAILABLE;
+	}
+	
+	HTTPClientSession* session = acquire();
+	if (!session) {
+		// Pool exhaustion isn't Influx' fault. Leave the breaker alone, but
+		// release the probe slot.
+		{
+			std::lock_guard<std::mutex> lk(breakerMutex);
+			probing = false;
+		}
+		
+		if (error) { *error = "Timeout waiting for an Influx session."; }
+		return INFLUX_UNAVAILABLE;
+	}
+	
+	for (int attempt = 0; attempt < 2; ++attempt) {
+		bool reused = session->connected();
+		bool responded = false;
+		try {
+			++statRequests;
+			if (body.empty()) {
+				session->sendRequest(request);
+			}
+			else {
+				request.setContentLength(body.length());
+				session->sendRequest(request) << body;
+			}
+			
+			HTTPResponse response;
+			std::istream &rs = session->receiveResponse(response);
+			responded = true;
+			HTTPResponse::HTTPStatus status = response.getStatus();
+			if (status >= 200 && status < 300) {
+				InfluxStatus read = reader ? readResponse(reader, rs, error) : INFLUX_OK;
+				if (read != INFLUX_OK) {
+					// The response may be partially read. Don't reuse the session.
+					release(session, false);
+					if (read == INFLUX_ABORTED) {
+						// Influx did nothing wrong, but didn't finish either.
+						// Leave the breaker alone, but release the probe slot.
+						std::lock_guard<std::mutex> lk(breakerMutex);
+						probing = false;
+						return read;
+					}
+					
+					if (read == INFLUX_UNAVAILABLE) { ++statFailures; }
+					else { ++statRejected; }
+					
+					reportResult(read == INFLUX_REJECTED);
+					return read;
+				}
+				
+				// Drain any remaining data so the session can be reused.
+				NullOutputStream null;
+				StreamCopier::copyStream(rs, null);
+				release(session, true);
+				reportResult(true);
+				return INFLUX_OK;
+			}
+			
+			std::string msg;
+			StreamCopier::copyToString(rs, msg);
+			if (error) { *error = msg; }
+			release(session, true);
+			if (status >= 500) {
+				++statFailures;
+				std::cerr << "Received InfluxDB error: " << response.getReason() << std::endl;
+				reportResult(false);
+				return INFLUX_UNAVAILABLE;
+			}
+			
+			// A client error still means Influx is up.
+			++statRejected;
+			std::cerr << "InfluxDB rejected request: " << response.getReason() << " - "
+						<< msg << std::endl;
+			reportResult(true);
+			return INFLUX_REJECTED;
+		}
+		catch (Exception &exc) {
+			session->reset();
+			++statReconnects;
+			if (reused && !responded && attempt == 0) { continue; }
+			
+			++statFailures;
+			std::cerr << "Influx request failed: " << exc.displayText() << std::endl;
+			if (error) { *error = exc.displayText(); }
+			release(session, false);
+			reportResult(false);
+			return INFLUX_UNAVAILABLE;
+		}
+		catch (std::exception &exc) {
+			// E.g. out of memory. The session and the probe slot still have to
+			// be given back.
+			++statFailures;
+			std::cerr << "Influx request failed: " << exc.what() << std::endl;
+			if (error) { *error = exc.what(); }
+			release(session, false);
+			reportResult(false);
+			return INFLUX_UNAVAILABLE;
+		}
+	}
+	
+	// Not reached.
+	release(session, false);
+	return INFLUX_UNAVAILABLE;
+}
+
+
+// --- NOTIFY ---
+void InfluxClient::notify(bool query, InfluxStatus status, 
+											std::chrono::steady_clock::time_point start) {
+	if (!observer) { return; }
+	observer(query, status, std::chrono::duration_cast<std::chrono::microseconds>(
+									std::chrono::steady_clock::now() - start).count());
+}
+
+
+// --- WRITE ---
+// Write one or more newline-separated points in line protocol format.
+InfluxStatus InfluxClient::write(const std::string &lines, std::string* error) {
+	return write(lines, std::string(), error);
+}
+
+
+InfluxStatus InfluxClient::write(const std::string &lines, const std::string &params, std::string* error) {
+	std::string uri = "/write?db=" + db;
+	if (!params.empty()) { uri += "&" + params; }
+	HTTPRequest request(HTTPRequest::HTTP_POST, uri, HTTPMessage::HTTP_1_1);
+	request.setContentType("application/x-www-form-urlencoded");
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	InfluxStatus res = execute(request, lines, InfluxReader(), error);
+	notify(false, res, start);
+	return res;
+}
+
+
+// --- QUERY ---
+// Run an InfluxQL query, returning the raw JSON response.
+InfluxStatus InfluxClient::query(const std::string &q, std::string &result) {
+	result.clear();
+	return query(q, [&result](std::istream &rs) { StreamCopier::copyToString(rs, result); });
+}
+
+
+// Run an InfluxQL query, handing the response body stream to the reader.
+// Additional URL parameters (e.g. 'chunked=true&epoch=s') can be provided.
+InfluxStatus InfluxClient::query(const std::string &q, const InfluxReader &reader,
+							const std::string &params) {
+	std::string encoded;
+	URI::encode(q, "&+;=?#", encoded);
+	std::string uri = "/query?db=" + db + "&q=" + encoded;
+	if (!params.empty()) { uri += "&" + params; }
+	HTTPRequest request(HTTPRequest::HTTP_GET, uri, HTTPMessage::HTTP_1_1);
+	std::string error;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	InfluxStatus res = execute(request, std::string(), reader, &error);
+	notify(true, res, start);
+	if (res != INFLUX_OK) {
+		std::cerr << "Influx query failed: " << error << std::endl;
+	}
+	
+	return res;
+}
+
+
+// --- IS AVAILABLE ---
+// Whether requests are currently let through, i.e. the circuit is closed or its
+// cooldown has expired. Lock-free, for routing decisions on every point.
+bool InfluxClient::isAvailable() {
+	int64_t after = closedAfter;
+	if (after == 0) { return true; }
+	
+	int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+								std::chrono::steady_clock::now().time_since_epoch()).count();
+	return now >= after;
+}
+
+
+// --- GET STATS ---
+InfluxStats InfluxClient::getStats() {
+	InfluxStats stats;
+	stats.requests = statRequests;
+	stats.failures = statFailures;
+	stats.rejected = statRejected;
+	stats.shortCircuits = statShortCircuits;
+	stats.reconnects = statReconnects;
+	
+	{
+		std::lock_guard<std::mutex> lk(poolMutex);
+		stats.sessions = sessionCount;
+		stats.idle = idle.size();
+	}
+	
+	{
+		std::lock_guard<std::mutex> lk(breakerMutex);
+		stats.open = breakerOpen;
+	}
+	
+	return stats;
+}
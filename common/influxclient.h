@@ -0,0 +1,138 @@
+/*
+	influxclient.h - Header file for the shared InfluxDB HTTP client.
+	
+	Revision 0
+	
+	Notes:
+			- Thread-safe. A bounded pool of keep-alive sessions is shared by
+				all callers, so timer threads, MQTT threads and HTTP handlers
+				can use the same instance.
+			- A simple circuit breaker stops hammering an unreachable Influx
+				instance: after a number of consecutive failures all requests
+				fail fast until the cooldown expires, after which a single
+				probe request is let through.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#ifndef INFLUXCLIENT_H
+#define INFLUXCLIENT_H
+
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <istream>
+#include <stdexcept>
+#include <cstdint>
+
+#include <Poco/Net/HTTPClientSession.h>
+#include <Poco/Net/HTTPRequest.h>
+
+
+enum InfluxStatus {
+	INFLUX_OK = 0,
+	INFLUX_REJECTED,		// Influx refused the request (4xx). Retrying won't help.
+	INFLUX_UNAVAILABLE,		// Network error, 5xx or open circuit. Retry later.
+	INFLUX_ABORTED			// The reader stopped with InfluxAbort.
+};
+
+
+// Thrown by a reader to stop reading a response for a reason of its own, e.g.
+// because its client went away. The request ends with INFLUX_ABORTED, which
+// doesn't count against Influx.
+class InfluxAbort : public std::runtime_error {
+public:
+	InfluxAbort(const std::string &msg) : std::runtime_error(msg) { }
+};
+
+
+struct InfluxStats {
+	uint64_t requests;		// Requests sent to Influx.
+	uint64_t failures;		// Requests which failed (network or 5xx).
+	uint64_t rejected;		// Requests refused by Influx (4xx).
+	uint64_t shortCircuits;	// Requests refused locally by the open circuit.
+	uint64_t reconnects;	// Sessions reset after an error.
+	uint32_t sessions;		// Sessions currently allocated.
+	uint32_t idle;			// Sessions currently idle in the pool.
+	bool open;				// Circuit breaker state.
+};
+
+
+typedef std::function<void(std::istream &body)> InfluxReader;
+
+// Called after each write or query with the result and its duration (us).
+typedef std::function<void(bool query, InfluxStatus status, uint64_t duration)> InfluxObserver;
+
+
+class InfluxClient {
+	std::string host;
+	int port;
+	std::string db;
+	bool secure;
+	
+	// Session pool.
+	uint32_t maxSessions;
+	uint32_t sessionCount;
+	std::vector<Poco::Net::HTTPClientSession*> idle;
+	std::mutex poolMutex;
+	std::condition_variable poolCv;
+	uint32_t acquireTimeout;	// ms
+	uint32_t requestTimeout;	// s
+	uint32_t keepAliveTimeout;	// s
+	
+	// Circuit breaker.
+	std::mutex breakerMutex;
+	uint32_t breakerThreshold;
+	uint32_t breakerCooldown;	// ms
+	uint32_t failureCount;
+	bool breakerOpen;
+	bool probing;
+	std::chrono::steady_clock::time_point openedAt;
+	std::atomic<int64_t> closedAfter;	// Lock-free copy for isAvailable(), ms.
+	
+	// Statistics.
+	std::atomic<uint64_t> statRequests;
+	std::atomic<uint64_t> statFailures;
+	std::atomic<uint64_t> statRejected;
+	std::atomic<uint64_t> statShortCircuits;
+	std::atomic<uint64_t> statReconnects;
+	InfluxObserver observer;
+	
+	Poco::Net::HTTPClientSession* acquire();
+	void release(Poco::Net::HTTPClientSession* session, bool reusable);
+	bool allowRequest();
+	void reportResult(bool success);
+	InfluxStatus readResponse(const InfluxReader &reader, std::istream &rs, std::string* error);
+	InfluxStatus execute(Poco::Net::HTTPRequest &request, const std::string &body,
+							const InfluxReader &reader, std::string* error);
+	void notify(bool query, InfluxStatus status, std::chrono::steady_clock::time_point start);
+
+public:
+	InfluxClient(std::string host, int port, std::string db, bool secure,
+							uint32_t maxSessions = 4);
+	~InfluxClient();
+	
+	void setTimeouts(uint32_t requestSec, uint32_t keepAliveSec, uint32_t acquireMs);
+	void setBreaker(uint32_t threshold, uint32_t cooldownMs);
+	void setObserver(const InfluxObserver &observer);
+	
+	InfluxStatus write(const std::string &lines, std::string* error = 0);
+	InfluxStatus write(const std::string &lines, const std::string &params, std::string* error);
+	InfluxStatus query(const std::string &q, std::string &result);
+	InfluxStatus query(const std::string &q, const InfluxReader &reader,
+							const std::string &params = std::string());
+	
+	bool isAvailable();
+	InfluxStats getStats();
+	const std::string& getDb() { return db; }
+	const std::string& getHost() { return host; }
+	int getPort() { return port; }
+};
+
+#endif
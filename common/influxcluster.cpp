@@ -0,0 +1,267 @@
+/*
+	influxcluster.cpp - Implementation of the sharded InfluxDB client.
+	
+	Revision 0
+	
+	Notes:
+			- Hashes are FNV-1a with a final avalanche step, as plain FNV-1a
+				spreads short, similar strings like the virtual node names
+				poorly over the ring.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#include "influxcluster.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+
+// Virtual nodes per endpoint on the hash ring.
+static const uint32_t vnodesPerEndpoint = 128;
+
+static const uint32_t fnvOffset = 2166136261u;
+static const uint32_t fnvPrime = 16777619u;
+
+
+// --- FNV ---
+static uint32_t fnv(uint32_t hash, const char* data, size_t len) {
+	for (size_t i = 0; i < len; ++i) {
+		hash ^= (unsigned char) data[i];
+		hash *= fnvPrime;
+	}
+	
+	return hash;
+}
+
+
+// --- FINALISE ---
+static uint32_t finalise(uint32_t hash) {
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6b;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+
+// --- FIND UNESCAPED ---
+// Find the first of the characters in the line protocol string which is not
+// escaped with a backslash. Returns 'len' if not found.
+static size_t findUnescaped(const char* line, size_t start, size_t len, const char* chars) {
+	for (size_t i = start; i < len; ++i) {
+		if (line[i] == '\\') { ++i; continue; }
+		for (const char* c = chars; *c; ++c) {
+			if (line[i] == *c) { return i; }
+		}
+	}
+	
+	return len;
+}
+
+
+// --- CONSTRUCTOR ---
+// 'hosts' is a comma-separated list of 'host[:port]' endpoints.
+InfluxCluster::InfluxCluster(const std::string &hosts, int defaultPort, std::string db,
+							bool secure, uint32_t poolSize, uint32_t replicas) {
+	size_t start = 0;
+	while (start <= hosts.length()) {
+		size_t end = hosts.find(',', start);
+		if (end == std::string::npos) { end = hosts.length(); }
+		size_t first = hosts.find_first_not_of(" \t", start);
+		size_t last = hosts.find_last_not_of(" \t", end - 1);
+		std::string endpoint;
+		if (first < end && last != std::string::npos && last >= first) {
+			endpoint = hosts.substr(first, last - first + 1);
+		}
+		
+		start = end + 1;
+		if (endpoint.empty()) { continue; }
+		
+		std::string host = endpoint;
+		int port = defaultPort;
+		size_t colon = endpoint.rfind(':');
+		if (colon != std::string::npos && colon + 1 < endpoint.length() &&
+				endpoint.find_first_not_of("0123456789", colon + 1) == std::string::npos) {
+			host = endpoint.substr(0, colon);
+			port = atoi(endpoint.c_str() + colon + 1);
+		}
+		
+		uint32_t index = clients.size();
+		clients.push_back(new InfluxClient(host, port, db, secure, poolSize));
+		
+		std::string name = host + ":" + std::to_string(port) + "-";
+		for (uint32_t i = 0; i < vnodesPerEndpoint; ++i) {
+			std::string vnode = name + std::to_string(i);
+			VNode node;
+			node.hash = finalise(fnv(fnvOffset, vnode.data(), vnode.length()));
+			node.endpoint = index;
+			ring.push_back(node);
+		}
+	}
+	
+	std::sort(ring.begin(), ring.end());
+	
+	if (replicas < 1) { replicas = 1; }
+	if (replicas > maxReplicas) { replicas = maxReplicas; }
+	if (replicas > clients.size()) { replicas = clients.size(); }
+	this->replicas = replicas;
+}
+
+
+// --- DECONSTRUCTOR ---
+InfluxCluster::~InfluxCluster() {
+	for (unsigned int i = 0; i < clients.size(); ++i) {
+		delete clients[i];
+	}
+}
+
+
+// --- SET TIMEOUTS ---
+void InfluxCluster::setTimeouts(uint32_t requestSec, uint32_t keepAliveSec, uint32_t acquireMs) {
+	for (unsigned int i = 0; i < clients.size(); ++i) {
+		clients[i]->setTimeouts(requestSec, keepAliveSec, acquireMs);
+	}
+}
+
+
+// --- SET BREAKER ---
+void InfluxCluster::setBreaker(uint32_t threshold, uint32_t cooldownMs) {
+	for (unsigned int i = 0; i < clients.size(); ++i) {
+		clients[i]->setBreaker(threshold, cooldownMs);
+	}
+}
+
+
+// --- SERIES HASH ---
+// Hash of the series a line of line protocol belongs to. Only the measurement
+// and tag set are looked at, so the line may or may not have a field set.
+uint32_t InfluxCluster::seriesHash(const char* line, size_t len) {
+	size_t keyEnd = findUnescaped(line, 0, len, " ");
+	size_t measEnd = findUnescaped(line, 0, keyEnd, ",");
+	uint32_t hash = fnv(fnvOffset, line, measEnd);
+	
+	// Look for the location tag.
+	size_t pos = measEnd;
+	while (pos < keyEnd) {
+		size_t tagEnd = findUnescaped(line, pos + 1, keyEnd, ",");
+		if (tagEnd - pos > 9 && line[pos + 9] == '=' &&
+				std::equal(line + pos + 1, line + pos + 9, "location")) {
+			return finalise(fnv(hash, line + pos, tagEnd - pos));
+		}
+		
+		pos = tagEnd;
+	}
+	
+	// No location tag. Use the whole series key.
+	return finalise(fnv(hash, line + measEnd, keyEnd - measEnd));
+}
+
+
+// Hash of the series with the given measurement and location.
+uint32_t InfluxCluster::seriesHash(const std::string &measurement, const std::string &location) {
+	std::string key = measurement + ",location=";
+	for (unsigned int i = 0; i < location.length(); ++i) {
+		char c = location[i];
+		if (c == ',' || c == '=' || c == ' ') { key += '\\'; }
+		key += c;
+	}
+	
+	return seriesHash(key.data(), key.length());
+}
+
+
+// --- ROUTE ---
+// Find the endpoints for the series with the given hash, writing their indices
+// into 'shards' (with room for maxReplicas entries). Walks the ring from the
+// hash onwards, taking the first distinct healthy endpoints. If there aren't
+// enough of those, the remaining slots are filled with unhealthy ones, whose
+// writes then fail or get retried by the caller. Returns the number of shards.
+uint32_t InfluxCluster::route(uint32_t hash, uint32_t* shards) {
+	if (clients.size() == 1) {
+		shards[0] = 0;
+		return 1;
+	}
+	
+	VNode key;
+	key.hash = hash;
+	key.endpoint = 0;
+	size_t first = std::lower_bound(ring.begin(), ring.end(), key) - ring.begin();
+	uint32_t count = 0;
+	for (int pass = 0; pass < 2 && count < replicas; ++pass) {
+		for (size_t i = 0; i < ring.size() && count < replicas; ++i) {
+			uint32_t endpoint = ring[(first + i) % ring.size()].endpoint;
+			bool taken = false;
+			for (uint32_t j = 0; j < count; ++j) {
+				if (shards[j] == endpoint) { taken = true; }
+			}
+			
+			if (taken || (pass == 0 && !clients[endpoint]->isAvailable())) { continue; }
+			shards[count++] = endpoint;
+		}
+	}
+	
+	return count;
+}
+
+
+// --- READER ---
+// The endpoint to query for the series. This is the first endpoint the series
+// is currently written to, i.e. its owner if healthy, else a replica or the
+// endpoint writes were rerouted to.
+InfluxClient* InfluxCluster::reader(const std::string &measurement, const std::string &location) {
+	uint32_t shards[maxReplicas];
+	route(seriesHash(measurement, location), shards);
+	return clients[shards[0]];
+}
+
+
+// --- WRITE ---
+// Write lines of line protocol, each to the endpoints of its series. Returns
+// the worst status of the requests made.
+InfluxStatus InfluxCluster::write(const std::string &lines, std::string* error) {
+	return write(lines, std::string(), error);
+}
+
+
+InfluxStatus InfluxCluster::write(const std::string &lines, const std::string &params,
+																std::string* error) {
+	if (clients.size() == 1) { return clients[0]->write(lines, params, error); }
+	
+	if (error) { error->clear(); }
+	std::vector<std::string> bodies(clients.size());
+	uint32_t shards[maxReplicas];
+	size_t start = 0;
+	while (start < lines.length()) {
+		size_t end = lines.find('\n', start);
+		if (end == std::string::npos) { end = lines.length(); }
+		if (end > start) {
+			uint32_t count = route(seriesHash(lines.data() + start, end - start), shards);
+			for (uint32_t i = 0; i < count; ++i) {
+				bodies[shards[i]].append(lines, start, end - start);
+				bodies[shards[i]] += '\n';
+			}
+		}
+		
+		start = end + 1;
+	}
+	
+	// Statuses are ordered by severity.
+	InfluxStatus status = INFLUX_OK;
+	for (unsigned int i = 0; i < bodies.size(); ++i) {
+		if (bodies[i].empty()) { continue; }
+		std::string err;
+		InfluxStatus res = clients[i]->write(bodies[i], params, &err);
+		if (res == INFLUX_OK) { continue; }
+		if (res > status) { status = res; }
+		if (error) {
+			if (!error->empty()) { *error += "; "; }
+			*error += clients[i]->getHost() + ":" + std::to_string(clients[i]->getPort()) +
+																": " + err;
+		}
+	}
+	
+	return status;
+}
@@ -0,0 +1,74 @@
+/*
+	influxcluster.h - Header file for the sharded InfluxDB client.
+	
+	Revision 0
+	
+	Notes:
+			- Spreads series over several InfluxDB endpoints using consistent
+				hashing, so adding or removing an endpoint only moves a small
+				share of the series. Each endpoint gets a fixed number of
+				virtual nodes on the hash ring.
+			- A series is identified by its measurement and 'location' tag,
+				which is what all queries select on. Lines without a location
+				tag are routed on their measurement and full tag set.
+			- With a replication factor of 2, every series is written to the
+				next distinct endpoint on the ring as well.
+			- Endpoints whose circuit breaker is open are skipped in favour of
+				the next healthy endpoint on the ring. While this is the case,
+				queries against the original owner miss the rerouted points
+				unless a replica holds them.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#ifndef INFLUXCLUSTER_H
+#define INFLUXCLUSTER_H
+
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "influxclient.h"
+
+
+class InfluxCluster {
+	struct VNode {
+		uint32_t hash;
+		uint32_t endpoint;
+		
+		bool operator<(const VNode &other) const { return hash < other.hash; }
+	};
+	
+	std::vector<InfluxClient*> clients;
+	std::vector<VNode> ring;
+	uint32_t replicas;
+	
+	InfluxCluster(const InfluxCluster&);
+	InfluxCluster& operator=(const InfluxCluster&);
+
+public:
+	static const uint32_t maxReplicas = 2;
+	
+	InfluxCluster(const std::string &hosts, int defaultPort, std::string db, bool secure,
+							uint32_t poolSize = 4, uint32_t replicas = 1);
+	~InfluxCluster();
+	
+	void setTimeouts(uint32_t requestSec, uint32_t keepAliveSec, uint32_t acquireMs);
+	void setBreaker(uint32_t threshold, uint32_t cooldownMs);
+	
+	static uint32_t seriesHash(const char* line, size_t len);
+	static uint32_t seriesHash(const std::string &measurement, const std::string &location);
+	uint32_t route(uint32_t hash, uint32_t* shards);
+	InfluxClient* reader(const std::string &measurement, const std::string &location);
+	
+	InfluxStatus write(const std::string &lines, std::string* error = 0);
+	InfluxStatus write(const std::string &lines, const std::string &params, std::string* error);
+	
+	uint32_t size() { return clients.size(); }
+	uint32_t getReplicas() { return replicas; }
+	InfluxClient* getClient(uint32_t i) { return clients[i]; }
+};
+
+#endif
@@ -0,0 +1,482 @@
+/*
+	influxparser.cpp - Implementation of the streaming InfluxDB response parser.
+
+	Revision 0
+
+	Notes:
+			- Row values and series strings are reused between rows, so a
+				large response causes no allocations beyond the first rows.
+
+	2026/10/19, Maya Posch
+*/
+
+
+#include "influxparser.h"
+
+#include <cstdlib>
+
+
+// Static empty string for missing tags.
+static const std::string emptyString;
+
+
+// --- GET TAG ---
+const std::string& InfluxSeries::getTag(const std::string &key) const {
+	for (unsigned int i = 0; i < tags.size(); ++i) {
+		if (tags[i].first == key) { return tags[i].second; }
+	}
+
+	return emptyString;
+}
+
+
+// --- GET COLUMN ---
+// Returns the index of the column, or -1 if not found.
+int InfluxSeries::getColumn(const std::string &column) const {
+	for (unsigned int i = 0; i < columns.size(); ++i) {
+		if (columns[i] == column) { return i; }
+	}
+
+	return -1;
+}
+
+
+// --- CONSTRUCTOR ---
+InfluxParser::InfluxParser(InfluxRowHandler handler) {
+	this->handler = handler;
+	sb = 0;
+	rows = 0;
+	stopped = false;
+}
+
+
+// --- PARSE ---
+// Parse one or more (chunked) response documents from the stream. Returns false
+// on a syntax error or an error reported by Influx, see getError().
+bool InfluxParser::parse(std::istream &in) {
+	sb = in.rdbuf();
+	error.clear();
+	stopped = false;
+
+	skipWhitespace();
+	while (peek() != std::char_traits<char>::eof()) {
+		if (!parseResponse()) { return stopped; }
+		skipWhitespace();
+	}
+
+	return error.empty();
+}
+
+
+// --- PEEK ---
+int InfluxParser::peek() {
+	return sb->sgetc();
+}
+
+
+// --- NEXT ---
+int InfluxParser::next() {
+	return sb->sbumpc();
+}
+
+
+// --- SKIP WHITESPACE ---
+void InfluxParser::skipWhitespace() {
+	int c = peek();
+	while (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+		sb->sbumpc();
+		c = peek();
+	}
+}
+
+
+// --- EXPECT ---
+bool InfluxParser::expect(char c) {
+	skipWhitespace();
+	if (next() != c) { return fail(std::string("Expected '") + c + "'."); }
+	return true;
+}
+
+
+// --- FAIL ---
+bool InfluxParser::fail(const std::string &msg) {
+	if (error.empty()) { error = msg; }
+	return false;
+}
+
+
+// --- NEXT MEMBER ---
+// Advance to the next member of an object, reading its key into 'key'. Sets
+// 'end' once the closing brace has been consumed.
+bool InfluxParser::nextMember(bool &first, bool &end) {
+	skipWhitespace();
+	if (peek() == '}') {
+		next();
+		end = true;
+		return true;
+	}
+
+	if (!first && !expect(',')) { return false; }
+	first = false;
+	end = false;
+	skipWhitespace();
+	if (!parseString(key)) { return false; }
+	return expect(':');
+}
+
+
+// --- NEXT ELEMENT ---
+// Advance to the next element of an array. Sets 'end' once the closing
+// bracket has been consumed.
+bool InfluxParser::nextElement(bool &first, bool &end) {
+	skipWhitespace();
+	if (peek() == ']') {
+		next();
+		end = true;
+		return true;
+	}
+
+	if (!first && !expect(',')) { return false; }
+	first = false;
+	end = false;
+	skipWhitespace();
+	return true;
+}
+
+
+// --- PARSE HEX ---
+// Parse the four hex digits of a unicode escape.
+bool InfluxParser::parseHex(uint32_t &cp) {
+	cp = 0;
+	for (int i = 0; i < 4; ++i) {
+		int h = next();
+		cp <<= 4;
+		if (h >= '0' && h <= '9') { cp |= h - '0'; }
+		else if (h >= 'a' && h <= 'f') { cp |= h - 'a' + 10; }
+		else if (h >= 'A' && h <= 'F') { cp |= h - 'A' + 10; }
+		else { return fail("Invalid unicode escape."); }
+	}
+
+	return true;
+}
+
+
+// --- PARSE STRING ---
+bool InfluxParser::parseString(std::string &out) {
+	if (next() != '"') { return fail("Expected string."); }
+	out.clear();
+	while (true) {
+		int c = next();
+		if (c == std::char_traits<char>::eof()) { return fail("Unterminated string."); }
+		if (c == '"') { return true; }
+		if (c != '\\') {
+			out += (char) c;
+			continue;
+		}
+
+		c = next();
+		switch (c) {
+			case '"':	out += '"'; break;
+			case '\\':	out += '\\'; break;
+			case '/':	out += '/'; break;
+			case 'b':	out += '\b'; break;
+			case 'f':	out += '\f'; break;
+			case 'n':	out += '\n'; break;
+			case 'r':	out += '\r'; break;
+			case 't':	out += '\t'; break;
+			case 'u': {
+				uint32_t cp;
+				if (!parseHex(cp)) { return false; }
+
+				// Characters outside the BMP are escaped as a surrogate pair,
+				// which is combined into a single code point.
+				if (cp >= 0xDC00 && cp <= 0xDFFF) { return fail("Unpaired surrogate."); }
+				if (cp >= 0xD800 && cp <= 0xDBFF) {
+					uint32_t low;
+					if (next() != '\\' || next() != 'u') { return fail("Unpaired surrogate."); }
+					if (!parseHex(low)) { return false; }
+					if (low < 0xDC00 || low > 0xDFFF) { return fail("Unpaired surrogate."); }
+					cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+				}
+
+				if (cp < 0x80) {
+					out += (char) cp;
+				}
+				else if (cp < 0x800) {
+					out += (char) (0xC0 | (cp >> 6));
+					out += (char) (0x80 | (cp & 0x3F));
+				}
+				else if (cp < 0x10000) {
+					out += (char) (0xE0 | (cp >> 12));
+					out += (char) (0x80 | ((cp >> 6) & 0x3F));
+					out += (char) (0x80 | (cp & 0x3F));
+				}
+				else {
+					out += (char) (0xF0 | (cp >> 18));
+					out += (char) (0x80 | ((cp >> 12) & 0x3F));
+					out += (char) (0x80 | ((cp >> 6) & 0x3F));
+					out += (char) (0x80 | (cp & 0x3F));
+				}
+
+				break;
+			}
+			default:
+				return fail("Invalid escape sequence.");
+		}
+	}
+}
+
+
+// --- PARSE NUMBER ---
+bool InfluxParser::parseNumber(double &out) {
+	char buffer[64];
+	unsigned int len = 0;
+	int c = peek();
+	while ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E') {
+		if (len >= sizeof(buffer) - 1) { return fail("Number too long."); }
+		buffer[len++] = (char) next();
+		c = peek();
+	}
+
+	if (len == 0) { return fail("Expected number."); }
+	buffer[len] = 0;
+	char* end;
+	out = strtod(buffer, &end);
+	if (end != buffer + len) { return fail("Invalid number."); }
+	return true;
+}
+
+
+// --- PARSE LITERAL ---
+bool InfluxParser::parseLiteral(const char* literal) {
+	for (const char* p = literal; *p; ++p) {
+		if (next() != *p) { return fail(std::string("Expected '") + literal + "'."); }
+	}
+
+	return true;
+}
+
+
+// --- PARSE SCALAR ---
+// Parse a row value. Nested arrays and objects are skipped and read as null.
+bool InfluxParser::parseScalar(InfluxValue &value) {
+	int c = peek();
+	if (c == '"') {
+		value.type = InfluxValue::STRING;
+		return parseString(value.str);
+	}
+	else if (c == 't' || c == 'f') {
+		value.type = InfluxValue::BOOL;
+		value.boolean = (c == 't');
+		return parseLiteral(value.boolean ? "true" : "false");
+	}
+	else if (c == 'n') {
+		value.type = InfluxValue::NUL;
+		return parseLiteral("null");
+	}
+	else if (c == '[' || c == '{') {
+		value.type = InfluxValue::NUL;
+		return skipValue();
+	}
+
+	value.type = InfluxValue::NUMBER;
+	return parseNumber(value.number);
+}
+
+
+// --- SKIP VALUE ---
+// Skip over any JSON value we're not interested in.
+bool InfluxParser::skipValue() {
+	skipWhitespace();
+	int c = peek();
+	bool first = true;
+	bool end = false;
+	if (c == '{') {
+		next();
+		while (true) {
+			if (!nextMember(first, end)) { return false; }
+			if (end) { return true; }
+			if (!skipValue()) { return false; }
+		}
+	}
+	else if (c == '[') {
+		next();
+		while (true) {
+			if (!nextElement(first, end)) { return false; }
+			if (end) { return true; }
+			if (!skipValue()) { return false; }
+		}
+	}
+	else if (c == '"') {
+		return parseString(key);
+	}
+
+	InfluxValue value;
+	return parseScalar(value);
+}
+
+
+// --- PARSE RESPONSE ---
+// { "results": [ <statement>, ... ], "error": "..." }
+bool InfluxParser::parseResponse() {
+	if (!expect('{')) { return false; }
+	bool first = true;
+	bool end = false;
+	while (true) {
+		if (!nextMember(first, end)) { return false; }
+		if (end) { return true; }
+
+		skipWhitespace();
+		if (key == "results") {
+			if (!expect('[')) { return false; }
+			bool firstEl = true;
+			bool endEl = false;
+			while (true) {
+				if (!nextElement(firstEl, endEl)) { return false; }
+				if (endEl) { break; }
+				if (!parseStatement()) { return false; }
+			}
+		}
+		else if (key == "error") {
+			std::string msg;
+			if (!parseString(msg)) { return false; }
+			fail(msg);
+		}
+		else if (!skipValue()) { return false; }
+	}
+}
+
+
+// --- PARSE STATEMENT ---
+// { "statement_id": 0, "series": [ <series>, ... ], "error": "..." }
+bool InfluxParser::parseStatement() {
+	if (!expect('{')) { return false; }
+	bool first = true;
+	bool end = false;
+	series.statement = 0;
+	while (true) {
+		if (!nextMember(first, end)) { return false; }
+		if (end) { return true; }
+
+		skipWhitespace();
+		if (key == "statement_id") {
+			double id;
+			if (!parseNumber(id)) { return false; }
+			series.statement = (int) id;
+		}
+		else if (key == "series") {
+			if (!expect('[')) { return false; }
+			bool firstEl = true;
+			bool endEl = false;
+			while (true) {
+				if (!nextElement(firstEl, endEl)) { return false; }
+				if (endEl) { break; }
+				if (!parseSeries()) { return false; }
+			}
+		}
+		else if (key == "error") {
+			std::string msg;
+			if (!parseString(msg)) { return false; }
+			fail(msg);
+		}
+		else if (!skipValue()) { return false; }
+	}
+}
+
+
+// --- PARSE SERIES ---
+// { "name": "...", "tags": { ... }, "columns": [ ... ], "values": [ [ ... ], ... ] }
+bool InfluxParser::parseSeries() {
+	if (!expect('{')) { return false; }
+	bool first = true;
+	bool end = false;
+	series.name.clear();
+	series.tags.clear();
+	series.columns.clear();
+	while (true) {
+		if (!nextMember(first, end)) { return false; }
+		if (end) { return true; }
+
+		skipWhitespace();
+		if (key == "name") {
+			if (!parseString(series.name)) { return false; }
+		}
+		else if (key == "tags") {
+			if (!parseTags()) { return false; }
+		}
+		else if (key == "columns") {
+			if (!parseColumns()) { return false; }
+		}
+		else if (key == "values") {
+			if (!parseValues()) { return false; }
+		}
+		else if (!skipValue()) { return false; }
+	}
+}
+
+
+// --- PARSE TAGS ---
+bool InfluxParser::parseTags() {
+	if (!expect('{')) { return false; }
+	bool first = true;
+	bool end = false;
+	while (true) {
+		if (!nextMember(first, end)) { return false; }
+		if (end) { return true; }
+
+		skipWhitespace();
+		series.tags.push_back(std::pair<std::string, std::string>(key, std::string()));
+		if (peek() == 'n') {
+			if (!parseLiteral("null")) { return false; }
+		}
+		else if (!parseString(series.tags.back().second)) { return false; }
+	}
+}
+
+
+// --- PARSE COLUMNS ---
+bool InfluxParser::parseColumns() {
+	if (!expect('[')) { return false; }
+	bool first = true;
+	bool end = false;
+	while (true) {
+		if (!nextElement(first, end)) { return false; }
+		if (end) { return true; }
+
+		series.columns.push_back(std::string());
+		if (!parseString(series.columns.back())) { return false; }
+	}
+}
+
+
+// --- PARSE VALUES ---
+// Parse the rows, handing each one to the handler.
+bool InfluxParser::parseValues() {
+	if (!expect('[')) { return false; }
+	bool first = true;
+	bool end = false;
+	while (true) {
+		if (!nextElement(first, end)) { return false; }
+		if (end) { return true; }
+		if (!expect('[')) { return false; }
+
+		// Reuse the row's values (and their string buffers) between rows. The
+		// vector never shrinks, so a shorter row doesn't free any of them.
+		row.count = 0;
+		bool firstVal = true;
+		bool endVal = false;
+		while (true) {
+			if (!nextElement(firstVal, endVal)) { return false; }
+			if (endVal) { break; }
+			if (row.count >= row.values.size()) { row.values.resize(row.count + 1); }
+			if (!parseScalar(row.values[row.count])) { return false; }
+			++row.count;
+		}
+
+		++rows;
+		if (!handler(series, row)) {
+			stopped = true;
+			return false;
+		}
+	}
+}
@@ -0,0 +1,117 @@
+/*
+	influxparser.h - Header file for the streaming InfluxDB response parser.
+
+	Revision 0
+
+	Notes:
+			- Parses the JSON returned by the InfluxDB /query endpoint straight
+				off the stream, without building a document tree. Each row in
+				'results[].series[].values' is handed to a callback together
+				with the series it belongs to.
+			- Handles chunked responses (one JSON document per chunk).
+			- Influx emits 'name', 'tags' and 'columns' before 'values', which
+				is what this parser assumes.
+
+	2026/10/19, Maya Posch
+*/
+
+
+#ifndef INFLUXPARSER_H
+#define INFLUXPARSER_H
+
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <istream>
+#include <cstdint>
+
+
+struct InfluxValue {
+	enum Type {
+		NUL = 0,
+		NUMBER,
+		STRING,
+		BOOL
+	};
+
+	Type type;
+	double number;
+	bool boolean;
+	std::string str;
+
+	InfluxValue() : type(NUL), number(0), boolean(false) { }
+	bool isNumber() const { return type == NUMBER; }
+	bool isString() const { return type == STRING; }
+	bool isNull() const { return type == NUL; }
+};
+
+
+struct InfluxSeries {
+	int statement;
+	std::string name;
+	std::vector<std::pair<std::string, std::string> > tags;
+	std::vector<std::string> columns;
+
+	const std::string& getTag(const std::string &key) const;
+	int getColumn(const std::string &column) const;
+};
+
+
+// The values of a row. The parser reuses the values, and their string buffers,
+// for the next row, so their storage only grows.
+class InfluxRow {
+	friend class InfluxParser;
+	std::vector<InfluxValue> values;
+	size_t count;
+
+public:
+	InfluxRow() : count(0) { }
+	size_t size() const { return count; }
+	const InfluxValue& operator[](size_t i) const { return values[i]; }
+};
+
+
+// Return false to stop parsing.
+typedef std::function<bool(const InfluxSeries &series, const InfluxRow &row)> InfluxRowHandler;
+
+
+class InfluxParser {
+	InfluxRowHandler handler;
+	std::streambuf* sb;
+	std::string error;
+	uint64_t rows;
+	bool stopped;
+	InfluxSeries series;
+	InfluxRow row;
+	std::string key;
+
+	int peek();
+	int next();
+	void skipWhitespace();
+	bool expect(char c);
+	bool fail(const std::string &msg);
+	bool nextMember(bool &first, bool &end);
+	bool nextElement(bool &first, bool &end);
+	bool parseHex(uint32_t &cp);
+	bool parseString(std::string &out);
+	bool parseNumber(double &out);
+	bool parseLiteral(const char* literal);
+	bool parseScalar(InfluxValue &value);
+	bool skipValue();
+	bool parseResponse();
+	bool parseStatement();
+	bool parseSeries();
+	bool parseTags();
+	bool parseColumns();
+	bool parseValues();
+
+public:
+	InfluxParser(InfluxRowHandler handler);
+
+	bool parse(std::istream &in);
+	const std::string& getError() { return error; }
+	uint64_t getRowCount() { return rows; }
+};
+
+#endif
@@ -0,0 +1,117 @@
+/*
+	telemetry.cpp - Implementation of the batched telemetry decoder.
+	
+	Revision 0
+	
+	Notes:
+			- The batch is read in place from the message buffer. Readings of
+				unknown modules or metrics are skipped, so that newer firmware
+				can add metrics without breaking older services.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#include "telemetry.h"
+
+
+#define METRIC(module, metric, topic, decimals) \
+	{ module, metric, topic, sizeof(topic) - 1, decimals }
+
+// Known metrics, by module and metric id.
+static const TelemetryMetric metrics[] = {
+	METRIC(1, 0, "nsa/temperature", 2),		// BME280
+	METRIC(1, 1, "nsa/humidity", 2),
+	METRIC(1, 2, "nsa/pressure", 2),
+	METRIC(2, 0, "nsa/temperature", 2),		// DHT
+	METRIC(2, 1, "nsa/humidity", 2),
+	METRIC(3, 0, "nsa/co2", 0),				// CO2
+	METRIC(4, 0, "nsa/espresso", 0),		// Jura
+	METRIC(4, 1, "nsa/espresso2", 0),
+	METRIC(4, 2, "nsa/coffee", 0),
+	METRIC(4, 3, "nsa/coffee2", 0)
+};
+
+static const uint32_t metricCount = sizeof(metrics) / sizeof(metrics[0]);
+
+// Size of a single reading.
+static const size_t readingSize = 8;
+
+
+// --- PARSE ---
+// Check the header of a batch and prepare for reading its readings. The
+// payload has to stay valid while the batch is used.
+bool TelemetryBatch::parse(const char* payload, size_t len) {
+	data = (const unsigned char*) payload;
+	length = len;
+	if (len < 2 || data[0] != telemetryVersion) { return false; }
+	
+	locationLength = data[1];
+	if (locationLength == 0 || 2 + locationLength > len) { return false; }
+	location = payload + 2;
+	pos = 2 + locationLength;
+	return (len - pos) % readingSize == 0;
+}
+
+
+// --- NEXT ---
+// Read the next known reading. Returns false at the end of the batch.
+bool TelemetryBatch::next(TelemetryReading &reading) {
+	while (pos + readingSize <= length) {
+		const unsigned char* r = data + pos;
+		pos += readingSize;
+		reading.metric = findMetric(r[0], r[1]);
+		if (!reading.metric) { continue; }
+		reading.age = (uint32_t) (r[2] | (r[3] << 8)) * 100;
+		reading.value = (int32_t) ((uint32_t) r[4] | ((uint32_t) r[5] << 8) |
+									((uint32_t) r[6] << 16) | ((uint32_t) r[7] << 24));
+		return true;
+	}
+	
+	return false;
+}
+
+
+// --- FIND METRIC ---
+const TelemetryMetric* TelemetryBatch::findMetric(uint8_t module, uint8_t metric) {
+	for (uint32_t i = 0; i < metricCount; ++i) {
+		if (metrics[i].module == module && metrics[i].metric == metric) { return &metrics[i]; }
+	}
+	
+	return 0;
+}
+
+
+// --- FORMAT VALUE ---
+// Write the scaled integer as a decimal number into 'out', which must hold at
+// least 16 characters. Returns the length.
+uint32_t TelemetryBatch::formatValue(int32_t value, uint8_t decimals, char* out) {
+	char digits[16];
+	uint32_t count = 0;
+	uint32_t v = (value < 0) ? 0u - (uint32_t) value : (uint32_t) value;
+	do {
+		digits[count++] = '0' + v % 10;
+		v /= 10;
+	} while (v > 0 || count <= decimals);
+	
+	uint32_t len = 0;
+	if (value < 0) { out[len++] = '-'; }
+	while (count > 0) {
+		if (count == decimals) { out[len++] = '.'; }
+		out[len++] = digits[--count];
+	}
+	
+	return len;
+}
+
+
+// --- FORMAT PAYLOAD ---
+// Format a reading as the text payload it used to be published with
+// ('<location>;<value>'), reusing the payload's buffer.
+void TelemetryBatch::formatPayload(const TelemetryReading &reading, std::string &payload) const {
+	char value[16];
+	uint32_t len = formatValue(reading.value, reading.metric->decimals, value);
+	payload.assign(location, locationLength);
+	payload += ';';
+	payload.append(value, len);
+}
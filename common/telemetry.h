@@ -0,0 +1,77 @@
+/*
+	telemetry.h - Header file for decoding batched telemetry from the nodes.
+	
+	Revision 0
+	
+	Notes:
+			- Nodes collect their sensor readings and publish them as a single
+				binary message per interval, instead of one text message per
+				reading on the reading's own topic.
+			- Format (version 1, integers little-endian):
+				uint8		version
+				uint8		location length (L)
+				L bytes		location (node UID)
+				followed by 8-byte readings:
+				uint8		module id
+				uint8		metric id
+				uint16		age: time before the batch was sent, in 0.1 s
+				int32		value, multiplied by 10^decimals of the metric
+			- The module and metric ids have to match those in the node
+				firmware (esp8266/app/telemetry.h). Each maps onto the topic its
+				readings used to be published on, so that they can be handled
+				as before.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+
+static const uint8_t telemetryVersion = 1;
+
+
+struct TelemetryMetric {
+	uint8_t module;
+	uint8_t metric;
+	const char* topic;
+	uint32_t topicLength;
+	uint8_t decimals;
+};
+
+
+struct TelemetryReading {
+	const TelemetryMetric* metric;
+	uint32_t age;			// ms
+	int32_t value;			// Scaled by 10^decimals.
+};
+
+
+class TelemetryBatch {
+	const unsigned char* data;
+	size_t length;
+	size_t pos;
+	const char* location;
+	size_t locationLength;
+
+public:
+	TelemetryBatch() : data(0), length(0), pos(0), location(0), locationLength(0) { }
+	
+	bool parse(const char* payload, size_t len);
+	bool next(TelemetryReading &reading);
+	
+	const char* getLocation() const { return location; }
+	size_t getLocationLength() const { return locationLength; }
+	
+	static const TelemetryMetric* findMetric(uint8_t module, uint8_t metric);
+	static uint32_t formatValue(int32_t value, uint8_t decimals, char* out);
+	void formatPayload(const TelemetryReading &reading, std::string &payload) const;
+};
+
+#endif
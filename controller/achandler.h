@@ -28,6 +28,7 @@ using namespace Poco::Net;
 using namespace Poco::JSON;
 
 #include "nodes.h"
+#include "batchrequest.h"
 
 
 class ACHandler: public HTTPRequestHandler { 
@@ -41,6 +42,8 @@ public:
 		// -> Returns info on specified AC unit, or 404.
 		// * POST /ac/<id>
 		// -> Sets the target temperature for the specified AC unit.
+		// * POST /ac/batch
+		// -> Reads and sets the temperatures of many units. See BatchRequest.
 		
 		std::cout << "ACHandler: Request from " + request.clientAddress().toString() << "\n";
 		
@@ -59,6 +62,9 @@ public:
 			std::ostream& ostr = response.send();
 			ostr << "{ }";
 		}
+		else if (parts.size() == 2 && parts[1] == "batch") {
+			BatchRequest::process(request, response);
+		}
 		else if (parts.size() == 2) {
 			std::string id = parts[1];
 			
@@ -0,0 +1,84 @@
+/*
+	admission.cpp - Implementation of the Admission class.
+	
+	Revision 0
+	
+	Notes:
+			- A limit of 0 active requests means no limit.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#include "admission.h"
+
+#include <chrono>
+
+
+// --- SET LIMITS ---
+// At most 'maxActive' requests are handled at once, and at most 'maxQueued'
+// wait up to 'timeout' ms for their turn. Rejected clients are asked to retry
+// after 'retryAfter' seconds.
+void Admission::setLimits(uint32_t maxActive, uint32_t maxQueued, uint32_t timeout,
+																uint32_t retryAfter) {
+	std::lock_guard<std::mutex> lk(mtx);
+	this->maxActive = maxActive;
+	this->maxQueued = maxQueued;
+	this->timeout = timeout;
+	this->retryAfter = retryAfter;
+	cv.notify_all();
+}
+
+
+// --- GET ACTIVE ---
+uint32_t Admission::getActive() {
+	std::lock_guard<std::mutex> lk(mtx);
+	return active;
+}
+
+
+// --- GET QUEUED ---
+uint32_t Admission::getQueued() {
+	std::lock_guard<std::mutex> lk(mtx);
+	return queued;
+}
+
+
+// --- ENTER ---
+// Admit a request, waiting in the queue if the class is at its limit. Returns
+// false if the request is rejected. An admitted request has to call leave().
+bool Admission::enter() {
+	std::unique_lock<std::mutex> lk(mtx);
+	if (maxActive == 0 || active < maxActive) {
+		++active;
+		return true;
+	}
+	
+	if (queued >= maxQueued) {
+		rejected.add();
+		return false;
+	}
+	
+	++queued;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	bool admitted = cv.wait_for(lk, std::chrono::milliseconds(timeout),
+							[this]() { return maxActive == 0 || active < maxActive; });
+	--queued;
+	wait.observe(std::chrono::duration_cast<std::chrono::microseconds>(
+								std::chrono::steady_clock::now() - start).count());
+	if (!admitted) {
+		rejected.add();
+		return false;
+	}
+	
+	++active;
+	return true;
+}
+
+
+// --- LEAVE ---
+void Admission::leave() {
+	std::lock_guard<std::mutex> lk(mtx);
+	--active;
+	cv.notify_one();
+}
@@ -0,0 +1,59 @@
+/*
+	admission.h - Header file for the Admission class.
+	
+	Revision 0
+	
+	Notes:
+			- Limits the number of HTTP requests of one class (e.g. control
+				API, firmware downloads) which are handled at the same time.
+				With the server's thread pool sized to the sum of the limits,
+				every class keeps its share of the threads, whatever the load
+				on the other classes. Idle keep-alive connections also hold
+				threads, which the server's keep-alive settings bound (see
+				controller.cpp).
+			- A request over the limit waits in the class's queue for the class's
+				timeout, and is rejected if the queue is full or the wait times
+				out, so that clients can retry instead of piling up. API calls
+				wait briefly, firmware downloads long.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+#include "metrics.h"
+
+
+class Admission {
+	std::mutex mtx;
+	std::condition_variable cv;
+	uint32_t maxActive;
+	uint32_t maxQueued;
+	uint32_t timeout;		// ms
+	uint32_t retryAfter;	// s
+	uint32_t active;
+	uint32_t queued;
+
+public:
+	Counter rejected;
+	Histogram wait;
+	
+	Admission() : maxActive(0), maxQueued(0), timeout(0), retryAfter(1), active(0), queued(0) { }
+	
+	void setLimits(uint32_t maxActive, uint32_t maxQueued, uint32_t timeout, uint32_t retryAfter);
+	uint32_t getThreads() { return maxActive + maxQueued; }
+	uint32_t getRetryAfter() { return retryAfter; }
+	uint32_t getActive();
+	uint32_t getQueued();
+	bool enter();
+	void leave();
+};
+
+#endif
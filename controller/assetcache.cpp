@@ -0,0 +1,184 @@
+/*
+	assetcache.cpp - Implementation of the AssetCache class.
+	
+	Revision 0
+	
+	Notes:
+			- ETags are a hash of the contents, with the compressed variant
+				having its own ETag, as the ETags are strong.
+			- HTML pages are revalidated on every load, other files are cached
+				by the browser for 'maxAge' seconds.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#include "assetcache.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <cstdio>
+
+#include <sys/stat.h>
+
+#include <Poco/DeflatingStream.h>
+#include <Poco/File.h>
+
+using namespace Poco;
+
+
+// Static initialisations.
+std::mutex AssetCache::mtx;
+std::map<std::string, AssetCache::Entry> AssetCache::assets;
+std::string AssetCache::root = "htdocs";
+uint32_t AssetCache::maxAge = 86400;
+uint32_t AssetCache::checkInterval = 2000;
+
+
+// --- MIME TYPE ---
+// Content type by file extension, and whether that type is worth compressing.
+static std::string mimeType(const std::string &path, bool &compress) {
+	std::string::size_type idx = path.rfind('.');
+	std::string ext = "";
+	if (idx != std::string::npos) {
+		ext = path.substr(idx + 1);
+	}
+	
+	compress = true;
+	if (ext == "html") { return "text/html"; }
+	else if (ext == "css") { return "text/css"; }
+	else if (ext == "js") { return "application/javascript"; }
+	else if (ext == "json") { return "application/json"; }
+	else if (ext == "svg") { return "image/svg+xml"; }
+	
+	compress = false;
+	if (ext == "zip") { return "application/zip"; }
+	else if (ext == "png") { return "image/png"; }
+	else if (ext == "jpeg" || ext == "jpg") { return "image/jpeg"; }
+	else if (ext == "gif") { return "image/gif"; }
+	
+	compress = true;
+	return "text/plain";
+}
+
+
+// --- INIT ---
+// Load all files below 'root'. 'maxAge' is in seconds, 'checkInterval' in ms.
+void AssetCache::init(const std::string &root, uint32_t maxAge, uint32_t checkInterval) {
+	std::lock_guard<std::mutex> lk(mtx);
+	AssetCache::root = root;
+	AssetCache::maxAge = maxAge;
+	AssetCache::checkInterval = checkInterval;
+	assets.clear();
+	loadFolder("/");
+	
+	std::cout << "Loaded " << assets.size() << " files from " << root << "." << std::endl;
+}
+
+
+// --- LOAD FOLDER ---
+void AssetCache::loadFolder(const std::string &path) {
+	std::vector<std::string> names;
+	File folder(root + path);
+	if (!folder.isDirectory()) { return; }
+	folder.list(names);
+	for (unsigned int i = 0; i < names.size(); ++i) {
+		std::string child = path + names[i];
+		struct stat st;
+		if (stat((root + child).c_str(), &st) != 0) { continue; }
+		if (S_ISDIR(st.st_mode)) {
+			loadFolder(child + "/");
+			continue;
+		}
+		
+		if (!S_ISREG(st.st_mode)) { continue; }
+		Entry &entry = assets[child];
+		entry.asset = load(child);
+		entry.mtime = st.st_mtime;
+		entry.size = st.st_size;
+		entry.checked = std::chrono::steady_clock::now();
+		if (!entry.asset) { assets.erase(child); }
+	}
+}
+
+
+// --- LOAD ---
+// Read the file, and compress it if that makes it at least 10% smaller.
+AssetPtr AssetCache::load(const std::string &path) {
+	std::ifstream in(root + path, std::ifstream::binary);
+	if (!in) { return AssetPtr(); }
+	
+	std::shared_ptr<Asset> asset = std::make_shared<Asset>();
+	std::ostringstream data;
+	data << in.rdbuf();
+	asset->data = data.str();
+	
+	bool compress;
+	asset->mime = mimeType(path, compress);
+	asset->cacheControl = (asset->mime == "text/html") ? std::string("no-cache") :
+											"public, max-age=" + std::to_string(maxAge);
+	
+	if (compress && asset->data.size() > 256) {
+		std::ostringstream gzip;
+		DeflatingOutputStream deflater(gzip, DeflatingStreamBuf::STREAM_GZIP, 9);
+		deflater.write(asset->data.data(), asset->data.size());
+		deflater.close();
+		if (gzip.str().size() < asset->data.size() * 9 / 10) { asset->gzip = gzip.str(); }
+	}
+	
+	// 64-bit FNV-1a hash of the contents.
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < asset->data.size(); ++i) {
+		hash = (hash ^ (uint8_t) asset->data[i]) * 1099511628211ULL;
+	}
+	
+	char etag[32];
+	snprintf(etag, sizeof(etag), "\"%016llx\"", (unsigned long long) hash);
+	asset->etag = etag;
+	snprintf(etag, sizeof(etag), "\"%016llx-gz\"", (unsigned long long) hash);
+	asset->gzipEtag = etag;
+	return asset;
+}
+
+
+// --- GET ---
+// Returns the file at 'path' (starting with a slash), or an empty pointer if it
+// doesn't exist. Files added after start-up are loaded on their first request.
+AssetPtr AssetCache::get(const std::string &path) {
+	if (path.empty() || path[0] != '/' || path.find("..") != std::string::npos) {
+		return AssetPtr();
+	}
+	
+	std::lock_guard<std::mutex> lk(mtx);
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	std::map<std::string, Entry>::iterator it = assets.find(path);
+	if (it != assets.end() && now - it->second.checked < std::chrono::milliseconds(checkInterval)) {
+		return it->second.asset;
+	}
+	
+	struct stat st;
+	if (stat((root + path).c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+		if (it != assets.end()) { assets.erase(it); }
+		return AssetPtr();
+	}
+	
+	if (it != assets.end() && it->second.mtime == st.st_mtime && it->second.size == st.st_size) {
+		it->second.checked = now;
+		return it->second.asset;
+	}
+	
+	AssetPtr asset = load(path);
+	if (!asset) { return asset; }
+	
+	std::cout << "Loaded " << root << path << " (" << asset->data.size() << " bytes, "
+				<< asset->gzip.size() << " compressed)." << std::endl;
+	
+	Entry &entry = assets[path];
+	entry.asset = asset;
+	entry.mtime = st.st_mtime;
+	entry.size = st.st_size;
+	entry.checked = now;
+	return asset;
+}
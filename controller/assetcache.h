@@ -0,0 +1,68 @@
+/*
+	assetcache.h - Header file for the AssetCache class.
+	
+	Revision 0
+	
+	Notes:
+			- Keeps the files of the web UI ('htdocs') in memory, loaded on
+				start-up, along with a gzip-compressed copy of the files for
+				which compression pays off.
+			- Each file is an immutable snapshot. When a file's modification
+				time or size changes, it's loaded again on the next request
+				after the check interval, while responses still being sent keep
+				the old snapshot alive.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#ifndef ASSETCACHE_H
+#define ASSETCACHE_H
+
+
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+
+#include <sys/types.h>
+
+
+struct Asset {
+	std::string data;
+	std::string gzip;			// Empty if compressing doesn't pay off.
+	std::string mime;
+	std::string etag;
+	std::string gzipEtag;
+	std::string cacheControl;
+};
+
+
+typedef std::shared_ptr<const Asset> AssetPtr;
+
+
+class AssetCache {
+	struct Entry {
+		AssetPtr asset;
+		time_t mtime;
+		off_t size;
+		std::chrono::steady_clock::time_point checked;
+	};
+	
+	static std::mutex mtx;
+	static std::map<std::string, Entry> assets;		// By path, e.g. '/index.html'.
+	static std::string root;
+	static uint32_t maxAge;
+	static uint32_t checkInterval;
+	
+	static AssetPtr load(const std::string &path);
+	static void loadFolder(const std::string &path);
+
+public:
+	static void init(const std::string &root, uint32_t maxAge, uint32_t checkInterval);
+	static AssetPtr get(const std::string &path);
+};
+
+#endif
@@ -0,0 +1,193 @@
+/*
+	batchrequest.h - Header file for the BatchRequest class.
+	
+	Revision 0
+	
+	Notes:
+			- Handles POST /cc/batch and /ac/batch: reads and target temperature
+				updates for many nodes in a single request.
+			- All items are validated first, after which the valid updates are
+				applied in one transaction. Each item gets its own result.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#ifndef BATCHREQUEST_H
+#define BATCHREQUEST_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+
+#include <Poco/Net/HTTPServerResponse.h>
+#include <Poco/Net/HTTPServerRequest.h>
+#include <Poco/JSON/Parser.h>
+#include <Poco/JSON/Object.h>
+#include <Poco/JSON/Array.h>
+#include <Poco/StreamCopier.h>
+#include <Poco/Exception.h>
+
+using namespace Poco;
+using namespace Poco::Net;
+using namespace Poco::JSON;
+
+#include "nodes.h"
+
+
+// Maximum number of reads and updates in a single batch.
+const unsigned int maxBatchItems = 10000;
+
+
+class BatchRequest {
+	// --- SEND ERROR ---
+	static void sendError(HTTPServerResponse& response, HTTPResponse::HTTPStatus status,
+																const std::string &error) {
+		response.setStatus(status);
+		std::ostream& ostr = response.send();
+		ostr << "{ \"error\": \"" << error << "\" }";
+	}
+	
+	// --- ITEM RESULT ---
+	static Object::Ptr itemResult(const std::string &uid, int status, const std::string &error) {
+		Object::Ptr result = new Object;
+		result->set("id", uid);
+		result->set("status", status);
+		if (!error.empty()) { result->set("error", error); }
+		return result;
+	}
+
+public:
+	// --- PROCESS ---
+	// Request body:
+	// { "read": [ "<id>", ... ],
+	//   "update": [ { "id": "<id>", "temperatureTarget": <temperature> }, ... ] }
+	// Both arrays are optional. Response:
+	// { "read": [ { "id": "<id>", "status": 200, "temperatureCurrent": <temperature>,
+	//					"temperatureTarget": <temperature> }, ... ],
+	//   "update": [ { "id": "<id>", "status": 200, ... }, ... ] }
+	// in the order of the request. Failed items have a 400, 404 or 500 status
+	// and an error message instead of the temperatures.
+	static void process(HTTPServerRequest& request, HTTPServerResponse& response) {
+		if (request.getMethod() != HTTPRequest::HTTP_POST) {
+			sendError(response, HTTPResponse::HTTP_METHOD_NOT_ALLOWED, "Batch requests use POST.");
+			return;
+		}
+		
+		Object::Ptr object;
+		Array::Ptr reads;
+		Array::Ptr updates;
+		try {
+			std::string content;
+			StreamCopier::copyToString(request.stream(), content);
+			Parser parser;
+			object = parser.parse(content).extract<Object::Ptr>();
+			if (object->has("read")) { reads = object->getArray("read"); }
+			if (object->has("update")) { updates = object->getArray("update"); }
+		}
+		catch (Poco::Exception &exc) {
+			sendError(response, HTTPResponse::HTTP_BAD_REQUEST, "Invalid request.");
+			return;
+		}
+		
+		if ((object->has("read") && reads.isNull()) || (object->has("update") && updates.isNull())) {
+			sendError(response, HTTPResponse::HTTP_BAD_REQUEST, "Invalid request.");
+			return;
+		}
+		
+		unsigned int readCount = reads.isNull() ? 0 : reads->size();
+		unsigned int updateCount = updates.isNull() ? 0 : updates->size();
+		if (readCount + updateCount > maxBatchItems) {
+			sendError(response, HTTPResponse::HTTP_REQUEST_ENTITY_TOO_LARGE, "Too many items in batch.");
+			return;
+		}
+		
+		std::cout << "Batch request: " << readCount << " reads, " << updateCount << " updates.\n";
+		
+		// Collect the UIDs of all items, so that they're looked up together.
+		std::vector<std::string> uids;
+		std::vector<float> targets(updateCount);
+		std::vector<std::string> errors(readCount + updateCount);
+		for (unsigned int i = 0; i < readCount; ++i) {
+			Dynamic::Var id = reads->get(i);
+			uids.push_back(id.isString() ? id.extract<std::string>() : std::string());
+			if (!id.isString()) { errors[i] = "Invalid ID."; }
+		}
+		
+		for (unsigned int i = 0; i < updateCount; ++i) {
+			Object::Ptr item = updates->getObject(i);
+			std::string& error = errors[readCount + i];
+			if (item.isNull() || !item->has("id") || !item->get("id").isString()) {
+				uids.push_back(std::string());
+				error = "Invalid ID.";
+				continue;
+			}
+			
+			uids.push_back(item->getValue<std::string>("id"));
+			try {
+				targets[i] = item->getValue<float>("temperatureTarget");
+				if (targets[i] <= 15 || targets[i] >= 30) {
+					error = "Target temperature must be between 15 and 30 degrees.";
+				}
+			}
+			catch (Poco::Exception &exc) {
+				error = "Invalid target temperature.";
+			}
+		}
+		
+		std::vector<NodeInfo> info;
+		std::vector<bool> found;
+		if (!Nodes::getTemperatures(uids, info, found)) {
+			sendError(response, HTTPResponse::HTTP_INTERNAL_SERVER_ERROR, "Failed to look up nodes.");
+			return;
+		}
+		
+		// Apply the valid updates in a single transaction.
+		std::map<std::string, float> temps;
+		for (unsigned int i = 0; i < updateCount; ++i) {
+			if (errors[readCount + i].empty() && found[readCount + i]) {
+				temps[uids[readCount + i]] = targets[i];
+			}
+		}
+		
+		bool updated = Nodes::setTargetTemperatures(temps);
+		
+		// Per-item results.
+		Array::Ptr readResults = new Array;
+		for (unsigned int i = 0; i < readCount; ++i) {
+			if (!errors[i].empty()) { readResults->add(itemResult(uids[i], 400, errors[i])); }
+			else if (!found[i]) { readResults->add(itemResult(uids[i], 404, "Node ID doesn't exist")); }
+			else {
+				Object::Ptr result = itemResult(uids[i], 200, "");
+				result->set("temperatureCurrent", info[i].current);
+				result->set("temperatureTarget", info[i].target);
+				readResults->add(result);
+			}
+		}
+		
+		Array::Ptr updateResults = new Array;
+		for (unsigned int i = 0; i < updateCount; ++i) {
+			unsigned int j = readCount + i;
+			if (!errors[j].empty()) { updateResults->add(itemResult(uids[j], 400, errors[j])); }
+			else if (!found[j]) { updateResults->add(itemResult(uids[j], 404, "Node ID doesn't exist")); }
+			else if (!updated) {
+				updateResults->add(itemResult(uids[j], 500, "Updating target temperature failed."));
+			}
+			else {
+				Object::Ptr result = itemResult(uids[j], 200, "");
+				result->set("temperatureCurrent", info[j].current);
+				result->set("temperatureTarget", temps[uids[j]]);
+				updateResults->add(result);
+			}
+		}
+		
+		Object results;
+		results.set("read", readResults);
+		results.set("update", updateResults);
+		std::ostream& ostr = response.send();
+		results.stringify(ostr);
+	}
+};
+
+#endif
@@ -15,11 +15,14 @@
 
 #include <iostream>
 #include <vector>
+#include <sstream>
+#include <cctype>
 
 #include <Poco/Net/HTTPRequestHandler.h>
 #include <Poco/Net/HTTPServerResponse.h>
 #include <Poco/Net/HTTPServerRequest.h>
 #include <Poco/URI.h>
+#include <Poco/StringTokenizer.h>
 #include <Poco/JSON/Parser.h>
 #include <Poco/JSON/Object.h>
 
@@ -28,9 +31,167 @@ using namespace Poco::Net;
 using namespace Poco::JSON;
 
 #include "nodes.h"
+#include "batchrequest.h"
 
 
 class CCHandler: public HTTPRequestHandler { 
+	// --- INFLUX TIME ---
+	// Convert a time parameter into an InfluxQL time expression. Accepts either
+	// a duration relative to now (e.g. '30d', '12h') or an RFC3339 timestamp.
+	static bool influxTime(const std::string &in, std::string &out) {
+		if (in.empty()) { return false; }
+		
+		size_t digits = 0;
+		while (digits < in.length() && isdigit((unsigned char) in[digits])) { ++digits; }
+		std::string unit = in.substr(digits);
+		if (digits > 0 && (unit == "s" || unit == "m" || unit == "h" || unit == "d" || unit == "w")) {
+			out = "now() - " + in;
+			return true;
+		}
+		
+		for (size_t i = 0; i < in.length(); ++i) {
+			char c = in[i];
+			if (!isdigit((unsigned char) c) && c != '-' && c != ':' && c != 'T' && c != 'Z' 
+					&& c != '.' && c != '+') {
+				return false;
+			}
+		}
+		
+		out = "'" + in + "'";
+		return true;
+	}
+	
+	
+	// --- SEND HISTORY ---
+	// Stream the stored history for a single node, or for all nodes on a floor
+	// (nodes whose location starts with the floor name).
+	// Query parameters:
+	// * measurement:	comma-separated list of measurements. Default: temperature.
+	// * from, to:		RFC3339 timestamp or a duration relative to now ('30d').
+	//					Default: the past day.
+	// * format:		'csv' (default) or 'ndjson'.
+	void sendHistory(URI &uri, std::vector<std::string> &parts, HTTPServerResponse& response) {
+		std::vector<std::string> uids;
+		if (parts.size() == 3) {
+			// Read-only lookup: unlike getNodeInfo(), this doesn't register an
+			// unknown UID as an unassigned node.
+			uids.push_back(parts[1]);
+			std::vector<NodeInfo> info;
+			std::vector<bool> found;
+			if (!Nodes::getTemperatures(uids, info, found)) {
+				response.setStatus(HTTPResponse::HTTP_INTERNAL_SERVER_ERROR);
+				std::ostream& ostr = response.send();
+				ostr << "{ \"error\": \"Failed to look up node.\" }";
+				return;
+			}
+			
+			if (!found[0]) {
+				response.setStatus(HTTPResponse::HTTP_NOT_FOUND);
+				std::ostream& ostr = response.send();
+				ostr << "{ \"error\": \"Node ID doesn't exist\" }";
+				return;
+			}
+		}
+		else if (parts.size() == 4 && parts[1] == "floor") {
+			if (!Nodes::getLocationUIDs(parts[2], uids)) {
+				response.setStatus(HTTPResponse::HTTP_INTERNAL_SERVER_ERROR);
+				std::ostream& ostr = response.send();
+				ostr << "{ \"error\": \"Failed to look up nodes.\" }";
+				return;
+			}
+		}
+		else {
+			response.setStatus(HTTPResponse::HTTP_BAD_REQUEST);
+			std::ostream& ostr = response.send();
+			ostr << "{ \"error\": \"Invalid request.\" }";
+			return;
+		}
+		
+		std::string measurement = "temperature";
+		std::string from = "now() - 1d";
+		std::string to = "now()";
+		bool csv = true;
+		bool valid = true;
+		URI::QueryParameters params = uri.getQueryParameters();
+		for (unsigned int i = 0; i < params.size(); ++i) {
+			if (params[i].first == "measurement") { measurement = params[i].second; }
+			else if (params[i].first == "from") { valid = valid && influxTime(params[i].second, from); }
+			else if (params[i].first == "to") { valid = valid && influxTime(params[i].second, to); }
+			else if (params[i].first == "format") {
+				if (params[i].second == "ndjson") { csv = false; }
+				else if (params[i].second != "csv") { valid = false; }
+			}
+		}
+		
+		// Measurement names end up in the query, so only allow plain identifiers.
+		std::vector<std::string> measurements;
+		std::istringstream ss(measurement);
+		std::string name;
+		while (std::getline(ss, name, ',')) {
+			if (name.empty()) { valid = false; }
+			for (unsigned int i = 0; i < name.length(); ++i) {
+				if (!isalnum((unsigned char) name[i]) && name[i] != '_') { valid = false; }
+			}
+			
+			measurements.push_back(name);
+		}
+		
+		if (!valid || measurements.empty()) {
+			response.setStatus(HTTPResponse::HTTP_BAD_REQUEST);
+			std::ostream& ostr = response.send();
+			ostr << "{ \"error\": \"Invalid history parameters.\" }";
+			return;
+		}
+		
+		// A failure once the export has started throws, and the server then drops
+		// the connection so that the client can tell the export is incomplete.
+		response.setContentType(csv ? "text/csv" : "application/x-ndjson");
+		if (!Nodes::exportHistory(uids, measurements, from, to, csv, 
+								[&response]() -> std::ostream& { return response.send(); })) {
+			response.setContentType("application/json");
+			response.setStatus(HTTPResponse::HTTP_BAD_GATEWAY);
+			std::ostream& ostr = response.send();
+			ostr << "{ \"error\": \"Failed to query history.\" }";
+		}
+	}
+	
+	
+	// --- NOT MODIFIED ---
+	// Tag the response with the generation of the node lists. If the client 
+	// already has this version, answer with a bodyless 304 and return true.
+	bool notModified(HTTPServerRequest& request, HTTPServerResponse& response, uint64_t gen) {
+		std::string etag = "\"nodes-" + std::to_string(gen) + "\"";
+		response.set("ETag", etag);
+		response.set("Cache-Control", "no-cache");
+		if (!request.has("If-None-Match")) { return false; }
+		
+		StringTokenizer st(request.get("If-None-Match"), ",", 
+							StringTokenizer::TOK_TRIM | StringTokenizer::TOK_IGNORE_EMPTY);
+		for (StringTokenizer::Iterator it = st.begin(); it != st.end(); ++it) {
+			if (*it == etag || *it == "W/" + etag || *it == "*") {
+				response.setChunkedTransferEncoding(false);
+				response.setStatus(HTTPResponse::HTTP_NOT_MODIFIED);
+				response.setContentLength(0);
+				response.send();
+				return true;
+			}
+		}
+		
+		return false;
+	}
+	
+	
+	// --- SEND NODES ---
+	// Send the requested node lists (NodeLists flags), unless the client's copy
+	// is current.
+	void sendNodes(HTTPServerRequest& request, HTTPServerResponse& response, int lists) {
+		uint64_t gen;
+		const std::string &json = Nodes::getNodesJson(lists, gen);
+		if (notModified(request, response, gen)) { return; }
+		std::ostream& ostr = response.send();
+		ostr.write(json.data(), json.length());
+	}
+
 public: 
 	void handleRequest(HTTPServerRequest& request, HTTPServerResponse& response) {
 		// Process the request. Valid API calls:
@@ -41,6 +202,10 @@ public:
 		// -> Returns info on specified AC unit, or 404.
 		// * POST /ac/<id>
 		// -> Sets the target temperature for the specified AC unit.
+		// * POST /cc/batch
+		// -> Reads and sets the temperatures of many units. See BatchRequest.
+		// * GET /cc/<id>/history, GET /cc/floor/<floor>/history
+		// -> Streams the stored history as CSV or NDJSON. See sendHistory().
 		
 		std::cout << "CCHandler: Request from " + request.clientAddress().toString() << "\n";
 		
@@ -60,10 +225,11 @@ public:
 		// list of units. Otherwise check there's a valid ID and whether it's a 
 		// POST or GET request.
 		if (parts.size() == 1) {
-			// Return list.
-			std::ostream& ostr = response.send();
-			ostr << "{ \"nodes\": " << Nodes::nodesToJson() << 
-					", \"unassigned\": " << Nodes::unassignedToJson() << " }";
+			// Return list, unless the client's copy is current.
+			sendNodes(request, response, NODES_ASSIGNED | NODES_UNASSIGNED);
+		}
+		else if (parts.size() == 2 && parts[1] == "batch") {
+			BatchRequest::process(request, response);
 		}
 		else if (parts.size() == 2) {
 			std::string id = parts[1];
@@ -136,6 +302,9 @@ public:
 				ostr << "}";
 			}
 		}
+		else if (parts.size() >= 3 && parts.back() == "history") {
+			sendHistory(uri, parts, response);
+		}
 		else if (parts.size() == 3) {
 			if (parts[1] != "nodes") {
 				// Set 400 error.
@@ -146,13 +315,11 @@ public:
 			
 			if (parts[2] == "assigned") {
 				//Return list.
-				std::ostream& ostr = response.send();
-				ostr << "{ \"nodes\": " << Nodes::nodesToJson() << " }";
+				sendNodes(request, response, NODES_ASSIGNED);
 			}
 			else if (parts[2] == "unassigned") {
 				//Return list.
-				std::ostream& ostr = response.send();
-				ostr << "{ \"unassigned\": " << Nodes::unassignedToJson() << " }";
+				sendNodes(request, response, NODES_UNASSIGNED);
 			}
 			else if (parts[2] == "update") {
 				// Check POST or GET.
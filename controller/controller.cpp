@@ -20,6 +20,12 @@
 
 #include "httprequestfactory.h"
 #include "nodes.h"
+#include "events.h"
+#include "firmwarecache.h"
+#include "firmwarestore.h"
+#include "firmwareupload.h"
+#include "assetcache.h"
+#include "metrics.h"
 
 #include <iostream>
 #include <string>
@@ -28,6 +34,7 @@
 #include <csignal>
 #include <mutex>
 #include <condition_variable>
+#include <chrono>
 
 #include "sarge.h"
 #include "INIReader.h"
@@ -35,6 +42,9 @@
 //#include <Poco/Util/IniFileConfiguration.h>
 //#include <Poco/AutoPtr.h>
 #include <Poco/Net/HTTPServer.h>
+#include <Poco/Net/ServerSocket.h>
+#include <Poco/ThreadPool.h>
+#include <Poco/Timespan.h>
 #include <Poco/StringTokenizer.h>
 #include <Poco/String.h>
 
@@ -58,6 +68,66 @@ void signal_handler(int signal) {
 }
 
 
+// --- ADD INFLUX METRICS ---
+// Export the request latencies and statistics of each Influx endpoint.
+void addInfluxMetrics(InfluxCluster &influx) {
+	for (uint32_t i = 0; i < influx.size(); ++i) {
+		InfluxClient* client = influx.getClient(i);
+		std::string endpoint = "endpoint=\"" + client->getHost() + ":" + 
+												std::to_string(client->getPort()) + "\"";
+		Histogram* writes = new Histogram;
+		Histogram* queries = new Histogram;
+		Metrics::addHistogram("bmac_influx_request_seconds", "Duration of Influx requests.",
+											endpoint + ",request=\"write\"", writes);
+		Metrics::addHistogram("bmac_influx_request_seconds", "Duration of Influx requests.",
+											endpoint + ",request=\"query\"", queries);
+		client->setObserver([writes, queries](bool query, InfluxStatus status, uint64_t duration) {
+			(query ? queries : writes)->observe(duration);
+		});
+		
+		Metrics::addCallback("bmac_influx_requests_total", "Requests sent to Influx.", endpoint,
+					METRIC_COUNTER, [client]() { return (double) client->getStats().requests; });
+		Metrics::addCallback("bmac_influx_failures_total", "Influx requests which failed.", 
+					endpoint, METRIC_COUNTER, 
+					[client]() { return (double) client->getStats().failures; });
+		Metrics::addCallback("bmac_influx_rejected_total", "Influx requests refused by Influx.", 
+					endpoint, METRIC_COUNTER, 
+					[client]() { return (double) client->getStats().rejected; });
+		Metrics::addCallback("bmac_influx_short_circuits_total", 
+					"Influx requests refused by the open circuit breaker.", endpoint,
+					METRIC_COUNTER, [client]() { return (double) client->getStats().shortCircuits; });
+		Metrics::addCallback("bmac_influx_reconnects_total", "Influx sessions reset after an error.",
+					endpoint, METRIC_COUNTER, 
+					[client]() { return (double) client->getStats().reconnects; });
+		Metrics::addCallback("bmac_influx_circuit_open", "Whether the circuit breaker is open.",
+					endpoint, METRIC_GAUGE, [client]() { return client->getStats().open ? 1.0 : 0.0; });
+	}
+}
+
+
+// --- ADD SERVER METRICS ---
+void addServerMetrics(HTTPServer &httpd, Poco::ThreadPool &httpPool) {
+	HTTPServer* server = &httpd;
+	Poco::ThreadPool* pool = &httpPool;
+	Metrics::addCallback("bmac_http_threads_pool", "Capacity of the HTTP server's thread pool.", 
+					"", METRIC_GAUGE, [pool]() { return (double) pool->capacity(); });
+	Metrics::addCallback("bmac_http_threads_busy", "HTTP server threads handling a connection.", 
+					"", METRIC_GAUGE, [server]() { return (double) server->currentThreads(); });
+	Metrics::addCallback("bmac_http_threads_max", "Maximum number of HTTP server threads.", 
+					"", METRIC_GAUGE, [server]() { return (double) server->maxThreads(); });
+	Metrics::addCallback("bmac_http_queued_connections", "HTTP connections waiting for a thread.",
+					"", METRIC_GAUGE, [server]() { return (double) server->queuedConnections(); });
+	Metrics::addCallback("bmac_http_max_concurrent_connections", 
+					"Highest number of concurrent HTTP connections.", "", METRIC_GAUGE, 
+					[server]() { return (double) server->maxConcurrentConnections(); });
+	Metrics::addCallback("bmac_http_connections_total", "HTTP connections handled.", 
+					"", METRIC_COUNTER, [server]() { return (double) server->totalConnections(); });
+	Metrics::addCallback("bmac_http_refused_connections_total", 
+					"HTTP connections refused because the queue was full.", "", METRIC_COUNTER,
+					[server]() { return (double) server->refusedConnections(); });
+}
+
+
 int main(int argc, char* argv[]) {
 	// Read configuration.
 	/* std::string configFile;
@@ -114,12 +184,38 @@ int main(int argc, char* argv[]) {
 	Listener listener;
 	listener.init("BMaC_Controller", mqtt_host, mqtt_port);
 	
+	// Set up the Influx cluster, shared by the Nodes class and the listener. A
+	// single 'host' is used if no list of 'hosts' is given.
+	std::string influx_host = config.Get("Influx", "host", "localhost");
+	std::string influx_hosts = config.Get("Influx", "hosts", influx_host);
+	int influx_port = config.GetInteger("Influx", "port", 8086);
+	bool influx_sec = config.GetBoolean("Influx", "secure", false);
+	std::string influx_db = config.Get("Influx", "db", "test");
+	InfluxCluster influx(influx_hosts, influx_port, influx_db, influx_sec, 
+											config.GetInteger("Influx", "pool_size", 4),
+											config.GetInteger("Influx", "replication", 1));
+	if (influx.size() == 0) {
+		std::cerr << "No Influx hosts configured." << std::endl;
+		return 1;
+	}
+	
+	influx.setBreaker(config.GetInteger("Influx", "breaker_threshold", 5), 
+											config.GetInteger("Influx", "breaker_cooldown", 10000));
+	std::cout << "Using " << influx.size() << " Influx endpoints, replication " 
+				<< influx.getReplicas() << ".\n";
+	
+	addInfluxMetrics(influx);
+	
+	// Load the firmware store, before nodes can be assigned firmware.
+	if (!FirmwareStore::init("firmware/", defaultFirmware)) {
+		std::cerr << "Failed to initialise the firmware store." << std::endl;
+		return 1;
+	}
+	
+	FirmwareUpload::init();
+	
 	// Initialise the Nodes class.
-	std::string influx_host = config.Get("", "Influx.host", "localhost");
-	int influx_port = config.GetInteger("", "Influx.port", 8086);
-	std::string influx_sec = config.Get("", "Influx.secure", "false");
-	std::string influx_db = config.Get("", "Influx.db", "test");
-	Nodes::init(defaultFirmware, influx_host, influx_port, influx_db, influx_sec, &listener);
+	Nodes::init(&influx, &listener);
 	
 	// Connect to the MQTT broker.
 	if (!listener.connectBroker()) {
@@ -151,6 +247,25 @@ int main(int argc, char* argv[]) {
 		series.insert(std::pair<std::string, std::string>(topic, s));
 	}
 	
+	listener.setInflux(&influx, series);
+	
+	// Batches of sensor readings published by the nodes.
+	std::string batchTopic = config.Get("MQTT", "batch_topic", "nsa/batch");
+	listener.setBatchTopic(batchTopic);
+	if (!batchTopic.empty()) { topics.push_back(batchTopic); }
+	
+	// Optional suppression of sensor readings redelivered by the broker.
+	DedupWindow* dedup = 0;
+	int dedup_window = config.GetInteger("Dedup", "window", 1000);
+	if (dedup_window > 0) {
+		dedup = new DedupWindow(dedup_window, config.GetInteger("Dedup", "capacity", 65536));
+		listener.setDedup(dedup);
+		Metrics::addCallback("bmac_dedup_checked_total", "Sensor readings checked for duplicates.",
+					"", METRIC_COUNTER, [dedup]() { return (double) dedup->getChecked(); });
+		Metrics::addCallback("bmac_dedup_duplicates_total", "Duplicate sensor readings dropped.",
+					"", METRIC_COUNTER, [dedup]() { return (double) dedup->getDuplicates(); });
+	}
+	
 	for (uint32_t i = 0; i < topics.size(); ++i) {
 		std::cout << "Subscribing to: " << topics[i] << "\n";
 		if (!listener.addSubscription(topics[i])) {
@@ -159,13 +274,60 @@ int main(int argc, char* argv[]) {
 		}
 	}
 	
-	// Initialise the HTTP server.
+	// Set up the event stream. Each of its clients occupies a server thread.
+	int event_clients = config.GetInteger("Events", "max_clients", 4);
+	Events::init(config.GetInteger("Events", "backlog", 1024), 
+				config.GetInteger("Events", "queue", 256), event_clients,
+				config.GetInteger("Events", "keepalive", 15) * 1000);
+	
+	// Set up the firmware image cache.
+	FirmwareCache::init(FirmwareStore::getObjectRoot(), 
+				config.GetInteger("Firmware", "check_interval", 1000));
+	
+	// Initialise the HTTP server, and load the web UI into memory.
 	uint16_t port = config.GetInteger("HTTP", "port", 8080);
+	AssetCache::init("htdocs", config.GetInteger("HTTP", "asset_max_age", 86400),
+				config.GetInteger("HTTP", "asset_check_interval", 2000));
+	
+	// Each class of requests gets its own share of the server threads, for the
+	// requests it's handling and those waiting for admission, so that e.g. a 
+	// wave of firmware downloads can't hold up the control API.
+	RequestHandlerFactory* factory = new RequestHandlerFactory;
+	uint32_t timeout = config.GetInteger("HTTP", "queue_timeout", 1000);
+	uint32_t retry = config.GetInteger("HTTP", "retry_after", 1);
+	uint32_t threads = event_clients + 2;
+	threads += factory->setLimits(HTTP_AC, config.GetInteger("HTTP", "ac_threads", 4), 
+				config.GetInteger("HTTP", "ac_queue", 4), timeout, retry);
+	threads += factory->setLimits(HTTP_CC, config.GetInteger("HTTP", "cc_threads", 4), 
+				config.GetInteger("HTTP", "cc_queue", 4), timeout, retry);
+	threads += factory->setLimits(HTTP_DATA, config.GetInteger("HTTP", "data_threads", 4), 
+				config.GetInteger("HTTP", "data_queue", 4), timeout, retry);
+	threads += factory->setLimits(HTTP_FIRMWARE, 
+				config.GetInteger("Firmware", "max_downloads", 16), 
+				config.GetInteger("Firmware", "queue", 128), 
+				config.GetInteger("Firmware", "queue_timeout", 60000),
+				config.GetInteger("Firmware", "retry_after", 5));
+	
+	// A keep-alive connection holds its server thread while it waits for the 
+	// next request, outside the limits above. Keep-alive stays on for the web UI
+	// and the APIs, but such connections are closed after being idle for 
+	// 'keepalive_timeout' seconds or after 'keepalive_requests' requests, and 
+	// 'keepalive_threads' threads are added to the pool for them. Firmware 
+	// downloads and rejected requests close their connection.
+	threads += config.GetInteger("HTTP", "keepalive_threads", 8);
 	HTTPServerParams* params = new HTTPServerParams;
 	params->setMaxQueued(100);
-	params->setMaxThreads(10);
-	HTTPServer httpd(new RequestHandlerFactory, port, params);
+	params->setMaxThreads(threads);
+	params->setKeepAlive(true);
+	params->setKeepAliveTimeout(Poco::Timespan(config.GetInteger("HTTP", "keepalive_timeout", 2), 0));
+	params->setMaxKeepAliveRequests(config.GetInteger("HTTP", "keepalive_requests", 100));
+	
+	// The server's default thread pool holds at most 16 threads, whatever the 
+	// parameters say, so it gets a pool of its own sized to the total.
+	Poco::ThreadPool httpPool(2, threads);
+	HTTPServer httpd(factory, httpPool, Poco::Net::ServerSocket(port), params);
 	httpd.start();
+	addServerMetrics(httpd, httpPool);
 	
 	// Publish the OTA URL as a retained message.
 	// Use IP interface that is connected to the MQTT broker as target.
@@ -181,7 +343,9 @@ int main(int argc, char* argv[]) {
 	// Lock and wait.
 	std::mutex sigmutex;
 	std::unique_lock<std::mutex> lk(sigmutex);
-	sigcv.wait(lk);
+	while (sigcv.wait_for(lk, std::chrono::seconds(60)) == std::cv_status::timeout) {
+		if (dedup) { dedup->report(60, "Dedup"); }
+	}
 	
 	/* int rc;
 	while(1) {
@@ -194,10 +358,16 @@ int main(int argc, char* argv[]) {
 	
 	std::cout << "Cleanup...\n";
 	
+	Events::shutdown();
+	httpd.stop();
+	
 	if (!listener.disconnectBroker()) {
 		std::cerr << "Failed to disconnect from broker: " << std::endl;
 		return 1;
 	}
+	
+	delete dedup;
+	FirmwareStore::stop();
 
 	return 0;
 }
@@ -15,21 +15,144 @@
 
 #include <iostream>
 #include <vector>
+#include <cstdlib>
 
 #include <Poco/Net/HTTPRequestHandler.h>
 #include <Poco/Net/HTTPServerResponse.h>
 #include <Poco/Net/HTTPServerRequest.h>
 #include <Poco/URI.h>
-#include <Poco/File.h>
+#include <Poco/Exception.h>
+#include <Poco/String.h>
 
 using namespace Poco::Net;
 using namespace Poco::Data::Keywords;
 using namespace Poco;
 
 //#include "coffeenet.h"
+#include "firmwarestore.h"
+#include "firmwarecache.h"
+#include "assetcache.h"
 
 
 class DataHandler: public HTTPRequestHandler { 
+	// --- PARSE RANGE ---
+	// Parses a 'bytes=<first>-<last>' Range header with a single range. Returns
+	// 1 for a valid range, 0 if the header is to be ignored, and -1 if the
+	// range can't be satisfied.
+	static int parseRange(const std::string &range, size_t size, size_t &start, size_t &length) {
+		if (range.compare(0, 6, "bytes=") != 0 || range.find(',') != std::string::npos) { return 0; }
+		std::string::size_type dash = range.find('-', 6);
+		if (dash == std::string::npos) { return 0; }
+		std::string first = range.substr(6, dash - 6);
+		std::string last = range.substr(dash + 1);
+		if (first.find_first_not_of("0123456789") != std::string::npos ||
+				last.find_first_not_of("0123456789") != std::string::npos) {
+			return 0;
+		}
+		
+		if (first.empty()) {
+			// The last 'last' bytes.
+			if (last.empty()) { return 0; }
+			uint64_t count = strtoull(last.c_str(), 0, 10);
+			if (count == 0 || size == 0) { return -1; }
+			if (count > size) { count = size; }
+			start = size - count;
+			length = count;
+			return 1;
+		}
+		
+		uint64_t from = strtoull(first.c_str(), 0, 10);
+		uint64_t to = last.empty() ? size - 1 : strtoull(last.c_str(), 0, 10);
+		if (to < from) { return 0; }
+		if (from >= size) { return -1; }
+		if (to >= size) { to = size - 1; }
+		start = from;
+		length = to - from + 1;
+		return 1;
+	}
+	
+	// --- ACCEPTS GZIP ---
+	// Whether an Accept-Encoding header allows gzip, e.g. 'gzip, deflate, br'
+	// or '*;q=0.5'.
+	static bool acceptsGzip(const std::string &header) {
+		bool accepted = false;
+		std::string::size_type start = 0;
+		while (start < header.size()) {
+			std::string::size_type end = header.find(',', start);
+			if (end == std::string::npos) { end = header.size(); }
+			std::string coding = header.substr(start, end - start);
+			start = end + 1;
+			
+			std::string::size_type params = coding.find(';');
+			std::string name = Poco::trim(coding.substr(0, params));
+			bool refused = false;
+			if (params != std::string::npos) {
+				std::string::size_type q = coding.find("q=", params);
+				refused = (q != std::string::npos && strtod(coding.c_str() + q + 2, 0) <= 0);
+			}
+			
+			if (Poco::icompare(name, "gzip") == 0) { return !refused; }
+			if (name == "*") { accepted = !refused; }
+		}
+		
+		return accepted;
+	}
+	
+	// --- SEND FIRMWARE ---
+	// Sends the firmware image assigned to the node, or the requested range of
+	// it. The image is written from the firmware cache's mapping.
+	void sendFirmware(HTTPServerRequest& request, HTTPServerResponse& response, 
+															const std::string &uid) {
+		std::string hash;
+		FirmwareImagePtr image;
+		if (FirmwareStore::getAssigned(uid, hash)) { image = FirmwareCache::get(hash); }
+		if (!image) {
+			// Return 404.
+			response.setStatus(HTTPResponse::HTTP_NOT_FOUND);
+			std::ostream& ostr = response.send();
+			ostr << "File Not Found: " << uid;
+			return;
+		}
+		
+		if (request.get("If-None-Match", "") == image->etag) {
+			response.set("ETag", image->etag);
+			response.setStatus(HTTPResponse::HTTP_NOT_MODIFIED);
+			response.send();
+			return;
+		}
+		
+		// A Range request is only honoured if If-Range, if any, names this image.
+		size_t start = 0;
+		size_t length = image->size;
+		int range = 0;
+		if (request.has("Range") && request.get("If-Range", image->etag) == image->etag) {
+			range = parseRange(request.get("Range"), image->size, start, length);
+		}
+		
+		if (range < 0) {
+			response.set("Content-Range", "bytes */" + std::to_string(image->size));
+			response.setStatus(HTTPResponse::HTTP_REQUESTED_RANGE_NOT_SATISFIABLE);
+			response.send();
+			return;
+		}
+		
+		response.setContentType("application/octet-stream");
+		response.set("ETag", image->etag);
+		response.set("Accept-Ranges", "bytes");
+		if (range > 0) {
+			response.setStatus(HTTPResponse::HTTP_PARTIAL_CONTENT);
+			response.set("Content-Range", "bytes " + std::to_string(start) + "-" + 
+						std::to_string(start + length - 1) + "/" + std::to_string(image->size));
+		}
+		
+		try {
+			response.sendBuffer(image->data + start, length);
+		}
+		catch (Poco::Exception &exc) {
+			std::cerr << "Firmware download failed: " << exc.displayText() << std::endl;
+		}
+	}
+
 public: 
 	void handleRequest(HTTPServerRequest& request, HTTPServerResponse& response) {
 		// Process the request. A request for data (HTML, JS, etc.) is returned
@@ -52,64 +175,8 @@ public:
 		URI::QueryParameters parts;
 		parts = uri.getQueryParameters();
 		if (parts.size() > 0 && parts[0].first == "uid") {
-			// Check whether we have this UID in the database.
-			// Set up SQLite database link.
-			// TODO: use Session Pool for SQLite sessions.
-			Data::SQLite::Connector::registerConnector();
-			Data::Session* session = new Poco::Data::Session("SQLite", "nodes.db");
-			
-			Data::Statement select(*session);
-			std::string filename;
-			select << "SELECT file FROM firmware WHERE uid=?",
-						into (filename),
-						use (parts[0].second);
-			
-			size_t rows = select.execute();
-			
-			if (rows != 1) {
-				// Return 404.
-				response.setStatus(HTTPResponse::HTTP_NOT_FOUND);
-				std::ostream& ostr = response.send();
-				ostr << "File Not Found: " << parts[0].second;
-				return;
-			}
-			
-			// Return 200 OK with the firmware data, or a 404 if not found.
-			std::string fileroot = "firmware/";
-			File file(fileroot + filename);
-			
-			if (!file.exists() || file.isDirectory()) {
-				// Return a 404.
-				response.setStatus(HTTPResponse::HTTP_NOT_FOUND);
-				std::ostream& ostr = response.send();
-				ostr << "File Not Found.";
-				return;
-			}
-			
-			std::string mime = "application/octet-stream";
-			try {
-				response.sendFile(file.path(), mime);
-			}
-			catch (FileNotFoundException &e) {
-				std::cout << "File not found exception triggered..." << std::endl;
-				std::cerr << e.displayText() << std::endl;
-				
-				// Return a 404.
-				response.setStatus(HTTPResponse::HTTP_NOT_FOUND);
-				std::ostream& ostr = response.send();
-				ostr << "File Not Found.";
-				return;
-			}
-			catch (OpenFileException &e) {
-				std::cout << "Open file exception triggered..." << std::endl;
-				std::cerr << e.displayText() << std::endl;
-				
-				// Return a 500.
-				response.setStatus(HTTPResponse::HTTP_INTERNAL_SERVER_ERROR);
-				std::ostream& ostr = response.send();
-				ostr << "Internal Server Error. Couldn't open file.";
-				return;
-			}
+			sendFirmware(request, response, parts[0].second);
+			return;
 		}
 		/* else {
 			// Return Bad Request
@@ -229,15 +296,14 @@ public:
 			return;
 		} */
 		
-		// No endpoint found, continue serving the requested file.
-		std::string fileroot = "htdocs";
+		// No endpoint found, continue serving the requested file from the
+		// asset cache.
 		if (path.empty() || path == "/") { path = "/index.html"; }
 		
-		File file(fileroot + path);
-		
-		std::cout << "DataHandler: Request for " << file.path() << std::endl;
+		std::cout << "DataHandler: Request for " << path << std::endl;
 		
-		if (!file.exists() || file.isDirectory()) {
+		AssetPtr asset = AssetCache::get(path);
+		if (!asset) {
 			// Return a 404.
 			response.setStatus(HTTPResponse::HTTP_NOT_FOUND);
 			std::ostream& ostr = response.send();
@@ -245,46 +311,27 @@ public:
 			return;
 		}
 		
-		// Determine file type.
-		std::string::size_type idx = path.rfind('.');
-		std::string ext = "";
-		if (idx != std::string::npos) {
-			ext = path.substr(idx + 1);
-		}
+		bool gzip = !asset->gzip.empty() && acceptsGzip(request.get("Accept-Encoding", ""));
+		const std::string &etag = gzip ? asset->gzipEtag : asset->etag;
+		response.set("ETag", etag);
+		response.set("Cache-Control", asset->cacheControl);
+		if (!asset->gzip.empty()) { response.set("Vary", "Accept-Encoding"); }
 		
-		std::string mime = "text/plain";
-		if (ext == "html") { mime = "text/html"; }
-		if (ext == "css") { mime = "text/css"; }
-		else if (ext == "js") { mime = "application/javascript"; }
-		else if (ext == "zip") { mime = "application/zip"; }
-		else if (ext == "json") { mime = "application/json"; }
-		else if (ext == "png") { mime = "image/png"; }
-		else if (ext == "jpeg" || ext == "jpg") { mime = "image/jpeg"; }
-		else if (ext == "gif") { mime = "image/gif"; }
-		else if (ext == "svg") { mime = "image/svg"; }
+		std::string ifNoneMatch = request.get("If-None-Match", "");
+		if (ifNoneMatch == "*" || ifNoneMatch.find(etag) != std::string::npos) {
+			response.setStatus(HTTPResponse::HTTP_NOT_MODIFIED);
+			response.send();
+			return;
+		}
 		
+		response.setContentType(asset->mime);
+		if (gzip) { response.set("Content-Encoding", "gzip"); }
+		const std::string &body = gzip ? asset->gzip : asset->data;
 		try {
-			response.sendFile(file.path(), mime);
-		}
-		catch (FileNotFoundException &e) {
-			std::cout << "File not found exception triggered...\n";
-			std::cerr << e.displayText() << std::endl;
-			
-			// Return a 404.
-			response.setStatus(HTTPResponse::HTTP_NOT_FOUND);
-			std::ostream& ostr = response.send();
-			ostr << "File Not Found.";
-			return;
+			response.sendBuffer(body.data(), body.size());
 		}
-		catch (OpenFileException &e) {
-			std::cout << "Open file exception triggered...\n";
-			std::cerr << e.displayText() << std::endl;
-			
-			// Return a 500.
-			response.setStatus(HTTPResponse::HTTP_INTERNAL_SERVER_ERROR);
-			std::ostream& ostr = response.send();
-			ostr << "Internal Server Error. Couldn't open file.";
-			return;
+		catch (Poco::Exception &exc) {
+			std::cerr << "Sending " << path << " failed: " << exc.displayText() << std::endl;
 		}
 	}
 };
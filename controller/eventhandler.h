@@ -0,0 +1,90 @@
+/*
+	eventhandler.h - Header file for the EventHandler class.
+	
+	Revision 0
+	
+	Notes:
+			- Streams changes to the node registry as server-sent events. See
+				events.h.
+			- Each connected client occupies one HTTP server thread. The number
+				of clients is limited by the Events class.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#ifndef EVENTHANDLER_H
+#define EVENTHANDLER_H
+
+#include <iostream>
+#include <vector>
+
+#include <Poco/Net/HTTPRequestHandler.h>
+#include <Poco/Net/HTTPServerResponse.h>
+#include <Poco/Net/HTTPServerRequest.h>
+#include <Poco/URI.h>
+#include <Poco/Exception.h>
+
+using namespace Poco;
+using namespace Poco::Net;
+
+#include "events.h"
+
+
+class EventHandler: public HTTPRequestHandler {
+public:
+	void handleRequest(HTTPServerRequest& request, HTTPServerResponse& response) {
+		// * GET /cc/events
+		// -> Streams events: 'unassigned', 'node', 'deleted', 'target',
+		// 'targets', 'temperatures', 'duty', 'valves' and 'switch', each with a
+		// JSON object as data. A 'reset' event means that events were missed and
+		// that the client has to reload the node lists.
+		//
+		// Clients resume with the Last-Event-ID header, or the 'lastEventId'
+		// query parameter.
+		std::cout << "EventHandler: Request from " + request.clientAddress().toString() << "\n";
+		
+		std::string lastEventId = request.get("Last-Event-ID", "");
+		URI uri(request.getURI());
+		URI::QueryParameters params = uri.getQueryParameters();
+		for (unsigned int i = 0; i < params.size(); ++i) {
+			if (params[i].first == "lastEventId") { lastEventId = params[i].second; }
+		}
+		
+		bool reset;
+		EventClient* client = Events::subscribe(lastEventId, reset);
+		if (!client) {
+			response.setContentType("application/json");
+			response.setStatus(HTTPResponse::HTTP_SERVICE_UNAVAILABLE);
+			response.set("Retry-After", "10");
+			std::ostream& ostr = response.send();
+			ostr << "{ \"error\": \"Too many event stream clients.\" }";
+			return;
+		}
+		
+		try {
+			response.setContentType("text/event-stream");
+			response.set("Cache-Control", "no-cache");
+			response.setChunkedTransferEncoding(true);
+			std::ostream& ostr = response.send();
+			ostr << "retry: 3000\n\n";
+			if (reset) { ostr << "event: reset\ndata: {}\n\n"; }
+			ostr.flush();
+			
+			// Write out events as they arrive, with a comment line as keep-alive.
+			std::vector<EventFrame> frames;
+			while (ostr.good() && Events::wait(client, frames, Events::getKeepalive())) {
+				if (frames.empty()) { ostr << ":\n\n"; }
+				for (unsigned int i = 0; i < frames.size(); ++i) { ostr << *frames[i]; }
+				ostr.flush();
+			}
+		}
+		catch (Poco::Exception &exc) {
+			std::cerr << "Event stream closed: " << exc.displayText() << std::endl;
+		}
+		
+		Events::unsubscribe(client);
+	}
+};
+
+#endif
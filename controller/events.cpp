@@ -0,0 +1,147 @@
+/*
+	events.cpp - Implementation of the Events class.
+	
+	Revision 0
+	
+	Notes:
+			- Events are formatted once as a server-sent event frame, which is
+				shared between the backlog and the client queues.
+			- Event IDs are seeded with the start time, so that IDs from
+				before a restart are older than any new event, and clients
+				resuming with them are told to reload.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#include "events.h"
+
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+
+
+// Static initialisations.
+std::mutex Events::mtx;
+std::deque<Events::Event> Events::backlog;
+std::vector<EventClient*> Events::clients;
+uint64_t Events::nextId = 1;
+uint32_t Events::backlogSize = 1024;
+uint32_t Events::queueSize = 256;
+uint32_t Events::maxClients = 4;
+uint32_t Events::keepalive = 15000;
+bool Events::stopping = false;
+
+
+// --- INIT ---
+void Events::init(uint32_t backlogSize, uint32_t queueSize, uint32_t maxClients, 
+															uint32_t keepalive) {
+	std::lock_guard<std::mutex> lk(mtx);
+	Events::backlogSize = backlogSize;
+	Events::queueSize = (queueSize > 0) ? queueSize : 1;
+	Events::maxClients = maxClients;
+	Events::keepalive = (keepalive > 0) ? keepalive : 15000;
+	nextId = std::chrono::duration_cast<std::chrono::milliseconds>(
+							std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+
+// --- SHUTDOWN ---
+// End all event streams, so that the HTTP server can stop.
+void Events::shutdown() {
+	std::lock_guard<std::mutex> lk(mtx);
+	stopping = true;
+	for (unsigned int i = 0; i < clients.size(); ++i) { clients[i]->cv.notify_one(); }
+}
+
+
+// --- PUBLISH ---
+// Send an event to all clients. 'data' has to be a single line, e.g. JSON.
+// Never blocks on clients: a client whose queue is full is marked, and gets
+// disconnected by its handler.
+void Events::publish(const char* type, const std::string &data) {
+	std::lock_guard<std::mutex> lk(mtx);
+	Event event;
+	event.id = nextId++;
+	event.frame = std::make_shared<const std::string>("id: " + std::to_string(event.id) +
+								"\nevent: " + type + "\ndata: " + data + "\n\n");
+	if (backlogSize > 0) {
+		if (backlog.size() >= backlogSize) { backlog.pop_front(); }
+		backlog.push_back(event);
+	}
+	
+	for (unsigned int i = 0; i < clients.size(); ++i) {
+		EventClient* client = clients[i];
+		if (client->overflowed) { continue; }
+		if (client->queue.size() >= queueSize) {
+			client->overflowed = true;
+			client->queue.clear();
+		}
+		else {
+			client->queue.push_back(event.frame);
+		}
+		
+		client->cv.notify_one();
+	}
+}
+
+
+// --- SUBSCRIBE ---
+// Register a new client. If it resumes after the given event ID, the events
+// it missed are queued from the backlog. If they're no longer all available,
+// 'reset' is set, and the client has to reload the full state. Returns 0 if
+// the maximum number of clients is reached.
+EventClient* Events::subscribe(const std::string &lastEventId, bool &reset) {
+	std::lock_guard<std::mutex> lk(mtx);
+	reset = false;
+	if (stopping || clients.size() >= maxClients) { return 0; }
+	
+	EventClient* client = new EventClient;
+	client->overflowed = false;
+	if (!lastEventId.empty()) {
+		uint64_t last = strtoull(lastEventId.c_str(), 0, 10);
+		uint64_t oldest = backlog.empty() ? nextId : backlog.front().id;
+		if (last + 1 < oldest || last >= nextId) { reset = true; }
+		else {
+			for (unsigned int i = 0; i < backlog.size(); ++i) {
+				if (backlog[i].id > last) { client->queue.push_back(backlog[i].frame); }
+			}
+		}
+	}
+	
+	clients.push_back(client);
+	return client;
+}
+
+
+// --- UNSUBSCRIBE ---
+void Events::unsubscribe(EventClient* client) {
+	std::lock_guard<std::mutex> lk(mtx);
+	clients.erase(std::remove(clients.begin(), clients.end(), client), clients.end());
+	delete client;
+}
+
+
+// --- WAIT ---
+// Wait up to 'timeout' milliseconds for events for the client, moving them
+// into 'frames'. Returns false if the client fell behind and has to be
+// disconnected, or the server is stopping.
+bool Events::wait(EventClient* client, std::vector<EventFrame> &frames, uint32_t timeout) {
+	frames.clear();
+	std::unique_lock<std::mutex> lk(mtx);
+	if (client->queue.empty() && !client->overflowed && !stopping) {
+		client->cv.wait_for(lk, std::chrono::milliseconds(timeout));
+	}
+	
+	if (client->overflowed) {
+		std::cerr << "Event stream client fell behind. Disconnecting." << std::endl;
+		return false;
+	}
+	
+	if (stopping) { return false; }
+	
+	frames.assign(client->queue.begin(), client->queue.end());
+	client->queue.clear();
+	return true;
+}
@@ -0,0 +1,69 @@
+/*
+	events.h - Header file for the Events class.
+	
+	Revision 0
+	
+	Notes:
+			- Broadcasts changes to the node registry (new, updated and deleted
+				nodes, temperatures, duty cycles, valves and switches) to the
+				clients of the event stream, as server-sent events.
+			- The most recent events are kept, so that a client which
+				reconnects can resume after the last event it received.
+			- Each client has a bounded queue. A client which falls behind is
+				disconnected, instead of holding up the publishers.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#ifndef EVENTS_H
+#define EVENTS_H
+
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+
+typedef std::shared_ptr<const std::string> EventFrame;
+
+
+struct EventClient {
+	std::condition_variable cv;
+	std::deque<EventFrame> queue;
+	bool overflowed;
+};
+
+
+class Events {
+	struct Event {
+		uint64_t id;
+		EventFrame frame;
+	};
+	
+	static std::mutex mtx;
+	static std::deque<Event> backlog;
+	static std::vector<EventClient*> clients;
+	static uint64_t nextId;
+	static uint32_t backlogSize;
+	static uint32_t queueSize;
+	static uint32_t maxClients;
+	static uint32_t keepalive;
+	static bool stopping;
+
+public:
+	static void init(uint32_t backlogSize, uint32_t queueSize, uint32_t maxClients, 
+															uint32_t keepalive);
+	static uint32_t getKeepalive() { return keepalive; }
+	static void shutdown();
+	static void publish(const char* type, const std::string &data);
+	static EventClient* subscribe(const std::string &lastEventId, bool &reset);
+	static void unsubscribe(EventClient* client);
+	static bool wait(EventClient* client, std::vector<EventFrame> &frames, uint32_t timeout);
+};
+
+#endif
@@ -0,0 +1,118 @@
+/*
+	firmwarecache.cpp - Implementation of the FirmwareCache class.
+	
+	Revision 0
+	
+	Notes:
+			- The ETag is the SHA-256 of the image, which is also its name in
+				the firmware store.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#include "firmwarecache.h"
+#include "firmwarestore.h"
+
+#include <iostream>
+
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+// Static initialisations.
+std::mutex FirmwareCache::mtx;
+std::map<std::string, FirmwareCache::Entry> FirmwareCache::images;
+std::string FirmwareCache::root = "firmware/";
+uint32_t FirmwareCache::checkInterval = 1000;
+
+
+// --- FIRMWARE IMAGE ---
+FirmwareImage::~FirmwareImage() {
+	if (data) { munmap((void*) data, size); }
+}
+
+
+// --- INIT ---
+// 'root' is the firmware folder, ending with a slash. 'checkInterval' is in ms.
+void FirmwareCache::init(const std::string &root, uint32_t checkInterval) {
+	std::lock_guard<std::mutex> lk(mtx);
+	FirmwareCache::root = root;
+	FirmwareCache::checkInterval = checkInterval;
+	images.clear();
+}
+
+
+// --- MAP ---
+// Map the image, and verify it against its hash.
+FirmwareImagePtr FirmwareCache::map(const std::string &path, const std::string &hash, 
+																size_t size) {
+	std::shared_ptr<FirmwareImage> image = std::make_shared<FirmwareImage>();
+	if (size > 0) {
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0) { return FirmwareImagePtr(); }
+		void* data = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (data == MAP_FAILED) {
+			std::cerr << "Failed to map firmware image " << path << std::endl;
+			return FirmwareImagePtr();
+		}
+		
+		image->data = (const char*) data;
+		image->size = size;
+	}
+	
+	if (FirmwareStore::sha256(image->data, image->size) != hash) {
+		std::cerr << "Firmware image " << path << " doesn't match its hash." << std::endl;
+		return FirmwareImagePtr();
+	}
+	
+	image->etag = "\"" + hash + "\"";
+	return image;
+}
+
+
+// --- GET ---
+// Returns the image with the given hash, or an empty pointer if it doesn't
+// exist or is corrupted.
+FirmwareImagePtr FirmwareCache::get(const std::string &file) {
+	if (file.empty() || file.find('/') != std::string::npos || file[0] == '.') {
+		return FirmwareImagePtr();
+	}
+	
+	std::lock_guard<std::mutex> lk(mtx);
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	std::map<std::string, Entry>::iterator it = images.find(file);
+	if (it != images.end() && now - it->second.checked < std::chrono::milliseconds(checkInterval)) {
+		return it->second.image;
+	}
+	
+	std::string path = root + file;
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+		if (it != images.end()) { images.erase(it); }
+		return FirmwareImagePtr();
+	}
+	
+	if (it != images.end() && it->second.device == st.st_dev && it->second.inode == st.st_ino &&
+						it->second.mtime == st.st_mtime && it->second.size == st.st_size) {
+		it->second.checked = now;
+		return it->second.image;
+	}
+	
+	FirmwareImagePtr image = map(path, file, st.st_size);
+	if (!image) { return image; }
+	
+	std::cout << "Mapped firmware image " << path << " (" << st.st_size << " bytes).\n";
+	
+	Entry &entry = images[file];
+	entry.image = image;
+	entry.device = st.st_dev;
+	entry.inode = st.st_ino;
+	entry.mtime = st.st_mtime;
+	entry.size = st.st_size;
+	entry.checked = now;
+	return image;
+}
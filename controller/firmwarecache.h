@@ -0,0 +1,69 @@
+/*
+	firmwarecache.h - Header file for the FirmwareCache class.
+	
+	Revision 0
+	
+	Notes:
+			- Keeps the firmware images served to the nodes memory-mapped, so
+				that concurrent downloads of the same image share one copy,
+				which is written straight from the mapping to the socket.
+			- An image is checked against the file on disk at most once per
+				check interval. A file which was replaced is mapped anew, while
+				downloads still using the old mapping keep it alive.
+			- Images are the objects of the firmware store, named by their
+				SHA-256, which is verified when an image is mapped.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#ifndef FIRMWARECACHE_H
+#define FIRMWARECACHE_H
+
+
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+
+#include <sys/types.h>
+
+
+struct FirmwareImage {
+	const char* data;
+	size_t size;
+	std::string etag;
+	
+	FirmwareImage() : data(0), size(0) { }
+	~FirmwareImage();
+};
+
+
+typedef std::shared_ptr<const FirmwareImage> FirmwareImagePtr;
+
+
+class FirmwareCache {
+	struct Entry {
+		FirmwareImagePtr image;
+		dev_t device;
+		ino_t inode;
+		time_t mtime;
+		off_t size;
+		std::chrono::steady_clock::time_point checked;
+	};
+	
+	static std::mutex mtx;
+	static std::map<std::string, Entry> images;
+	static std::string root;
+	static uint32_t checkInterval;
+	
+	static FirmwareImagePtr map(const std::string &path, const std::string &hash, size_t size);
+
+public:
+	static void init(const std::string &root, uint32_t checkInterval);
+	static FirmwareImagePtr get(const std::string &file);
+};
+
+#endif
@@ -0,0 +1,295 @@
+/*
+	firmwarestore.cpp - Implementation of the FirmwareStore class.
+	
+	Revision 0
+	
+	Notes:
+			- Image files in the firmware folder from before the store are
+				imported under their file name on start-up, and nodes assigned
+				to them by name are assigned to their hash.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#include "firmwarestore.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <ctime>
+
+#include <Poco/Data/SQLite/Connector.h>
+#include <Poco/Data/SQLite/SQLiteException.h>
+#include <Poco/SHA2Engine.h>
+#include <Poco/File.h>
+
+using namespace Poco::Data::Keywords;
+
+
+// Static initialisations.
+std::mutex FirmwareStore::mtx;
+Data::Session* FirmwareStore::session = 0;
+std::string FirmwareStore::root = "firmware/";
+std::string FirmwareStore::defaultName;
+std::map<std::string, FirmwareInfo> FirmwareStore::images;
+std::map<std::string, std::string> FirmwareStore::assignments;
+
+
+// --- INIT ---
+// 'root' is the firmware folder, ending with a slash. 'defaultName' is the name
+// of the image assigned to new nodes.
+bool FirmwareStore::init(const std::string &root, const std::string &defaultName) {
+	FirmwareStore::root = root;
+	FirmwareStore::defaultName = defaultName;
+	
+	try {
+		File objects(getObjectRoot());
+		objects.createDirectories();
+		
+		Data::SQLite::Connector::registerConnector();
+		session = new Data::Session("SQLite", "nodes.db");
+		
+		// Ensure we have valid firmware tables.
+		(*session) << "CREATE TABLE IF NOT EXISTS firmware_images (name TEXT UNIQUE, \
+			version TEXT, \
+			hash TEXT, \
+			size INTEGER, \
+			uploaded INTEGER)", now;
+		(*session) << "CREATE TABLE IF NOT EXISTS firmware_assignments (uid TEXT UNIQUE, \
+			hash TEXT)", now;
+		(*session) << "CREATE TABLE IF NOT EXISTS firmware (uid TEXT UNIQUE, \
+			file TEXT)", now;
+		
+		std::cout << "Checked for firmware tables." << std::endl;
+		
+		// Load the index and the assignments into memory.
+		Data::Statement selectImages(*session);
+		FirmwareInfo info;
+		selectImages << "SELECT name, version, hash, size, uploaded FROM firmware_images",
+					into (info.name),
+					into (info.version),
+					into (info.hash),
+					into (info.size),
+					into (info.uploaded),
+					range(0, 1);
+		
+		while (!selectImages.done()) {
+			if (selectImages.execute() > 0) { images[info.name] = info; }
+		}
+		
+		Data::Statement selectAssignments(*session);
+		std::string uid;
+		std::string hash;
+		selectAssignments << "SELECT uid, hash FROM firmware_assignments",
+					into (uid),
+					into (hash),
+					range(0, 1);
+		
+		while (!selectAssignments.done()) {
+			if (selectAssignments.execute() > 0) { assignments[uid] = hash; }
+		}
+		
+		importFiles();
+		
+		// Assign nodes from the old 'firmware' table, which has image names.
+		Data::Statement selectNames(*session);
+		std::string file;
+		selectNames << "SELECT uid, file FROM firmware",
+					into (uid),
+					into (file),
+					range(0, 1);
+		
+		while (!selectNames.done()) {
+			if (selectNames.execute() > 0 && assignments.count(uid) == 0) { assign(uid, file); }
+		}
+	}
+	catch (Poco::Exception &e) {
+		std::cerr << "Firmware store: " << e.displayText() << std::endl;
+		return false;
+	}
+	
+	std::cout << "Firmware store has " << images.size() << " images, " << assignments.size()
+				<< " assigned nodes." << std::endl;
+	
+	return true;
+}
+
+
+// --- STOP ---
+void FirmwareStore::stop() {
+	delete session;
+	session = 0;
+}
+
+
+// --- VALID NAME ---
+// Names are used as file names in the firmware folder.
+bool FirmwareStore::validName(const std::string &name) {
+	return !name.empty() && name[0] != '.' && name.find('/') == std::string::npos &&
+						name.find(';') == std::string::npos && name.find(',') == std::string::npos;
+}
+
+
+// --- IMPORT FILES ---
+// Add the image files in the firmware folder which aren't in the store yet.
+void FirmwareStore::importFiles() {
+	std::vector<File> files;
+	File folder(root);
+	folder.list(files);
+	for (unsigned int i = 0; i < files.size(); ++i) {
+		std::string name = files[i].path().substr(files[i].path().rfind('/') + 1);
+		if (!files[i].isFile() || !validName(name) || images.count(name) > 0) { continue; }
+		
+		std::ifstream in(files[i].path(), std::ifstream::binary);
+		std::ostringstream data;
+		data << in.rdbuf();
+		FirmwareInfo info;
+		if (add(name, "", data.str(), info)) {
+			std::cout << "Imported firmware image " << name << " as " << info.hash << std::endl;
+		}
+	}
+}
+
+
+// --- SHA256 ---
+// SHA-256 of the data, in hex.
+std::string FirmwareStore::sha256(const void* data, size_t size) {
+	SHA2Engine engine(SHA2Engine::SHA_256);
+	engine.update(data, size);
+	return DigestEngine::digestToHex(engine.digest());
+}
+
+
+// --- ADD ---
+// Store an image under the given name, replacing any image with that name.
+// The image data is only written if no identical image is stored yet.
+bool FirmwareStore::add(const std::string &name, const std::string &version,
+									const std::string &data, FirmwareInfo &info) {
+	if (!validName(name)) {
+		std::cerr << "Invalid firmware image name: " << name << std::endl;
+		return false;
+	}
+	
+	info.name = name;
+	info.version = version;
+	info.hash = sha256(data.data(), data.size());
+	info.size = data.size();
+	
+	// Write to a temporary file first, so that a stored object is always
+	// complete.
+	std::string path = getObjectRoot() + info.hash;
+	File file(path);
+	if (!file.exists()) {
+		std::string temppath = path + ".tmp";
+		std::ofstream outfile(temppath, std::ofstream::binary | std::ofstream::trunc);
+		outfile.write(data.data(), data.size());
+		outfile.close();
+		if (!outfile || std::rename(temppath.c_str(), path.c_str()) != 0) {
+			std::cerr << "Failed to store firmware image " << path << std::endl;
+			return false;
+		}
+	}
+	
+	return addImage(info);
+}
+
+
+// --- ADD IMAGE ---
+// Add an image whose object is already stored to the index, under its name.
+bool FirmwareStore::addImage(FirmwareInfo &info) {
+	if (!validName(info.name)) {
+		std::cerr << "Invalid firmware image name: " << info.name << std::endl;
+		return false;
+	}
+	
+	info.uploaded = time(0);
+	std::lock_guard<std::mutex> lk(mtx);
+	(*session) << "INSERT OR REPLACE INTO firmware_images VALUES(?, ?, ?, ?, ?)",
+			use(info.name),
+			use(info.version),
+			use(info.hash),
+			use(info.size),
+			use(info.uploaded),
+			now;
+	
+	images[info.name] = info;
+	return true;
+}
+
+
+// --- HAS OBJECT ---
+bool FirmwareStore::hasObject(const std::string &hash) {
+	File file(getObjectRoot() + hash);
+	return file.exists();
+}
+
+
+// --- FIND ---
+bool FirmwareStore::find(const std::string &name, FirmwareInfo &info) {
+	std::lock_guard<std::mutex> lk(mtx);
+	std::map<std::string, FirmwareInfo>::const_iterator it = images.find(name);
+	if (it == images.end()) { return false; }
+	
+	info = it->second;
+	return true;
+}
+
+
+// --- LIST ---
+// Returns the index, ordered by name.
+std::vector<FirmwareInfo> FirmwareStore::list() {
+	std::lock_guard<std::mutex> lk(mtx);
+	std::vector<FirmwareInfo> out;
+	out.reserve(images.size());
+	std::map<std::string, FirmwareInfo>::const_iterator it;
+	for (it = images.begin(); it != images.end(); ++it) { out.push_back(it->second); }
+	return out;
+}
+
+
+// --- ASSIGN ---
+// Assign the image with the given name to the node. Fails if there's no such
+// image.
+bool FirmwareStore::assign(const std::string &uid, const std::string &name) {
+	std::lock_guard<std::mutex> lk(mtx);
+	std::map<std::string, FirmwareInfo>::const_iterator it = images.find(name);
+	if (it == images.end()) {
+		std::cerr << "Can't assign unknown firmware image " << name << " to " << uid << std::endl;
+		return false;
+	}
+	
+	std::string hash = it->second.hash;
+	(*session) << "INSERT OR REPLACE INTO firmware_assignments VALUES(?, ?)",
+			use(uid),
+			use(hash),
+			now;
+	
+	assignments[uid] = hash;
+	return true;
+}
+
+
+// --- ASSIGN DEFAULT ---
+// Assign the default image to the node, if it has no image assigned yet.
+void FirmwareStore::assignDefault(const std::string &uid) {
+	{
+		std::lock_guard<std::mutex> lk(mtx);
+		if (assignments.count(uid) > 0) { return; }
+	}
+	
+	assign(uid, defaultName);
+}
+
+
+// --- GET ASSIGNED ---
+// Sets 'hash' to the hash of the image assigned to the node.
+bool FirmwareStore::getAssigned(const std::string &uid, std::string &hash) {
+	std::lock_guard<std::mutex> lk(mtx);
+	std::map<std::string, std::string>::const_iterator it = assignments.find(uid);
+	if (it == assignments.end()) { return false; }
+	
+	hash = it->second;
+	return true;
+}
@@ -0,0 +1,72 @@
+/*
+	firmwarestore.h - Header file for the FirmwareStore class.
+	
+	Revision 0
+	
+	Notes:
+			- Firmware images are stored once per content, as 'objects/<hash>'
+				in the firmware folder, with the hash being the SHA-256 of the
+				image. Names refer to an image, and several names can refer to
+				the same one.
+			- The index of images and the assignment of an image to each node
+				are kept in memory, and written through to the database.
+			- Nodes are assigned an image by its hash. Uploading a new image
+				under an existing name doesn't change the image of the nodes
+				assigned to the old one.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#ifndef FIRMWARESTORE_H
+#define FIRMWARESTORE_H
+
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <cstdint>
+
+#include <Poco/Data/Session.h>
+
+using namespace Poco;
+
+
+struct FirmwareInfo {
+	std::string name;
+	std::string version;
+	std::string hash;		// SHA-256 of the image, in hex.
+	uint64_t size;
+	int64_t uploaded;		// Unix time.
+};
+
+
+class FirmwareStore {
+	static std::mutex mtx;
+	static Data::Session* session;
+	static std::string root;
+	static std::string defaultName;
+	static std::map<std::string, FirmwareInfo> images;			// By name.
+	static std::map<std::string, std::string> assignments;		// UID to hash.
+	
+	static void importFiles();
+
+public:
+	static bool init(const std::string &root, const std::string &defaultName);
+	static void stop();
+	static std::string getObjectRoot() { return root + "objects/"; }
+	static bool validName(const std::string &name);
+	static std::string sha256(const void* data, size_t size);
+	static bool add(const std::string &name, const std::string &version, const std::string &data,
+																	FirmwareInfo &info);
+	static bool addImage(FirmwareInfo &info);
+	static bool hasObject(const std::string &hash);
+	static bool find(const std::string &name, FirmwareInfo &info);
+	static std::vector<FirmwareInfo> list();
+	static bool assign(const std::string &uid, const std::string &name);
+	static void assignDefault(const std::string &uid);
+	static bool getAssigned(const std::string &uid, std::string &hash);
+};
+
+#endif
@@ -0,0 +1,246 @@
+/*
+	firmwareupload.cpp - Implementation of the FirmwareUpload class.
+	
+	Revision 0
+	
+	Notes:
+			- Replies are published by the listener on 'cc/firmware/upload':
+				* ready;<hash>;<chunk size>;<missing chunks>
+				* missing;<hash>;<missing chunks>
+				* done;<hash>
+				* failed;<hash>;<reason>
+				* unknown;<hash>
+				Missing chunks are a comma-separated list of chunk indices and
+				ranges, e.g. '0-15,18'.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#include "firmwareupload.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <Poco/SHA2Engine.h>
+#include <Poco/File.h>
+
+using namespace Poco;
+
+
+// Static initialisations.
+std::mutex FirmwareUpload::mtx;
+std::map<std::string, FirmwareUpload::Upload*> FirmwareUpload::uploads;
+
+
+// --- INIT ---
+// Remove the temporary files of uploads from before a restart.
+void FirmwareUpload::init() {
+	std::vector<File> files;
+	File folder(FirmwareStore::getObjectRoot());
+	folder.list(files);
+	for (unsigned int i = 0; i < files.size(); ++i) {
+		const std::string &path = files[i].path();
+		if (path.size() > 5 && path.compare(path.size() - 5, 5, ".part") == 0) {
+			std::cout << "Removing incomplete firmware upload " << path << std::endl;
+			files[i].remove();
+		}
+	}
+}
+
+
+// --- VALID HASH ---
+// A SHA-256 in lower-case hex.
+bool FirmwareUpload::validHash(const std::string &hash) {
+	return hash.size() == 64 && hash.find_first_not_of("0123456789abcdef") == std::string::npos;
+}
+
+
+// --- MISSING ---
+// Ranges of the chunks which haven't been received yet.
+std::string FirmwareUpload::missing(const Upload &upload) {
+	std::string out;
+	uint32_t count = upload.received.size();
+	for (uint32_t i = 0; i < count; ++i) {
+		if (upload.received[i]) { continue; }
+		uint32_t last = i;
+		while (last + 1 < count && !upload.received[last + 1]) { ++last; }
+		if (!out.empty()) { out += ","; }
+		out += std::to_string(i);
+		if (last > i) { out += "-" + std::to_string(last); }
+		i = last;
+	}
+	
+	return out;
+}
+
+
+// --- VERIFY ---
+// Check the SHA-256 of the received file.
+bool FirmwareUpload::verify(Upload &upload) {
+	SHA2Engine engine(SHA2Engine::SHA_256);
+	std::vector<char> buffer(firmwareChunkSize);
+	uint64_t offset = 0;
+	while (offset < upload.info.size) {
+		ssize_t bytes = pread(upload.fd, buffer.data(), buffer.size(), offset);
+		if (bytes <= 0) { return false; }
+		engine.update(buffer.data(), bytes);
+		offset += bytes;
+	}
+	
+	return DigestEngine::digestToHex(engine.digest()) == upload.info.hash;
+}
+
+
+// --- REMOVE ---
+// Drop an upload, and optionally its temporary file.
+void FirmwareUpload::remove(const std::string &hash, bool unlinkFile) {
+	std::map<std::string, Upload*>::iterator it = uploads.find(hash);
+	if (it == uploads.end()) { return; }
+	
+	close(it->second->fd);
+	if (unlinkFile) { unlink(it->second->path.c_str()); }
+	delete it->second;
+	uploads.erase(it);
+}
+
+
+// --- BEGIN ---
+// Start an upload, or continue the upload of the image with this hash. If the
+// image is stored already, it's only added under the new name.
+std::string FirmwareUpload::begin(const std::string &name, const std::string &version,
+												uint64_t size, const std::string &hash) {
+	if (!validHash(hash)) { return "failed;" + hash + ";Invalid hash."; }
+	if (!FirmwareStore::validName(name)) { return "failed;" + hash + ";Invalid name."; }
+	if (size == 0 || size > maxFirmwareSize) { return "failed;" + hash + ";Invalid size."; }
+	
+	FirmwareInfo info;
+	info.name = name;
+	info.version = version;
+	info.hash = hash;
+	info.size = size;
+	
+	std::lock_guard<std::mutex> lk(mtx);
+	if (FirmwareStore::hasObject(hash)) {
+		remove(hash, true);
+		if (!FirmwareStore::addImage(info)) { return "failed;" + hash + ";Storing failed."; }
+		return "done;" + hash;
+	}
+	
+	std::map<std::string, Upload*>::iterator it = uploads.find(hash);
+	if (it != uploads.end() && it->second->info.size != size) {
+		remove(hash, true);
+		it = uploads.end();
+	}
+	
+	if (it == uploads.end()) {
+		// Make room by dropping the upload which was active least recently.
+		if (uploads.size() >= maxFirmwareUploads) {
+			std::map<std::string, Upload*>::iterator oldest = uploads.begin();
+			for (std::map<std::string, Upload*>::iterator i = uploads.begin(); i != uploads.end(); ++i) {
+				if (i->second->active < oldest->second->active) { oldest = i; }
+			}
+			
+			std::cout << "Dropping firmware upload " << oldest->first << std::endl;
+			remove(oldest->first, true);
+		}
+		
+		std::string path = FirmwareStore::getObjectRoot() + hash + ".part";
+		int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) { return "failed;" + hash + ";Creating file failed."; }
+		if (ftruncate(fd, size) != 0) {
+			close(fd);
+			unlink(path.c_str());
+			return "failed;" + hash + ";Creating file failed.";
+		}
+		
+		uint32_t count = (size + firmwareChunkSize - 1) / firmwareChunkSize;
+		Upload* upload = new Upload;
+		upload->path = path;
+		upload->fd = fd;
+		upload->received.assign(count, false);
+		upload->remaining = count;
+		it = uploads.insert(std::make_pair(hash, upload)).first;
+		
+		std::cout << "Starting firmware upload of " << name << " (" << size << " bytes, "
+					<< count << " chunks)." << std::endl;
+	}
+	
+	Upload &upload = *(it->second);
+	upload.info = info;
+	upload.active = std::chrono::steady_clock::now();
+	return "ready;" + hash + ";" + std::to_string(firmwareChunkSize) + ";" + missing(upload);
+}
+
+
+// --- CHUNK ---
+// Write a chunk of an upload. Invalid chunks, and chunks of unknown uploads,
+// are dropped. The client finds out through a status request. Returns the
+// reply once the upload is complete.
+std::string FirmwareUpload::chunk(const std::string &hash, uint32_t index, const char* data,
+																	size_t size) {
+	std::lock_guard<std::mutex> lk(mtx);
+	std::map<std::string, Upload*>::iterator it = uploads.find(hash);
+	if (it == uploads.end()) { return std::string(); }
+	
+	Upload &upload = *(it->second);
+	uint64_t offset = (uint64_t) index * firmwareChunkSize;
+	if (index >= upload.received.size() ||
+			size != std::min<uint64_t>(firmwareChunkSize, upload.info.size - offset)) {
+		std::cerr << "Invalid chunk " << index << " for firmware upload " << hash << std::endl;
+		return std::string();
+	}
+	
+	if (pwrite(upload.fd, data, size, offset) != (ssize_t) size) {
+		std::cerr << "Writing chunk " << index << " of firmware upload " << hash << " failed."
+					<< std::endl;
+		return std::string();
+	}
+	
+	upload.active = std::chrono::steady_clock::now();
+	if (!upload.received[index]) {
+		upload.received[index] = true;
+		--upload.remaining;
+	}
+	
+	if (upload.remaining > 0) { return std::string(); }
+	
+	// All chunks received. Verify the image, and move it into the store.
+	if (!verify(upload)) {
+		std::cerr << "Firmware upload " << hash << " doesn't match its hash." << std::endl;
+		upload.received.assign(upload.received.size(), false);
+		upload.remaining = upload.received.size();
+		return "failed;" + hash + ";Hash mismatch.";
+	}
+	
+	std::string path = FirmwareStore::getObjectRoot() + hash;
+	if (fsync(upload.fd) != 0 || std::rename(upload.path.c_str(), path.c_str()) != 0) {
+		remove(hash, true);
+		return "failed;" + hash + ";Storing failed.";
+	}
+	
+	FirmwareInfo info = upload.info;
+	remove(hash, false);
+	if (!FirmwareStore::addImage(info)) { return "failed;" + hash + ";Storing failed."; }
+	
+	std::cout << "Stored firmware image " << info.name << " (" << info.size << " bytes) as "
+				<< hash << std::endl;
+	return "done;" + hash;
+}
+
+
+// --- STATUS ---
+// Report the missing chunks of an upload, or whether the image is stored.
+std::string FirmwareUpload::status(const std::string &hash) {
+	if (!validHash(hash)) { return std::string(); }
+	
+	std::lock_guard<std::mutex> lk(mtx);
+	std::map<std::string, Upload*>::iterator it = uploads.find(hash);
+	if (it != uploads.end()) { return "missing;" + hash + ";" + missing(*(it->second)); }
+	if (FirmwareStore::hasObject(hash)) { return "done;" + hash; }
+	return "unknown;" + hash;
+}
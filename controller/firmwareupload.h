@@ -0,0 +1,76 @@
+/*
+	firmwareupload.h - Header file for the FirmwareUpload class.
+	
+	Revision 0
+	
+	Notes:
+			- Receives firmware images over MQTT in numbered chunks of a fixed
+				size, which are written to a temporary file at their offset, so
+				that they can arrive in any order and the image is never held
+				in memory.
+			- The received chunks are tracked per upload. A client can ask
+				for the chunks which are still missing, and resend only those,
+				e.g. after lost messages or a reconnect.
+			- Once all chunks are received, the SHA-256 of the file is checked
+				against the hash given when starting the upload, after which it
+				is renamed into the firmware store.
+			- Uploads are kept in memory only. After a restart of the service,
+				an upload has to be started again.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#ifndef FIRMWAREUPLOAD_H
+#define FIRMWAREUPLOAD_H
+
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+
+#include "firmwarestore.h"
+
+
+// Size of the chunks, except for the last one of an image.
+const uint32_t firmwareChunkSize = 64 * 1024;
+
+// Largest image which can be uploaded.
+const uint64_t maxFirmwareSize = 16 * 1024 * 1024;
+
+// Number of uploads in progress at the same time. Starting another one drops
+// the least recently active upload.
+const uint32_t maxFirmwareUploads = 4;
+
+
+class FirmwareUpload {
+	struct Upload {
+		FirmwareInfo info;
+		std::string path;
+		int fd;
+		std::vector<bool> received;
+		uint32_t remaining;
+		std::chrono::steady_clock::time_point active;
+	};
+	
+	static std::mutex mtx;
+	static std::map<std::string, Upload*> uploads;		// By hash.
+	
+	static bool validHash(const std::string &hash);
+	static std::string missing(const Upload &upload);
+	static bool verify(Upload &upload);
+	static void remove(const std::string &hash, bool unlinkFile);
+
+public:
+	static void init();
+	static std::string begin(const std::string &name, const std::string &version, uint64_t size,
+																	const std::string &hash);
+	static std::string chunk(const std::string &hash, uint32_t index, const char* data,
+																	size_t size);
+	static std::string status(const std::string &hash);
+};
+
+#endif
@@ -21,16 +21,125 @@ using namespace Poco::Net;
 
 #include "achandler.h"
 #include "cchandler.h"
+#include "eventhandler.h"
 #include "datahandler.h"
+#include "metricshandler.h"
+#include "admission.h"
+
+
+// Classes of requests, each with its own latency metrics and admission limits.
+// Firmware downloads by the nodes are the data requests with a 'uid' query.
+// Event streams last as long as the client stays connected, and are limited
+// by the event stream itself.
+enum HttpHandlerClass {
+	HTTP_AC = 0,
+	HTTP_CC,
+	HTTP_DATA,
+	HTTP_FIRMWARE,
+	HTTP_HANDLER_COUNT
+};
+
+
+// Wraps a request handler, admitting the request by its class and recording the
+// time spent handling it. A rejected request gets a 503 response.
+// An idle keep-alive connection holds a server thread outside the admission
+// limits, so rejected requests, and those of classes without 'keepAlive', close
+// their connection once answered.
+class TimedHandler: public HTTPRequestHandler {
+	HTTPRequestHandler* handler;
+	Admission &admission;
+	Histogram &latency;
+	bool keepAlive;
+	
+public:
+	TimedHandler(HTTPRequestHandler* handler, Admission &admission, Histogram &latency,
+											bool keepAlive) : handler(handler), 
+											admission(admission), latency(latency), 
+											keepAlive(keepAlive) { }
+	~TimedHandler() { delete handler; }
+	
+	void handleRequest(HTTPServerRequest& request, HTTPServerResponse& response) {
+		if (!keepAlive) { response.setKeepAlive(false); }
+		if (!admission.enter()) {
+			response.setKeepAlive(false);
+			response.setStatus(HTTPResponse::HTTP_SERVICE_UNAVAILABLE);
+			response.set("Retry-After", std::to_string(admission.getRetryAfter()));
+			response.setContentType("application/json");
+			std::ostream& ostr = response.send();
+			ostr << "{ \"error\": \"Server busy, retry later.\" }";
+			return;
+		}
+		
+		try {
+			MetricsTimer timer(latency);
+			handler->handleRequest(request, response);
+		}
+		catch (...) {
+			admission.leave();
+			throw;
+		}
+		
+		admission.leave();
+	}
+};
 
 
 class RequestHandlerFactory: public HTTPRequestHandlerFactory { 
+	Admission admission[HTTP_HANDLER_COUNT];
+	Histogram latency[HTTP_HANDLER_COUNT];
+	
+	// Nodes download a single firmware image per connection, so there's no point
+	// in keeping theirs open.
+	TimedHandler* timed(HTTPRequestHandler* handler, HttpHandlerClass cls) {
+		return new TimedHandler(handler, admission[cls], latency[cls], cls != HTTP_FIRMWARE);
+	}
+	
 public:
-	RequestHandlerFactory() {}
+	RequestHandlerFactory() {
+		static const char* names[HTTP_HANDLER_COUNT] = { "ac", "cc", "data", "firmware" };
+		for (uint32_t i = 0; i < HTTP_HANDLER_COUNT; ++i) {
+			std::string label = std::string("handler=\"") + names[i] + "\"";
+			Admission* adm = &admission[i];
+			Metrics::addHistogram("bmac_http_request_seconds", 
+									"Time spent handling HTTP requests, by handler.",
+									label, &latency[i]);
+			Metrics::addHistogram("bmac_http_queue_seconds", 
+									"Time HTTP requests waited for admission, by handler.",
+									label, &adm->wait);
+			Metrics::addCounter("bmac_http_rejected_total", 
+									"HTTP requests rejected with a 503, by handler.", label, 
+									&adm->rejected);
+			Metrics::addCallback("bmac_http_active", "HTTP requests being handled, by handler.",
+									label, METRIC_GAUGE, 
+									[adm]() { return (double) adm->getActive(); });
+			Metrics::addCallback("bmac_http_queued", 
+									"HTTP requests waiting for admission, by handler.", label,
+									METRIC_GAUGE, [adm]() { return (double) adm->getQueued(); });
+		}
+	}
+	
+	// Limits the requests of a class to 'active' at a time, with 'queued' more
+	// waiting up to 'timeout' ms. Returns the number of server threads the class
+	// can occupy.
+	uint32_t setLimits(HttpHandlerClass cls, uint32_t active, uint32_t queued, uint32_t timeout,
+																	uint32_t retryAfter) {
+		admission[cls].setLimits(active, queued, timeout, retryAfter);
+		return admission[cls].getThreads();
+	}
+	
 	HTTPRequestHandler* createRequestHandler(const HTTPServerRequest& request) {
-		if (request.getURI().compare(0, 4, "/ac/") == 0) { return new ACHandler(); }
-		else if (request.getURI().compare(0, 4, "/cc/") == 0) { return new CCHandler(); }
-		else { return new DataHandler(); }
+		const std::string &uri = request.getURI();
+		if (uri.compare(0, 4, "/ac/") == 0) { return timed(new ACHandler(), HTTP_AC); }
+		else if (uri.compare(0, 10, "/cc/events") == 0) { return new EventHandler(); }
+		else if (uri.compare(0, 4, "/cc/") == 0) { return timed(new CCHandler(), HTTP_CC); }
+		else if (uri == "/metrics") { return new MetricsHandler(); }
+		
+		std::string::size_type query = uri.find('?');
+		if (query != std::string::npos && uri.compare(query + 1, 4, "uid=") == 0) {
+			return timed(new DataHandler(), HTTP_FIRMWARE);
+		}
+		
+		return timed(new DataHandler(), HTTP_DATA);
 	}
 };
 
@@ -0,0 +1,169 @@
+/*
+	metrics.cpp - Implementation of the controller's metrics.
+	
+	Revision 0
+	
+	Notes:
+			- Reads sum the shards without locking, so a read may miss updates
+				which happen at the same time. Counts never go backwards.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#include "metrics.h"
+
+#include <algorithm>
+#include <cstdio>
+
+
+// Static initialisations.
+std::mutex Metrics::mtx;
+std::vector<Metrics::Entry> Metrics::entries;
+
+// Upper bounds of the histogram buckets, in microseconds: 5 us to 10 s.
+const uint64_t Histogram::bounds[histogramBuckets] = {
+	5, 10, 25, 50, 100, 250, 500,
+	1000, 2500, 5000, 10000, 25000, 50000,
+	100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000
+};
+
+static std::atomic<uint32_t> nextShard(0);
+
+
+// --- METRIC SHARD ---
+// Shard used by the calling thread.
+uint32_t metricShard() {
+	static thread_local uint32_t shard = nextShard.fetch_add(1) % metricShards;
+	return shard;
+}
+
+
+// --- COUNTER ---
+Counter::Counter() {
+	for (uint32_t i = 0; i < metricShards; ++i) { shards[i].value = 0; }
+}
+
+
+// --- VALUE ---
+uint64_t Counter::value() const {
+	uint64_t total = 0;
+	for (uint32_t i = 0; i < metricShards; ++i) {
+		total += shards[i].value.load(std::memory_order_relaxed);
+	}
+	
+	return total;
+}
+
+
+// --- HISTOGRAM ---
+Histogram::Histogram() {
+	for (uint32_t i = 0; i < metricShards; ++i) {
+		for (uint32_t j = 0; j <= histogramBuckets; ++j) { shards[i].counts[j] = 0; }
+		shards[i].sum = 0;
+	}
+}
+
+
+// --- OBSERVE ---
+// Record a duration in microseconds.
+void Histogram::observe(uint64_t us) {
+	uint32_t bucket = std::lower_bound(bounds, bounds + histogramBuckets, us) - bounds;
+	Shard &shard = shards[metricShard()];
+	shard.counts[bucket].fetch_add(1, std::memory_order_relaxed);
+	shard.sum.fetch_add(us, std::memory_order_relaxed);
+}
+
+
+// --- READ ---
+// Sum the shards into 'counts' (histogramBuckets + 1 entries, not cumulative)
+// and 'sum' (microseconds).
+void Histogram::read(uint64_t* counts, uint64_t &sum) const {
+	sum = 0;
+	for (uint32_t j = 0; j <= histogramBuckets; ++j) { counts[j] = 0; }
+	for (uint32_t i = 0; i < metricShards; ++i) {
+		for (uint32_t j = 0; j <= histogramBuckets; ++j) {
+			counts[j] += shards[i].counts[j].load(std::memory_order_relaxed);
+		}
+		
+		sum += shards[i].sum.load(std::memory_order_relaxed);
+	}
+}
+
+
+// --- ADD ---
+void Metrics::add(const Entry &entry) {
+	std::lock_guard<std::mutex> lk(mtx);
+	entries.push_back(entry);
+}
+
+
+// --- ADD COUNTER ---
+void Metrics::addCounter(const std::string &name, const std::string &help,
+							const std::string &labels, const Counter* counter) {
+	Entry entry = { name, help, labels, METRIC_COUNTER, counter, 0, MetricCallback() };
+	add(entry);
+}
+
+
+// --- ADD HISTOGRAM ---
+void Metrics::addHistogram(const std::string &name, const std::string &help,
+							const std::string &labels, const Histogram* histogram) {
+	Entry entry = { name, help, labels, METRIC_HISTOGRAM, 0, histogram, MetricCallback() };
+	add(entry);
+}
+
+
+// --- ADD CALLBACK ---
+// Export the value returned by the callback as a counter or gauge.
+void Metrics::addCallback(const std::string &name, const std::string &help,
+							const std::string &labels, MetricType type, MetricCallback callback) {
+	Entry entry = { name, help, labels, type, 0, 0, callback };
+	add(entry);
+}
+
+
+// --- WRITE ---
+// Write all metrics in the Prometheus text format, grouped by name.
+void Metrics::write(std::ostream &out) {
+	std::lock_guard<std::mutex> lk(mtx);
+	std::vector<const Entry*> sorted;
+	for (unsigned int i = 0; i < entries.size(); ++i) { sorted.push_back(&entries[i]); }
+	std::stable_sort(sorted.begin(), sorted.end(),
+						[](const Entry* a, const Entry* b) { return a->name < b->name; });
+	
+	static const char* typeNames[] = { "counter", "gauge", "histogram" };
+	char value[32];
+	uint64_t counts[histogramBuckets + 1];
+	for (unsigned int i = 0; i < sorted.size(); ++i) {
+		const Entry &e = *sorted[i];
+		if (i == 0 || sorted[i - 1]->name != e.name) {
+			out << "# HELP " << e.name << " " << e.help << "\n";
+			out << "# TYPE " << e.name << " " << typeNames[e.type] << "\n";
+		}
+		
+		std::string labels = e.labels.empty() ? std::string() : "{" + e.labels + "}";
+		if (e.type != METRIC_HISTOGRAM) {
+			double v = e.counter ? (double) e.counter->value() : e.callback();
+			snprintf(value, sizeof(value), "%.17g", v);
+			out << e.name << labels << " " << value << "\n";
+			continue;
+		}
+		
+		uint64_t sum;
+		e.histogram->read(counts, sum);
+		std::string prefix = e.name + "_bucket{" + e.labels + (e.labels.empty() ? "" : ",");
+		uint64_t total = 0;
+		for (uint32_t j = 0; j < histogramBuckets; ++j) {
+			total += counts[j];
+			snprintf(value, sizeof(value), "%g", Histogram::bounds[j] / 1000000.0);
+			out << prefix << "le=\"" << value << "\"} " << total << "\n";
+		}
+		
+		total += counts[histogramBuckets];
+		out << prefix << "le=\"+Inf\"} " << total << "\n";
+		snprintf(value, sizeof(value), "%.17g", sum / 1000000.0);
+		out << e.name << "_sum" << labels << " " << value << "\n";
+		out << e.name << "_count" << labels << " " << total << "\n";
+	}
+}
@@ -0,0 +1,135 @@
+/*
+	metrics.h - Header file for the controller's metrics.
+	
+	Revision 0
+	
+	Notes:
+			- Counters and fixed-bucket latency histograms, exported in the
+				Prometheus text format at /metrics.
+			- Recording is lock-free: each thread updates its own shard of a
+				metric with relaxed atomic adds, and shards are summed when the
+				metrics are read. Shards are padded to the size of a cache line.
+			- Other values (e.g. statistics kept elsewhere, server state) can
+				be exported through callbacks, which are only called on read.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#ifndef METRICS_H
+#define METRICS_H
+
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <ostream>
+#include <cstdint>
+
+
+// Number of shards per metric. Threads are spread over the shards in order of
+// their first update.
+const uint32_t metricShards = 16;
+
+// Number of histogram buckets, excluding +Inf.
+const uint32_t histogramBuckets = 20;
+
+
+uint32_t metricShard();
+
+
+class Counter {
+	struct Shard {
+		std::atomic<uint64_t> value;
+		char pad[64 - sizeof(std::atomic<uint64_t>)];
+	};
+	
+	Shard shards[metricShards];
+
+public:
+	Counter();
+	
+	void add(uint64_t n = 1) { shards[metricShard()].value.fetch_add(n, std::memory_order_relaxed); }
+	uint64_t value() const;
+};
+
+
+class Histogram {
+	struct Shard {
+		std::atomic<uint64_t> counts[histogramBuckets + 1];
+		std::atomic<uint64_t> sum;
+		char pad[64 - ((histogramBuckets + 2) * sizeof(std::atomic<uint64_t>)) % 64];
+	};
+	
+	Shard shards[metricShards];
+
+public:
+	static const uint64_t bounds[histogramBuckets];
+	
+	Histogram();
+	
+	void observe(uint64_t us);
+	void read(uint64_t* counts, uint64_t &sum) const;
+};
+
+
+// Records the time from its construction until it goes out of scope, or until
+// stop() is called.
+class MetricsTimer {
+	Histogram* histogram;
+	std::chrono::steady_clock::time_point start;
+
+public:
+	explicit MetricsTimer(Histogram &histogram) : histogram(&histogram),
+											start(std::chrono::steady_clock::now()) { }
+	~MetricsTimer() { stop(); }
+	
+	void stop() {
+		if (!histogram) { return; }
+		histogram->observe(std::chrono::duration_cast<std::chrono::microseconds>(
+									std::chrono::steady_clock::now() - start).count());
+		histogram = 0;
+	}
+};
+
+
+enum MetricType {
+	METRIC_COUNTER,
+	METRIC_GAUGE,
+	METRIC_HISTOGRAM
+};
+
+
+typedef std::function<double()> MetricCallback;
+
+
+class Metrics {
+	struct Entry {
+		std::string name;
+		std::string help;
+		std::string labels;		// E.g. 'handler="cc"', or empty.
+		MetricType type;
+		const Counter* counter;
+		const Histogram* histogram;
+		MetricCallback callback;
+	};
+	
+	static std::mutex mtx;
+	static std::vector<Entry> entries;
+	
+	static void add(const Entry &entry);
+
+public:
+	static void addCounter(const std::string &name, const std::string &help,
+							const std::string &labels, const Counter* counter);
+	static void addHistogram(const std::string &name, const std::string &help,
+							const std::string &labels, const Histogram* histogram);
+	static void addCallback(const std::string &name, const std::string &help,
+							const std::string &labels, MetricType type, MetricCallback callback);
+	static void write(std::ostream &out);
+};
+
+#endif
@@ -0,0 +1,37 @@
+/*
+	metricshandler.h - Header file for the MetricsHandler class.
+	
+	Revision 0
+	
+	Notes:
+			- Serves the controller's metrics in the Prometheus text format.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#ifndef METRICSHANDLER_H
+#define METRICSHANDLER_H
+
+#include <Poco/Net/HTTPRequestHandler.h>
+#include <Poco/Net/HTTPServerResponse.h>
+#include <Poco/Net/HTTPServerRequest.h>
+
+using namespace Poco::Net;
+
+#include "metrics.h"
+
+
+class MetricsHandler: public HTTPRequestHandler {
+public:
+	void handleRequest(HTTPServerRequest& request, HTTPServerResponse& response) {
+		// * GET /metrics
+		// -> Returns all metrics.
+		response.setContentType("text/plain; version=0.0.4");
+		response.setChunkedTransferEncoding(true);
+		std::ostream& ostr = response.send();
+		Metrics::write(ostr);
+	}
+};
+
+#endif
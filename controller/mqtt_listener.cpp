@@ -9,22 +9,52 @@
 
 #include "mqtt_listener.h"
 #include "nodes.h"
+#include "metrics.h"
+#include "firmwarestore.h"
+#include "firmwareupload.h"
 
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <chrono>
+#include <cstdlib>
 
 #include <Poco/StringTokenizer.h>
 #include <Poco/String.h>
-#include <Poco/Net/HTTPSClientSession.h>
-#include <Poco/Net/HTTPRequest.h>
-#include <Poco/Net/HTTPResponse.h>
 #include <Poco/File.h>
+#include <Poco/Thread.h>
+#include <Poco/NumberFormatter.h>
 
 using namespace Poco::Data::Keywords;
 
 
+// Classes of topics, by the branch of the message handler they're handled in.
+enum MqttClass {
+	MQTT_CONFIG = 0,
+	MQTT_UI_CONFIG,
+	MQTT_NODES_NEW,
+	MQTT_NODES_UPDATE,
+	MQTT_NODES_DELETE,
+	MQTT_CO2_EVENT,
+	MQTT_FIRMWARE,
+	MQTT_PWM_RESPONSE,
+	MQTT_IO_RESPONSE,
+	MQTT_SWITCH_RESPONSE,
+	MQTT_BATCH,
+	MQTT_SENSOR,
+	MQTT_CLASS_COUNT
+};
+
+static const char* mqttClassNames[MQTT_CLASS_COUNT] = {
+	"config", "ui_config", "nodes_new", "nodes_update", "nodes_delete", "co2_event",
+	"firmware", "pwm_response", "io_response", "switch_response", "batch", "sensor"
+};
+
+static Counter mqttMessages[MQTT_CLASS_COUNT];
+static Histogram mqttLatency[MQTT_CLASS_COUNT];
+
+
 // Structs
 struct Node {
 	std::string uid;
@@ -37,6 +67,19 @@ struct Node {
 
 // --- CONSTRUCTOR ---
 Listener::Listener() {
+	influx = 0;
+	dedup = 0;
+	batchTopic = "nsa/batch";
+	
+	for (uint32_t i = 0; i < MQTT_CLASS_COUNT; ++i) {
+		std::string labels = std::string("class=\"") + mqttClassNames[i] + "\"";
+		Metrics::addCounter("bmac_mqtt_messages_total", "MQTT messages handled, by topic class.", 
+															labels, &mqttMessages[i]);
+		Metrics::addHistogram("bmac_mqtt_handler_seconds", 
+								"Time spent handling MQTT messages, by topic class.", labels, 
+								&mqttLatency[i]);
+	}
+	
 	// Initialise the MQTT client.
 	//client.setClientId("BMaC_Controller");
 	using namespace std::placeholders;
@@ -88,6 +131,29 @@ bool Listener::init(std::string clientId, std::string host, int port) {
 }
 
 
+// --- SET INFLUX ---
+// Set the Influx cluster and the topic to series mapping used for forwarding
+// sensor readings. Must be called before subscribing to the sensor topics.
+void Listener::setInflux(InfluxCluster* influx, const std::map<std::string, std::string> &series) {
+	this->influx = influx;
+	this->series = series;
+}
+
+
+// --- SET DEDUP ---
+// Drop sensor readings redelivered by the broker instead of forwarding them.
+void Listener::setDedup(DedupWindow* dedup) {
+	this->dedup = dedup;
+}
+
+
+// --- SET BATCH TOPIC ---
+// Topic on which nodes publish batches of sensor readings. Empty to disable.
+void Listener::setBatchTopic(const std::string &topic) {
+	batchTopic = topic;
+}
+
+
 // --- ADD SUBSCRIPTION ---
 bool Listener::addSubscription(std::string topic) {
 	std::string result;
@@ -133,8 +199,52 @@ bool Listener::publishMessage(std::string topic, std::string msg, uint8_t qos, b
 }
 
 
+// --- SPLIT FIELDS ---
+// Read 'count' semi-colon terminated fields following the semi-colon at 'pos'.
+// Afterwards 'pos' is the start of the rest of the payload, which may contain
+// binary data.
+static bool splitFields(const std::string &payload, unsigned int count, 
+							std::vector<std::string> &fields, std::string::size_type &pos) {
+	while (fields.size() < count && pos != std::string::npos) {
+		std::string::size_type next = payload.find(';', pos + 1);
+		if (next == std::string::npos) { return false; }
+		fields.push_back(payload.substr(pos + 1, next - pos - 1));
+		pos = next;
+	}
+	
+	if (fields.size() != count) { return false; }
+	
+	++pos;
+	return true;
+}
+
+
 // --- MESSAGE HANDLER ---
+// Count and time each message by the class of its topic.
 void Listener::messageHandler(int handle, std::string topic, std::string payload) {
+	uint32_t cls = MQTT_SENSOR;
+	if (topic.compare(0, 3, "cc/") == 0) {
+		if (topic == "cc/config") { cls = MQTT_CONFIG; }
+		else if (topic == "cc/ui/config") { cls = MQTT_UI_CONFIG; }
+		else if (topic == "cc/nodes/new") { cls = MQTT_NODES_NEW; }
+		else if (topic == "cc/nodes/update") { cls = MQTT_NODES_UPDATE; }
+		else if (topic == "cc/nodes/delete") { cls = MQTT_NODES_DELETE; }
+		else if (topic == "cc/firmware") { cls = MQTT_FIRMWARE; }
+	}
+	else if (topic == "nsa/events/co2") { cls = MQTT_CO2_EVENT; }
+	else if (topic == "pwm/response") { cls = MQTT_PWM_RESPONSE; }
+	else if (topic.compare(0, 11, "io/response") == 0) { cls = MQTT_IO_RESPONSE; }
+	else if (topic.compare(0, 15, "switch/response") == 0) { cls = MQTT_SWITCH_RESPONSE; }
+	else if (!batchTopic.empty() && topic == batchTopic) { cls = MQTT_BATCH; }
+	
+	mqttMessages[cls].add();
+	MetricsTimer timer(mqttLatency[cls]);
+	dispatchMessage(topic, payload);
+}
+
+
+// --- DISPATCH MESSAGE ---
+void Listener::dispatchMessage(const std::string &topic, const std::string &payload) {
 	// Handle:
 	// * On Connect.
 	// * Subscriptions.
@@ -445,54 +555,70 @@ void Listener::messageHandler(int handle, std::string topic, std::string payload
 	}
 	else if (topic == "cc/firmware") {
 		if (payload == "list") {
-			// Return a list of the available firmware images as found on the 
-			// filesystem.
-			std::vector<File> files;
-			File file("firmware");
-			if (!file.isDirectory()) { return; }
-			
-			file.list(files);
+			// Return the index of the firmware store, as a semi-colon separated 
+			// list of 'name,version,size,hash,uploaded' entries.
+			std::vector<FirmwareInfo> images = FirmwareStore::list();
 			std::string out;
-			for (int i = 0; i < files.size(); ++i) {
-				if (files[i].isFile()) {
-					out += files[i].path();
-					out += ";";
-				}
+			for (unsigned int i = 0; i < images.size(); ++i) {
+				if (i > 0) { out += ";"; }
+				out += images[i].name + "," + images[i].version + "," + 
+						std::to_string(images[i].size) + "," + images[i].hash + "," + 
+						std::to_string(images[i].uploaded);
 			}
 			
-			// Erase last semi-colon.
-			out.pop_back();
-			
-			//publish(0, "cc/firmware/list", out.length(), out.c_str());
 			publishMessage("cc/firmware/list", out);
 		}
 		else {
 			// Payload should contain the command followed by any further data.
 			// All separated by semi-colons.
-			StringTokenizer st(payload, ";", StringTokenizer::TOK_TRIM | StringTokenizer::TOK_IGNORE_EMPTY);
-			
-			if (st[0] == "change") {
+			std::string::size_type pos = payload.find(';');
+			std::string command = payload.substr(0, pos);
+			if (command == "change") {
 				// Change the assigned firmware for a UID from the default.
-				// Second argument should be UID, third the new firmware name.
-				// TODO: add check for whether new firmware file exists?
+				// Second argument should be UID, third the firmware name.
+				StringTokenizer st(payload, ";", StringTokenizer::TOK_TRIM | StringTokenizer::TOK_IGNORE_EMPTY);
 				if (st.count() != 3) { return; }
-				(*session) << "UPDATE firmware SET file = ? WHERE uid = ?",
-								use (st[1]),
-								use (st[2]),
-								now;
+				FirmwareStore::assign(st[1], st[2]);
 			}
-			else if (st[0] == "upload") {
-				// Save the new firmware data to disk. Overwrites an existing 
-				// file with the same name.
-				// Second argument is filename, third argument is file data.
-				// TODO: add some kind of CRC check.
-				if (st.count() != 3) { return; }
+			else if (command == "upload" || command == "add") {
+				// Store a new firmware image, in a single message. Replaces an
+				// existing image with the same name.
+				// 'upload;<name>;<data>' or 'add;<name>;<version>;<data>'.
+				std::vector<std::string> fields;
+				unsigned int count = (command == "add") ? 2 : 1;
+				if (!splitFields(payload, count, fields, pos)) { return; }
 				
-				// Write file & truncate if exists.
-				std::string filepath = "firmware/" + st[1];				
-				std::ofstream outfile("firmware/" + st[1], std::ofstream::binary | std::ofstream::trunc);
-				outfile.write(st[2].data(), st[2].size());
-				outfile.close();
+				FirmwareInfo info;
+				if (FirmwareStore::add(fields[0], (count == 2) ? fields[1] : "", 
+										payload.substr(pos), info)) {
+					std::cout << "Stored firmware image " << info.name << " (" << info.size 
+								<< " bytes) as " << info.hash << std::endl;
+				}
+			}
+			else if (command == "begin") {
+				// Start or resume a chunked upload. See FirmwareUpload.
+				// 'begin;<name>;<version>;<size>;<sha256>'
+				std::vector<std::string> fields;
+				if (!splitFields(payload + ";", 4, fields, pos)) { return; }
+				std::string reply = FirmwareUpload::begin(fields[0], fields[1], 
+											strtoull(fields[2].c_str(), 0, 10), fields[3]);
+				publishMessage("cc/firmware/upload", reply);
+			}
+			else if (command == "chunk") {
+				// 'chunk;<sha256>;<index>;<data>'
+				std::vector<std::string> fields;
+				if (!splitFields(payload, 2, fields, pos)) { return; }
+				std::string reply = FirmwareUpload::chunk(fields[0], 
+											strtoul(fields[1].c_str(), 0, 10), 
+											payload.data() + pos, payload.size() - pos);
+				if (!reply.empty()) { publishMessage("cc/firmware/upload", reply); }
+			}
+			else if (command == "status") {
+				// 'status;<sha256>'
+				std::vector<std::string> fields;
+				if (!splitFields(payload + ";", 1, fields, pos)) { return; }
+				std::string reply = FirmwareUpload::status(fields[0]);
+				if (!reply.empty()) { publishMessage("cc/firmware/upload", reply); }
 			}
 		}
 	}
@@ -1084,8 +1210,19 @@ void Listener::messageHandler(int handle, std::string topic, std::string payload
 		
 		switchesLock.unlock();
 	}
+	else if (!batchTopic.empty() && topic == batchTopic) {
+		if (!influx) { return; }
+		if (dedup) {
+			uint64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+							std::chrono::system_clock::now().time_since_epoch()).count();
+			if (dedup->duplicate(topic, payload, now)) { return; }
+		}
+		
+		forwardBatch(payload);
+	}
 	else {
 		// Assume possible MQTT-To-Influx topic. Check topics.
+		if (!influx) { return; }
 		std::map<std::string, std::string>::iterator it = series.find(topic);
 		if (it == series.end()) { 
 			std::cerr << "Topic not found: " << topic << "\n";
@@ -1104,43 +1241,76 @@ void Listener::messageHandler(int handle, std::string topic, std::string payload
 			return;
 		}
 		
+		if (dedup) {
+			uint64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+							std::chrono::system_clock::now().time_since_epoch()).count();
+			if (dedup->duplicate(topic, payload, now)) { return; }
+		}
+		
 		// Assemble the message to send to the InfluxDB instance. 
 		// This message contains the uid and value from the MQTT payload, as well
 		// as information from the listener's configuration.
 		// Note: The timestamp is currently added by the InfluxDB, which is why it's
 		// commented out here.
+		// The line is formatted straight from the payload into a buffer which is
+		// reused for every message on this thread.
 		// TODO: is a space (0x20) a valid UID?
-		std::string uid = payload.substr(0, pos);
-		std::string value = payload.substr(pos + 1);
-		std::string influxMsg;	
-		influxMsg = series[topic];
-		influxMsg += ",location=" + uid;
-		influxMsg += " value=" + value;
+		static thread_local std::string influxMsg;
+		influxMsg.assign(it->second);
+		influxMsg.append(",location=", 10);
+		influxMsg.append(payload, 0, pos);
+		influxMsg.append(" value=", 7);
+		influxMsg.append(payload, pos + 1, std::string::npos);
 		//influxMsg += " " + to_string(static_cast<long int>(time(0)));
 		
-		// Send message.
-		try {
-			Net::HTTPRequest request(Net::HTTPRequest::HTTP_POST, "/write?db=" + influxDb, Net::HTTPMessage::HTTP_1_1);
-			request.setContentLength(influxMsg.length());
-			request.setContentType("application/x-www-form-urlencoded");
-			influxClient->sendRequest(request) << influxMsg;
-			
-			Net::HTTPResponse response;
-			influxClient->receiveResponse(response);
-			/* Poco::Net::HTTPResponse::HTTPStatus status = response.getStatus();
-			if (status != Poco::Net::HTTPResponse::HTTP_OK && status != Poco::Net::HTTPResponse::HTTP_NO_CONTENT) {
-				cerr << "Received InfluxDB error: " << response.getReason() << "\n";
-			} */
-		}
-		catch (Exception& exc) {
-			std::cout << "Exception caught while attempting to connect." << std::endl;
-			std::cerr << exc.displayText() << std::endl;
-			return;
-		}
+		// Send message. Errors are reported by the Influx client.
+		influx->write(influxMsg);
 	}
 }
 
 
+// --- FORWARD BATCH ---
+// Forward a batch of sensor readings from a node to InfluxDB in a single write.
+// Each reading is written to the series of the topic it used to be published
+// on, timestamped by its age in the batch. Readings of topics which aren't
+// configured are skipped, as they would have been as separate messages.
+void Listener::forwardBatch(const std::string &payload) {
+	TelemetryBatch batch;
+	if (!batch.parse(payload.data(), payload.length())) {
+		std::cerr << "Invalid batch of " << payload.length() << " bytes. Reject.\n";
+		return;
+	}
+	
+	uint64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+							std::chrono::system_clock::now().time_since_epoch()).count();
+	static thread_local std::string lines;
+	static thread_local std::string topic;
+	lines.clear();
+	TelemetryReading reading;
+	char value[16];
+	while (batch.next(reading)) {
+		topic.assign(reading.metric->topic, reading.metric->topicLength);
+		std::map<std::string, std::string>::iterator it = series.find(topic);
+		if (it == series.end()) { continue; }
+		
+		uint32_t len = TelemetryBatch::formatValue(reading.value, reading.metric->decimals, value);
+		lines.append(it->second);
+		lines.append(",location=", 10);
+		lines.append(batch.getLocation(), batch.getLocationLength());
+		lines.append(" value=", 7);
+		lines.append(value, len);
+		lines += ' ';
+		lines += std::to_string(now - reading.age);
+		lines += '\n';
+	}
+	
+	if (lines.empty()) { return; }
+	
+	// Send the lines. Errors are reported by the Influx client.
+	influx->write(lines, "precision=ms", 0);
+}
+
+
 // --- CHECK NODES ---
 // Check the PWM and I/O status for each node: active pins, current duty.
 // Adjust active pins and duty cycle as needed.
@@ -18,7 +18,10 @@
 #include <Poco/Data/Session.h>
 #include <Poco/Data/SQLite/Connector.h>
 #include <Poco/Mutex.h>
-#include <Poco/Net/HTTPSClientSession.h>
+
+#include "influxcluster.h"
+#include "dedupwindow.h"
+#include "telemetry.h"
 
 using namespace Poco;
 
@@ -36,9 +39,9 @@ class Listener {
 	Data::Session* session;
 	std::string defaultFirmware;
 	
-	Poco::Net::HTTPClientSession* influxClient;
-	std::string influxDb;
-	bool secure;
+	InfluxCluster* influx;
+	DedupWindow* dedup;
+	std::string batchTopic;
 	
 	std::map<std::string, std::string> series;
 	//std::map<std::string, NodeInfo> nodes;
@@ -52,12 +55,17 @@ class Listener {
 	
 	void logHandler(int level, std::string text);
 	void messageHandler(int handle, std::string topic, std::string payload);
+	void dispatchMessage(const std::string &topic, const std::string &payload);
+	void forwardBatch(const std::string &payload);
 	
 public:
 	Listener();
 	~Listener();
 	
 	bool init(std::string clientId = "BMaC-controller", std::string host = "localhost", int port = 1883);
+	void setInflux(InfluxCluster* influx, const std::map<std::string, std::string> &series);
+	void setDedup(DedupWindow* dedup);
+	void setBatchTopic(const std::string &topic);
 	bool connectBroker();
     bool disconnectBroker();
 	bool addSubscription(std::string topic);
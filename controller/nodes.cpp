@@ -11,14 +11,24 @@
 
 
 #include "nodes.h"
+#include "events.h"
+#include "metrics.h"
+#include "firmwarestore.h"
 
 #include <iostream>
+#include <map>
+#include <algorithm>
+#include <cctype>
+#include <functional>
+#include <chrono>
+#include <cstdio>
 
 #include <Poco/Net/HTTPRequest.h>
 #include <Poco/Net/HTTPResponse.h>
 #include <Poco/StringTokenizer.h>
 #include <Poco/String.h>
 #include <Poco/StreamCopier.h>
+#include <Poco/Exception.h>
 #include <Poco/JSON/Parser.h>
 #include <Poco/JSON/Object.h>
 #include <Poco/Data/SQLite/SQLiteException.h>
@@ -31,38 +41,214 @@ using namespace Poco::Data::Keywords;
 
 // Static initialisations.
 Data::Session* Nodes::session;
+std::mutex Nodes::sessionMutex;
 bool Nodes::initialized = false;
-HTTPClientSession* Nodes::influxClient;
-std::string Nodes::influxDb;
+InfluxCluster* Nodes::influx;
 Listener* Nodes::listener;
-bool Nodes::secure;
-std::string Nodes::defaultFirmware;
 std::vector<NodeInfo> Nodes::nodes;
 std::vector<NodeInfo> Nodes::newNodes;
 Timer* Nodes::tempTimer;
 Timer* Nodes::nodesTimer;
 Timer* Nodes::switchTimer;
 Nodes* Nodes::selfRef;
+std::atomic<uint64_t> Nodes::generation(0);
 //vector<string> Nodes::uids;
 
 
+// Constants
+// Number of UIDs matched per Influx query.
+const unsigned int uidQueryChunk = 250;
+
+// SQLite statements whose latency is recorded.
+enum SqlStatement {
+	SQL_NODE_READ = 0,
+	SQL_NODE_WRITE,
+	SQL_NODE_DELETE,
+	SQL_VALVE_READ,
+	SQL_SWITCH_READ,
+	SQL_TEMPERATURE_READ,
+	SQL_TARGET_WRITE,
+	SQL_TARGET_BATCH,
+	SQL_CURRENT_WRITE,
+	SQL_CURRENT_BATCH,
+	SQL_DUTY_WRITE,
+	SQL_VALVE_WRITE,
+	SQL_SWITCH_WRITE,
+	SQL_UID_READ,
+	SQL_STATEMENT_COUNT
+};
+
+static const char* sqlStatementNames[SQL_STATEMENT_COUNT] = {
+	"node_read", "node_write", "node_delete", "valve_read", "switch_read", "temperature_read",
+	"target_write", "target_batch", "current_write", "current_batch", "duty_write", 
+	"valve_write", "switch_write", "uid_read"
+};
+
+static Histogram sqlLatency[SQL_STATEMENT_COUNT];
+
+
+// Modules section of the node list.
+// The bit flags match up with a module:
+// * 0x01: 	THPModule
+// * 0x02: 	CO2Module
+// * 0x04: 	JuraModule
+// * 0x08: 	JuraTermModule
+// * 0x10: 	MotionModule
+// * 0x20: 	PwmModule
+// * 0x40: 	IOModule
+// * 0x80: 	SwitchModule
+// * 0x100: PlantModule
+// ---
+// Of these, the CO2, Jura and JuraTerm modules are mutually
+// exclusive, since they all use the UART (Serial).
+// If two or more of these are still specified in the bitflags,
+// only the first module will be enabled and the others
+// ignored.
+//
+// The Switch module currently uses the same pins as the i2c bus,
+// as well as a number of the PWM pins (D5, 6).
+// This means that it excludes all modules but the MotionModule and
+// those using the UART.
+// (Above copied from node firmware source)
+struct ModuleFlag {
+	uint32_t flag;
+	const char* name;
+};
+
+static const ModuleFlag moduleFlags[] = {
+	{ 0x01, "\"THP\": " },
+	{ 0x02, "\"CO2\": " },
+	{ 0x04, "\"Jura\": " },
+	{ 0x08, "\"JuraTerm\": " },
+	{ 0x10, "\"Motion\": " },
+	{ 0x20, "\"PWM\": " },
+	{ 0x40, "\"IO\": " },
+	{ 0x80, "\"Switch\": " },
+	{ 0x100, "\"Plant\": " }
+};
+
+
+// --- APPEND JSON STRING ---
+// Append the string as a quoted JSON string.
+static void appendJsonString(std::string &out, const std::string &str) {
+	out += '"';
+	for (unsigned int i = 0; i < str.length(); ++i) {
+		unsigned char c = str[i];
+		if (c == '"' || c == '\\') {
+			out += '\\';
+			out += c;
+		}
+		else if (c < 0x20) {
+			char esc[8];
+			snprintf(esc, sizeof(esc), "\\u%04x", c);
+			out += esc;
+		}
+		else { out += c; }
+	}
+	
+	out += '"';
+}
+
+
+// --- APPEND NODE JSON ---
+// Append the JSON object of an assigned node, as used in the node list.
+static void appendNodeJson(std::string &out, const NodeInfo &node) {
+	out.append("{ \"uid\": ", 9);
+	appendJsonString(out, node.uid);
+	out.append(", \"location\": ", 14);
+	appendJsonString(out, node.location);
+	out.append(", \"modules\": { ", 15);
+	for (unsigned int j = 0; j < sizeof(moduleFlags) / sizeof(moduleFlags[0]); ++j) {
+		if (j > 0) { out.append(", ", 2); }
+		out.append(moduleFlags[j].name);
+		out.append((node.modules & moduleFlags[j].flag) ? "true" : "false");
+	}
+	
+	out.append(" } }", 4);
+}
+
+
+// --- UID JSON ---
+// Start the JSON object of an event about a node, up to its UID.
+static std::string uidJson(const std::string &uid) {
+	std::string out = "{ \"uid\": ";
+	appendJsonString(out, uid);
+	return out;
+}
+
+
+// --- REGEX ESCAPE ---
+// Escape a string for literal use in an InfluxQL regular expression.
+static std::string regexEscape(const std::string &str) {
+	std::string out;
+	for (unsigned int i = 0; i < str.length(); ++i) {
+		if (!isalnum((unsigned char) str[i]) && str[i] != '_' && str[i] != '-') { out += '\\'; }
+		out += str[i];
+	}
+	
+	return out;
+}
+
+
+// --- LOCATION FILTER ---
+// Returns an InfluxQL condition matching the UIDs in the range [begin, end) 
+// with an anchored regular expression.
+static std::string locationFilter(const std::vector<std::string> &uids, unsigned int begin, 
+																unsigned int end) {
+	std::string filter = "\"location\" =~ /^(";
+	for (unsigned int i = begin; i < end; ++i) {
+		if (i > begin) { filter += "|"; }
+		filter += regexEscape(uids[i]);
+	}
+	
+	filter += ")$/";
+	return filter;
+}
+
+
+// --- GROUP BY SHARD ---
+// Group the UIDs by the Influx endpoint holding the measurement's series for
+// them, so that each query only selects series on the endpoint it is sent to.
+static std::map<InfluxClient*, std::vector<std::string> > groupByShard(InfluxCluster* influx,
+							const std::string &measurement, const std::vector<std::string> &uids) {
+	std::map<InfluxClient*, std::vector<std::string> > groups;
+	for (unsigned int i = 0; i < uids.size(); ++i) {
+		groups[influx->reader(measurement, uids[i])].push_back(uids[i]);
+	}
+	
+	return groups;
+}
+
+
+// --- WRITE STRING ---
+// Write a string value as a quoted CSV field or JSON string.
+static void writeString(std::ostream &out, const std::string &str, bool csv) {
+	out << '"';
+	for (unsigned int i = 0; i < str.length(); ++i) {
+		char c = str[i];
+		if (c == '"') { out << (csv ? "\"\"" : "\\\""); }
+		else if (!csv && c == '\\') { out << "\\\\"; }
+		else if (!csv && (unsigned char) c < 0x20) { out << ' '; }
+		else { out << c; }
+	}
+	
+	out << '"';
+}
+
+
 // --- INIT ---
 // Initialise the static class.
-void Nodes::init(std::string defaultFirmware, std::string influxHost, int influxPort, std::string influxDb, 
-									std::string influx_sec, Listener* listener) {
+// The Influx cluster is shared with the listener and owned by the caller.
+void Nodes::init(InfluxCluster* influx, Listener* listener) {
 	// Assign parameters.
-	Nodes::defaultFirmware = defaultFirmware;
 	Nodes::listener = listener;
-	Nodes::influxDb = influxDb;
-	if (influx_sec == "true") { 
-		std::cout << "Connecting with HTTPS..." << std::endl;
-		influxClient = new HTTPSClientSession(influxHost, influxPort);
-		secure = true; 
-	} 
-	else {
-		std::cout << "Connecting with HTTP..." << std::endl;
-		influxClient = new HTTPClientSession(influxHost, influxPort);
-		secure = false; 
+	Nodes::influx = influx;
+	
+	for (uint32_t i = 0; i < SQL_STATEMENT_COUNT; ++i) {
+		Metrics::addHistogram("bmac_sqlite_statement_seconds", 
+								"Time spent executing SQLite statements, by statement.",
+								std::string("statement=\"") + sqlStatementNames[i] + "\"", 
+								&sqlLatency[i]);
 	}
 	
 	// Set up SQLite database link.
@@ -112,12 +298,6 @@ void Nodes::init(std::string defaultFirmware, std::string influxHost, int influx
 		
 	std::cout << "Checked for 'nodes' table." << std::endl;
 		
-	// Ensure we have a valid firmware table.
-	(*session) << "CREATE TABLE IF NOT EXISTS firmware (uid TEXT UNIQUE, \
-		file TEXT)", now;
-		
-	std::cout << "Checked for 'firmware' table." << std::endl;
-		
 	// Ensure we have a valid valves table.
 	// * uid TEXT UNIQUE
 	// * ch0_valve INT
@@ -180,6 +360,11 @@ void Nodes::init(std::string defaultFirmware, std::string influxHost, int influx
 	}
 	
 	std::cout << "Read " << nodes.size() << " nodes from the database." << std::endl;
+	
+	// Start the generation of the node lists at the current time, so that ETags
+	// handed out before a restart don't match.
+	generation = std::chrono::duration_cast<std::chrono::milliseconds>(
+							std::chrono::system_clock::now().time_since_epoch()).count();
 		
 	// Start the timers for checking the condition of each node.
 	// One for the current PWM status (active pins, duty cycle), one for 
@@ -207,7 +392,6 @@ void Nodes::stop() {
 	nodesTimer->stop();
 	delete tempTimer;
 	delete nodesTimer;
-	delete influxClient;
 	delete session;
 	delete selfRef;
 }
@@ -220,6 +404,8 @@ bool Nodes::getNodeInfo(std::string uid, NodeInfo &info) {
 	
 	std::cout << "Getting node info for UID: " << uid << std::endl;
 	
+	std::lock_guard<std::mutex> lk(sessionMutex);
+	MetricsTimer timer(sqlLatency[SQL_NODE_READ]);
 	Data::Statement select(*session);
 	info.uid = uid;
 	select << "SELECT location, modules, posx, posy, current, target, ch0_state, ch0_duty, \
@@ -256,6 +442,8 @@ bool Nodes::getNodeInfo(std::string uid, NodeInfo &info) {
 		std::cout << "Adding new node with UID " << uid << " to unassigned list." << std::endl;
 		info.uid = uid;
 		newNodes.push_back(info);
+		++generation;
+		Events::publish("unassigned", uidJson(uid) + " }");
 		
 		return false; 
 	}
@@ -269,23 +457,50 @@ bool Nodes::updateNodeInfo(std::string uid, NodeInfo &node) {
 	std::cout << "Updating nodes table..." << std::endl;
 	
 	// Update a node if it already exists, otherwise insert it as a new entry.
-	Data::Statement insert(*session);
-		insert << "INSERT OR REPLACE INTO nodes (uid, location, modules, posx, posy) \
-					VALUES(?, ?, ?, ?, ?)",
-				use(node.uid),
-				use(node.location),
-				use(node.modules),
-				use(node.posx),
-				use(node.posy),
-				now;
-				
-	std::cout << "Updating firmware table..." << std::endl;
-				
-	// If the UID doesn't exist yet in the firmware table, insert the default.
-	(*session) << "INSERT OR ABORT INTO firmware VALUES(?, ?)",
-			use(node.uid),
-			use(defaultFirmware),
-			now;
+	// Only the database and the in-memory lists are updated under the lock.
+	// The node and the event clients are told after it has been released.
+	{
+		std::lock_guard<std::mutex> lk(sessionMutex);
+		MetricsTimer timer(sqlLatency[SQL_NODE_WRITE]);
+		Data::Statement insert(*session);
+			insert << "INSERT OR REPLACE INTO nodes (uid, location, modules, posx, posy) \
+						VALUES(?, ?, ?, ?, ?)",
+					use(node.uid),
+					use(node.location),
+					use(node.modules),
+					use(node.posx),
+					use(node.posy),
+					now;
+					
+		timer.stop();
+		
+		// If newly assigned node, from from unassigned list, assign to assigned
+		// list. Otherwise update the assigned node.
+		std::vector<NodeInfo>::iterator it;
+		for (it = newNodes.begin(); it != newNodes.end(); ++it) {
+			if ((*it).uid == uid) {
+				std::cout << "Moving newly assigned node from unassigned to assigned." << std::endl;
+				nodes.push_back(node);
+				newNodes.erase(it);
+				break;
+			}
+		}
+		
+		for (it = nodes.begin(); it != nodes.end(); ++it) {
+			if ((*it).uid == uid) {
+				(*it).location = node.location;
+				(*it).modules = node.modules;
+				(*it).posx = node.posx;
+				(*it).posy = node.posy;
+				break;
+			}
+		}
+		
+		++generation;
+	}
+	
+	// If the node has no firmware assigned yet, assign the default.
+	FirmwareStore::assignDefault(node.uid);
 			
 	std::cout << "Updating node via MQTT..." << std::endl;
 				
@@ -298,29 +513,46 @@ bool Nodes::updateNodeInfo(std::string uid, NodeInfo &node) {
 	msg += std::string(((char*) &(node.modules)), 4);
 	listener->publishMessage(topic, msg);
 	
-	// If newly assigned node, from from unassigned list, assign to assigned list.
-	std::vector<NodeInfo>::iterator it;
-	for (it = newNodes.begin(); it != newNodes.end(); ++it) {
-		if ((*it).uid == uid) {
-			std::cout << "Moving newly assigned node from unassigned to assigned." << std::endl;
-			nodes.push_back(node);
-			newNodes.erase(it);
-			break;
-		}
-	}
+	std::string json;
+	appendNodeJson(json, node);
+	Events::publish("node", json);
 	
 	return true;
 }
 
 
 // --- DELETE NODE INFO ---
+// Remove the node from the database and from the in-memory node lists.
 bool Nodes::deleteNodeInfo(std::string uid) {
-	// Update a node if it already exists, otherwise insert it as a new entry.
-	Data::Statement insert(*session);
-		insert << "DELETE FROM nodes WHERE uid=?",
-				use(uid),
-				now;
+	{
+		std::lock_guard<std::mutex> lk(sessionMutex);
+		MetricsTimer timer(sqlLatency[SQL_NODE_DELETE]);
+		Data::Statement insert(*session);
+			insert << "DELETE FROM nodes WHERE uid=?",
+					use(uid),
+					now;
 		
+		timer.stop();
+		std::vector<NodeInfo>::iterator it;
+		for (it = nodes.begin(); it != nodes.end(); ++it) {
+			if ((*it).uid == uid) {
+				nodes.erase(it);
+				break;
+			}
+		}
+		
+		for (it = newNodes.begin(); it != newNodes.end(); ++it) {
+			if ((*it).uid == uid) {
+				newNodes.erase(it);
+				break;
+			}
+		}
+		
+		++generation;
+	}
+	
+	Events::publish("deleted", uidJson(uid) + " }");
+	
 	return true;
 }
 
@@ -332,6 +564,8 @@ bool Nodes::getValveInfo(std::string uid, ValveInfo &info) {
 	
 	std::cout << "Getting valve info for UID: " << uid << std::endl;
 	
+	std::lock_guard<std::mutex> lk(sessionMutex);
+	MetricsTimer timer(sqlLatency[SQL_VALVE_READ]);
 	Data::Statement select(*session);
 	info.uid = uid;
 	select << "SELECT ch0_valve, ch1_valve, ch2_valve, ch3_valve FROM valves WHERE uid=?",
@@ -354,6 +588,8 @@ bool Nodes::getSwitchInfo(std::string uid, SwitchInfo &info) {
 	
 	std::cout << "Getting switch info for UID: " << uid << std::endl;
 	
+	std::lock_guard<std::mutex> lk(sessionMutex);
+	MetricsTimer timer(sqlLatency[SQL_SWITCH_READ]);
 	Data::Statement select(*session);
 	info.uid = uid;
 	select << "SELECT state FROM switches WHERE uid=?",
@@ -367,88 +603,45 @@ bool Nodes::getSwitchInfo(std::string uid, SwitchInfo &info) {
 }
 
 
-// ---	NODES TO JSON ---
-// Returns a JSON array containing the assigned nodes.
-// TODO: Buffer the output.
-std::string Nodes::nodesToJson() {
-	std::string out = "[ ";
+// --- GET NODES JSON ---
+// Serialise the requested node lists (NodeLists flags) into a JSON object and
+// set 'gen' to the generation of the lists. The lists are serialised under the
+// lock, so that the object and its generation match, into a buffer which is 
+// reused for every request on this thread. The caller writes it out after the
+// lock has been released.
+const std::string& Nodes::getNodesJson(int lists, uint64_t &gen) {
+	static thread_local std::string buffer;
+	buffer.assign("{ ", 2);
 	
-	std::cout << "Converting " << nodes.size() << " nodes to JSON..." << std::endl;
-	
-	for (int i = 0; i < nodes.size(); ++i) {
-		out += "{ \"uid\": \"" + nodes[i].uid + "\", ";
-		out += "\"location\": \"" + nodes[i].location + "\", ";
-		
-		// Modules section.
-		// The bit flags match up with a module:
-		// * 0x01: 	THPModule
-		// * 0x02: 	CO2Module
-		// * 0x04: 	JuraModule
-		// * 0x08: 	JuraTermModule
-		// * 0x10: 	MotionModule
-		// * 0x20: 	PwmModule
-		// * 0x40: 	IOModule
-		// * 0x80: 	SwitchModule
-		// * 0x100: PlantModule
-		// ---
-		// Of these, the CO2, Jura and JuraTerm modules are mutually
-		// exclusive, since they all use the UART (Serial).
-		// If two or more of these are still specified in the bitflags,
-		// only the first module will be enabled and the others
-		// ignored.
-		//
-		// The Switch module currently uses the same pins as the i2c bus,
-		// as well as a number of the PWM pins (D5, 6).
-		// This means that it excludes all modules but the MotionModule and
-		// those using the UART.
-		// (Above copied from node firmware source)
-		out += "\"modules\": { ";
-		out += "\"THP\": ";
-		(nodes[i].modules & 0x01) ? out += "true, " : out += "false, ";
-		out += "\"CO2\": ";
-		(nodes[i].modules & 0x02) ? out += "true, " : out += "false, ";
-		out += "\"Jura\": ";
-		(nodes[i].modules & 0x04) ? out += "true, " : out += "false, ";
-		out += "\"JuraTerm\": ";
-		(nodes[i].modules & 0x08) ? out += "true, " : out += "false, ";
-		out += "\"Motion\": ";
-		(nodes[i].modules & 0x10) ? out += "true, " : out += "false, ";
-		out += "\"PWM\": ";
-		(nodes[i].modules & 0x20) ? out += "true, " : out += "false, ";
-		out += "\"IO\": ";
-		(nodes[i].modules & 0x40) ? out += "true, " : out += "false, ";
-		out += "\"Switch\": ";
-		(nodes[i].modules & 0x80) ? out += "true, " : out += "false, ";
-		out += "\"Plant\": ";
-		(nodes[i].modules & 0x100) ? out += "true" : out += "false";
-		
-		out += "} }";
+	std::lock_guard<std::mutex> lk(sessionMutex);
+	gen = generation;
+	if (lists & NODES_ASSIGNED) {
+		buffer.append("\"nodes\": [ ", 12);
+		for (unsigned int i = 0; i < nodes.size(); ++i) {
+			if (i > 0) { buffer.append(", ", 2); }
+			appendNodeJson(buffer, nodes[i]);
+		}
 		
-		if ((i + 1) < nodes.size()) { out += ", "; }
+		buffer.append(" ]", 2);
 	}
 	
-	out += "]";
-	
-	return out;
-}
-
-
-// --- UNASSIGNED TO JSON ---
-// Returns a JSON array containing unassigned nodes.
-// TODO: Buffer the output.
-std::string Nodes::unassignedToJson() {
-	std::string out = "[ ";
-	
-	for (int i = 0; i < newNodes.size(); ++i) {
-		out += "{ \"uid\": \"" + newNodes[i].uid + "\", ";
-		out += "\"location\": \"" + newNodes[i].location + "\" }";
+	if (lists & NODES_UNASSIGNED) {
+		if (lists & NODES_ASSIGNED) { buffer.append(", ", 2); }
+		buffer.append("\"unassigned\": [ ", 17);
+		for (unsigned int i = 0; i < newNodes.size(); ++i) {
+			if (i > 0) { buffer.append(", ", 2); }
+			buffer.append("{ \"uid\": ", 9);
+			appendJsonString(buffer, newNodes[i].uid);
+			buffer.append(", \"location\": ", 14);
+			appendJsonString(buffer, newNodes[i].location);
+			buffer.append(" }", 2);
+		}
 		
-		if ((i + 1) < newNodes.size()) { out += ", "; }
+		buffer.append(" ]", 2);
 	}
 	
-	out += "]";
-	
-	return out;
+	buffer.append(" }", 2);
+	return buffer;
 }
 
 
@@ -488,12 +681,110 @@ bool Nodes::setTargetTemperature(std::string uid, float temp) {
 	
 	std::cout << "Setting target temperature for UID: " << uid << std::endl;
 	
+	std::lock_guard<std::mutex> lk(sessionMutex);
+	MetricsTimer timer(sqlLatency[SQL_TARGET_WRITE]);
 	Data::Statement update(*session);
 	update << "UPDATE nodes SET target = ? WHERE uid = ?",
 			use(temp),
 			use(uid),
 			now;
 			
+	char value[32];
+	snprintf(value, sizeof(value), ", \"target\": %.2f }", temp);
+	Events::publish("target", uidJson(uid) + value);
+			
+	return true;
+}
+
+
+// --- GET TEMPERATURES ---
+// Look up the current and target temperature of a set of nodes, re-using a 
+// single prepared statement. 'found' is set for each UID in the database.
+// Unlike getNodeInfo(), unknown UIDs aren't added to the unassigned nodes.
+bool Nodes::getTemperatures(const std::vector<std::string> &uids, std::vector<NodeInfo> &info,
+															std::vector<bool> &found) {
+	if (!initialized) { return false; }
+	
+	info.resize(uids.size());
+	found.assign(uids.size(), false);
+	try {
+		std::string uid;
+		float current;
+		float target;
+		std::lock_guard<std::mutex> lk(sessionMutex);
+		MetricsTimer timer(sqlLatency[SQL_TEMPERATURE_READ]);
+		Data::Statement select(*session);
+		select << "SELECT current, target FROM nodes WHERE uid=?",
+				into(current),
+				into(target),
+				use(uid);
+		
+		for (unsigned int i = 0; i < uids.size(); ++i) {
+			uid = uids[i];
+			info[i].uid = uid;
+			if (select.execute() != 1) { continue; }
+			found[i] = true;
+			info[i].current = current;
+			info[i].target = target;
+		}
+	}
+	catch (Exception &exc) {
+		std::cerr << "Failed to look up temperatures: " << exc.displayText() << std::endl;
+		return false;
+	}
+	
+	return true;
+}
+
+
+// --- SET TARGET TEMPERATURES ---
+// Set the target temperature for a set of nodes in a single transaction.
+bool Nodes::setTargetTemperatures(const std::map<std::string, float> &temps) {
+	if (!initialized) { return false; }
+	if (temps.empty()) { return true; }
+	
+	std::cout << "Setting target temperature for " << temps.size() << " nodes." << std::endl;
+	
+	std::lock_guard<std::mutex> lk(sessionMutex);
+	
+	try {
+		std::string uid;
+		float temp;
+		MetricsTimer timer(sqlLatency[SQL_TARGET_BATCH]);
+		session->begin();
+		Data::Statement update(*session);
+		update << "UPDATE nodes SET target = ? WHERE uid = ?",
+				use(temp),
+				use(uid);
+		
+		std::map<std::string, float>::const_iterator it;
+		for (it = temps.begin(); it != temps.end(); ++it) {
+			uid = it->first;
+			temp = it->second;
+			update.execute();
+		}
+		
+		session->commit();
+	}
+	catch (Exception &exc) {
+		std::cerr << "Failed to update target temperatures: " << exc.displayText() << std::endl;
+		if (session->isTransaction()) { session->rollback(); }
+		return false;
+	}
+	
+	// Send all targets as a single event, mapping UIDs onto temperatures.
+	std::string json = "{ ";
+	char value[32];
+	std::map<std::string, float>::const_iterator it;
+	for (it = temps.begin(); it != temps.end(); ++it) {
+		if (it != temps.begin()) { json.append(", ", 2); }
+		appendJsonString(json, it->first);
+		snprintf(value, sizeof(value), ": %.2f", it->second);
+		json += value;
+	}
+	
+	Events::publish("targets", json + " }");
+	
 	return true;
 }
 
@@ -506,12 +797,72 @@ bool Nodes::setCurrentTemperature(std::string uid, float temp) {
 	std::cout << "Updating current temperature for node " << uid << " to " 
 			<< temp << std::endl;
 	
+	std::lock_guard<std::mutex> lk(sessionMutex);
+	MetricsTimer timer(sqlLatency[SQL_CURRENT_WRITE]);
 	Data::Statement update(*session);
 	update << "UPDATE nodes SET current = ? WHERE uid = ?",
 			use(temp),
 			use(uid),
 			now;
 			
+	char value[32];
+	snprintf(value, sizeof(value), ": %.2f }", temp);
+	std::string json = "{ ";
+	appendJsonString(json, uid);
+	Events::publish("temperatures", json + value);
+			
+	return true;
+}
+
+
+// --- SET CURRENT TEMPERATURES ---
+// Set the current temperature for a set of nodes in a single transaction.
+bool Nodes::setCurrentTemperatures(const std::map<std::string, float> &temps) {
+	if (!initialized) { return false; }
+	if (temps.empty()) { return true; }
+	
+	std::cout << "Updating current temperature for " << temps.size() << " nodes." << std::endl;
+	
+	std::lock_guard<std::mutex> lk(sessionMutex);
+	
+	try {
+		std::string uid;
+		float temp;
+		MetricsTimer timer(sqlLatency[SQL_CURRENT_BATCH]);
+		session->begin();
+		Data::Statement update(*session);
+		update << "UPDATE nodes SET current = ? WHERE uid = ?",
+				use(temp),
+				use(uid);
+		
+		std::map<std::string, float>::const_iterator it;
+		for (it = temps.begin(); it != temps.end(); ++it) {
+			uid = it->first;
+			temp = it->second;
+			update.execute();
+		}
+		
+		session->commit();
+	}
+	catch (Exception &exc) {
+		std::cerr << "Failed to update current temperatures: " << exc.displayText() << std::endl;
+		if (session->isTransaction()) { session->rollback(); }
+		return false;
+	}
+	
+	// Send all temperatures as a single event, mapping UIDs onto temperatures.
+	std::string json = "{ ";
+	char value[32];
+	std::map<std::string, float>::const_iterator it;
+	for (it = temps.begin(); it != temps.end(); ++it) {
+		if (it != temps.begin()) { json.append(", ", 2); }
+		appendJsonString(json, it->first);
+		snprintf(value, sizeof(value), ": %.2f", it->second);
+		json += value;
+	}
+	
+	Events::publish("temperatures", json + " }");
+	
 	return true;
 }
 
@@ -523,6 +874,8 @@ bool Nodes::setDuty(std::string uid, uint8_t ch0, uint8_t ch1, uint8_t ch2, uint
 	
 	std::cout << "Setting duty for UID: " << uid << std::endl;
 	
+	std::lock_guard<std::mutex> lk(sessionMutex);
+	MetricsTimer timer(sqlLatency[SQL_DUTY_WRITE]);
 	Data::Statement update(*session);
 	update << "UPDATE nodes SET ch0_duty = ?, ch1_duty = ?, ch2_duty = ?, ch3_duty = ? WHERE uid = ?",
 			use(ch0),
@@ -532,6 +885,11 @@ bool Nodes::setDuty(std::string uid, uint8_t ch0, uint8_t ch1, uint8_t ch2, uint
 			use(uid),
 			now;
 			
+	char value[96];
+	snprintf(value, sizeof(value), ", \"ch0\": %u, \"ch1\": %u, \"ch2\": %u, \"ch3\": %u }",
+												ch0, ch1, ch2, ch3);
+	Events::publish("duty", uidJson(uid) + value);
+			
 	return true;
 }
 
@@ -543,6 +901,8 @@ bool Nodes::setValves(std::string uid, bool ch0, bool ch1, bool ch2, bool ch3) {
 	
 	std::cout << "Setting valve state for UID: " << uid << std::endl;
 	
+	std::lock_guard<std::mutex> lk(sessionMutex);
+	MetricsTimer timer(sqlLatency[SQL_VALVE_WRITE]);
 	Data::Statement update(*session);
 	update << "UPDATE valves SET ch0_valve = ?, ch1_valve = ?, ch2_valve = ?, ch3_valve = ? WHERE uid = ?",
 			use(ch0),
@@ -552,6 +912,13 @@ bool Nodes::setValves(std::string uid, bool ch0, bool ch1, bool ch2, bool ch3) {
 			use(uid),
 			now;
 			
+	std::string json = uidJson(uid);
+	json += ch0 ? ", \"ch0\": true" : ", \"ch0\": false";
+	json += ch1 ? ", \"ch1\": true" : ", \"ch1\": false";
+	json += ch2 ? ", \"ch2\": true" : ", \"ch2\": false";
+	json += ch3 ? ", \"ch3\": true }" : ", \"ch3\": false }";
+	Events::publish("valves", json);
+			
 	return true;
 }
 
@@ -563,18 +930,24 @@ bool Nodes::setSwitch(std::string uid, bool state) {
 	
 	std::cout << "Setting switch state for UID: " << uid << " to " << state << std::endl;
 	
+	std::lock_guard<std::mutex> lk(sessionMutex);
+	MetricsTimer timer(sqlLatency[SQL_SWITCH_WRITE]);
 	Data::Statement update(*session);
 	update << "UPDATE switches SET state = ? WHERE uid = ?",
 			use(state),
 			use(uid),
 			now;
 			
+	Events::publish("switch", uidJson(uid) + (state ? ", \"state\": true }" : ", \"state\": false }"));
+			
 	return true;
 }
 
 
 // --- UPDATE CURRENT TEMPERATURES ---
 // Request the current temperatures from the Influx database using the MACs.
+// The last value of every node is fetched with a single grouped query per chunk
+// of UIDs, after which all nodes are updated in one transaction.
 void Nodes::updateCurrentTemperatures(Timer& /*timer*/) {
 	if (!initialized) { return; }
 	
@@ -589,61 +962,37 @@ void Nodes::updateCurrentTemperatures(Timer& /*timer*/) {
 	
 	std::cout << "Contacting Influx database..." << std::endl;
 	
-	int uidsl = uids.size();
-	std::string responseStr;
-	for (unsigned int i = 0; i < uidsl; ++i) {
-		// Send message.
-		std::string query = "SELECT%20\"value\"%20FROM%20\"temperature\"%20WHERE%20\"location\"='"
-							+ uids[i] + "'%20ORDER%20BY%20time%20DESC%20LIMIT%201";
-		try {			
-			HTTPRequest request(HTTPRequest::HTTP_GET, "/query?db=" + influxDb + 
-										"&q=" + query, HTTPMessage::HTTP_1_1);
-										
-			//std::cout << "Request: " << request.getURI() << endl;
-												
-			influxClient->sendRequest(request);
-			
-			HTTPResponse response;
-			std::istream &rs = influxClient->receiveResponse(response);
-			HTTPResponse::HTTPStatus status = response.getStatus();
-			if (status != HTTPResponse::HTTP_OK/*  && 
-					status != HTTPResponse::HTTP_NO_CONTENT */) {
-				std::cerr << "Received InfluxDB error: " << response.getReason() << "\n";
-				std::cerr << "Aborting temperature update loop.\n";
-				break;
-			}
-			
-			StreamCopier::copyToString(rs, responseStr);
-		}
-		catch (Exception& exc) {
-			std::cout << "Exception caught while attempting to connect." << std::endl;
-			std::cerr << exc.displayText() << std::endl;
-			return;
+	std::map<std::string, float> temps;
+	InfluxParser parser([&temps](const InfluxSeries &series, const InfluxRow &row) {
+		if (row.size() > 1 && row[1].isNumber()) {
+			temps[series.getTag("location")] = row[1].number;
 		}
 		
-		//cout << "Influx response: " << responseStr << endl;
-		
-		// Process response.
-		// Write the obtained temperature for each node to the database.
-		Parser parser;
-		Dynamic::Var result = parser.parse(responseStr);
-		Object::Ptr object = result.extract<Object::Ptr>();
-		if (object->has("error")) { // Error occurred.
-			std::string err = object->getValue<std::string>("error");
-			std::cerr << "Error from Influx DB for current temperature: " << err << std::endl;
-			continue;
-		}
-		
-		if (!object->isArray("results")) {
-			std::cerr << "Results content wasn't an array. Skipping.\n";
-			continue;
+		return true;
+	});
+	
+	std::map<InfluxClient*, std::vector<std::string> > shards = groupByShard(influx, "temperature", uids);
+	std::map<InfluxClient*, std::vector<std::string> >::iterator it;
+	for (it = shards.begin(); it != shards.end(); ++it) {
+		const std::vector<std::string> &shardUids = it->second;
+		for (unsigned int i = 0; i < shardUids.size(); i += uidQueryChunk) {
+			unsigned int end = std::min(i + uidQueryChunk, (unsigned int) shardUids.size());
+			std::string query = "SELECT last(\"value\") FROM \"temperature\" WHERE " + 
+									locationFilter(shardUids, i, end) + " GROUP BY \"location\"";
+			
+			// Each node is returned as its own series, tagged with its location 
+			// (UID). The response is parsed straight off the HTTP stream. On 
+			// failure, still apply whatever the other chunks returned.
+			it->first->query(query, [&parser](std::istream &rs) {
+				if (!parser.parse(rs)) {
+					std::cerr << "Error from Influx DB for current temperature: " 
+							<< parser.getError() << std::endl;
+				}
+			});
 		}
-		
-		Array::Ptr results = object->getArray("results");
-		Dynamic::Array da = *results;
-		float newTemp = da[0]["series"][0]["values"][0][1];
-		setCurrentTemperature(uids[i], newTemp);
 	}
+	
+	setCurrentTemperatures(temps);
 }
 
 
@@ -678,6 +1027,8 @@ bool Nodes::getUIDs(std::vector<std::string> &uids) {
 	
 	//std::vector<string> temp;
 	
+	std::lock_guard<std::mutex> lk(sessionMutex);
+	MetricsTimer timer(sqlLatency[SQL_UID_READ]);
 	Data::Statement select(*session);
 	std::string uid;
 	select << "SELECT uid FROM nodes", into (uid), range(0, 1);
@@ -708,6 +1059,8 @@ bool Nodes::getSwitchUIDs(std::vector<std::string> &uids) {
 	
 	uids.clear();
 	
+	std::lock_guard<std::mutex> lk(sessionMutex);
+	MetricsTimer timer(sqlLatency[SQL_UID_READ]);
 	Data::Statement select(*session);
 	std::string uid;
 	select << "SELECT uid FROM switches", into (uid), range(0, 1);
@@ -722,3 +1075,123 @@ bool Nodes::getSwitchUIDs(std::vector<std::string> &uids) {
 	
 	return true;
 }
+
+
+
+// --- GET LOCATION UIDS ---
+// Get the UIDs of all nodes whose location starts with the provided prefix.
+bool Nodes::getLocationUIDs(std::string prefix, std::vector<std::string> &uids) {
+	if (!initialized) { return false; }
+	
+	uids.clear();
+	
+	std::lock_guard<std::mutex> lk(sessionMutex);
+	MetricsTimer timer(sqlLatency[SQL_UID_READ]);
+	Data::Statement select(*session);
+	std::string uid;
+	select << "SELECT uid FROM nodes WHERE substr(location, 1, length(?)) = ?", 
+				into (uid), 
+				use (prefix), 
+				use (prefix), 
+				range(0, 1);
+	
+	while (!select.done()) {
+		if (select.execute() > 0) { uids.push_back(uid); }
+	}
+	
+	std::cout << "Found " << uids.size() << " nodes for location " << prefix << ".\n";
+	
+	return true;
+}
+
+
+// --- EXPORT HISTORY ---
+// Stream the history of the measurements for the nodes as CSV or NDJSON. Both
+// 'from' and 'to' are InfluxQL time expressions.
+// Influx is queried in chunked mode and rows are written out as soon as they
+// have been parsed, so memory use doesn't depend on the length of the time 
+// range. The output stream is only opened once Influx has responded 
+// successfully, allowing the caller to report an error otherwise. Once output
+// has started, a failure throws an IOException instead, so that the connection
+// is dropped without the terminating chunk and the client sees a truncated 
+// export rather than a complete-looking one. A client which went away aborts
+// the query with InfluxAbort, which doesn't count as a failure of Influx.
+bool Nodes::exportHistory(const std::vector<std::string> &uids, 
+							const std::vector<std::string> &measurements, const std::string &from, 
+							const std::string &to, bool csv, std::function<std::ostream&()> open) {
+	if (!initialized || measurements.empty()) { return false; }
+	
+	std::ostream* out = 0;
+	bool failed = false;
+	std::function<void()> start = [&out, &open, csv]() {
+		out = &open();
+		if (csv) { *out << "time,location,measurement,value\n"; }
+	};
+	
+	if (uids.empty()) {
+		start();
+		return true;
+	}
+	
+	InfluxParser parser([&out, csv](const InfluxSeries &series, const InfluxRow &row) {
+		if (row.size() < 2) { return true; }
+		
+		std::ostream &o = *out;
+		if (csv) {
+			o << row[0].str << ',';
+			writeString(o, series.getTag("location"), csv);
+			o << ',' << series.name << ',';
+		}
+		else {
+			o << "{ \"time\": \"" << row[0].str << "\", \"location\": ";
+			writeString(o, series.getTag("location"), csv);
+			o << ", \"measurement\": \"" << series.name << "\", \"value\": ";
+		}
+		
+		if (row[1].isNumber()) { o << row[1].number; }
+		else if (row[1].isString()) { writeString(o, row[1].str, csv); }
+		else if (row[1].type == InfluxValue::BOOL) { o << (row[1].boolean ? "true" : "false"); }
+		else if (!csv) { o << "null"; }
+		
+		o << (csv ? "\n" : " }\n");
+		
+		// Stop once the client has gone away.
+		return o.good();
+	});
+	
+	// Series are sharded by measurement and location, so each measurement is
+	// queried separately on the endpoints holding its series.
+	for (unsigned int m = 0; m < measurements.size(); ++m) {
+		std::map<InfluxClient*, std::vector<std::string> > shards = groupByShard(influx, 
+																measurements[m], uids);
+		std::map<InfluxClient*, std::vector<std::string> >::iterator it;
+		for (it = shards.begin(); it != shards.end(); ++it) {
+			const std::vector<std::string> &shardUids = it->second;
+			for (unsigned int i = 0; i < shardUids.size(); i += uidQueryChunk) {
+				unsigned int end = std::min(i + uidQueryChunk, (unsigned int) shardUids.size());
+				std::string query = "SELECT \"value\" FROM \"" + measurements[m] + "\" WHERE " + 
+										locationFilter(shardUids, i, end) + " AND time >= " + from + 
+										" AND time < " + to + " GROUP BY \"location\"";
+				InfluxStatus res = it->first->query(query, [&](std::istream &rs) {
+					if (!out) { start(); }
+					if (!parser.parse(rs) && !parser.getError().empty()) {
+						std::cerr << "History export: Influx error: " << parser.getError() << std::endl;
+						failed = true;
+					}
+					
+					// Don't bother draining the rest of the response for a client 
+					// that disconnected.
+					if (!out->good()) { throw InfluxAbort("History export: client disconnected."); }
+				}, "chunked=true&chunk_size=10000");
+				
+				if (res != INFLUX_OK || failed) {
+					if (!out) { return false; }
+					throw IOException("History export: query failed after output started.");
+				}
+			}
+		}
+	}
+	
+	if (!out) { start(); }
+	return true;
+}
@@ -16,15 +16,20 @@
 
 #include <string>
 #include <vector>
+#include <map>
+#include <functional>
+#include <ostream>
+#include <atomic>
+#include <mutex>
 
 #include <Poco/Data/Session.h>
 #include <Poco/Data/SQLite/Connector.h>
 
-#include <Poco/Net/HTTPClientSession.h>
-#include <Poco/Net/HTTPSClientSession.h>
-
 #include <Poco/Timer.h>
 
+#include "influxcluster.h"
+#include "influxparser.h"
+
 using namespace Poco;
 using namespace Poco::Net;
 
@@ -80,13 +85,18 @@ struct SwitchInfo {
 #include "mqtt_listener.h"
 
 
+// Node lists for Nodes::getNodesJson().
+enum NodeLists {
+	NODES_ASSIGNED = 1,
+	NODES_UNASSIGNED = 2
+};
+
+
 class Nodes {
 	static Data::Session* session;
+	static std::mutex sessionMutex;		// Serialises all use of 'session'.
 	static bool initialized;
-	static HTTPClientSession* influxClient;
-	static std::string influxDb;
-	static bool secure;
-	static std::string defaultFirmware;
+	static InfluxCluster* influx;
 	static std::vector<NodeInfo> nodes;
 	static std::vector<NodeInfo> newNodes;
 	static Listener* listener;
@@ -94,22 +104,25 @@ class Nodes {
 	static Timer* nodesTimer;
 	static Timer* switchTimer;
 	static Nodes* selfRef;
+	static std::atomic<uint64_t> generation;
 	//static vector<string> uids;
 	
 public:
-	static void init(std::string defaultFirmware, std::string influxHost, int influxPort, 
-						std::string influxDb, std::string influx_sec, Listener* listener);
+	static void init(InfluxCluster* influx, Listener* listener);
 	static void stop();
 	static bool getNodeInfo(std::string uid, NodeInfo &info);
 	static bool updateNodeInfo(std::string uid, NodeInfo &node);
 	static bool deleteNodeInfo(std::string uid);
 	static bool getValveInfo(std::string uid, ValveInfo &info);
 	static bool getSwitchInfo(std::string uid, SwitchInfo &info);
-	static std::string nodesToJson();
-	static std::string unassignedToJson();
+	static const std::string& getNodesJson(int lists, uint64_t &gen);
 	//static bool getNodesInfo(vector<NodeInfo> &info);
+	static bool getTemperatures(const std::vector<std::string> &uids, std::vector<NodeInfo> &info,
+														std::vector<bool> &found);
 	static bool setTargetTemperature(std::string uid, float temp);
+	static bool setTargetTemperatures(const std::map<std::string, float> &temps);
 	static bool setCurrentTemperature(std::string uid, float temp);
+	static bool setCurrentTemperatures(const std::map<std::string, float> &temps);
 	static bool setDuty(std::string uid, uint8_t ch0, uint8_t ch1, uint8_t ch2, uint8_t ch3);
 	static bool setValves(std::string uid, bool ch0, bool ch1, bool ch2, bool ch3);
 	static bool setSwitch(std::string uid, bool state);
@@ -118,6 +131,10 @@ public:
 	void checkSwitch(Timer& timer);
 	static bool getUIDs(std::vector<std::string> &uids);
 	static bool getSwitchUIDs(std::vector<std::string> &uids);
+	static bool getLocationUIDs(std::string prefix, std::vector<std::string> &uids);
+	static bool exportHistory(const std::vector<std::string> &uids, 
+							const std::vector<std::string> &measurements, const std::string &from, 
+							const std::string &to, bool csv, std::function<std::ostream&()> open);
 };
 
 #endif
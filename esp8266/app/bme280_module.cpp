@@ -77,10 +77,10 @@ void BME280Module::readSensor() {
 		h = bme280->GetHumidity();
 		p = bme280->GetPressure();
 		
-		// Publish via MQTT.
-		OtaCore::publish("nsa/temperature", OtaCore::getLocation() + ";" + t);
-		OtaCore::publish("nsa/humidity", OtaCore::getLocation() + ";" + h);
-		OtaCore::publish("nsa/pressure", OtaCore::getLocation() + ";" + p);
+		// Publish via MQTT with the next batch.
+		OtaCore::addReading(TELEMETRY_BME280, TELEMETRY_TEMPERATURE, t);
+		OtaCore::addReading(TELEMETRY_BME280, TELEMETRY_HUMIDITY, h);
+		OtaCore::addReading(TELEMETRY_BME280, TELEMETRY_PRESSURE, p);
 	}
 	else {
 		OtaCore::log(LOG_ERROR, "Disconnected from BME280 sensor.");
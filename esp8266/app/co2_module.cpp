@@ -112,8 +112,8 @@ void CO2Module::onSerialReceived(Stream &stream, char arrivedChar, unsigned shor
 		int responseHigh = (int) buff[2];
 		int responseLow = (int) buff[3];
 		int ppm = (responseHigh * 0xFF) + responseLow;
-		String response = OtaCore::getLocation() + ";" + ppm;
-		OtaCore::publish("nsa/co2", response);
+		String response;
+		OtaCore::addReading(TELEMETRY_CO2, TELEMETRY_CO2_PPM, ppm);
 		
 		// Check and update event counters.
 		// Format of the semicolon-separated response is:
@@ -73,9 +73,9 @@ void DHTModule::readDHT() {
 	th = dht->getTempAndHumidity();
 	//if (dht->readTempAndHumidity(th)) {
 		
-	// Publish via MQTT.
-	OtaCore::publish("nsa/temperature", OtaCore::getLocation() + ";" + th.temperature);
-	OtaCore::publish("nsa/humidity", OtaCore::getLocation() + ";" + th.humidity);
+	// Publish via MQTT with the next batch.
+	OtaCore::addReading(TELEMETRY_DHT, TELEMETRY_TEMPERATURE, th.temperature);
+	OtaCore::addReading(TELEMETRY_DHT, TELEMETRY_HUMIDITY, th.humidity);
 	// (th.humid - 17.0)); // FIXME: Subtract 17% (hack for wrong resistor on sensors).
 		
 	/* }
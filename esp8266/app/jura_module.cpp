@@ -215,10 +215,10 @@ void JuraModule::onSerialReceived(Stream &stream, char arrivedChar, unsigned sho
 			long int coffeeCount = strtol(mqttTxBuffer.substring(11, 15).c_str(), 0, 16);
 			long int coffee2Count = strtol(mqttTxBuffer.substring(15, 19).c_str(), 0, 16);
 			
-			OtaCore::publish("nsa/espresso", OtaCore::getLocation() + ";" + espressoCount);
-			OtaCore::publish("nsa/espresso2", OtaCore::getLocation() + ";" + espresso2Count);
-			OtaCore::publish("nsa/coffee", OtaCore::getLocation() + ";" + coffeeCount);
-			OtaCore::publish("nsa/coffee2", OtaCore::getLocation() + ";" + coffee2Count);
+			OtaCore::addReading(TELEMETRY_JURA, TELEMETRY_ESPRESSO, espressoCount);
+			OtaCore::addReading(TELEMETRY_JURA, TELEMETRY_ESPRESSO2, espresso2Count);
+			OtaCore::addReading(TELEMETRY_JURA, TELEMETRY_COFFEE, coffeeCount);
+			OtaCore::addReading(TELEMETRY_JURA, TELEMETRY_COFFEE2, coffee2Count);
 			mqttTxBuffer = "";
 		}
 	}
@@ -36,6 +36,8 @@
 
 // Static initialisations.
 Timer OtaCore::procTimer;
+Timer OtaCore::otaTimer;
+uint8 OtaCore::otaAttempt = 0;
 RbootHttpUpdater* OtaCore::otaUpdater = 0;
 MqttClient* OtaCore::mqtt = 0;
 String OtaCore::MAC;
@@ -50,6 +52,32 @@ int OtaCore::sdaPin = SDA_PIN; // default.
 bool OtaCore::i2c_active = false;
 bool OtaCore::spi_active = false;
 uint32 OtaCore::esp8266_pins = 0x0;
+Timer OtaCore::telemetryTimer;
+OtaCore::Reading OtaCore::readings[TELEMETRY_MAX_READINGS];
+uint8 OtaCore::readingCount = 0;
+
+
+// Topic each metric's readings are published on when not batched, and the
+// number of decimals kept. Has to match common/telemetry.cpp.
+struct TelemetryInfo {
+	uint8 module;
+	uint8 metric;
+	const char* topic;
+	uint8 decimals;
+};
+
+static const TelemetryInfo telemetryInfo[] = {
+	{ TELEMETRY_BME280, TELEMETRY_TEMPERATURE, "nsa/temperature", 2 },
+	{ TELEMETRY_BME280, TELEMETRY_HUMIDITY, "nsa/humidity", 2 },
+	{ TELEMETRY_BME280, TELEMETRY_PRESSURE, "nsa/pressure", 2 },
+	{ TELEMETRY_DHT, TELEMETRY_TEMPERATURE, "nsa/temperature", 2 },
+	{ TELEMETRY_DHT, TELEMETRY_HUMIDITY, "nsa/humidity", 2 },
+	{ TELEMETRY_CO2, TELEMETRY_CO2_PPM, "nsa/co2", 0 },
+	{ TELEMETRY_JURA, TELEMETRY_ESPRESSO, "nsa/espresso", 0 },
+	{ TELEMETRY_JURA, TELEMETRY_ESPRESSO2, "nsa/espresso2", 0 },
+	{ TELEMETRY_JURA, TELEMETRY_COFFEE, "nsa/coffee", 0 },
+	{ TELEMETRY_JURA, TELEMETRY_COFFEE2, "nsa/coffee2", 0 }
+};
 
 //const Url mqtt_url(MQTT_URL);
 
@@ -136,6 +164,11 @@ bool OtaCore::init(onInitCallback cb) {
 	// Initialise the sub module system.
 	BaseModule::init();
 	
+#if TELEMETRY_INTERVAL > 0
+	// Publish collected sensor readings at a fixed interval.
+	telemetryTimer.initializeMs(TELEMETRY_INTERVAL, OtaCore::flushTelemetry).start();
+#endif
+	
 	//spiffs_mount(); // Mount file system, in order to work with files.
 	
 	// Mount the SpifFS manually. Automatic mounting is not
@@ -229,7 +262,20 @@ void OtaCore::otaUpdate_CallBack(RbootHttpUpdater& update, bool result) {
 		System.restart();
 	} 
 	else { // fail
-		OtaCore::log(LOG_ERROR, "Firmware update failed.");
+		if (++otaAttempt >= OTA_RETRIES) {
+			OtaCore::log(LOG_ERROR, "Firmware update failed, giving up.");
+			return;
+		}
+		
+		// Exponential backoff, waiting between half and all of the delay.
+		uint32 delay = OTA_RETRY_MIN;
+		for (uint8 i = 1; i < otaAttempt && delay < OTA_RETRY_MAX; ++i) { delay *= 2; }
+		if (delay > OTA_RETRY_MAX) { delay = OTA_RETRY_MAX; }
+		delay = delay / 2 + os_random() % (delay / 2 + 1);
+		
+		OtaCore::log(LOG_WARNING, "Firmware update failed, retrying in " + String(delay / 1000) + 
+																						" s.");
+		otaTimer.initializeMs(delay, OtaCore::otaDownload).startOnce();
 	}
 }
 
@@ -263,8 +309,82 @@ bool OtaCore::publish(String topic, String message, int qos /* = 1 */) {
 }
 
 
+// --- ADD READING ---
+// Add a sensor reading, to be published with the next batch. If batching is
+// disabled, it's published right away on the metric's own topic.
+bool OtaCore::addReading(TelemetryModule module, uint8 metric, float value) {
+	const TelemetryInfo* info = 0;
+	for (uint8 i = 0; i < sizeof(telemetryInfo) / sizeof(telemetryInfo[0]); ++i) {
+		if (telemetryInfo[i].module == module && telemetryInfo[i].metric == metric) {
+			info = &telemetryInfo[i];
+			break;
+		}
+	}
+	
+	if (!info) { return false; }
+	
+#if TELEMETRY_INTERVAL > 0
+	float scaled = value;
+	for (uint8 i = 0; i < info->decimals; ++i) { scaled *= 10; }
+	
+	Reading &r = readings[readingCount++];
+	r.module = module;
+	r.metric = metric;
+	r.time = millis();
+	r.value = (int32) (scaled + ((scaled < 0) ? -0.5f : 0.5f));
+	if (readingCount == TELEMETRY_MAX_READINGS) { flushTelemetry(); }
+	return true;
+#else
+	return publish(info->topic, location + ";" + String(value, info->decimals));
+#endif
+}
+
+
+// --- FLUSH TELEMETRY ---
+// Publish the collected readings as a single binary message. Each reading
+// carries its age in 0.1 s units, so that the receiver can timestamp it.
+void OtaCore::flushTelemetry() {
+	if (readingCount == 0) { return; }
+	
+	static char buffer[2 + 255 + TELEMETRY_MAX_READINGS * 8];
+	uint8 locationLength = (location.length() > 255) ? 255 : location.length();
+	uint16 len = 0;
+	buffer[len++] = TELEMETRY_VERSION;
+	buffer[len++] = locationLength;
+	memcpy(buffer + len, location.c_str(), locationLength);
+	len += locationLength;
+	
+	uint32 now = millis();
+	for (uint8 i = 0; i < readingCount; ++i) {
+		const Reading &r = readings[i];
+		uint32 age = (now - r.time + 50) / 100;
+		if (age > 0xffff) { age = 0xffff; }
+		buffer[len++] = r.module;
+		buffer[len++] = r.metric;
+		buffer[len++] = age & 0xff;
+		buffer[len++] = age >> 8;
+		buffer[len++] = r.value & 0xff;
+		buffer[len++] = (r.value >> 8) & 0xff;
+		buffer[len++] = (r.value >> 16) & 0xff;
+		buffer[len++] = (r.value >> 24) & 0xff;
+	}
+	
+	readingCount = 0;
+	publish("nsa/batch", String(buffer, len));
+}
+
+
 // --- OTA UPDATE ---
+// Start a firmware update. A failed download is retried with a backoff.
 void OtaCore::otaUpdate() {
+	otaTimer.stop();
+	otaAttempt = 0;
+	otaDownload();
+}
+
+
+// --- OTA DOWNLOAD ---
+void OtaCore::otaDownload() {
 	//Serial1.printf("Updating firmware from URL: %s...", OTA_URL);
 	OtaCore::log(LOG_INFO, "Updating firmware from URL: " + String(ota_url));
 	
@@ -20,6 +20,8 @@
 #include <Network/RbootHttpUpdater.h>
 #include <SmingCore.h>
 
+#include "telemetry.h"
+
 
 enum {
 	LOG_ERROR = 0,
@@ -52,6 +54,23 @@ enum ESP8266_pins {
 };
 
 
+// Retries of a failed firmware update, e.g. when the controller is busy with
+// other downloads during an upgrade of many nodes and answers with a 503. The
+// delay doubles with each attempt, from OTA_RETRY_MIN up to OTA_RETRY_MAX ms,
+// of which a random half is waited, so that the nodes don't all retry at once.
+#ifndef OTA_RETRY_MIN
+#define OTA_RETRY_MIN 5000
+#endif
+
+#ifndef OTA_RETRY_MAX
+#define OTA_RETRY_MAX 300000
+#endif
+
+#ifndef OTA_RETRIES
+#define OTA_RETRIES 10
+#endif
+
+
 // I2C pins.
 #define SCL_PIN 5 // SCL pin: GPIO5 ('D1' on NodeMCU)
 #define SDA_PIN 4 // SDA pin: GPIO4 ('D2' on NodeMCU)
@@ -64,6 +83,8 @@ typedef void (*onInitCallback)();
 
 class OtaCore {
 	static Timer procTimer;
+	static Timer otaTimer;
+	static uint8 otaAttempt;
 	static RbootHttpUpdater* otaUpdater;
 	static MqttClient* mqtt;
 	static String MAC;
@@ -78,8 +99,21 @@ class OtaCore {
 	static bool i2c_active;
 	static bool spi_active;
 	static uint32 esp8266_pins;
+	
+	// Readings waiting to be published as a batch.
+	struct Reading {
+		uint8 module;
+		uint8 metric;
+		uint32 time;	// millis()
+		int32 value;	// Scaled by 10^decimals.
+	};
+	
+	static Timer telemetryTimer;
+	static Reading readings[TELEMETRY_MAX_READINGS];
+	static uint8 readingCount;
 
 	static void otaUpdate();
+	static void otaDownload();
 	static void otaUpdate_CallBack(RbootHttpUpdater& update, bool result);
 	static void startMqttClient();
 	static void checkResponses();
@@ -89,12 +123,14 @@ class OtaCore {
 	static int onMqttReceived(MqttClient& client, mqtt_message_t* payload);
 	static void updateModules(uint32 input);
 	static bool mapGpioToBit(int pin, ESP8266_pins &addr);
+	static void flushTelemetry();
 	
 public:
 	static bool init(onInitCallback cb);
 	static bool registerTopic(String topic, topicCallback cb);
 	static bool deregisterTopic(String topic);
 	static bool publish(String topic, String message, int qos = 1);
+	static bool addReading(TelemetryModule module, uint8 metric, float value);
 	static void log(int level, String msg);
 	static String getMAC() { return OtaCore::MAC; }
 	static String getLocation() { return OtaCore::location; }
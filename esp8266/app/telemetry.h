@@ -0,0 +1,60 @@
+/*
+	telemetry.h - Module and metric ids for batched telemetry.
+	
+	Revision 0
+	
+	Notes:
+			- Sensor readings are collected by OtaCore and published as one
+				binary message per interval on the 'nsa/batch' topic. See
+				common/telemetry.h for the format.
+			- These ids have to match the metric table in common/telemetry.cpp
+				of the services decoding the batches.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+
+#define TELEMETRY_VERSION 1
+
+// Interval (ms) at which collected readings are published. 0 publishes each
+// reading as a text message on its own topic, as older services expect.
+// Readings are up to this old when they arrive, so the rollup grace period of
+// influx_mqtt (Rollup.grace in its config.ini) has to be longer.
+#ifndef TELEMETRY_INTERVAL
+#define TELEMETRY_INTERVAL 30000
+#endif
+
+// Readings collected before the batch is published early. Each takes 8 bytes
+// in the message.
+#define TELEMETRY_MAX_READINGS 64
+
+
+enum TelemetryModule {
+	TELEMETRY_BME280 = 1,
+	TELEMETRY_DHT = 2,
+	TELEMETRY_CO2 = 3,
+	TELEMETRY_JURA = 4
+};
+
+
+enum {
+	// BME280 and DHT.
+	TELEMETRY_TEMPERATURE = 0,
+	TELEMETRY_HUMIDITY = 1,
+	TELEMETRY_PRESSURE = 2,
+	
+	// CO2.
+	TELEMETRY_CO2_PPM = 0,
+	
+	// Jura.
+	TELEMETRY_ESPRESSO = 0,
+	TELEMETRY_ESPRESSO2 = 1,
+	TELEMETRY_COFFEE = 2,
+	TELEMETRY_COFFEE2 = 3
+};
+
+#endif
@@ -0,0 +1,395 @@
+/*
+	archive.cpp - Implementation of the compressed columnar archive sink.
+	
+	Revision 0
+	
+	Notes:
+			- Points of a series arriving slightly out of order from different
+				parser workers are stored with the time of the point before,
+				as blocks need non-decreasing timestamps.
+			- A block torn by a crash while being appended is cut off the file
+				before the first new block is appended to it.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#include "archive.h"
+
+#include <iostream>
+#include <fstream>
+#include <ctime>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+
+#include <Poco/File.h>
+#include <Poco/Exception.h>
+
+#include "lineproto.h"
+
+using namespace Poco;
+
+
+// Most fields looked at in a single line.
+static const uint32_t maxFields = 16;
+
+// Maximum number of sealed blocks waiting to be written.
+static const size_t maxPending = 65536;
+
+// Interval between checks for blocks which have reached the maximum age.
+static const uint32_t ageCheckInterval = 10; // s
+
+
+// --- DAYS FROM CIVIL ---
+// Days since the epoch of the given date (proleptic Gregorian calendar).
+static int64_t daysFromCivil(int64_t y, int m, int d) {
+	y -= (m <= 2) ? 1 : 0;
+	int64_t era = (y >= 0 ? y : y - 399) / 400;
+	int64_t yoe = y - era * 400;
+	int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+	int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + doe - 719468;
+}
+
+
+// --- MONTH RANGE ---
+static void monthRange(int y, int m, int64_t &start, int64_t &end) {
+	start = daysFromCivil(y, m, 1) * 86400000;
+	end = (m == 12) ? daysFromCivil(y + 1, 1, 1) : daysFromCivil(y, m + 1, 1);
+	end *= 86400000;
+}
+
+
+// --- CONSTRUCTOR ---
+Archive::Archive(string dir, uint32_t resolutionMs, uint32_t blockPoints, uint32_t maxAgeSec,
+											uint32_t stripeCount) {
+	this->dir = dir;
+	resolution = (resolutionMs > 0) ? resolutionMs : 1;
+	this->blockPoints = (blockPoints > 1) ? blockPoints : 2;
+	maxAge = maxAgeSec;
+	if (stripeCount == 0) { stripeCount = 1; }
+	for (uint32_t i = 0; i < stripeCount; ++i) {
+		stripes.push_back(new Stripe);
+	}
+	
+	running = false;
+	statPoints = 0;
+	statBlocks = 0;
+	statBytes = 0;
+	statErrors = 0;
+	lastPoints = 0;
+}
+
+
+// --- DECONSTRUCTOR ---
+Archive::~Archive() {
+	stop();
+	for (unsigned int i = 0; i < stripes.size(); ++i) {
+		delete stripes[i];
+	}
+}
+
+
+// --- ESCAPE ---
+// Escape a series key or field name for use as a file name.
+string Archive::escape(const string &name) {
+	string out;
+	for (unsigned int i = 0; i < name.length(); ++i) {
+		unsigned char c = name[i];
+		if (isalnum(c) || c == '-' || c == '_' || c == ',' || c == '=') {
+			out += c;
+			continue;
+		}
+		
+		char hex[4];
+		snprintf(hex, sizeof(hex), "%%%02X", c);
+		out += hex;
+	}
+	
+	return out;
+}
+
+
+// --- PARTITION ---
+// Name (YYYYMM) and time range of the partition containing the time (ms).
+string Archive::partition(int64_t time, int64_t &start, int64_t &end) {
+	time_t secs = time / 1000;
+	struct tm t;
+	gmtime_r(&secs, &t);
+	monthRange(t.tm_year + 1900, t.tm_mon + 1, start, end);
+	
+	char name[16];
+	snprintf(name, sizeof(name), "%04d%02d", t.tm_year + 1900, t.tm_mon + 1);
+	return string(name);
+}
+
+
+// --- PARTITION RANGE ---
+// Time range of the partition with the given name.
+bool Archive::partitionRange(const string &name, int64_t &start, int64_t &end) {
+	if (name.length() != 6 || name.find_first_not_of("0123456789") != string::npos) {
+		return false;
+	}
+	
+	int y = atoi(name.substr(0, 4).c_str());
+	int m = atoi(name.substr(4, 2).c_str());
+	if (m < 1 || m > 12) { return false; }
+	monthRange(y, m, start, end);
+	return true;
+}
+
+
+// --- OPEN ---
+// Create the archive directory if needed.
+bool Archive::open() {
+	try {
+		File(dir).createDirectories();
+	}
+	catch (Exception &exc) {
+		cerr << "Archive: failed to open " << dir << ": " << exc.displayText() << endl;
+		return false;
+	}
+	
+	return true;
+}
+
+
+// --- START ---
+// Start the writer thread.
+void Archive::start() {
+	lock_guard<mutex> lk(writeMutex);
+	if (running) { return; }
+	running = true;
+	writer = thread(&Archive::run, this);
+}
+
+
+// --- STOP ---
+// Seal all open blocks, write them and stop the writer thread.
+void Archive::stop() {
+	{
+		lock_guard<mutex> lk(writeMutex);
+		if (!running) { return; }
+	}
+	
+	sealOld(true);
+	{
+		lock_guard<mutex> lk(writeMutex);
+		running = false;
+	}
+	
+	writeCv.notify_all();
+	writer.join();
+}
+
+
+// --- SEAL ---
+// Finish the series' current block, adding it to 'blocks'. Must be called with
+// the stripe's lock held.
+void Archive::seal(Series &series, vector<Block> &blocks) {
+	if (series.encoder.count() == 0) { return; }
+	
+	blocks.push_back(Block());
+	blocks.back().path = series.path + "-" + series.partName + ".gor";
+	series.encoder.finish(blocks.back().data);
+	++statBlocks;
+}
+
+
+// --- QUEUE ---
+// Queue sealed blocks for the writer thread.
+void Archive::queue(vector<Block> &blocks) {
+	{
+		lock_guard<mutex> lk(writeMutex);
+		for (unsigned int i = 0; i < blocks.size(); ++i) {
+			if (pending.size() >= maxPending) {
+				++statErrors;
+				continue;
+			}
+			
+			pending.push_back(Block());
+			pending.back().path.swap(blocks[i].path);
+			pending.back().data.swap(blocks[i].data);
+		}
+	}
+	
+	writeCv.notify_one();
+}
+
+
+// --- SEAL OLD ---
+// Seal the blocks which have reached the maximum age, or all of them.
+void Archive::sealOld(bool all) {
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	vector<Block> blocks;
+	for (unsigned int i = 0; i < stripes.size(); ++i) {
+		lock_guard<mutex> lk(stripes[i]->lock);
+		unordered_map<string, Series>::iterator it;
+		for (it = stripes[i]->series.begin(); it != stripes[i]->series.end(); ++it) {
+			Series &series = it->second;
+			if (series.encoder.count() == 0) { continue; }
+			if (all || now - series.opened >= chrono::seconds(maxAge)) {
+				seal(series, blocks);
+			}
+		}
+	}
+	
+	if (!blocks.empty()) { queue(blocks); }
+}
+
+
+// --- APPEND ---
+// Append a block to its file. The first time a file is written to, its
+// directory is created and any torn block at its end is removed.
+bool Archive::append(const Block &block) {
+	if (checked.find(block.path) == checked.end()) {
+		try {
+			File(block.path.substr(0, block.path.rfind('/'))).createDirectories();
+			File file(block.path);
+			if (file.exists()) {
+				uint64_t size = file.getSize();
+				uint64_t pos = 0;
+				ifstream in(block.path.c_str(), ios::binary);
+				GorillaBlock hdr;
+				while (pos + sizeof(hdr) <= size) {
+					in.seekg(pos);
+					if (!in.read((char*) &hdr, sizeof(hdr))) { break; }
+					if (hdr.magic != gorillaMagic || hdr.bytes > size - pos - sizeof(hdr)) { break; }
+					pos += sizeof(hdr) + hdr.bytes;
+				}
+				
+				if (pos != size) {
+					cerr << "Archive: cutting off " << size - pos << " torn bytes from "
+							<< block.path << ".\n";
+					file.setSize(pos);
+				}
+			}
+		}
+		catch (Exception &exc) {
+			cerr << "Archive: failed to open " << block.path << ": " << exc.displayText() << endl;
+			++statErrors;
+			return false;
+		}
+		
+		checked.insert(block.path);
+	}
+	
+	ofstream out(block.path.c_str(), ios::binary | ios::app);
+	out.write(block.data.data(), block.data.length());
+	out.close();
+	if (!out) {
+		cerr << "Archive: failed to write to " << block.path << ".\n";
+		++statErrors;
+		return false;
+	}
+	
+	statBytes += block.data.length();
+	return true;
+}
+
+
+// --- RUN ---
+// Writer thread. Also seals blocks which have reached the maximum age.
+void Archive::run() {
+	chrono::steady_clock::time_point nextCheck = chrono::steady_clock::now() +
+														chrono::seconds(ageCheckInterval);
+	unique_lock<mutex> lk(writeMutex);
+	while (true) {
+		if (!pending.empty()) {
+			Block block;
+			block.path.swap(pending.front().path);
+			block.data.swap(pending.front().data);
+			pending.pop_front();
+			lk.unlock();
+			append(block);
+			lk.lock();
+			continue;
+		}
+		
+		if (!running) { break; }
+		if (chrono::steady_clock::now() >= nextCheck) {
+			lk.unlock();
+			sealOld(false);
+			lk.lock();
+			nextCheck += chrono::seconds(ageCheckInterval);
+			continue;
+		}
+		
+		writeCv.wait_until(lk, nextCheck);
+	}
+}
+
+
+// --- ADD ---
+// Archive the numeric fields of a point (line protocol without timestamp)
+// received at the given time, in milliseconds since the epoch.
+void Archive::add(const string &line, uint64_t time) {
+	size_t keyEnd;
+	pair<size_t, size_t> names[maxFields];
+	double values[maxFields];
+	uint32_t count = lpNumericFields(line.data(), line.length(), keyEnd, names, values, maxFields);
+	if (count == 0) { return; }
+	
+	static thread_local string key;
+	static thread_local string id;
+	key.assign(line, 0, keyEnd);
+	vector<Block> blocks;
+	Stripe &stripe = *stripes[hash<string>()(key) % stripes.size()];
+	{
+		lock_guard<mutex> lk(stripe.lock);
+		for (uint32_t i = 0; i < count; ++i) {
+			id.assign(line, 0, keyEnd + 1);
+			id.append(line, names[i].first, names[i].second);
+			unordered_map<string, Series>::iterator it = stripe.series.find(id);
+			if (it == stripe.series.end()) {
+				it = stripe.series.insert(pair<string, Series>(id, Series())).first;
+				Series &series = it->second;
+				series.path = dir + "/" + escape(key) + "/" +
+								escape(line.substr(names[i].first, names[i].second));
+				series.encoder = GorillaEncoder(resolution);
+				series.last = 0;
+				series.partStart = 0;
+				series.partEnd = 0;
+			}
+			
+			Series &series = it->second;
+			int64_t t = time;
+			if (series.encoder.count() > 0) {
+				if (t < series.last) { t = series.last; }
+				if (t >= series.partEnd || series.encoder.count() >= blockPoints) {
+					seal(series, blocks);
+				}
+			}
+			
+			if (series.encoder.count() == 0) {
+				series.partName = partition(t, series.partStart, series.partEnd);
+				series.opened = chrono::steady_clock::now();
+			}
+			
+			series.encoder.add(t, values[i]);
+			series.last = t;
+		}
+	}
+	
+	statPoints += count;
+	if (!blocks.empty()) { queue(blocks); }
+}
+
+
+// --- REPORT ---
+// Report the points archived over the past interval (in seconds).
+void Archive::report(uint32_t interval) {
+	if (interval == 0) { interval = 1; }
+	uint64_t points = statPoints;
+	size_t queued;
+	{
+		lock_guard<mutex> lk(writeMutex);
+		queued = pending.size();
+	}
+	
+	cout << "Archive: " << (points - lastPoints) / interval << " points/s, " << statBlocks
+			<< " blocks (" << statBytes / 1048576 << " MB) written, " << queued
+			<< " queued, " << statErrors << " errors.\n";
+	lastPoints = points;
+}
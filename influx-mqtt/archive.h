@@ -0,0 +1,106 @@
+/*
+	archive.h - Header file for the compressed columnar archive sink.
+	
+	Revision 0
+	
+	Notes:
+			- Writes every numeric field of every series to its own files, one
+				per calendar month (UTC), as blocks of Gorilla-compressed points
+				(see gorilla.h). This forms a long-term archive independent of
+				the retention policies of InfluxDB.
+			- Files are laid out as <dir>/<series key>/<field>-<YYYYMM>.gor,
+				with characters which aren't safe in file names escaped as %XX.
+			- Points are collected in memory per series until a block is full,
+				its month ends or it reaches the maximum age. Sealed blocks are
+				appended to their files by a single writer thread, so the
+				parser workers never wait for the disk. Points in open blocks
+				are lost if the bridge crashes.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#pragma once
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <set>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+using namespace std;
+
+#include "gorilla.h"
+
+
+class Archive {
+	struct Series {
+		string path;		// File path without the partition.
+		GorillaEncoder encoder;
+		int64_t last;		// Time of the last point (ms).
+		int64_t partStart;
+		int64_t partEnd;
+		string partName;
+		chrono::steady_clock::time_point opened;
+	};
+	
+	struct Stripe {
+		mutex lock;
+		unordered_map<string, Series> series;
+	};
+	
+	struct Block {
+		string path;
+		string data;
+	};
+	
+	string dir;
+	uint32_t resolution;	// ms
+	uint32_t blockPoints;
+	uint32_t maxAge;		// s
+	vector<Stripe*> stripes;
+	
+	deque<Block> pending;
+	mutex writeMutex;
+	condition_variable writeCv;
+	thread writer;
+	bool running;
+	set<string> checked;	// Files whose tail was checked, by the writer thread.
+	
+	atomic<uint64_t> statPoints;
+	atomic<uint64_t> statBlocks;
+	atomic<uint64_t> statBytes;
+	atomic<uint64_t> statErrors;
+	uint64_t lastPoints;
+	
+	void seal(Series &series, vector<Block> &blocks);
+	void queue(vector<Block> &blocks);
+	void sealOld(bool all);
+	bool append(const Block &block);
+	void run();
+
+public:
+	Archive(string dir, uint32_t resolutionMs = 1000, uint32_t blockPoints = 4096,
+											uint32_t maxAgeSec = 3600, uint32_t stripeCount = 16);
+	~Archive();
+	
+	bool open();
+	void start();
+	void stop();
+	void add(const string &line, uint64_t time);
+	void report(uint32_t interval);
+	
+	static string escape(const string &name);
+	static string partition(int64_t time, int64_t &start, int64_t &end);
+	static bool partitionRange(const string &name, int64_t &start, int64_t &end);
+};
+
+#endif
@@ -0,0 +1,395 @@
+/*
+	batcher.cpp - Implementation of the batching InfluxDB writer.
+	
+	Revision 0
+	
+	Notes:
+			- Influx (1.x) writes all valid points of a batch and answers with
+				a 400 'partial write' error for the rest. Such batches are not
+				retried, since the same points would be rejected again.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#include "batcher.h"
+
+#include <iostream>
+#include <cstdlib>
+
+using namespace std;
+
+
+// Back-off before retrying a batch while Influx is unavailable.
+static const uint32_t retryDelay = 1000; // ms
+
+// Interval between statistics reports.
+static const uint32_t statsInterval = 60; // s
+
+
+// --- CONSTRUCTOR ---
+InfluxBatcher::InfluxBatcher(InfluxClient* influx, uint32_t maxPoints, uint32_t maxBytes,
+											uint32_t maxAgeMs, uint32_t maxQueued) {
+	this->influx = influx;
+	params = "precision=ms";
+	this->maxPoints = (maxPoints > 0) ? maxPoints : 1;
+	this->maxBytes = maxBytes;
+	this->maxAge = maxAgeMs;
+	this->maxQueued = (maxQueued > 0) ? maxQueued : 1;
+	running = false;
+	block = false;
+	replaying = false;
+	spool = 0;
+	replayRate = 0;
+	lastReplayed = 0;
+	lastWritten = 0;
+	statPoints = 0;
+	statWritten = 0;
+	statRejected = 0;
+	statDropped = 0;
+	statBatches = 0;
+	statRetries = 0;
+	
+	current.lines.reserve(this->maxBytes);
+}
+
+
+// --- DECONSTRUCTOR ---
+InfluxBatcher::~InfluxBatcher() {
+	stop();
+}
+
+
+// --- SET NAME ---
+// Name shown in reports as 'Batcher [name]', to tell the batchers of several
+// endpoints apart.
+void InfluxBatcher::setName(const string &name) {
+	this->name = " [" + name + "]";
+}
+
+
+// --- SET RETENTION POLICY ---
+// Write into the given retention policy instead of the database's default.
+// Spooled batches don't record the policy, so batchers with different 
+// policies need their own spools. Call before start().
+void InfluxBatcher::setRetentionPolicy(const string &rp) {
+	params = "precision=ms";
+	if (!rp.empty()) { params += "&rp=" + rp; }
+}
+
+
+// --- SET SPOOL ---
+// Use a spool for batches which can't be delivered. A replay rate of zero
+// replays as fast as Influx accepts the batches. Call before start().
+void InfluxBatcher::setSpool(Spool* spool, uint32_t replayRate) {
+	this->spool = spool;
+	this->replayRate = replayRate;
+}
+
+
+// --- SET BLOCKING ---
+// Overflow policy for a full write queue. When blocking, add() waits for room
+// instead of pushing the oldest batch out to the spool, or dropping it. Call
+// before start().
+void InfluxBatcher::setBlocking(bool block) {
+	this->block = block;
+}
+
+
+// --- START ---
+// Start the writer threads. Each has at most one request in flight.
+void InfluxBatcher::start(uint32_t writers) {
+	lock_guard<mutex> lk(batchMutex);
+	if (running) { return; }
+	running = true;
+	nextReplay = chrono::steady_clock::now();
+	if (writers == 0) { writers = 1; }
+	for (uint32_t i = 0; i < writers; ++i) {
+		this->writers.push_back(thread(&InfluxBatcher::run, this, i));
+	}
+}
+
+
+// --- STOP ---
+// Flush all remaining points and stop the writer threads.
+void InfluxBatcher::stop() {
+	{
+		lock_guard<mutex> lk(batchMutex);
+		if (!running) { return; }
+		running = false;
+	}
+	
+	cv.notify_all();
+	spaceCv.notify_all();
+	for (unsigned int i = 0; i < writers.size(); ++i) {
+		writers[i].join();
+	}
+	
+	writers.clear();
+}
+
+
+// --- NOW ---
+// Current time in milliseconds since the epoch.
+uint64_t InfluxBatcher::now() {
+	return chrono::duration_cast<chrono::milliseconds>(
+								chrono::system_clock::now().time_since_epoch()).count();
+}
+
+
+// --- ADD ---
+// Add a single point in line protocol format, without timestamp. The timestamp
+// is in milliseconds since the epoch.
+void InfluxBatcher::add(const char* line, size_t len, uint64_t timestamp) {
+	char ts[24];
+	char* p = ts + sizeof(ts);
+	*(--p) = '\n';
+	do {
+		*(--p) = '0' + (timestamp % 10);
+		timestamp /= 10;
+	} while (timestamp > 0);
+	*(--p) = ' ';
+	
+	unique_lock<mutex> lk(batchMutex);
+	bool notify = (current.points == 0);
+	if (notify) { started = chrono::steady_clock::now(); }
+	current.lines.append(line, len);
+	current.lines.append(p, ts + sizeof(ts) - p);
+	++current.points;
+	++statPoints;
+	if (current.points >= maxPoints || current.lines.length() >= maxBytes) {
+		if (block) {
+			spaceCv.wait(lk, [this] { return queue.size() < maxQueued || !running; });
+		}
+		
+		Batch evicted;
+		seal(evicted);
+		notify = true;
+		lk.unlock();
+		evict(evicted);
+	}
+	else {
+		lk.unlock();
+	}
+	
+	if (notify) { cv.notify_one(); }
+}
+
+
+// --- SEAL ---
+// Move the current batch onto the write queue. If the queue is full, the
+// oldest batch is taken off it into 'evicted', to be passed to evict() once
+// the mutex has been released. Must be called with the mutex held.
+void InfluxBatcher::seal(Batch &evicted) {
+	if (current.points == 0) { return; }
+	if (queue.size() >= maxQueued) {
+		evicted.lines.swap(queue.front().lines);
+		evicted.points = queue.front().points;
+		queue.pop_front();
+	}
+	
+	queue.push_back(Batch());
+	queue.back().lines.swap(current.lines);
+	queue.back().points = current.points;
+	current.points = 0;
+	current.lines.reserve(maxBytes);
+}
+
+
+// --- EVICT ---
+// Move a batch evicted from the full queue to the spool, or drop it without
+// one. Called without the mutex held, so that the disk write doesn't stall 
+// the other parsers and the writers.
+// Drops are only counted here, as this runs on the caller's thread. They show
+// up in the periodic statistics report.
+void InfluxBatcher::evict(Batch &batch) {
+	if (batch.points == 0) { return; }
+	if (!spool || !spool->append(batch.lines, batch.points)) {
+		statDropped += batch.points;
+	}
+}
+
+
+// --- SEND ---
+// Write a batch to Influx. Returns false if Influx was unavailable and the
+// batch should be retried.
+bool InfluxBatcher::send(Batch &batch) {
+	++statBatches;
+	string error;
+	InfluxStatus res = influx->write(batch.lines, params, &error);
+	if (res == INFLUX_OK) {
+		statWritten += batch.points;
+		return true;
+	}
+	
+	if (res == INFLUX_UNAVAILABLE) { return false; }
+	
+	// Rejected. On a partial write Influx reports how many points it dropped,
+	// otherwise assume the whole batch was refused.
+	uint64_t dropped = batch.points;
+	size_t pos = error.find("dropped=");
+	if (pos != string::npos) {
+		uint64_t n = strtoull(error.c_str() + pos + 8, 0, 10);
+		if (n <= batch.points) { dropped = n; }
+	}
+	
+	statWritten += batch.points - dropped;
+	statRejected += dropped;
+	cerr << "Batcher" << name << ": Influx rejected " << dropped << " of " << batch.points << " points.\n";
+	return true;
+}
+
+
+// --- REPLAY ---
+// Send the oldest spooled batch. The next replay is scheduled such that the
+// replay rate stays below the configured number of points per second.
+// Called with the lock held, which is released while sending.
+void InfluxBatcher::replay(unique_lock<mutex> &lk) {
+	replaying = true;
+	lk.unlock();
+	Batch batch;
+	SpoolCursor cursor;
+	bool done = false;
+	if (spool->peek(batch.lines, batch.points, cursor)) {
+		done = send(batch);
+		if (done) { spool->pop(cursor); }
+	}
+	
+	lk.lock();
+	replaying = false;
+	if (!done) {
+		nextReplay = chrono::steady_clock::now() + chrono::milliseconds(retryDelay);
+	}
+	else if (replayRate > 0) {
+		nextReplay = chrono::steady_clock::now() + 
+							chrono::milliseconds((uint64_t) batch.points * 1000 / replayRate);
+	}
+}
+
+
+// --- REPORT ---
+void InfluxBatcher::report() {
+	BatchStats stats = getStats();
+	cout << "Batcher" << name << ": " << stats.points << " points, " << stats.written << " written ("
+			<< (stats.written - lastWritten) / statsInterval << "/s), " << stats.rejected 
+			<< " rejected, " << stats.dropped << " dropped, " << stats.queued << "/" << maxQueued
+			<< " batches queued.\n";
+	lastWritten = stats.written;
+	if (!spool) { return; }
+	
+	SpoolStats sstats = spool->getStats();
+	cout << "Spool" << name << ": " << sstats.points << " points in " << sstats.segments << " segments ("
+			<< sstats.bytes / 1048576 << " MB), oldest " << sstats.oldest << " s, replaying "
+			<< (sstats.replayed - lastReplayed) / statsInterval << " points/s, "
+			<< sstats.dropped << " dropped.\n";
+	lastReplayed = sstats.replayed;
+}
+
+
+// --- RUN ---
+// Writer thread. Writes full batches as they arrive, and the current batch
+// once its oldest point has reached the maximum age. Batches which can't be
+// delivered go to the spool, if any, which is replayed by one writer at a time
+// while the queue is empty.
+void InfluxBatcher::run(uint32_t id) {
+	chrono::steady_clock::time_point nextReport = chrono::steady_clock::now() +
+														chrono::seconds(statsInterval);
+	unique_lock<mutex> lk(batchMutex);
+	while (true) {
+		// Only the first writer reports.
+		chrono::steady_clock::time_point now = chrono::steady_clock::now();
+		if (id == 0 && now >= nextReport) {
+			lk.unlock();
+			report();
+			lk.lock();
+			nextReport += chrono::seconds(statsInterval);
+			continue;
+		}
+		
+		if (queue.empty()) {
+			chrono::steady_clock::time_point deadline = started + chrono::milliseconds(maxAge);
+			if (current.points > 0 && (!running || now >= deadline)) {
+				Batch evicted;
+				seal(evicted);
+				if (evicted.points > 0) {
+					lk.unlock();
+					evict(evicted);
+					lk.lock();
+				}
+				
+				continue;
+			}
+			
+			if (!running) { break; }
+			
+			bool pending = spool && !replaying && !spool->empty();
+			if (pending && now >= nextReplay) {
+				replay(lk);
+				continue;
+			}
+			
+			// Sleep until the next batch is due, or until woken up by add().
+			chrono::steady_clock::time_point wake = nextReport;
+			if (id != 0) { wake = now + chrono::seconds(statsInterval); }
+			if (current.points > 0) { wake = min(wake, deadline); }
+			if (pending) { wake = min(wake, nextReplay); }
+			cv.wait_until(lk, wake);
+			continue;
+		}
+		
+		Batch batch;
+		batch.lines.swap(queue.front().lines);
+		batch.points = queue.front().points;
+		queue.pop_front();
+		
+		lk.unlock();
+		spaceCv.notify_all();
+		bool sent = send(batch);
+		if (!sent && spool) { spool->append(batch.lines, batch.points); }
+		lk.lock();
+		
+		if (sent) { continue; }
+		if (spool) {
+			// Spooled, or counted as dropped by the spool if that failed.
+			nextReplay = chrono::steady_clock::now() + chrono::milliseconds(retryDelay);
+			continue;
+		}
+		
+		if (!running) {
+			statDropped += batch.points;
+			cerr << "Batcher" << name << ": Influx unavailable on shutdown, dropping " << batch.points << " points.\n";
+			continue;
+		}
+		
+		// Without a spool, put the batch back at the front of the queue and wait
+		// before the next attempt. New batches keep queuing up behind it in the
+		// meantime.
+		++statRetries;
+		if (queue.size() >= maxQueued) {
+			statDropped += batch.points;
+		}
+		else {
+			queue.push_front(Batch());
+			queue.front().lines.swap(batch.lines);
+			queue.front().points = batch.points;
+		}
+		
+		cv.wait_for(lk, chrono::milliseconds(retryDelay), [this] { return !running; });
+	}
+}
+
+
+// --- GET STATS ---
+BatchStats InfluxBatcher::getStats() {
+	BatchStats stats;
+	stats.points = statPoints;
+	stats.written = statWritten;
+	stats.rejected = statRejected;
+	stats.dropped = statDropped;
+	stats.batches = statBatches;
+	stats.retries = statRetries;
+	
+	lock_guard<mutex> lk(batchMutex);
+	stats.queued = queue.size();
+	return stats;
+}
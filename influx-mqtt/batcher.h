@@ -0,0 +1,117 @@
+/*
+	batcher.h - Header file for the batching InfluxDB writer.
+	
+	Revision 0
+	
+	Notes:
+			- Collects line protocol points and writes them to InfluxDB as
+				multi-line bodies from a background thread, once a batch is
+				full or its oldest point has reached the maximum age.
+			- Points carry their receive timestamp (ms), which makes retrying
+				a failed batch idempotent: Influx overwrites identical points.
+			- With a spool set, batches which can't be delivered are written
+				to disk and replayed at a limited rate once Influx is back.
+			- Multiple writer threads can be started, each sending batches over
+				its own pooled Influx session.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#pragma once
+#ifndef BATCHER_H
+#define BATCHER_H
+
+#include <string>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+using namespace std;
+
+#include "influxclient.h"
+#include "spool.h"
+
+
+struct BatchStats {
+	uint64_t points;		// Points added.
+	uint64_t written;		// Points accepted by Influx.
+	uint64_t rejected;		// Points refused by Influx (bad data).
+	uint64_t dropped;		// Points discarded because the queue was full.
+	uint64_t batches;		// Write requests sent.
+	uint64_t retries;		// Batches retried after Influx was unavailable.
+	uint32_t queued;		// Full batches waiting to be written.
+};
+
+
+class InfluxBatcher {
+	struct Batch {
+		string lines;
+		uint32_t points;
+		
+		Batch() : points(0) { }
+	};
+	
+	InfluxClient* influx;
+	string name;
+	string params;
+	uint32_t maxPoints;
+	uint32_t maxBytes;
+	uint32_t maxAge;		// ms
+	uint32_t maxQueued;		// batches
+	
+	Batch current;
+	chrono::steady_clock::time_point started;
+	deque<Batch> queue;
+	mutex batchMutex;
+	condition_variable cv;
+	condition_variable spaceCv;
+	vector<thread> writers;
+	bool running;
+	bool block;
+	bool replaying;
+	
+	Spool* spool;
+	uint32_t replayRate;	// points/s
+	chrono::steady_clock::time_point nextReplay;
+	uint64_t lastReplayed;
+	uint64_t lastWritten;
+	
+	atomic<uint64_t> statPoints;
+	atomic<uint64_t> statWritten;
+	atomic<uint64_t> statRejected;
+	atomic<uint64_t> statDropped;
+	atomic<uint64_t> statBatches;
+	atomic<uint64_t> statRetries;
+	
+	void seal(Batch &evicted);
+	void evict(Batch &batch);
+	void run(uint32_t id);
+	bool send(Batch &batch);
+	void replay(unique_lock<mutex> &lk);
+	void report();
+
+public:
+	InfluxBatcher(InfluxClient* influx, uint32_t maxPoints = 5000, uint32_t maxBytes = 1048576,
+											uint32_t maxAgeMs = 1000, uint32_t maxQueued = 64);
+	~InfluxBatcher();
+	
+	void setName(const string &name);
+	void setRetentionPolicy(const string &rp);
+	void setSpool(Spool* spool, uint32_t replayRate);
+	void setBlocking(bool block);
+	void start(uint32_t writers = 1);
+	void stop();
+	void add(const char* line, size_t len, uint64_t timestamp);
+	void add(const string &line, uint64_t timestamp) { add(line.data(), line.length(), timestamp); }
+	BatchStats getStats();
+	
+	static uint64_t now();
+};
+
+#endif
@@ -0,0 +1,267 @@
+/*
+	gorilla.h - Time series compression for the archive.
+	
+	Revision 0
+	
+	Notes:
+			- Follows the scheme of Facebook's Gorilla paper: timestamps are
+				stored as delta-of-deltas with variable-length buckets, values
+				as the XOR with the previous value, storing only its meaningful
+				bits.
+			- Timestamps are stored in units of the block's resolution, so
+				regular samples with some jitter in their receive time mostly
+				compress to a single bit.
+			- Data is written as blocks, each with a fixed header holding the
+				time range and summary statistics, followed by the compressed
+				bit stream padded to a multiple of 8 bytes. Blocks can be read
+				in place from a memory-mapped file.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#pragma once
+#ifndef GORILLA_H
+#define GORILLA_H
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+
+
+// Header of a block of compressed points.
+struct GorillaBlock {
+	uint32_t magic;
+	uint32_t count;			// Number of points.
+	uint32_t bytes;			// Size of the bit stream, including padding.
+	uint32_t resolution;	// Timestamp unit (ms).
+	int64_t first;			// Time of the first point (ms).
+	int64_t last;			// Time of the last point (ms).
+	double min;
+	double max;
+	double sum;
+};
+
+static const uint32_t gorillaMagic = 0x4b4c4247;	// 'GBLK'
+
+
+class GorillaEncoder {
+	std::string data;
+	uint64_t bits;			// Pending bits, not yet in 'data'.
+	uint32_t bitCount;
+	GorillaBlock header;
+	int64_t prevUnits;
+	int64_t prevDelta;
+	uint64_t prevValue;
+	uint32_t prevLeading;
+	uint32_t prevTrailing;
+	
+	// Append the lowest 'n' (<= 32) bits of 'value', most significant first.
+	void write(uint64_t value, uint32_t n) {
+		if (n == 0) { return; }
+		bits = (bits << n) | (value & (((uint64_t) 1 << n) - 1));
+		bitCount += n;
+		while (bitCount >= 8) {
+			bitCount -= 8;
+			data += (char) (bits >> bitCount);
+		}
+	}
+	
+	void write64(uint64_t value, uint32_t n) {
+		if (n > 32) {
+			write(value >> 32, n - 32);
+			n = 32;
+		}
+		
+		write(value, n);
+	}
+
+public:
+	GorillaEncoder(uint32_t resolution = 1) {
+		if (resolution == 0) { resolution = 1; }
+		memset(&header, 0, sizeof(header));
+		header.magic = gorillaMagic;
+		header.resolution = resolution;
+		bits = 0;
+		bitCount = 0;
+		prevUnits = 0;
+		prevDelta = 0;
+		prevValue = 0;
+		prevLeading = 0;
+		prevTrailing = 0;
+	}
+	
+	// --- ADD ---
+	// Add a point. Times (ms) must not decrease.
+	void add(int64_t time, double value) {
+		int64_t units = time / header.resolution;
+		uint64_t v;
+		memcpy(&v, &value, sizeof(v));
+		if (header.count == 0) {
+			header.first = units * header.resolution;
+			header.min = value;
+			header.max = value;
+			write64(v, 64);
+		}
+		else {
+			// Timestamp.
+			int64_t delta = units - prevUnits;
+			int64_t dod = delta - prevDelta;
+			if (dod == 0) { write(0, 1); }
+			else if (dod >= -63 && dod <= 64) { write(2, 2); write(dod + 63, 7); }
+			else if (dod >= -255 && dod <= 256) { write(6, 3); write(dod + 255, 9); }
+			else if (dod >= -2047 && dod <= 2048) { write(14, 4); write(dod + 2047, 12); }
+			else { write(15, 4); write((uint32_t) (int32_t) dod, 32); }
+			prevDelta = delta;
+			
+			// Value.
+			uint64_t x = v ^ prevValue;
+			if (x == 0) {
+				write(0, 1);
+			}
+			else {
+				uint32_t leading = __builtin_clzll(x);
+				uint32_t trailing = __builtin_ctzll(x);
+				if (leading > 31) { leading = 31; }
+				if (header.count > 1 && leading >= prevLeading && trailing >= prevTrailing) {
+					write(2, 2);
+					write64(x >> prevTrailing, 64 - prevLeading - prevTrailing);
+				}
+				else {
+					uint32_t meaningful = 64 - leading - trailing;
+					write(3, 2);
+					write(leading, 5);
+					write(meaningful & 63, 6);
+					write64(x >> trailing, meaningful);
+					prevLeading = leading;
+					prevTrailing = trailing;
+				}
+			}
+			
+			if (value < header.min) { header.min = value; }
+			if (value > header.max) { header.max = value; }
+		}
+		
+		prevUnits = units;
+		prevValue = v;
+		header.last = units * header.resolution;
+		header.sum += value;
+		++header.count;
+	}
+	
+	// --- FINISH ---
+	// Write the block (header and padded bit stream) into 'out' and reset the
+	// encoder for the next block.
+	void finish(std::string &out) {
+		if (bitCount > 0) {
+			data += (char) (bits << (8 - bitCount));
+			bitCount = 0;
+		}
+		
+		data.append((8 - data.length() % 8) % 8, '\0');
+		header.bytes = data.length();
+		out.assign((const char*) &header, sizeof(header));
+		out += data;
+		
+		uint32_t resolution = header.resolution;
+		data.clear();
+		bits = 0;
+		memset(&header, 0, sizeof(header));
+		header.magic = gorillaMagic;
+		header.resolution = resolution;
+		prevDelta = 0;
+		prevLeading = 0;
+		prevTrailing = 0;
+	}
+	
+	uint32_t count() const { return header.count; }
+	int64_t first() const { return header.first; }
+	size_t size() const { return data.length(); }
+};
+
+
+class GorillaDecoder {
+	const unsigned char* data;
+	size_t length;			// bits
+	size_t pos;				// bits
+	uint32_t remaining;
+	uint32_t resolution;
+	int64_t units;
+	int64_t delta;
+	uint64_t value;
+	uint32_t leading;
+	uint32_t trailing;
+	bool started;
+	
+	// Read 'n' (<= 64) bits, a byte at a time.
+	uint64_t read(uint32_t n) {
+		uint64_t out = 0;
+		while (n > 0) {
+			if (pos >= length) { return out << n; }
+			uint32_t bit = pos & 7;
+			uint32_t take = (8 - bit < n) ? 8 - bit : n;
+			uint32_t byte = data[pos >> 3];
+			out = (out << take) | ((byte >> (8 - bit - take)) & ((1u << take) - 1));
+			pos += take;
+			n -= take;
+		}
+		
+		return out;
+	}
+
+public:
+	// The header must be followed by its bit stream.
+	GorillaDecoder(const GorillaBlock* block) {
+		data = (const unsigned char*) (block + 1);
+		length = (size_t) block->bytes * 8;
+		pos = 0;
+		remaining = block->count;
+		resolution = block->resolution ? block->resolution : 1;
+		units = block->first / resolution;
+		delta = 0;
+		value = 0;
+		leading = 0;
+		trailing = 0;
+		started = false;
+	}
+	
+	// --- NEXT ---
+	// Decode the next point. Returns false at the end of the block.
+	bool next(int64_t &time, double &out) {
+		if (remaining == 0) { return false; }
+		--remaining;
+		if (!started) {
+			started = true;
+			value = read(64);
+		}
+		else {
+			int64_t dod = 0;
+			if (read(1)) {
+				if (!read(1)) { dod = (int64_t) read(7) - 63; }
+				else if (!read(1)) { dod = (int64_t) read(9) - 255; }
+				else if (!read(1)) { dod = (int64_t) read(12) - 2047; }
+				else { dod = (int32_t) (uint32_t) read(32); }
+			}
+			
+			delta += dod;
+			units += delta;
+			
+			if (read(1)) {
+				if (read(1)) {
+					leading = read(5);
+					uint32_t meaningful = read(6);
+					if (meaningful == 0) { meaningful = 64; }
+					trailing = 64 - leading - meaningful;
+				}
+				
+				value ^= read(64 - leading - trailing) << trailing;
+			}
+		}
+		
+		time = units * resolution;
+		memcpy(&out, &value, sizeof(out));
+		return true;
+	}
+};
+
+#endif
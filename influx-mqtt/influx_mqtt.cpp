@@ -18,16 +18,64 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <chrono>
 
 using namespace std;
 
 #include <Poco/Util/IniFileConfiguration.h>
 #include <Poco/AutoPtr.h>
+#include <Poco/StringTokenizer.h>
 
 using namespace Poco::Util;
 using namespace Poco;
 
 
+// Interval between pipeline statistics reports.
+static const int statsInterval = 60; // s
+
+
+// --- CREATE BATCHERS ---
+// Create and start a batcher for each endpoint of the cluster, each with its 
+// own spool for points which can't be delivered while the endpoint is down. 
+// With several endpoints the spools are kept in per-endpoint subdirectories.
+static void createBatchers(AutoPtr<IniFileConfiguration> &config, InfluxCluster &influx,
+							const string &spoolDir, const string &rp, const string &label, 
+							uint32_t writers, vector<InfluxBatcher*> &batchers, 
+							vector<Spool*> &spools) {
+	for (uint32_t i = 0; i < influx.size(); ++i) {
+		InfluxClient* client = influx.getClient(i);
+		string endpoint = client->getHost() + ":" + to_string(client->getPort());
+		string dir = spoolDir;
+		if (influx.size() > 1) {
+			string sub = endpoint;
+			replace(sub.begin(), sub.end(), ':', '_');
+			dir += "/" + sub;
+		}
+		
+		spools.push_back(new Spool(dir, config->getUInt64("Spool.segment_size", 16777216),
+											config->getUInt64("Spool.max_size", 1073741824)));
+		batchers.push_back(new InfluxBatcher(client, config->getInt("Influx.batch_size", 5000),
+											config->getInt("Influx.batch_bytes", 1048576),
+											config->getInt("Influx.batch_age", 1000),
+											config->getInt("Influx.batch_queue", 64)));
+		InfluxBatcher &batcher = *batchers.back();
+		string name = label;
+		if (influx.size() > 1) { name += (name.empty() ? "" : " ") + endpoint; }
+		if (!name.empty()) { batcher.setName(name); }
+		batcher.setRetentionPolicy(rp);
+		if (!spoolDir.empty() && spools.back()->open()) {
+			batcher.setSpool(spools.back(), config->getInt("Spool.replay_rate", 10000));
+		}
+		
+		batcher.setBlocking(config->getString("Pipeline.batch_policy", "drop") == "block");
+		batcher.start(writers);
+	}
+}
+
+
 int main(int argc, char* argv[]) {
 	cout << "Starting MQTT to InfluxDB-REST listener...\n";
 	
@@ -44,27 +92,165 @@ int main(int argc, char* argv[]) {
 	AutoPtr<IniFileConfiguration> config(new IniFileConfiguration(configFile));
 	string mqtt_host = config->getString("MQTT.host", "localhost");
 	int mqtt_port = config->getInt("MQTT.port", 1883);
-	string topics = config->getString("MQTT.topics");
+	string topics = config->getString("MQTT.topics", "");
 	
 	string influx_host = config->getString("Influx.host", "localhost");
+	string influx_hosts = config->getString("Influx.hosts", influx_host);
 	int influx_port = config->getInt("Influx.port", 8086);
 	string influx_sec = config->getString("Influx.secure", "false");
 	string influx_db = config->getString("Influx.db", "test");
 	
-	MtH mth("MQTT-to-InfluxDB", mqtt_host, mqtt_port, topics, influx_host, 
-											influx_port, influx_db, influx_sec);
+	// Compile the topic mapping. Topics in the plain 'topics' list are mapped
+	// onto the series named after their last level, rules in the Mapping
+	// section can use wildcards and their own line protocol template.
+	TopicMapper mapper;
+	string error;
+	StringTokenizer st(topics, ",", StringTokenizer::TOK_TRIM | StringTokenizer::TOK_IGNORE_EMPTY);
+	for (StringTokenizer::Iterator it = st.begin(); it != st.end(); ++it) {
+		string topic = string(*it);
+		StringTokenizer st1(topic, "/", StringTokenizer::TOK_TRIM | StringTokenizer::TOK_IGNORE_EMPTY);
+		string series = st1[st1.count() - 1]; // Get last item.
+		if (!mapper.addRule(topic, topic, series + ",location={p0} value={p1}", error)) {
+			cerr << "Invalid topic: " << error << "\n";
+			return 1;
+		}
+	}
+	
+	IniFileConfiguration::Keys rules;
+	config->keys("Mapping", rules);
+	for (unsigned int i = 0; i < rules.size(); ++i) {
+		if (!mapper.addRule(rules[i], config->getString("Mapping." + rules[i]), error)) {
+			cerr << "Invalid mapping rule: " << error << "\n";
+			return 1;
+		}
+	}
 	
-	cout << "Created listener, entering loop...\n";
+	if (mapper.getRuleCount() == 0) {
+		cerr << "No topics or mapping rules configured.\n";
+		return 1;
+	}
 	
-	while(1) {
-		rc = mth.loop();
-		if (rc){
-			cout << "Disconnected. Trying to reconnect...\n";
-			mth.reconnect();
+	InfluxCluster influx(influx_hosts, influx_port, influx_db, influx_sec == "true",
+											config->getInt("Influx.pool_size", 4),
+											config->getInt("Influx.replication", 1));
+	if (influx.size() == 0) {
+		cerr << "No Influx hosts configured.\n";
+		return 1;
+	}
+	
+	influx.setBreaker(config->getInt("Influx.breaker_threshold", 5), 
+											config->getInt("Influx.breaker_cooldown", 10000));
+	
+	// Optional archive of all points on local disk. If exclusive, nothing is
+	// written to InfluxDB.
+	Archive* archive = 0;
+	string archive_dir = config->getString("Archive.dir", "");
+	bool archive_only = false;
+	if (!archive_dir.empty()) {
+		archive = new Archive(archive_dir, config->getInt("Archive.resolution", 1000),
+											config->getInt("Archive.block_points", 4096),
+											config->getInt("Archive.max_age", 3600));
+		if (!archive->open()) { return 1; }
+		archive->start();
+		archive_only = config->getBool("Archive.exclusive", false);
+		cout << "Archiving points in " << archive_dir << ".\n";
+	}
+	
+	string spool_dir = config->getString("Spool.dir", "");
+	vector<Spool*> spools;
+	vector<InfluxBatcher*> batchers;
+	if (!archive_only) {
+		createBatchers(config, influx, spool_dir, "", "", config->getInt("Pipeline.writers", 4), 
+																batchers, spools);
+		cout << "Writing to " << influx.size() << " Influx endpoints, replication " 
+				<< influx.getReplicas() << ".\n";
+	}
+	
+	// Optional rollups of points over time windows. These go into their own
+	// retention policy if one is set, else alongside the other points.
+	Rollup* rollup = 0;
+	vector<InfluxBatcher*> rollupBatchers = batchers;
+	uint32_t rollup_window = config->getInt("Rollup.window", 0);
+	if (rollup_window > 0 && !archive_only) {
+		string rollup_rp = config->getString("Rollup.retention", "");
+		if (!rollup_rp.empty()) {
+			rollupBatchers.clear();
+			createBatchers(config, influx, spool_dir.empty() ? spool_dir : spool_dir + "/rollup", 
+											rollup_rp, "rollup", 1, rollupBatchers, spools);
+		}
+		
+		RollupWriter writer = [&influx, &rollupBatchers](const string &line, uint64_t time) {
+			uint32_t shards[InfluxCluster::maxReplicas];
+			uint32_t count = influx.route(InfluxCluster::seriesHash(line.data(), line.length()), 
+																shards);
+			for (uint32_t i = 0; i < count; ++i) {
+				rollupBatchers[shards[i]]->add(line, time);
+			}
+		};
+		
+		rollup = new Rollup(rollup_window, config->getInt("Rollup.grace", 35), writer);
+		vector<string> measurements;
+		StringTokenizer st(config->getString("Rollup.measurements", ""), ",", 
+								StringTokenizer::TOK_TRIM | StringTokenizer::TOK_IGNORE_EMPTY);
+		for (StringTokenizer::Iterator it = st.begin(); it != st.end(); ++it) {
+			measurements.push_back(*it);
 		}
+		
+		rollup->setMeasurements(measurements);
+		rollup->start();
+		cout << "Rolling up points over " << rollup_window << " s windows.\n";
+	}
+	
+	// Optional suppression of messages redelivered by the broker.
+	DedupWindow* dedup = 0;
+	uint32_t dedup_window = config->getInt("Dedup.window", 1000);
+	if (dedup_window > 0) {
+		dedup = new DedupWindow(dedup_window, config->getInt("Dedup.capacity", 65536));
+		cout << "Dropping duplicate messages within " << dedup_window << " ms.\n";
+	}
+	
+	MtH mth("MQTT-to-InfluxDB", mqtt_host, mqtt_port, &mapper, &influx, batchers,
+											config->getInt("Pipeline.queue_size", 65536),
+											config->getString("Pipeline.queue_policy", "drop") == "block");
+	if (rollup) { mth.setRollup(rollup, config->getString("Rollup.mode", "replace") == "both"); }
+	if (archive) { mth.setArchive(archive); }
+	if (dedup) { mth.setDedup(dedup); }
+	mth.setBatchTopic(config->getString("MQTT.batch_topic", "nsa/batch"));
+	mth.start(config->getInt("Pipeline.parsers", 0));
+	
+	cout << "Created listener, starting network thread...\n";
+	
+	// The network thread takes care of reconnecting. This thread only reports
+	// on the pipeline.
+	rc = mth.loop_start();
+	if (rc != MOSQ_ERR_SUCCESS) {
+		cerr << "Failed to start the MQTT network thread: " << rc << "\n";
+		return 1;
+	}
+	
+	while(1) {
+		this_thread::sleep_for(chrono::seconds(statsInterval));
+		mth.report(statsInterval);
+		if (rollup) { rollup->report(statsInterval); }
+		if (archive) { archive->report(statsInterval); }
+		if (dedup) { dedup->report(statsInterval, "Dedup"); }
 	}
 	
 	cout << "Cleanup...\n";
+	
+	mth.stop();
+	delete dedup;
+	delete archive;
+	delete rollup;
+	if (rollupBatchers != batchers) {
+		batchers.insert(batchers.end(), rollupBatchers.begin(), rollupBatchers.end());
+	}
+	
+	for (unsigned int i = 0; i < batchers.size(); ++i) {
+		batchers[i]->stop();
+		delete batchers[i];
+		delete spools[i];
+	}
 
 	mosqpp::lib_cleanup();
 
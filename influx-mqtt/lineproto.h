@@ -0,0 +1,76 @@
+/*
+	lineproto.h - Helpers for taking apart lines of InfluxDB line protocol.
+	
+	Revision 0
+	
+	Notes:
+			- Lines are expected without timestamp, as produced by the topic
+				mapper.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#pragma once
+#ifndef LINEPROTO_H
+#define LINEPROTO_H
+
+#include <utility>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+
+
+// --- LP FIND ---
+// Find the first unescaped occurrence of one of the characters, skipping over
+// quoted strings. Returns 'len' if not found.
+inline size_t lpFind(const char* line, size_t start, size_t len, const char* chars) {
+	bool quoted = false;
+	for (size_t i = start; i < len; ++i) {
+		if (line[i] == '\\') { ++i; continue; }
+		if (line[i] == '"') { quoted = !quoted; continue; }
+		if (quoted) { continue; }
+		for (const char* c = chars; *c; ++c) {
+			if (line[i] == *c) { return i; }
+		}
+	}
+	
+	return len;
+}
+
+
+// --- LP NUMERIC FIELDS ---
+// Split a line into its series key (measurement and tag set), ending at
+// 'keyEnd', and its numeric (float or integer) fields. Field names are
+// returned as offset and length. Other fields are skipped. Returns the number
+// of numeric fields found, up to 'max'.
+inline uint32_t lpNumericFields(const char* str, size_t len, size_t &keyEnd,
+								std::pair<size_t, size_t>* names, double* values, uint32_t max) {
+	keyEnd = lpFind(str, 0, len, " ");
+	if (keyEnd == len) { return 0; }
+	
+	uint32_t count = 0;
+	size_t pos = keyEnd + 1;
+	while (pos < len && count < max) {
+		size_t end = lpFind(str, pos, len, ", ");
+		size_t eq = lpFind(str, pos, end, "=");
+		if (eq < end && eq > pos && eq + 1 < end) {
+			const char* v = str + eq + 1;
+			char* vend;
+			double value = strtod(v, &vend);
+			if (vend == str + end || (vend + 1 == str + end && (*vend == 'i' || *vend == 'u'))) {
+				if (vend != v) {
+					names[count] = std::pair<size_t, size_t>(pos, eq - pos);
+					values[count++] = value;
+				}
+			}
+		}
+		
+		if (end == len || str[end] == ' ') { break; }
+		pos = end + 1;
+	}
+	
+	return count;
+}
+
+#endif
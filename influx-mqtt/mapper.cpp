@@ -0,0 +1,422 @@
+/*
+	mapper.cpp - Implementation of the topic to line protocol mapper.
+	
+	Revision 0
+	
+	Notes:
+			- Substituted values are escaped as line protocol requires for the
+				part of the template they appear in: spaces and commas in the
+				measurement, additionally equal signs in tag and field keys, and
+				double quotes and backslashes in string field values.
+			- Messages with control characters (including tabs and newlines) in
+				a substituted value are rejected, as are unquoted field values
+				which aren't a number (optionally with an 'i' or 'u' suffix) or a
+				boolean.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#include "mapper.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+
+
+// Limits on the number of topic levels and payload fields looked at.
+static const uint32_t maxLevels = 32;
+static const uint32_t maxFields = 32;
+
+
+// --- ESCAPE MASK ---
+// Bit mask of the characters to escape. Only characters below 64 are needed.
+static uint64_t escapeMask(const char* chars) {
+	uint64_t mask = 0;
+	for (const char* c = chars; *c; ++c) { mask |= (uint64_t) 1 << *c; }
+	return mask;
+}
+
+
+// --- VALID NUMBER ---
+// Whether the value is a valid unquoted field value: a float, an integer with
+// an 'i' or 'u' suffix, or a boolean. With 'integer' set, the template adds the
+// suffix and the value has to be a plain integer.
+static bool validNumber(const char* str, uint32_t len, bool integer) {
+	uint32_t i = 0;
+	if (integer) {
+		if (i < len && (str[i] == '-' || str[i] == '+')) { ++i; }
+		if (i == len) { return false; }
+		for (; i < len; ++i) {
+			if (!isdigit((unsigned char) str[i])) { return false; }
+		}
+		
+		return true;
+	}
+	
+	static const char* booleans[] = { "t", "T", "true", "True", "TRUE", 
+										"f", "F", "false", "False", "FALSE" };
+	for (unsigned int i = 0; i < sizeof(booleans) / sizeof(booleans[0]); ++i) {
+		if (strlen(booleans[i]) == len && memcmp(booleans[i], str, len) == 0) { return true; }
+	}
+	
+	if (i < len && (str[i] == '-' || str[i] == '+')) { ++i; }
+	
+	uint32_t digits = 0;
+	while (i < len && isdigit((unsigned char) str[i])) { ++i; ++digits; }
+	if (i < len && (str[i] == 'i' || str[i] == 'u')) { return digits > 0 && i + 1 == len; }
+	if (i < len && str[i] == '.') {
+		++i;
+		while (i < len && isdigit((unsigned char) str[i])) { ++i; ++digits; }
+	}
+	
+	if (digits == 0) { return false; }
+	if (i < len && (str[i] == 'e' || str[i] == 'E')) {
+		++i;
+		if (i < len && (str[i] == '-' || str[i] == '+')) { ++i; }
+		uint32_t exp = 0;
+		while (i < len && isdigit((unsigned char) str[i])) { ++i; ++exp; }
+		if (exp == 0) { return false; }
+	}
+	
+	return i == len;
+}
+
+
+// --- CONSTRUCTOR ---
+TopicMapper::TopicMapper(char separator) {
+	this->separator = separator;
+	
+	// Root node.
+	nodes.push_back(Node());
+}
+
+
+// --- COMPILE ---
+// Compile a line protocol template into literal and placeholder parts.
+bool TopicMapper::compile(const string &tmpl, vector<Part> &parts, string &error) {
+	// 0: measurement, 1: tag set, 2: field set.
+	int section = 0;
+	bool fieldKey = false;
+	bool quoted = false;
+	string literal;
+	for (size_t i = 0; i < tmpl.length(); ++i) {
+		char c = tmpl[i];
+		if (c == '\\' && i + 1 < tmpl.length()) {
+			literal += c;
+			literal += tmpl[++i];
+			continue;
+		}
+		
+		if (c != '{' || quoted) {
+			if (c == ',' && section == 0) { section = 1; }
+			else if (c == ' ' && section < 2) {
+				section = 2;
+				fieldKey = true;
+			}
+			else if (section == 2) {
+				if (c == '"') { quoted = !quoted; }
+				else if (c == '=' && !quoted) { fieldKey = false; }
+				else if (c == ',' && !quoted) { fieldKey = true; }
+			}
+			
+			if (c != '{') {
+				literal += c;
+				continue;
+			}
+		}
+		
+		size_t end = tmpl.find('}', i);
+		if (end == string::npos) {
+			error = "Unterminated placeholder in '" + tmpl + "'.";
+			return false;
+		}
+		
+		string spec = tmpl.substr(i + 1, end - i - 1);
+		Part part;
+		if (spec == "p") {
+			part.type = Part::PAYLOAD_ALL;
+			part.index = 0;
+		}
+		else if (spec.length() > 1 && (spec[0] == 't' || spec[0] == 'p') &&
+					spec.find_first_not_of("0123456789", 1) == string::npos) {
+			part.type = (spec[0] == 't') ? Part::TOPIC : Part::PAYLOAD;
+			part.index = atoi(spec.c_str() + 1);
+		}
+		else {
+			error = "Unknown placeholder '{" + spec + "}' in '" + tmpl + "'.";
+			return false;
+		}
+		
+		part.value = Part::NAME;
+		part.escape = 0;
+		if (section == 0) { part.escape = escapeMask(", "); }
+		else if (section == 1 || fieldKey) { part.escape = escapeMask(", ="); }
+		else if (quoted) {
+			part.value = Part::STRING;
+			part.escape = escapeMask("\"");
+		}
+		else { part.value = Part::NUMBER; }
+		
+		if (!literal.empty()) {
+			Part lit;
+			lit.type = Part::LITERAL;
+			lit.value = Part::NAME;
+			lit.text.swap(literal);
+			lit.index = 0;
+			lit.escape = 0;
+			parts.push_back(lit);
+		}
+		
+		parts.push_back(part);
+		i = end;
+	}
+	
+	if (!literal.empty()) {
+		Part lit;
+		lit.type = Part::LITERAL;
+		lit.value = Part::NAME;
+		lit.text = literal;
+		lit.index = 0;
+		lit.escape = 0;
+		parts.push_back(lit);
+	}
+	
+	if (section != 2) {
+		error = "Template '" + tmpl + "' has no field set.";
+		return false;
+	}
+	
+	// Field values the template gives an integer suffix.
+	for (size_t i = 0; i + 1 < parts.size(); ++i) {
+		const string &next = parts[i + 1].text;
+		if (parts[i].value == Part::NUMBER && parts[i + 1].type == Part::LITERAL &&
+				(next[0] == 'i' || next[0] == 'u')) {
+			parts[i].value = Part::INTEGER;
+		}
+	}
+	
+	return true;
+}
+
+
+// --- ADD RULE ---
+// Add a rule mapping the topic filter onto the line protocol template.
+bool TopicMapper::addRule(const string &name, const string &filter, const string &tmpl,
+															string &error) {
+	Rule rule;
+	rule.name = name;
+	rule.filter = filter;
+	if (!compile(tmpl, rule.parts, error)) { return false; }
+	
+	// Walk the filter's levels down the trie, adding nodes as needed.
+	uint32_t node = 0;
+	bool hash = false;
+	size_t start = 0;
+	while (start <= filter.length()) {
+		size_t end = filter.find('/', start);
+		if (end == string::npos) { end = filter.length(); }
+		string level = filter.substr(start, end - start);
+		start = end + 1;
+		
+		if (level == "#") {
+			if (end != filter.length()) {
+				error = "'#' must be the last level in '" + filter + "'.";
+				return false;
+			}
+			
+			hash = true;
+			break;
+		}
+		
+		if (level.find_first_of("+#") != string::npos && level != "+") {
+			error = "Wildcards must occupy a whole level in '" + filter + "'.";
+			return false;
+		}
+		
+		int32_t next = -1;
+		if (level == "+") {
+			next = nodes[node].plus;
+		}
+		else {
+			for (unsigned int i = 0; i < nodes[node].children.size(); ++i) {
+				if (nodes[node].children[i].first == level) {
+					next = nodes[node].children[i].second;
+					break;
+				}
+			}
+		}
+		
+		if (next < 0) {
+			next = nodes.size();
+			nodes.push_back(Node());
+			if (level == "+") { nodes[node].plus = next; }
+			else { nodes[node].children.push_back(pair<string, uint32_t>(level, next)); }
+		}
+		
+		node = next;
+	}
+	
+	int32_t &slot = hash ? nodes[node].hashRule : nodes[node].rule;
+	if (slot >= 0) {
+		error = "Rule '" + name + "' has the same topic filter as rule '" + rules[slot].name + "'.";
+		return false;
+	}
+	
+	slot = rules.size();
+	rules.push_back(rule);
+	return true;
+}
+
+
+// Add a rule given as '<topic filter> <template>'.
+bool TopicMapper::addRule(const string &name, const string &definition, string &error) {
+	size_t start = definition.find_first_not_of(" \t");
+	size_t split = definition.find_first_of(" \t", start);
+	size_t tmpl = definition.find_first_not_of(" \t", split);
+	if (start == string::npos || split == string::npos || tmpl == string::npos) {
+		error = "Rule '" + name + "' needs a topic filter and a template.";
+		return false;
+	}
+	
+	size_t end = definition.find_last_not_of(" \t\r");
+	return addRule(name, definition.substr(start, split - start),
+						definition.substr(tmpl, end - tmpl + 1), error);
+}
+
+
+// --- GET FILTERS ---
+// The topic filters to subscribe to.
+vector<string> TopicMapper::getFilters() const {
+	vector<string> filters;
+	for (unsigned int i = 0; i < rules.size(); ++i) {
+		filters.push_back(rules[i].filter);
+	}
+	
+	return filters;
+}
+
+
+// --- MATCH ---
+// Find the most specific rule matching the topic levels from 'level' onwards.
+int32_t TopicMapper::match(uint32_t node, const char* topic, const Span* levels,
+									uint32_t count, uint32_t level) const {
+	const Node &n = nodes[node];
+	if (level == count) {
+		return (n.rule >= 0) ? n.rule : n.hashRule;
+	}
+	
+	const char* str = topic + levels[level].first;
+	uint32_t len = levels[level].second;
+	for (unsigned int i = 0; i < n.children.size(); ++i) {
+		const string &child = n.children[i].first;
+		if (child.length() == len && child.compare(0, len, str, len) == 0) {
+			int32_t res = match(n.children[i].second, topic, levels, count, level + 1);
+			if (res >= 0) { return res; }
+			break;
+		}
+	}
+	
+	if (n.plus >= 0) {
+		int32_t res = match(n.plus, topic, levels, count, level + 1);
+		if (res >= 0) { return res; }
+	}
+	
+	return n.hashRule;
+}
+
+
+// --- MATCHES ---
+// Whether a rule matches the topic.
+bool TopicMapper::matches(const string &topic) const {
+	Span levels[maxLevels];
+	uint32_t levelCount = 0;
+	size_t start = 0;
+	for (size_t i = 0; i <= topic.length(); ++i) {
+		if (i < topic.length() && topic[i] != '/') { continue; }
+		if (levelCount == maxLevels) { return false; }
+		levels[levelCount++] = Span(start, i - start);
+		start = i + 1;
+	}
+	
+	return match(0, topic.data(), levels, levelCount, 0) >= 0;
+}
+
+
+// --- MAP ---
+// Map a message onto a line of line protocol (without timestamp). The line's
+// buffer is reused, so it doesn't allocate once it's grown large enough.
+MapResult TopicMapper::map(const char* topic, size_t topicLen, const char* payload,
+											size_t payloadLen, string &line) const {
+	Span levels[maxLevels];
+	uint32_t levelCount = 0;
+	size_t start = 0;
+	for (size_t i = 0; i <= topicLen; ++i) {
+		if (i < topicLen && topic[i] != '/') { continue; }
+		if (levelCount == maxLevels) { return MAP_NO_RULE; }
+		levels[levelCount++] = Span(start, i - start);
+		start = i + 1;
+	}
+	
+	int32_t ruleIndex = match(0, topic, levels, levelCount, 0);
+	if (ruleIndex < 0) { return MAP_NO_RULE; }
+	
+	Span fields[maxFields];
+	uint32_t fieldCount = 0;
+	start = 0;
+	for (size_t i = 0; i <= payloadLen && fieldCount < maxFields; ++i) {
+		if (i < payloadLen && payload[i] != separator) { continue; }
+		fields[fieldCount++] = Span(start, i - start);
+		start = i + 1;
+	}
+	
+	const Rule &rule = rules[ruleIndex];
+	line.clear();
+	for (unsigned int i = 0; i < rule.parts.size(); ++i) {
+		const Part &part = rule.parts[i];
+		const char* str;
+		uint32_t len;
+		if (part.type == Part::LITERAL) {
+			line += part.text;
+			continue;
+		}
+		else if (part.type == Part::TOPIC) {
+			if (part.index >= levelCount) { return MAP_INVALID; }
+			str = topic + levels[part.index].first;
+			len = levels[part.index].second;
+		}
+		else if (part.type == Part::PAYLOAD) {
+			if (part.index >= fieldCount) { return MAP_INVALID; }
+			str = payload + fields[part.index].first;
+			len = fields[part.index].second;
+		}
+		else {
+			str = payload;
+			len = payloadLen;
+		}
+		
+		if (len == 0) { return MAP_INVALID; }
+		if (part.value == Part::NUMBER || part.value == Part::INTEGER) {
+			if (!validNumber(str, len, part.value == Part::INTEGER)) { return MAP_INVALID; }
+			line.append(str, len);
+			continue;
+		}
+		
+		// Copy runs of characters which don't need escaping in one go.
+		uint32_t run = 0;
+		for (uint32_t j = 0; j < len; ++j) {
+			unsigned char ch = str[j];
+			if (ch < 32 || ch == 127) { return MAP_INVALID; }
+			bool special = (ch < 64) ? ((part.escape >> ch) & 1) :
+										(ch == '\\' && part.value == Part::STRING);
+			if (!special) { continue; }
+			line.append(str + run, j - run);
+			line += '\\';
+			run = j;
+		}
+		
+		line.append(str + run, len - run);
+	}
+	
+	return MAP_OK;
+}
@@ -0,0 +1,118 @@
+/*
+	mapper.h - Header file for the topic to line protocol mapper.
+	
+	Revision 0
+	
+	Notes:
+			- Each rule pairs an MQTT topic filter (with '+' and '#' wildcards)
+				with a line protocol template. Templates refer to topic levels
+				as {t0}, {t1}, ..., to payload fields as {p0}, {p1}, ... and to
+				the whole payload as {p}.
+			- Rules are compiled once into a trie of topic levels and a list
+				of template parts, so mapping a message involves no parsing of
+				the configuration and no allocations. Topic and payload can be
+				mapped straight from the buffers of the MQTT library.
+			- When several rules match, the most specific one wins: a literal
+				level beats '+', which beats '#'.
+			- Substituted values are checked against the part of the line they
+				end up in, so that a payload can't inject extra fields, tags or
+				lines: field values have to be numbers or booleans, unless the
+				template quotes them as strings.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#pragma once
+#ifndef MAPPER_H
+#define MAPPER_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+using namespace std;
+
+
+enum MapResult {
+	MAP_OK = 0,
+	MAP_NO_RULE,		// No rule matches the topic.
+	MAP_INVALID			// The payload lacks a field used by the template, or a value
+						// isn't valid where it's substituted.
+};
+
+
+class TopicMapper {
+	struct Part {
+		enum Type {
+			LITERAL = 0,
+			TOPIC,
+			PAYLOAD,
+			PAYLOAD_ALL
+		};
+		
+		// What the substituted value is in the line.
+		enum Value {
+			NAME = 0,		// Measurement, tag key or value, or field key.
+			NUMBER,			// Unquoted field value: number or boolean.
+			INTEGER,		// Unquoted field value followed by an 'i' or 'u' suffix.
+			STRING			// Quoted field value.
+		};
+		
+		Type type;
+		Value value;
+		string text;
+		uint32_t index;
+		uint64_t escape;	// Characters (< 64) to escape in the substituted value.
+	};
+	
+	struct Rule {
+		string name;
+		string filter;
+		vector<Part> parts;
+	};
+	
+	struct Node {
+		vector<pair<string, uint32_t> > children;
+		int32_t plus;		// Child node for '+', or -1.
+		int32_t rule;		// Rule ending at this node, or -1.
+		int32_t hashRule;	// Rule with '#' at this level, or -1.
+		
+		Node() : plus(-1), rule(-1), hashRule(-1) { }
+	};
+	
+	// Offset and length of a topic level or payload field. Left uninitialised
+	// by default, as arrays of these live on the stack of map().
+	struct Span {
+		uint32_t first;
+		uint32_t second;
+		
+		Span() { }
+		Span(uint32_t first, uint32_t second) : first(first), second(second) { }
+	};
+	
+	vector<Rule> rules;
+	vector<Node> nodes;
+	char separator;
+	
+	bool compile(const string &tmpl, vector<Part> &parts, string &error);
+	int32_t match(uint32_t node, const char* topic, const Span* levels, uint32_t count,
+														uint32_t level) const;
+
+public:
+	TopicMapper(char separator = ';');
+	
+	bool addRule(const string &name, const string &filter, const string &tmpl, string &error);
+	bool addRule(const string &name, const string &definition, string &error);
+	vector<string> getFilters() const;
+	size_t getRuleCount() const { return rules.size(); }
+	bool matches(const string &topic) const;
+	MapResult map(const char* topic, size_t topicLen, const char* payload, size_t payloadLen,
+														string &line) const;
+	MapResult map(const string &topic, const string &payload, string &line) const {
+		return map(topic.data(), topic.length(), payload.data(), payload.length(), line);
+	}
+};
+
+#endif
@@ -16,32 +16,27 @@
 
 //#include <ctime>
 #include <iostream>
+#include <cstring>
 
 using namespace std;
 
-#include <Poco/Net/HTTPRequest.h>
-#include <Poco/Net/HTTPResponse.h>
-#include <Poco/StringTokenizer.h>
-#include <Poco/String.h>
-
-using namespace Poco;
-
 
 // --- CONSTRUCTOR ---
-MtH::MtH(string clientId, string host, int port, string topics, string influxHost, 
-			int influxPort, string influxDb, string influx_sec) : mosquittopp(clientId.c_str()) {
-	this->topics  = topics;
-	this->influxDb = influxDb;
-	if (influx_sec == "true") { 
-		cout << "Connecting with HTTPS..." << std::endl;
-		influxClient = new Net::HTTPSClientSession(influxHost, influxPort);
-		secure = true; 
-	} 
-	else {
-		cout << "Connecting with HTTP..." << std::endl;
-		influxClient = new Net::HTTPClientSession(influxHost, influxPort);
-		secure = false; 
-	}
+MtH::MtH(string clientId, string host, int port, TopicMapper* mapper, InfluxCluster* cluster, 
+						const vector<InfluxBatcher*> &batchers, uint32_t queueSize, bool block) : 
+						mosquittopp(clientId.c_str()), queue(queueSize) {
+	this->mapper = mapper;
+	this->cluster = cluster;
+	this->batchers = batchers;
+	this->block = block;
+	rollup = 0;
+	keepRaw = true;
+	archive = 0;
+	dedup = 0;
+	statParsed = 0;
+	statInvalid = 0;
+	lastReceived = 0;
+	lastParsed = 0;
 	
 	int keepalive = 60;
 	connect(host.c_str(), port, keepalive);
@@ -50,7 +45,82 @@ MtH::MtH(string clientId, string host, int port, string topics, string influxHos
 
 // --- DECONSTRUCTOR ---
 MtH::~MtH() {
-	delete influxClient;
+	stop();
+}
+
+
+// --- SET ROLLUP ---
+// Aggregate points over time windows before writing them. Points which are 
+// aggregated are only written as-is if 'keepRaw' is set. Call before start().
+void MtH::setRollup(Rollup* rollup, bool keepRaw) {
+	this->rollup = rollup;
+	this->keepRaw = keepRaw;
+}
+
+
+// --- SET ARCHIVE ---
+// Also write all points to the archive. Call before start().
+void MtH::setArchive(Archive* archive) {
+	this->archive = archive;
+}
+
+
+// --- SET DEDUP ---
+// Drop messages redelivered by the broker. Call before start().
+void MtH::setDedup(DedupWindow* dedup) {
+	this->dedup = dedup;
+}
+
+
+// --- SET BATCH TOPIC ---
+// Topic on which nodes publish batches of readings. Call before start().
+void MtH::setBatchTopic(const string &topic) {
+	batchTopic = topic;
+}
+
+
+// --- START ---
+// Start the parser workers. Zero starts one per core.
+void MtH::start(uint32_t parsers) {
+	if (parsers == 0) { parsers = thread::hardware_concurrency(); }
+	if (parsers == 0) { parsers = 1; }
+	
+	cout << "Starting " << parsers << " parser workers.\n";
+	for (uint32_t i = 0; i < parsers; ++i) {
+		workers.push_back(thread(&MtH::work, this));
+	}
+}
+
+
+// --- STOP ---
+// Stop the MQTT network thread, then let the workers drain the queue.
+void MtH::stop() {
+	if (workers.empty()) { return; }
+	
+	disconnect();
+	loop_stop();
+	queue.close();
+	for (unsigned int i = 0; i < workers.size(); ++i) {
+		workers[i].join();
+	}
+	
+	workers.clear();
+}
+
+
+// --- REPORT ---
+// Report the depth and throughput of the message queue and the parser workers
+// over the past interval (in seconds).
+void MtH::report(uint32_t interval) {
+	if (interval == 0) { interval = 1; }
+	uint64_t received = queue.getPushed();
+	uint64_t parsed = statParsed;
+	cout << "Pipeline: " << (received - lastReceived) / interval << " msg/s received, queue "
+			<< queue.size() << "/" << queue.capacity() << ", " << queue.getDropped() 
+			<< " dropped; " << (parsed - lastParsed) / interval << " msg/s parsed, "
+			<< statInvalid << " invalid.\n";
+	lastReceived = received;
+	lastParsed = parsed;
 }
 
 
@@ -60,17 +130,18 @@ void MtH::on_connect(int rc) {
 	
 	// Check code.
 	if (rc == 0) {
-		// Subscribe to desired topics.
-		StringTokenizer st(topics, ",", StringTokenizer::TOK_TRIM | StringTokenizer::TOK_IGNORE_EMPTY);
-		for (StringTokenizer::Iterator it = st.begin(); it != st.end(); ++it) {
-			string topic = string(*it);
-			cout << "Subscribing to: " << topic << "\n";
-			subscribe(0, topic.c_str());
-			
-			// Add name of the series to the 'series' map.
-			StringTokenizer st1(topic, "/", StringTokenizer::TOK_TRIM | StringTokenizer::TOK_IGNORE_EMPTY);
-			string s = st1[st1.count() - 1]; // Get last item.
-			series.insert(std::pair<string, string>(topic, s));
+		// Subscribe to the topic filters of all mapping rules.
+		vector<string> filters = mapper->getFilters();
+		for (unsigned int i = 0; i < filters.size(); ++i) {
+			cout << "Subscribing to: " << filters[i] << "\n";
+			subscribe(0, filters[i].c_str());
+		}
+		
+		// Subscribe separately to the batch topic if no filter covers it, as
+		// overlapping subscriptions may cause the broker to deliver twice.
+		if (!batchTopic.empty() && !mapper->matches(batchTopic)) {
+			cout << "Subscribing to: " << batchTopic << "\n";
+			subscribe(0, batchTopic.c_str());
 		}
 	}
 	else {
@@ -81,59 +152,105 @@ void MtH::on_connect(int rc) {
 
 
 // --- ON MESSAGE ---
+// Runs on the MQTT network thread. Redeliveries are dropped straight from the
+// library's buffers. Other messages are copied into the buffers of a queue 
+// slot, which are reused and so don't allocate once they've grown large 
+// enough. Parsing is left to the workers.
 void MtH::on_message(const struct mosquitto_message* message) {
-	string topic = message->topic;	
-	map<string, string>::iterator it = series.find(topic);
-	if (it == series.end()) { 
-		cerr << "Topic not found: " << topic << "\n";
-		return; 
+	uint64_t time = InfluxBatcher::now();
+	size_t topicLen = strlen(message->topic);
+	size_t payloadLen = (message->payloadlen > 0) ? message->payloadlen : 0;
+	if (dedup && dedup->duplicate(message->topic, topicLen, (const char*) message->payload,
+																payloadLen, time)) {
+		return;
 	}
 	
-	if (message->payloadlen < 1) {
-		cerr << "No payload found. Returning...\n";
+	queue.push([message, time, topicLen, payloadLen](RawMessage &raw) {
+		raw.topic.assign(message->topic, topicLen);
+		raw.payload.assign((const char*) message->payload, payloadLen);
+		raw.time = time;
+	}, block);
+}
+
+
+// --- WORK ---
+// Parser worker. The message and line buffers are reused between messages.
+void MtH::work() {
+	RawMessage message;
+	string line;
+	while (queue.pop(message)) {
+		parse(message, line);
+	}
+}
+
+
+// --- PARSE ---
+// Handle a message from the queue. Batches of readings are split up first.
+void MtH::parse(RawMessage &message, string &influxMsg) {
+	if (!batchTopic.empty() && message.topic == batchTopic) {
+		parseBatch(message, influxMsg);
 		return;
 	}
 	
-	string payload = string((const char*) message->payload, message->payloadlen);
-	size_t pos = payload.find(";");
-	if (pos == string::npos || pos == 0) {
-		// Invalid payload. Reject.
-		cerr << "Invalid payload: " << payload << ". Reject.\n";
+	write(message.topic.data(), message.topic.length(), message.payload.data(),
+										message.payload.length(), message.time, influxMsg);
+}
+
+
+// --- PARSE BATCH ---
+// Split a batch of readings from a node into the messages they'd have been
+// published as individually, timestamped by their age. The batch is decoded 
+// in place; only the short payload of each reading is formatted.
+void MtH::parseBatch(RawMessage &message, string &influxMsg) {
+	TelemetryBatch batch;
+	if (!batch.parse(message.payload.data(), message.payload.length())) {
+		cerr << "Invalid batch of " << message.payload.length() << " bytes. Reject.\n";
+		++statInvalid;
 		return;
 	}
 	
-	// Assemble the message to send to the InfluxDB instance. 
-	// This message contains the uid and value from the MQTT payload, as well
-	// as information from the listener's configuration.
-	// Note: The timestamp is currently added by the InfluxDB, which is why it's
-	// commented out here.
-	// TODO: is a space (0x20) a valid UID?
-	string uid = payload.substr(0, pos);
-	string value = payload.substr(pos + 1);
-	string influxMsg;	
-	influxMsg = series[topic];
-	influxMsg += ",location=" + uid;
-	influxMsg += " value=" + value;
-	//influxMsg += " " + to_string(static_cast<long int>(time(0)));
-	
-	// Send message.
-	try {
-		Net::HTTPRequest request(Net::HTTPRequest::HTTP_POST, "/write?db=" + influxDb, Net::HTTPMessage::HTTP_1_1);
-		request.setContentLength(influxMsg.length());
-		request.setContentType("application/x-www-form-urlencoded");
-		influxClient->sendRequest(request) << influxMsg;
-		
-		Net::HTTPResponse response;
-		influxClient->receiveResponse(response);
-		/* Poco::Net::HTTPResponse::HTTPStatus status = response.getStatus();
-		if (status != Poco::Net::HTTPResponse::HTTP_OK && status != Poco::Net::HTTPResponse::HTTP_NO_CONTENT) {
-			cerr << "Received InfluxDB error: " << response.getReason() << "\n";
-		} */
+	static thread_local string payload;
+	TelemetryReading reading;
+	while (batch.next(reading)) {
+		batch.formatPayload(reading, payload);
+		uint64_t time = (message.time > reading.age) ? message.time - reading.age : 0;
+		write(reading.metric->topic, reading.metric->topicLength, payload.data(),
+													payload.length(), time, influxMsg);
 	}
-	catch (Exception& exc) {
-		cout << "Exception caught while attempting to connect." << std::endl;
-        cerr << exc.displayText() << std::endl;
-        return;
+}
+
+
+// --- WRITE ---
+// Map a message onto a line of line protocol using the compiled mapping rules,
+// and hand it to the archive and to the batchers of the endpoints its series
+// is routed to, unless it's only to be written as part of a rollup. The time
+// is that of reception, as the point may only be written to the InfluxDB 
+// some time later.
+void MtH::write(const char* topic, size_t topicLen, const char* payload, size_t payloadLen,
+												uint64_t time, string &influxMsg) {
+	MapResult res = mapper->map(topic, topicLen, payload, payloadLen, influxMsg);
+	if (res == MAP_NO_RULE) {
+		cerr << "Topic not found: " << string(topic, topicLen) << "\n";
+		++statInvalid;
+		return;
+	}
+	else if (res == MAP_INVALID) {
+		cerr << "Invalid payload: " << string(payload, payloadLen) << ". Reject.\n";
+		++statInvalid;
+		return;
+	}
+	
+	++statParsed;
+	if (archive) { archive->add(influxMsg, time); }
+	if (batchers.empty()) { return; }
+	if (rollup && rollup->add(influxMsg, time) && !keepRaw) { return; }
+	
+	// Queue the point for the next batch.
+	uint32_t shards[InfluxCluster::maxReplicas];
+	uint32_t count = cluster->route(InfluxCluster::seriesHash(influxMsg.data(), influxMsg.length()),
+																shards);
+	for (uint32_t i = 0; i < count; ++i) {
+		batchers[shards[i]]->add(influxMsg, time);
 	}
 }
 
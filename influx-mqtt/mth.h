@@ -5,6 +5,11 @@
 	
 	Notes:
 			- Declares a class for converting from MQTT to InfluxDB HTTP requests.
+			- Messages are handed from the MQTT network thread to a pool of
+				parser workers through a bounded queue. The workers feed the
+				batchers, whose writer threads send the batches to InfluxDB.
+			- With several InfluxDB endpoints, each point goes to the batcher
+				of the endpoint(s) its series is routed to.
 			
 	2017/02/09, Maya Posch <posch@synyx.de>
 */
@@ -17,26 +22,70 @@
 #include <mosquittopp.h>
 
 #include <string>
-#include <map>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdint>
 
 using namespace std;
 
-#include <Poco/Net/HTTPClientSession.h>
-#include <Poco/Net/HTTPSClientSession.h>
+#include "batcher.h"
+#include "influxcluster.h"
+#include "queue.h"
+#include "mapper.h"
+#include "rollup.h"
+#include "archive.h"
+#include "dedupwindow.h"
+#include "telemetry.h"
+
+
+// Message as received from the broker, queued for the parser workers.
+struct RawMessage {
+	string topic;
+	string payload;
+	uint64_t time;
+	
+	RawMessage() : time(0) { }
+};
 
 
 class MtH : public mosqpp::mosquittopp {
-	Poco::Net::HTTPClientSession* influxClient;
-	string topics;
-	string influxDb;
-	bool secure;
-	map<string, string> series;
+	InfluxCluster* cluster;
+	vector<InfluxBatcher*> batchers;	// One per cluster endpoint.
+	TopicMapper* mapper;
+	Rollup* rollup;
+	bool keepRaw;
+	Archive* archive;
+	DedupWindow* dedup;
+	string batchTopic;
+	BoundedQueue<RawMessage> queue;
+	bool block;
+	vector<thread> workers;
+	atomic<uint64_t> statParsed;
+	atomic<uint64_t> statInvalid;
+	uint64_t lastReceived;
+	uint64_t lastParsed;
+	
+	void work();
+	void parse(RawMessage &message, string &line);
+	void parseBatch(RawMessage &message, string &line);
+	void write(const char* topic, size_t topicLen, const char* payload, size_t payloadLen,
+											uint64_t time, string &line);
 	
 public:
-	MtH(string clientId, string host, int port, string topics, 
-					string influxHost, int influxPort, string influxDb, string influx_sec);
+	MtH(string clientId, string host, int port, TopicMapper* mapper, InfluxCluster* cluster,
+						const vector<InfluxBatcher*> &batchers, uint32_t queueSize = 65536,
+						bool block = false);
 	~MtH();
 	
+	void setRollup(Rollup* rollup, bool keepRaw);
+	void setArchive(Archive* archive);
+	void setDedup(DedupWindow* dedup);
+	void setBatchTopic(const string &topic);
+	void start(uint32_t parsers);
+	void stop();
+	void report(uint32_t interval);
+	
 	void on_connect(int rc);
 	void on_message(const struct mosquitto_message* message);
 	void on_subscribe(int mid, int qos_count, const int* granted_qos);
@@ -0,0 +1,203 @@
+/*
+	queue.h - Bounded lock-free queue for the message pipeline.
+
+	Revision 0
+
+	Notes:
+			- Array-based queue after Dmitry Vyukov's bounded MPMC design.
+				Producers and consumers each claim a slot with a single CAS.
+			- Slots are reused in place: push() fills the slot through a
+				callback and pop() swaps the slot's contents out, so types
+				holding buffers (std::string) stop allocating once warmed up.
+			- Consumers spin briefly before sleeping on a condition variable.
+				Producers only touch the mutex when a consumer is asleep.
+
+	2026/10/19, Maya Posch
+*/
+
+
+#pragma once
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+
+template<typename T>
+class BoundedQueue {
+	struct Cell {
+		std::atomic<size_t> sequence;
+		T data;
+	};
+
+	Cell* buffer;
+	size_t mask;
+	alignas(64) std::atomic<size_t> enqueuePos;
+	alignas(64) std::atomic<size_t> dequeuePos;
+	alignas(64) std::atomic<uint32_t> sleepers;
+	std::atomic<bool> closed;
+	std::mutex sleepMutex;
+	std::condition_variable sleepCv;
+
+	// Statistics.
+	std::atomic<uint64_t> statPushed;
+	std::atomic<uint64_t> statDropped;
+
+	BoundedQueue(const BoundedQueue&);
+	BoundedQueue& operator=(const BoundedQueue&);
+
+public:
+	// The capacity is rounded up to a power of two.
+	BoundedQueue(size_t capacity) {
+		size_t size = 2;
+		while (size < capacity) { size <<= 1; }
+		buffer = new Cell[size];
+		mask = size - 1;
+		for (size_t i = 0; i < size; ++i) {
+			buffer[i].sequence.store(i, std::memory_order_relaxed);
+		}
+
+		enqueuePos.store(0, std::memory_order_relaxed);
+		dequeuePos.store(0, std::memory_order_relaxed);
+		sleepers = 0;
+		closed = false;
+		statPushed = 0;
+		statDropped = 0;
+	}
+
+	~BoundedQueue() {
+		delete[] buffer;
+	}
+
+	// --- TRY PUSH ---
+	// Claim a free slot and fill it using fill(T&). Returns false if full.
+	template<typename F>
+	bool tryPush(F fill) {
+		Cell* cell;
+		size_t pos = enqueuePos.load(std::memory_order_relaxed);
+		while (true) {
+			cell = &buffer[pos & mask];
+			size_t seq = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+			if (diff == 0) {
+				if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			}
+			else if (diff < 0) {
+				return false;
+			}
+			else {
+				pos = enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		fill(cell->data);
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		++statPushed;
+
+		// Wake up a sleeping consumer, if any.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (sleepers.load(std::memory_order_relaxed) > 0) {
+			std::lock_guard<std::mutex> lk(sleepMutex);
+			sleepCv.notify_one();
+		}
+
+		return true;
+	}
+
+	// --- PUSH ---
+	// Push with the given overflow policy: when full, either drop the item or
+	// block until a slot frees up. Returns false if the item was dropped.
+	template<typename F>
+	bool push(F fill, bool block) {
+		for (uint32_t spins = 0; ; ++spins) {
+			if (tryPush(fill)) { return true; }
+			if (!block || closed) {
+				++statDropped;
+				return false;
+			}
+
+			if (spins < 64) { std::this_thread::yield(); }
+			else { std::this_thread::sleep_for(std::chrono::milliseconds(1)); }
+		}
+	}
+
+	// --- TRY POP ---
+	// Swap the oldest item into 'out'. Returns false if empty.
+	bool tryPop(T &out) {
+		Cell* cell;
+		size_t pos = dequeuePos.load(std::memory_order_relaxed);
+		while (true) {
+			cell = &buffer[pos & mask];
+			size_t seq = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t) seq - (intptr_t) (pos + 1);
+			if (diff == 0) {
+				if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			}
+			else if (diff < 0) {
+				return false;
+			}
+			else {
+				pos = dequeuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		std::swap(out, cell->data);
+		cell->sequence.store(pos + mask + 1, std::memory_order_release);
+		return true;
+	}
+
+	// --- POP ---
+	// Wait for an item. Returns false once the queue is closed and drained.
+	bool pop(T &out) {
+		for (uint32_t spins = 0; ; ++spins) {
+			if (tryPop(out)) { return true; }
+			if (closed) { return tryPop(out); }
+			if (spins < 64) {
+				std::this_thread::yield();
+				continue;
+			}
+
+			// The timeout covers the unlikely case of a missed wake-up.
+			std::unique_lock<std::mutex> lk(sleepMutex);
+			++sleepers;
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (size() == 0 && !closed) {
+				sleepCv.wait_for(lk, std::chrono::milliseconds(100));
+			}
+
+			--sleepers;
+			spins = 0;
+		}
+	}
+
+	// --- CLOSE ---
+	// Wake up all consumers. Remaining items can still be popped.
+	void close() {
+		closed = true;
+		std::lock_guard<std::mutex> lk(sleepMutex);
+		sleepCv.notify_all();
+	}
+
+	size_t size() {
+		size_t enq = enqueuePos.load(std::memory_order_relaxed);
+		size_t deq = dequeuePos.load(std::memory_order_relaxed);
+		return (enq > deq) ? enq - deq : 0;
+	}
+
+	size_t capacity() { return mask + 1; }
+	uint64_t getPushed() { return statPushed; }
+	uint64_t getDropped() { return statDropped; }
+};
+
+#endif
@@ -0,0 +1,305 @@
+/*
+	rollup.cpp - Implementation of the per-window point aggregator.
+	
+	Revision 0
+	
+	Notes:
+			- Only numeric fields (floats and integers) are aggregated. Lines
+				without any are left alone, so that the caller writes them
+				as-is.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#include "rollup.h"
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+
+#include "batcher.h"
+#include "lineproto.h"
+
+
+// Most fields looked at in a single line.
+static const uint32_t maxFields = 16;
+
+
+// --- APPEND NUMBER ---
+static void appendNumber(string &line, double value) {
+	char buf[32];
+	int n = snprintf(buf, sizeof(buf), "%.10g", value);
+	line.append(buf, n);
+}
+
+
+// --- CONSTRUCTOR ---
+Rollup::Rollup(uint32_t windowSec, uint32_t graceSec, const RollupWriter &writer,
+											uint32_t stripeCount) {
+	window = (windowSec > 0) ? (uint64_t) windowSec * 1000 : 1000;
+	grace = (uint64_t) graceSec * 1000;
+	this->writer = writer;
+	if (stripeCount == 0) { stripeCount = 1; }
+	for (uint32_t i = 0; i < stripeCount; ++i) {
+		stripes.push_back(new Stripe);
+	}
+	
+	running = false;
+	statPoints = 0;
+	statRollups = 0;
+	statLate = 0;
+	lastPoints = 0;
+	lastRollups = 0;
+}
+
+
+// --- DECONSTRUCTOR ---
+Rollup::~Rollup() {
+	stop();
+	for (unsigned int i = 0; i < stripes.size(); ++i) {
+		delete stripes[i];
+	}
+}
+
+
+// --- SET MEASUREMENTS ---
+// Only aggregate these measurements. All are aggregated if the list is empty.
+// Call before start().
+void Rollup::setMeasurements(const vector<string> &measurements) {
+	this->measurements = measurements;
+}
+
+
+// --- START ---
+// Start the thread which writes out closed windows.
+void Rollup::start() {
+	lock_guard<mutex> lk(flushMutex);
+	if (running) { return; }
+	running = true;
+	flusher = thread(&Rollup::run, this);
+}
+
+
+// --- STOP ---
+// Stop the flush thread and write out all windows, including open ones.
+void Rollup::stop() {
+	{
+		lock_guard<mutex> lk(flushMutex);
+		if (!running) { return; }
+		running = false;
+	}
+	
+	flushCv.notify_all();
+	flusher.join();
+	flush(UINT64_MAX);
+}
+
+
+// --- RUN ---
+void Rollup::run() {
+	chrono::milliseconds interval(min(window, (uint64_t) 1000));
+	unique_lock<mutex> lk(flushMutex);
+	while (running) {
+		flushCv.wait_for(lk, interval);
+		if (!running) { break; }
+		
+		lk.unlock();
+		uint64_t now = InfluxBatcher::now();
+		flush((now > window + grace) ? now - window - grace : 0);
+		lk.lock();
+	}
+}
+
+
+// --- FLUSH ---
+// Write out and forget all series whose window started before 'before'.
+void Rollup::flush(uint64_t before) {
+	vector<pair<string, uint64_t> > lines;
+	for (unsigned int i = 0; i < stripes.size(); ++i) {
+		Stripe &stripe = *stripes[i];
+		lock_guard<mutex> lk(stripe.lock);
+		stripe.flushed = max(stripe.flushed, before);
+		unordered_map<string, Series>::iterator it = stripe.series.begin();
+		while (it != stripe.series.end()) {
+			if (it->second.window >= before) {
+				++it;
+				continue;
+			}
+			
+			lines.push_back(pair<string, uint64_t>(string(), it->second.window));
+			format(it->first, it->second, lines.back().first);
+			it = stripe.series.erase(it);
+		}
+	}
+	
+	for (unsigned int i = 0; i < lines.size(); ++i) {
+		writer(lines[i].first, lines[i].second);
+	}
+	
+	statRollups += lines.size();
+}
+
+
+// --- SELECTED ---
+// Whether the line's measurement is to be aggregated.
+bool Rollup::selected(const char* line, size_t len) {
+	if (measurements.empty()) { return true; }
+	
+	size_t end = lpFind(line, 0, len, ", ");
+	for (unsigned int i = 0; i < measurements.size(); ++i) {
+		if (measurements[i].length() == end && measurements[i].compare(0, end, line, end) == 0) {
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+
+// --- FORMAT ---
+// Format the aggregates of a series' window as a line of line protocol.
+void Rollup::format(const string &key, const Series &series, string &line) {
+	line = key;
+	char sep = ' ';
+	for (unsigned int i = 0; i < series.fields.size(); ++i) {
+		const Field &f = series.fields[i];
+		if (f.count == 0) { continue; }
+		
+		line += sep;
+		line += f.name + "_min=";
+		appendNumber(line, f.min);
+		line += "," + f.name + "_max=";
+		appendNumber(line, f.max);
+		line += "," + f.name + "_mean=";
+		appendNumber(line, f.sum / f.count);
+		line += "," + f.name + "_last=";
+		appendNumber(line, f.last);
+		line += "," + f.name + "_count=" + to_string(f.count) + "i";
+		sep = ',';
+	}
+}
+
+
+// --- ADD ---
+// Add a point (line protocol without timestamp) received at the given time, in
+// milliseconds since the epoch. Returns false if the point isn't aggregated,
+// because its measurement isn't selected, it has no numeric fields or it is
+// late: its window has already been written out. The caller writes those
+// points as they are instead.
+bool Rollup::add(const string &line, uint64_t time) {
+	const char* str = line.data();
+	size_t len = line.length();
+	if (!selected(str, len)) { return false; }
+	
+	// Split the field set into numeric values.
+	size_t keyEnd;
+	pair<size_t, size_t> names[maxFields];
+	double values[maxFields];
+	uint32_t count = lpNumericFields(str, len, keyEnd, names, values, maxFields);
+	if (count == 0) { return false; }
+	
+	// Thread-local buffers, so that steady state needs no allocations.
+	static thread_local string key;
+	static thread_local string out;
+	key.assign(str, keyEnd);
+	uint64_t start = time - time % window;
+	uint64_t closed = 0;
+	bool emit = false;
+	
+	Stripe &stripe = *stripes[hash<string>()(key) % stripes.size()];
+	{
+		lock_guard<mutex> lk(stripe.lock);
+		if (start < stripe.flushed) {
+			++statLate;
+			return false;
+		}
+		
+		unordered_map<string, Series>::iterator it = stripe.series.find(key);
+		if (it == stripe.series.end()) {
+			it = stripe.series.insert(pair<string, Series>(key, Series())).first;
+			it->second.window = start;
+		}
+		
+		Series &series = it->second;
+		if (start > series.window) {
+			// A new window. Write out the previous one.
+			format(key, series, out);
+			closed = series.window;
+			emit = true;
+			series.window = start;
+			for (unsigned int i = 0; i < series.fields.size(); ++i) {
+				series.fields[i].count = 0;
+			}
+		}
+		else if (start < series.window) {
+			++statLate;
+			return false;
+		}
+		
+		for (uint32_t i = 0; i < count; ++i) {
+			const char* name = str + names[i].first;
+			size_t nameLen = names[i].second;
+			Field* field = 0;
+			for (unsigned int j = 0; j < series.fields.size(); ++j) {
+				if (series.fields[j].name.compare(0, string::npos, name, nameLen) == 0) {
+					field = &series.fields[j];
+					break;
+				}
+			}
+			
+			if (!field) {
+				series.fields.push_back(Field());
+				field = &series.fields.back();
+				field->name.assign(name, nameLen);
+				field->count = 0;
+			}
+			
+			double value = values[i];
+			if (field->count == 0) {
+				field->min = value;
+				field->max = value;
+				field->sum = 0;
+			}
+			else {
+				if (value < field->min) { field->min = value; }
+				if (value > field->max) { field->max = value; }
+			}
+			
+			field->sum += value;
+			field->last = value;
+			++field->count;
+		}
+	}
+	
+	++statPoints;
+	if (emit) {
+		writer(out, closed);
+		++statRollups;
+	}
+	
+	return true;
+}
+
+
+// --- REPORT ---
+// Report the points aggregated and rollups written over the past interval (in
+// seconds).
+void Rollup::report(uint32_t interval) {
+	if (interval == 0) { interval = 1; }
+	uint64_t points = statPoints;
+	uint64_t rollups = statRollups;
+	size_t series = 0;
+	for (unsigned int i = 0; i < stripes.size(); ++i) {
+		lock_guard<mutex> lk(stripes[i]->lock);
+		series += stripes[i]->series.size();
+	}
+	
+	cout << "Rollup: " << (points - lastPoints) / interval << " points/s aggregated into "
+			<< (rollups - lastRollups) / interval << " rollups/s, " << series
+			<< " open series, " << statLate << " late points.\n";
+	lastPoints = points;
+	lastRollups = rollups;
+}
@@ -0,0 +1,105 @@
+/*
+	rollup.h - Header file for the per-window point aggregator.
+	
+	Revision 0
+	
+	Notes:
+			- Aggregates the numeric fields of each series (measurement and tag
+				set) over tumbling windows aligned to multiples of the window
+				length. For a field 'value' the rollup has the fields
+				value_min, value_max, value_mean, value_last and value_count.
+			- Accumulators are updated in constant time per point. Series are
+				spread over a number of stripes, each with its own lock, so the
+				parser workers rarely contend.
+			- A window is written out as soon as a point for the next window
+				arrives, or by the flush thread once the window has been closed
+				for the grace period. Points arriving after their window was
+				written out are counted as late and not aggregated. They are
+				written out individually instead, so the grace period should
+				cover the time points spend queued, and the age of readings
+				batched by the nodes (TELEMETRY_INTERVAL, 30 s by default).
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#pragma once
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+using namespace std;
+
+
+// Called with a line of line protocol (without timestamp) and the start of
+// its window in milliseconds since the epoch.
+typedef function<void(const string &line, uint64_t time)> RollupWriter;
+
+
+class Rollup {
+	struct Field {
+		string name;
+		double min;
+		double max;
+		double sum;
+		double last;
+		uint64_t count;
+	};
+	
+	struct Series {
+		uint64_t window;
+		vector<Field> fields;
+	};
+	
+	struct Stripe {
+		mutex lock;
+		unordered_map<string, Series> series;
+		uint64_t flushed;	// Windows starting before this have been written out.
+		
+		Stripe() : flushed(0) { }
+	};
+	
+	uint64_t window;	// ms
+	uint64_t grace;		// ms
+	vector<string> measurements;
+	RollupWriter writer;
+	vector<Stripe*> stripes;
+	
+	thread flusher;
+	mutex flushMutex;
+	condition_variable flushCv;
+	bool running;
+	
+	atomic<uint64_t> statPoints;
+	atomic<uint64_t> statRollups;
+	atomic<uint64_t> statLate;
+	uint64_t lastPoints;
+	uint64_t lastRollups;
+	
+	bool selected(const char* line, size_t len);
+	void format(const string &key, const Series &series, string &line);
+	void run();
+	void flush(uint64_t before);
+
+public:
+	Rollup(uint32_t windowSec, uint32_t graceSec, const RollupWriter &writer,
+											uint32_t stripeCount = 16);
+	~Rollup();
+	
+	void setMeasurements(const vector<string> &measurements);
+	void start();
+	void stop();
+	bool add(const string &line, uint64_t time);
+	void report(uint32_t interval);
+};
+
+#endif
@@ -0,0 +1,384 @@
+/*
+	spool.cpp - Implementation of the on-disk store-and-forward spool.
+	
+	Revision 0
+	
+	Notes:
+			- Records are written through the memory mapping and left to the
+				OS to write back. This survives a crash of the bridge, but not
+				necessarily a power failure.
+			- Consumed records are marked as such in place, so a restart only
+				replays what hasn't been delivered yet.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#include "spool.h"
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+
+#include <Poco/File.h>
+#include <Poco/Checksum.h>
+#include <Poco/Exception.h>
+
+using namespace Poco;
+
+
+// Record header, followed by the line protocol data. Records start at 8-byte
+// aligned offsets within a segment.
+struct RecordHeader {
+	uint32_t magic;
+	uint32_t length;
+	uint32_t points;
+	uint32_t crc;
+	uint64_t time;
+};
+
+static const uint32_t recordPending = 0x4c4f4f50;	// 'POOL'
+static const uint32_t recordDone = 0x454e4f44;		// 'DONE'
+
+
+// --- ALIGN ---
+static uint64_t align(uint64_t size) {
+	return (size + 7) & ~((uint64_t) 7);
+}
+
+
+// --- RECORD CRC ---
+static uint32_t recordCrc(const RecordHeader &hdr, const char* data) {
+	Checksum crc(Checksum::TYPE_CRC32);
+	crc.update((const char*) &hdr.length, sizeof(hdr.length));
+	crc.update((const char*) &hdr.points, sizeof(hdr.points));
+	crc.update((const char*) &hdr.time, sizeof(hdr.time));
+	crc.update(data, hdr.length);
+	return crc.checksum();
+}
+
+
+// --- NOW ---
+static uint64_t nowMs() {
+	return chrono::duration_cast<chrono::milliseconds>(
+								chrono::system_clock::now().time_since_epoch()).count();
+}
+
+
+// --- CONSTRUCTOR ---
+Spool::Spool(string dir, uint64_t segmentSize, uint64_t maxBytes) {
+	this->dir = dir;
+	this->segmentSize = align(segmentSize);
+	this->maxBytes = maxBytes;
+	nextSeq = 0;
+	diskBytes = 0;
+	records = 0;
+	points = 0;
+	statSpooled = 0;
+	statReplayed = 0;
+	statDropped = 0;
+}
+
+
+// --- DECONSTRUCTOR ---
+Spool::~Spool() {
+	for (unsigned int i = 0; i < segments.size(); ++i) {
+		unmap(segments[i]);
+	}
+}
+
+
+// --- MAP ---
+bool Spool::map(Segment &segment) {
+	if (segment.map) { return true; }
+	try {
+		segment.map = new SharedMemory(File(segment.path), SharedMemory::AM_WRITE);
+	}
+	catch (Exception &exc) {
+		cerr << "Spool: failed to map " << segment.path << ": " << exc.displayText() << endl;
+		return false;
+	}
+	
+	return true;
+}
+
+
+// --- UNMAP ---
+void Spool::unmap(Segment &segment) {
+	delete segment.map;
+	segment.map = 0;
+}
+
+
+// --- SCAN ---
+// Find the pending records in a mapped segment. Scanning stops at the first
+// record which is incomplete or fails its CRC check.
+void Spool::scan(Segment &segment) {
+	const char* base = segment.map->begin();
+	uint64_t pos = 0;
+	while (pos + sizeof(RecordHeader) <= segment.size) {
+		RecordHeader hdr;
+		memcpy(&hdr, base + pos, sizeof(hdr));
+		if (hdr.length > segment.size - pos - sizeof(hdr)) { break; }
+		const char* data = base + pos + sizeof(hdr);
+		uint64_t next = pos + align(sizeof(hdr) + hdr.length);
+		if (hdr.magic == recordDone && segment.records == 0) {
+			segment.readPos = next;
+		}
+		else if (hdr.magic == recordPending && hdr.crc == recordCrc(hdr, data)) {
+			if (segment.records == 0) { segment.oldest = hdr.time; }
+			++segment.records;
+			segment.points += hdr.points;
+		}
+		else {
+			break;
+		}
+		
+		pos = next;
+	}
+	
+	segment.writePos = pos;
+}
+
+
+// --- OPEN ---
+// Create the spool directory if needed and pick up any records left over from
+// a previous run.
+bool Spool::open() {
+	lock_guard<mutex> lk(spoolMutex);
+	vector<string> files;
+	try {
+		File d(dir);
+		d.createDirectories();
+		d.list(files);
+	}
+	catch (Exception &exc) {
+		cerr << "Spool: failed to open " << dir << ": " << exc.displayText() << endl;
+		return false;
+	}
+	
+	// Segment names are fixed-width hexadecimal sequence numbers.
+	sort(files.begin(), files.end());
+	for (unsigned int i = 0; i < files.size(); ++i) {
+		if (files[i].length() != 20 || files[i].compare(16, 4, ".seg") != 0) { continue; }
+		Segment segment;
+		segment.seq = strtoull(files[i].substr(0, 16).c_str(), 0, 16);
+		segment.path = dir + "/" + files[i];
+		nextSeq = segment.seq + 1;
+		try {
+			segment.size = File(segment.path).getSize();
+		}
+		catch (Exception &exc) {
+			continue;
+		}
+		
+		if (segment.size > 0 && map(segment)) {
+			scan(segment);
+			unmap(segment);
+		}
+		
+		if (segment.records == 0) {
+			try { File(segment.path).remove(); }
+			catch (Exception &exc) { }
+			continue;
+		}
+		
+		segments.push_back(segment);
+		diskBytes += segment.size;
+		records += segment.records;
+		points += segment.points;
+	}
+	
+	cout << "Spool: " << points << " points in " << segments.size() << " segments in "
+			<< dir << ".\n";
+	
+	return true;
+}
+
+
+// --- ADD SEGMENT ---
+// Start a new segment at the tail. Must be called with the mutex held.
+bool Spool::addSegment(uint64_t minSize) {
+	char name[24];
+	snprintf(name, sizeof(name), "%016llx.seg", (unsigned long long) nextSeq);
+	
+	Segment segment;
+	segment.seq = nextSeq++;
+	segment.path = dir + "/" + name;
+	segment.size = max(segmentSize, minSize);
+	try {
+		File file(segment.path);
+		file.createFile();
+		file.setSize(segment.size);
+	}
+	catch (Exception &exc) {
+		cerr << "Spool: failed to create " << segment.path << ": " << exc.displayText() << endl;
+		return false;
+	}
+	
+	if (!map(segment)) {
+		try { File(segment.path).remove(); }
+		catch (Exception &exc) { }
+		return false;
+	}
+	
+	// Only the head and tail segments are kept mapped.
+	if (segments.size() > 1) { unmap(segments.back()); }
+	
+	segments.push_back(segment);
+	diskBytes += segment.size;
+	return true;
+}
+
+
+// --- REMOVE HEAD ---
+// Delete the oldest segment, along with any records still in it. Must be
+// called with the mutex held.
+void Spool::removeHead() {
+	Segment &head = segments.front();
+	unmap(head);
+	try { File(head.path).remove(); }
+	catch (Exception &exc) {
+		cerr << "Spool: failed to remove " << head.path << ": " << exc.displayText() << endl;
+	}
+	
+	diskBytes -= head.size;
+	records -= head.records;
+	points -= head.points;
+	segments.pop_front();
+}
+
+
+// --- APPEND ---
+// Append a batch to the spool. If the spool is full, the oldest segment is
+// discarded to make room.
+bool Spool::append(const string &lines, uint32_t points) {
+	lock_guard<mutex> lk(spoolMutex);
+	uint64_t need = align(sizeof(RecordHeader) + lines.length());
+	if (segments.empty() || segments.back().size - segments.back().writePos < need) {
+		uint64_t size = max(segmentSize, need);
+		while (!segments.empty() && diskBytes + size > maxBytes) {
+			statDropped += segments.front().points;
+			cerr << "Spool: full, dropping " << segments.front().points << " points.\n";
+			removeHead();
+		}
+		
+		if (size > maxBytes || !addSegment(need)) {
+			statDropped += points;
+			return false;
+		}
+	}
+	
+	Segment &tail = segments.back();
+	if (!map(tail)) {
+		statDropped += points;
+		return false;
+	}
+	
+	RecordHeader hdr;
+	hdr.magic = recordPending;
+	hdr.length = lines.length();
+	hdr.points = points;
+	hdr.time = nowMs();
+	hdr.crc = recordCrc(hdr, lines.data());
+	
+	// Write the data before the header, so that a torn write never looks like
+	// a valid record.
+	char* rec = tail.map->begin() + tail.writePos;
+	memcpy(rec + sizeof(hdr), lines.data(), lines.length());
+	memcpy(rec, &hdr, sizeof(hdr));
+	
+	tail.writePos += need;
+	if (tail.records == 0) { tail.oldest = hdr.time; }
+	++tail.records;
+	tail.points += points;
+	++records;
+	this->points += points;
+	statSpooled += points;
+	return true;
+}
+
+
+// --- PEEK ---
+// Read the oldest pending batch without consuming it. 'cursor' is set to the
+// position of the batch, to be passed to pop() once it's been delivered.
+bool Spool::peek(string &lines, uint32_t &points, SpoolCursor &cursor) {
+	lock_guard<mutex> lk(spoolMutex);
+	if (segments.empty() || segments.front().records == 0 || !map(segments.front())) { 
+		return false; 
+	}
+	
+	Segment &head = segments.front();
+	cursor.seq = head.seq;
+	cursor.pos = head.readPos;
+	RecordHeader hdr;
+	const char* rec = head.map->begin() + head.readPos;
+	memcpy(&hdr, rec, sizeof(hdr));
+	lines.assign(rec + sizeof(hdr), hdr.length);
+	points = hdr.points;
+	return true;
+}
+
+
+// --- POP ---
+// Mark the batch read by peek() as delivered. Does nothing if it's no longer
+// the oldest pending batch, i.e. its segment was discarded since.
+void Spool::pop(const SpoolCursor &cursor) {
+	lock_guard<mutex> lk(spoolMutex);
+	if (segments.empty() || segments.front().records == 0) { return; }
+	
+	Segment &head = segments.front();
+	if (head.seq != cursor.seq || head.readPos != cursor.pos || !map(head)) { return; }
+	
+	char* rec = head.map->begin() + head.readPos;
+	RecordHeader hdr;
+	memcpy(&hdr, rec, sizeof(hdr));
+	memcpy(rec, &recordDone, sizeof(recordDone));
+	
+	head.readPos += align(sizeof(hdr) + hdr.length);
+	--head.records;
+	head.points -= hdr.points;
+	--records;
+	points -= hdr.points;
+	statReplayed += hdr.points;
+	
+	if (head.records == 0) {
+		removeHead();
+		return;
+	}
+	
+	memcpy(&hdr, head.map->begin() + head.readPos, sizeof(hdr));
+	head.oldest = hdr.time;
+}
+
+
+// --- EMPTY ---
+bool Spool::empty() {
+	lock_guard<mutex> lk(spoolMutex);
+	return records == 0;
+}
+
+
+// --- GET STATS ---
+SpoolStats Spool::getStats() {
+	lock_guard<mutex> lk(spoolMutex);
+	SpoolStats stats;
+	stats.bytes = diskBytes;
+	stats.segments = segments.size();
+	stats.records = records;
+	stats.points = points;
+	stats.oldest = 0;
+	if (!segments.empty()) {
+		uint64_t now = nowMs();
+		if (now > segments.front().oldest) { stats.oldest = (now - segments.front().oldest) / 1000; }
+	}
+	
+	stats.spooled = statSpooled;
+	stats.replayed = statReplayed;
+	stats.dropped = statDropped;
+	return stats;
+}
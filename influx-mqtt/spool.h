@@ -0,0 +1,106 @@
+/*
+	spool.h - Header file for the on-disk store-and-forward spool.
+	
+	Revision 0
+	
+	Notes:
+			- Batches which could not be delivered to InfluxDB are appended to
+				fixed-size, memory-mapped segment files in the spool directory
+				and read back in order once InfluxDB is reachable again.
+			- Each record carries a CRC32 of its contents. On start-up the
+				segments are scanned and anything after a torn or corrupted
+				record is ignored.
+			- Total disk use is capped. Once exceeded, the oldest segment is
+				discarded.
+			- peek() returns a cursor to the record it read, which pop() takes
+				to mark that record as delivered. If the record was discarded
+				in the meantime, pop() leaves the spool alone, so a replay in
+				progress never consumes a record it didn't send.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#pragma once
+#ifndef SPOOL_H
+#define SPOOL_H
+
+#include <string>
+#include <deque>
+#include <mutex>
+#include <cstdint>
+
+#include <Poco/SharedMemory.h>
+
+using namespace std;
+
+
+struct SpoolStats {
+	uint64_t bytes;			// Disk space in use.
+	uint32_t segments;		// Segment files in use.
+	uint64_t records;		// Batches waiting to be replayed.
+	uint64_t points;		// Points waiting to be replayed.
+	uint64_t oldest;		// Age of the oldest record (s).
+	uint64_t spooled;		// Points appended since start.
+	uint64_t replayed;		// Points replayed since start.
+	uint64_t dropped;		// Points discarded because the spool was full.
+};
+
+
+// Position of a record: the segment's sequence number and the offset in it.
+struct SpoolCursor {
+	uint64_t seq;
+	uint64_t pos;
+	
+	SpoolCursor() : seq(0), pos(0) { }
+};
+
+
+class Spool {
+	struct Segment {
+		uint64_t seq;
+		string path;
+		uint64_t size;
+		Poco::SharedMemory* map;
+		uint64_t readPos;
+		uint64_t writePos;
+		uint64_t records;
+		uint64_t points;
+		uint64_t oldest;	// Spool time of the first pending record (ms).
+		
+		Segment() : seq(0), size(0), map(0), readPos(0), writePos(0), records(0),
+					points(0), oldest(0) { }
+	};
+	
+	string dir;
+	uint64_t segmentSize;
+	uint64_t maxBytes;
+	uint64_t nextSeq;
+	deque<Segment> segments;
+	uint64_t diskBytes;
+	uint64_t records;
+	uint64_t points;
+	uint64_t statSpooled;
+	uint64_t statReplayed;
+	uint64_t statDropped;
+	mutex spoolMutex;
+	
+	bool map(Segment &segment);
+	void unmap(Segment &segment);
+	void scan(Segment &segment);
+	bool addSegment(uint64_t minSize);
+	void removeHead();
+
+public:
+	Spool(string dir, uint64_t segmentSize = 16777216, uint64_t maxBytes = 1073741824);
+	~Spool();
+	
+	bool open();
+	bool append(const string &lines, uint32_t points);
+	bool peek(string &lines, uint32_t &points, SpoolCursor &cursor);
+	void pop(const SpoolCursor &cursor);
+	bool empty();
+	SpoolStats getStats();
+};
+
+#endif
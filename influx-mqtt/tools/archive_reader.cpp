@@ -0,0 +1,184 @@
+/*
+	archive_reader.cpp - Range scans over the influx-mqtt archive.
+	
+	Revision 0
+	
+	Features:
+				- Prints the points of a series' field within a time range as
+					CSV, or only their count, minimum, maximum and mean.
+	
+	Notes:
+				- Usage: archive_reader <archive dir> <series key> <field>
+					[-from <time>] [-to <time>] [-stats]
+					The series key is the measurement and tag set as written to
+					InfluxDB, e.g. 'temperature,location=abc'. Times are either
+					in milliseconds since the epoch or given as
+					YYYY-MM-DD[THH:MM:SS] (UTC).
+				- Partition files are memory-mapped. Blocks outside the range are
+					skipped using their headers, and with -stats blocks entirely
+					within the range are summarised from their headers without
+					being decompressed.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#include "../archive.h"
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+
+#include <Poco/File.h>
+#include <Poco/SharedMemory.h>
+#include <Poco/Exception.h>
+
+using namespace std;
+using namespace Poco;
+
+
+// --- PARSE TIME ---
+static bool parseTime(const string &in, int64_t &out) {
+	if (!in.empty() && in.find_first_not_of("0123456789") == string::npos) {
+		out = strtoll(in.c_str(), 0, 10);
+		return true;
+	}
+	
+	struct tm t;
+	memset(&t, 0, sizeof(t));
+	const char* end = strptime(in.c_str(), "%Y-%m-%dT%H:%M:%S", &t);
+	if (!end || *end) {
+		memset(&t, 0, sizeof(t));
+		end = strptime(in.c_str(), "%Y-%m-%d", &t);
+		if (!end || *end) { return false; }
+	}
+	
+	out = (int64_t) timegm(&t) * 1000;
+	return true;
+}
+
+
+int main(int argc, char* argv[]) {
+	if (argc < 4) {
+		cerr << "Usage: " << argv[0] << " <archive dir> <series key> <field> [-from <time>] "
+				<< "[-to <time>] [-stats]\n";
+		return 1;
+	}
+	
+	string dir = string(argv[1]) + "/" + Archive::escape(argv[2]);
+	string prefix = Archive::escape(argv[3]) + "-";
+	int64_t from = INT64_MIN;
+	int64_t to = INT64_MAX;
+	bool stats = false;
+	for (int i = 4; i < argc; ++i) {
+		string arg = argv[i];
+		if (arg == "-stats") { stats = true; continue; }
+		if ((arg != "-from" && arg != "-to") || i + 1 == argc) {
+			cerr << "Unknown argument: " << arg << "\n";
+			return 1;
+		}
+		
+		if (!parseTime(argv[++i], (arg == "-from") ? from : to)) {
+			cerr << "Invalid time: " << argv[i] << "\n";
+			return 1;
+		}
+	}
+	
+	chrono::steady_clock::time_point started = chrono::steady_clock::now();
+	
+	// Find the partitions overlapping the range. Their names sort by time.
+	vector<string> files;
+	try {
+		File(dir).list(files);
+	}
+	catch (Exception &exc) {
+		cerr << "No such series: " << exc.displayText() << "\n";
+		return 1;
+	}
+	
+	sort(files.begin(), files.end());
+	
+	uint64_t count = 0;
+	double min = 0;
+	double max = 0;
+	double sum = 0;
+	uint64_t blocksRead = 0;
+	uint64_t blocksSummarised = 0;
+	if (!stats) { cout << "time,value\n"; }
+	for (unsigned int i = 0; i < files.size(); ++i) {
+		const string &name = files[i];
+		int64_t partStart, partEnd;
+		if (name.length() != prefix.length() + 10 || name.compare(0, prefix.length(), prefix) != 0 ||
+				name.compare(name.length() - 4, 4, ".gor") != 0 ||
+				!Archive::partitionRange(name.substr(prefix.length(), 6), partStart, partEnd)) {
+			continue;
+		}
+		
+		if (partEnd <= from || partStart >= to) { continue; }
+		
+		string path = dir + "/" + name;
+		File file(path);
+		if (file.getSize() < sizeof(GorillaBlock)) { continue; }
+		SharedMemory map(file, SharedMemory::AM_READ);
+		const char* pos = map.begin();
+		const char* end = map.end();
+		while (pos + sizeof(GorillaBlock) <= end) {
+			const GorillaBlock* block = (const GorillaBlock*) pos;
+			if (block->magic != gorillaMagic || block->bytes > (uint64_t) (end - pos) - sizeof(GorillaBlock)) {
+				cerr << "Stopping at a damaged block in " << path << ".\n";
+				break;
+			}
+			
+			pos += sizeof(GorillaBlock) + block->bytes;
+			if (block->last < from || block->first >= to || block->count == 0) { continue; }
+			
+			// Summarise whole blocks from their header.
+			if (stats && block->first >= from && block->last < to) {
+				if (count == 0 || block->min < min) { min = block->min; }
+				if (count == 0 || block->max > max) { max = block->max; }
+				sum += block->sum;
+				count += block->count;
+				++blocksSummarised;
+				continue;
+			}
+			
+			GorillaDecoder decoder(block);
+			int64_t time;
+			double value;
+			++blocksRead;
+			while (decoder.next(time, value)) {
+				if (time < from) { continue; }
+				if (time >= to) { break; }
+				if (stats) {
+					if (count == 0 || value < min) { min = value; }
+					if (count == 0 || value > max) { max = value; }
+					sum += value;
+					++count;
+					continue;
+				}
+				
+				printf("%lld,%.10g\n", (long long) time, value);
+				++count;
+			}
+		}
+	}
+	
+	if (stats) {
+		double elapsed = chrono::duration_cast<chrono::microseconds>(
+								chrono::steady_clock::now() - started).count() / 1000.0;
+		cout << "count: " << count << "\n";
+		if (count > 0) {
+			cout << "min: " << min << "\nmax: " << max << "\nmean: " << sum / count << "\n";
+		}
+		
+		cout << "blocks: " << blocksSummarised << " from headers, " << blocksRead
+				<< " decompressed in " << elapsed << " ms.\n";
+	}
+	
+	return 0;
+}
@@ -33,6 +33,7 @@ using namespace Poco;
 using namespace Poco::Net;
 
 #include "httprequestfactory.h"
+#include "maptiles.h"
 
 
 int main(int argc, char* argv[]) {
@@ -53,11 +54,17 @@ int main(int argc, char* argv[]) {
 	string mqtt_host = config->getString("MQTT.host", "localhost");
 	int mqtt_port = config->getInt("MQTT.port", 1883);
 	string defaultFirmware = config->getString("Firmware.default", "ota_unified.bin");
+	UInt16 port = config->getInt("HTTP.port", 8080);
+	
+	// Generate the tiles of new floor maps. By default clients fetch the tiles
+	// from the MQTT broker's host, on the HTTP port.
+	MapTiles::init(config->getString("Map.folder", "maps/"));
+	string mapUrl = config->getString("Map.url", "");
+	if (mapUrl.empty()) { mapUrl = ":" + to_string(port) + "/map/"; }
 	
-	Listener listener("Command_and_Control", mqtt_host, mqtt_port, defaultFirmware);
+	Listener listener("Command_and_Control", mqtt_host, mqtt_port, defaultFirmware, mapUrl);
 	
 	// Initialise the HTTP server.
-	UInt16 port = config->getInt("HTTP.port", 8080);
 	HTTPServerParams* params = new HTTPServerParams;
 	params->setMaxQueued(100);
 	params->setMaxThreads(10);
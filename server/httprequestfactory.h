@@ -20,12 +20,14 @@
 using namespace Poco::Net;
 
 #include "datahandler.h"
+#include "maphandler.h"
 
 
 class RequestHandlerFactory: public HTTPRequestHandlerFactory { 
 public:
 	RequestHandlerFactory() {}
 	HTTPRequestHandler* createRequestHandler(const HTTPServerRequest& request) {
+		if (request.getURI().compare(0, 5, "/map/") == 0) { return new MapHandler(); }
 		return new DataHandler();
 	}
 };
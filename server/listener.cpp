@@ -29,6 +29,10 @@ using namespace std;
 
 using namespace Poco::Data::Keywords;
 
+#include <thread>
+
+#include "maptiles.h"
+
 
 // Structs
 struct Node {
@@ -41,7 +45,7 @@ struct Node {
 
 
 // --- CONSTRUCTOR ---
-Listener::Listener(string clientId, string host, int port, string defaultFirmware) : mosquittopp(clientId.c_str()) {
+Listener::Listener(string clientId, string host, int port, string defaultFirmware, string mapUrl) : mosquittopp(clientId.c_str()) {
 	int keepalive = 60;
 	connect(host.c_str(), port, keepalive);
 	
@@ -62,6 +66,7 @@ Listener::Listener(string clientId, string host, int port, string defaultFirmwar
 
 	// Load configuration settings.
 	this->defaultFirmware = defaultFirmware;
+	this->mapUrl = mapUrl;
 }
 
 
@@ -90,6 +95,8 @@ void Listener::on_connect(int rc) {
 		subscribe(0, topic.c_str());
 		topic = "cc/firmware";	// C&C client firmware command.
 		subscribe(0, topic.c_str());
+		topic = "cc/ui/map";	// C&C client uploading a floor map.
+		subscribe(0, topic.c_str());
 	}
 	else {
 		// handle.
@@ -142,8 +149,12 @@ void Listener::on_message(const struct mosquitto_message* message) {
 	else if (topic == "cc/ui/config") {
 		// Payload is the desired resource to return:
 		// * 'map'		- The layout image indicating node positioning.
+		// * 'floors'	- The tiled maps of the floors (see publishFloors()).
 		// * 'nodes'	- UID & position info (x/y) for each node.
-		if (payload == "map") {
+		if (payload == "floors") {
+			publishFloors();
+		}
+		else if (payload == "map") {
 			// The map is expected to exist in the executable's folder (./).
 			// Its name is 'map', with or without extension. If multiple files
 			// with the name exist, the first one is taken.
@@ -394,6 +405,16 @@ void Listener::on_message(const struct mosquitto_message* message) {
 			return;
 		}
 	}
+	else if (topic == "cc/ui/map") {
+		// Set the map of a floor. The payload is the floor name, followed by a
+		// semi-colon and the PNG image. Generating the tiles of a large image
+		// takes a while, so it's done on its own thread.
+		size_t pos = payload.find(';');
+		if (pos == string::npos) { return; }
+		string name = payload.substr(0, pos);
+		payload.erase(0, pos + 1);
+		thread(&Listener::addMap, this, name, payload).detach();
+	}
 	else if (topic == "cc/firmware") {
 		if (payload == "list") {
 			// Return a list of the available firmware images as found on the 
@@ -449,6 +470,32 @@ void Listener::on_message(const struct mosquitto_message* message) {
 }
 
 
+// --- ADD MAP ---
+// Adds the map of a floor, and publishes the result on 'cc/ui/map/upload', as
+// 'ok;<floor>' or 'error;<floor>;<reason>'. On success the new list of floors
+// is published as well, so that all clients pick up the new map.
+void Listener::addMap(string name, string data) {
+	string error;
+	string reply = "ok;" + name;
+	bool success = MapTiles::add(name, data, error);
+	if (!success) { reply = "error;" + name + ";" + error; }
+	publish(0, "cc/ui/map/upload", reply.length(), reply.c_str());
+	if (success) { publishFloors(); }
+}
+
+
+// --- PUBLISH FLOORS ---
+// Publishes the floor maps on 'cc/ui/config/floors', as the base URL of the 
+// tiles followed by the floors, all separated by semi-colons. A floor is
+// 'name,width,height,levels,version', and its tiles are found at
+// '<URL><name>/<version>/<level>/<x>_<y>.png'. A URL starting with ':' is
+// relative to the host of the MQTT broker.
+void Listener::publishFloors() {
+	string floors = mapUrl + ";" + MapTiles::list();
+	publish(0, "cc/ui/config/floors", floors.length(), floors.c_str());
+}
+
+
 // --- ON SUBSCRIBE ---
 void Listener::on_subscribe(int mid, int qos_count, const int* granted_qos) {
 	// Report success, with details.
@@ -30,9 +30,13 @@ using namespace Poco;
 class Listener : public mosqpp::mosquittopp {
 	Data::Session* session;
 	string defaultFirmware;
+	string mapUrl;
+	
+	void addMap(string name, string data);
+	void publishFloors();
 	
 public:
-	Listener(string clientId, string host, int port, string defaultFirmware);
+	Listener(string clientId, string host, int port, string defaultFirmware, string mapUrl);
 	~Listener();
 	
 	void on_connect(int rc);
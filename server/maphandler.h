@@ -0,0 +1,66 @@
+/*
+	maphandler.h - Header file for the MapHandler class.
+	
+	Revision 0
+	
+	Notes:
+			- Serves the tiles of the floor maps, at
+				'/map/<floor>/<version>/<level>/<x>_<y>.png'. As the version is
+				the hash of the map image, a tile never changes, and clients
+				may cache it forever.
+			
+	2026/10/19, Maya Posch
+*/
+
+
+#ifndef MAPHANDLER_H
+#define MAPHANDLER_H
+
+#include <iostream>
+
+using namespace std;
+
+#include <Poco/Net/HTTPRequestHandler.h>
+#include <Poco/Net/HTTPServerResponse.h>
+#include <Poco/Net/HTTPServerRequest.h>
+#include <Poco/URI.h>
+#include <Poco/File.h>
+
+using namespace Poco::Net;
+using namespace Poco;
+
+#include "maptiles.h"
+
+
+class MapHandler: public HTTPRequestHandler { 
+public: 
+	void handleRequest(HTTPServerRequest& request, HTTPServerResponse& response) {
+		URI uri(request.getURI());
+		string path = MapTiles::tilePath(uri.getPath());
+		if (path.empty() || !File(path).exists()) {
+			// Return a 404.
+			response.setStatus(HTTPResponse::HTTP_NOT_FOUND);
+			ostream& ostr = response.send();
+			ostr << "File Not Found: " << uri.getPath();
+			return;
+		}
+		
+		string etag = "\"" + uri.getPath() + "\"";
+		response.set("ETag", etag);
+		response.set("Cache-Control", "public, max-age=31536000, immutable");
+		if (request.get("If-None-Match", "") == etag) {
+			response.setStatus(HTTPResponse::HTTP_NOT_MODIFIED);
+			response.send();
+			return;
+		}
+		
+		try {
+			response.sendFile(path, "image/png");
+		}
+		catch (Poco::Exception &e) {
+			cerr << "Sending map tile failed: " << e.displayText() << endl;
+		}
+	}
+};
+
+#endif
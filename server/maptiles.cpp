@@ -0,0 +1,339 @@
+/*
+	maptiles.cpp - Implementation of the MapTiles class.
+	
+	Revision 0
+	
+	Notes:
+			- Uses the simplified API of libpng (1.6+) to decode the map images
+				and encode the tiles. Images are decoded to 8-bit RGBA, and each
+				lower level is a 2x2 box filtered copy of the level above it.
+			- A pyramid is generated in a '.part' folder, which is renamed once
+				complete, so that a tile is never served while being written.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#include "maptiles.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+
+#include <png.h>
+
+#include <Poco/File.h>
+#include <Poco/StringTokenizer.h>
+
+using namespace Poco;
+
+
+// Static initialisations.
+mutex MapTiles::mtx;
+mutex MapTiles::buildMtx;
+map<string, MapFloor> MapTiles::floors;
+string MapTiles::root = "maps/";
+
+
+// --- READ FILE ---
+static bool readFile(const string &path, string &data) {
+	ifstream in(path, ios::binary);
+	if (!in.is_open()) { return false; }
+	stringstream ss;
+	ss << in.rdbuf();
+	data = ss.str();
+	return true;
+}
+
+
+// --- INIT ---
+// Loads the floors from the map images in 'root' (ending with a slash), named
+// '<floor>.png', generating the tiles of new and changed images. A 'map.png'
+// in the current folder is imported as the 'default' floor if there are none.
+void MapTiles::init(const string &root) {
+	MapTiles::root = root;
+	File folder(root);
+	folder.createDirectories();
+	
+	vector<string> names;
+	folder.list(names);
+	bool found = false;
+	for (int i = 0; i < names.size(); ++i) {
+		if (names[i].size() > 4 && names[i].compare(names[i].size() - 4, 4, ".png") == 0) {
+			found = true;
+			break;
+		}
+	}
+	
+	File legacy("map.png");
+	if (!found && legacy.exists()) {
+		cout << "Importing map.png as the 'default' floor.\n";
+		legacy.copyTo(root + "default.png");
+		folder.list(names);
+	}
+	
+	for (int i = 0; i < names.size(); ++i) {
+		if (names[i].size() <= 4 || names[i].compare(names[i].size() - 4, 4, ".png") != 0) {
+			continue;
+		}
+		
+		string name = names[i].substr(0, names[i].size() - 4);
+		string data;
+		if (!validName(name) || !readFile(root + names[i], data)) { continue; }
+		
+		MapFloor floor;
+		string error;
+		if (!build(name, data, floor, error)) {
+			cerr << "Failed to load map for floor '" << name << "': " << error << endl;
+			continue;
+		}
+		
+		{
+			lock_guard<mutex> lk(mtx);
+			floors[name] = floor;
+		}
+		
+		removeVersions(name, floor.version);
+	}
+	
+	cout << "Loaded " << floors.size() << " floor maps.\n";
+}
+
+
+// --- VALID NAME ---
+// Floor names are used in paths and URLs, and are limited to letters, digits,
+// '-' and '_'.
+bool MapTiles::validName(const string &name) {
+	if (name.empty() || name.size() > 64) { return false; }
+	for (int i = 0; i < name.size(); ++i) {
+		char c = name[i];
+		if (!isalnum((unsigned char) c) && c != '-' && c != '_') { return false; }
+	}
+	
+	return true;
+}
+
+
+// --- HASH ---
+// 64-bit FNV-1a hash of the image, as hexadecimal string.
+string MapTiles::hash(const string &data) {
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < data.size(); ++i) {
+		hash = (hash ^ (uint8_t) data[i]) * 1099511628211ULL;
+	}
+	
+	char out[17];
+	snprintf(out, sizeof(out), "%016llx", (unsigned long long) hash);
+	return out;
+}
+
+
+// --- ADD ---
+// Sets the map image of a floor, adding the floor if it's new. Generates the
+// tiles before the new map replaces the old one, which can take seconds for
+// large images. Returns false with a reason in 'error' if the image isn't valid.
+bool MapTiles::add(const string &name, const string &data, string &error) {
+	if (!validName(name)) {
+		error = "Invalid floor name.";
+		return false;
+	}
+	
+	lock_guard<mutex> building(buildMtx);
+	MapFloor floor;
+	if (!build(name, data, floor, error)) { return false; }
+	
+	string path = root + name + ".png";
+	ofstream out(path + ".part", ofstream::binary | ofstream::trunc);
+	out.write(data.data(), data.size());
+	out.close();
+	if (!out) {
+		error = "Failed to write map image.";
+		return false;
+	}
+	
+	File(path + ".part").renameTo(path);
+	
+	{
+		lock_guard<mutex> lk(mtx);
+		floors[name] = floor;
+	}
+	
+	removeVersions(name, floor.version);
+	cout << "Updated map of floor '" << name << "' (" << floor.width << "x" << floor.height
+			<< ", " << floor.levels << " levels).\n";
+	return true;
+}
+
+
+// --- BUILD ---
+// Generates the tile pyramid of an image, unless it already exists.
+bool MapTiles::build(const string &name, const string &data, MapFloor &floor, string &error) {
+	floor.name = name;
+	floor.version = hash(data);
+	string dir = root + name + "/" + floor.version;
+	
+	// Tiles of this image were generated before.
+	ifstream info(dir + "/floor.txt");
+	if (info >> floor.width >> floor.height >> floor.levels) { return true; }
+	
+	png_image image;
+	memset(&image, 0, sizeof(image));
+	image.version = PNG_IMAGE_VERSION;
+	if (!png_image_begin_read_from_memory(&image, data.data(), data.size())) {
+		error = image.message;
+		return false;
+	}
+	
+	if (image.width > maxMapSize || image.height > maxMapSize) {
+		png_image_free(&image);
+		error = "Image larger than " + to_string(maxMapSize) + " pixels.";
+		return false;
+	}
+	
+	image.format = PNG_FORMAT_RGBA;
+	vector<uint8_t> pixels(PNG_IMAGE_SIZE(image));
+	if (!png_image_finish_read(&image, 0, pixels.data(), 0, 0)) {
+		error = image.message;
+		return false;
+	}
+	
+	// Each level halves the size, until the image fits in a single tile.
+	int width = image.width;
+	int height = image.height;
+	floor.width = width;
+	floor.height = height;
+	floor.levels = 1;
+	for (int size = max(width, height); size > mapTileSize; size = (size + 1) / 2) {
+		++floor.levels;
+	}
+	
+	string part = dir + ".part";
+	File partFolder(part);
+	if (partFolder.exists()) { partFolder.remove(true); }
+	partFolder.createDirectories();
+	
+	for (int level = floor.levels - 1; level >= 0; --level) {
+		if (!writeLevel(part + "/" + to_string(level), pixels, width, height)) {
+			partFolder.remove(true);
+			error = "Failed to write map tiles.";
+			return false;
+		}
+		
+		if (level == 0) { break; }
+		
+		// Box filter, repeating the last row and column of odd sizes.
+		int w = (width + 1) / 2;
+		int h = (height + 1) / 2;
+		vector<uint8_t> next(w * h * 4);
+		for (int y = 0; y < h; ++y) {
+			const uint8_t* row0 = &pixels[(2 * y) * width * 4];
+			const uint8_t* row1 = &pixels[min(2 * y + 1, height - 1) * width * 4];
+			uint8_t* out = &next[y * w * 4];
+			for (int x = 0; x < w; ++x) {
+				int x0 = 2 * x * 4;
+				int x1 = min(2 * x + 1, width - 1) * 4;
+				for (int c = 0; c < 4; ++c) {
+					out[x * 4 + c] = (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] +
+										row1[x1 + c] + 2) / 4;
+				}
+			}
+		}
+		
+		pixels.swap(next);
+		width = w;
+		height = h;
+	}
+	
+	ofstream out(part + "/floor.txt");
+	out << floor.width << " " << floor.height << " " << floor.levels << "\n";
+	out.close();
+	
+	File target(dir);
+	if (target.exists()) { target.remove(true); }
+	partFolder.renameTo(dir);
+	return true;
+}
+
+
+// --- WRITE LEVEL ---
+// Writes the tiles of one level of the pyramid as '<x>_<y>.png' in 'path'.
+bool MapTiles::writeLevel(const string &path, const vector<uint8_t> &pixels, int width,
+																		int height) {
+	File(path).createDirectories();
+	for (int y = 0; y * mapTileSize < height; ++y) {
+		for (int x = 0; x * mapTileSize < width; ++x) {
+			png_image tile;
+			memset(&tile, 0, sizeof(tile));
+			tile.version = PNG_IMAGE_VERSION;
+			tile.format = PNG_FORMAT_RGBA;
+			tile.width = min(mapTileSize, width - x * mapTileSize);
+			tile.height = min(mapTileSize, height - y * mapTileSize);
+			
+			const uint8_t* start = &pixels[((size_t) y * mapTileSize * width +
+											x * mapTileSize) * 4];
+			string file = path + "/" + to_string(x) + "_" + to_string(y) + ".png";
+			if (!png_image_write_to_file(&tile, file.c_str(), 0, start, width * 4, 0)) {
+				cerr << "Failed to write tile " << file << ": " << tile.message << endl;
+				return false;
+			}
+		}
+	}
+	
+	return true;
+}
+
+
+// --- REMOVE VERSIONS ---
+// Removes the tiles of the floor's images other than 'keep', including those
+// of unfinished pyramids.
+void MapTiles::removeVersions(const string &name, const string &keep) {
+	vector<string> versions;
+	File folder(root + name);
+	if (!folder.isDirectory()) { return; }
+	folder.list(versions);
+	for (int i = 0; i < versions.size(); ++i) {
+		if (versions[i] != keep) { File(root + name + "/" + versions[i]).remove(true); }
+	}
+}
+
+
+// --- LIST ---
+// Returns the floors, separated by semi-colons. Each floor is
+// 'name,width,height,levels,version'.
+string MapTiles::list() {
+	lock_guard<mutex> lk(mtx);
+	string out;
+	for (map<string, MapFloor>::const_iterator it = floors.begin(); it != floors.end(); ++it) {
+		if (!out.empty()) { out += ";"; }
+		out += it->second.name + "," + to_string(it->second.width) + "," +
+				to_string(it->second.height) + "," + to_string(it->second.levels) + "," +
+				it->second.version;
+	}
+	
+	return out;
+}
+
+
+// --- TILE PATH ---
+// Returns the file of the tile at 'uri', in the form
+// '/map/<floor>/<version>/<level>/<x>_<y>.png', or an empty string if the URI
+// isn't valid.
+string MapTiles::tilePath(const string &uri) {
+	StringTokenizer st(uri, "/", StringTokenizer::TOK_IGNORE_EMPTY);
+	if (st.count() != 5 || st[0] != "map" || !validName(st[1]) || st[2].size() != 16 ||
+			st[2].find_first_not_of("0123456789abcdef") != string::npos) {
+		return string();
+	}
+	
+	unsigned int level, x, y;
+	if (sscanf(st[3].c_str(), "%u", &level) != 1 || st[3] != to_string(level) ||
+			sscanf(st[4].c_str(), "%u_%u", &x, &y) != 2 || 
+			st[4] != to_string(x) + "_" + to_string(y) + ".png") {
+		return string();
+	}
+	
+	return root + st[1] + "/" + st[2] + "/" + st[3] + "/" + st[4];
+}
@@ -0,0 +1,71 @@
+/*
+	maptiles.h - Header file for the MapTiles class.
+	
+	Revision 0
+	
+	Notes:
+			- Each floor of the building has its own map image. When an image is
+				added, a pyramid of tiles is generated from it, from the whole
+				floor in a single tile (level 0) down to the full resolution.
+				Each level halves the resolution of the one below it.
+			- Tiles are stored below the folder of the floor, in a folder named
+				after the version (hash) of the image, so that their URLs never
+				change their contents and can be cached by clients forever.
+			- Only PNG images are supported. Tiles are PNG images of at most
+				'mapTileSize' pixels square, with the tiles on the right and
+				bottom edges cut to the size of the image.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#pragma once
+#ifndef MAPTILES_H
+#define MAPTILES_H
+
+#include <string>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+using namespace std;
+
+
+// Width and height of a map tile, in pixels.
+const int mapTileSize = 256;
+
+// Largest width or height of a map image, in pixels.
+const int maxMapSize = 16384;
+
+
+struct MapFloor {
+	string name;
+	int width;
+	int height;
+	int levels;			// Zoom levels, the last one being the full resolution.
+	string version;		// Hash of the image, as hexadecimal string.
+};
+
+
+class MapTiles {
+	static mutex mtx;
+	static mutex buildMtx;
+	static map<string, MapFloor> floors;
+	static string root;
+	
+	static string hash(const string &data);
+	static bool build(const string &name, const string &data, MapFloor &floor, string &error);
+	static bool writeLevel(const string &path, const vector<uint8_t> &pixels, int width,
+																		int height);
+	static void removeVersions(const string &name, const string &keep);
+
+public:
+	static void init(const string &root);
+	static bool validName(const string &name);
+	static bool add(const string &name, const string &data, string &error);
+	static string list();
+	static string tilePath(const string &uri);
+};
+
+#endif
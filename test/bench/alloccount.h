@@ -0,0 +1,54 @@
+/*
+	alloccount.h - Counts heap allocations in the benchmarks.
+	
+	Revision 0
+	
+	Notes:
+			- Replaces the global operator new and delete. Include it in exactly
+				one source file of a program.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#ifndef ALLOCCOUNT_H
+#define ALLOCCOUNT_H
+
+
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <cstdint>
+
+
+static std::atomic<uint64_t> allocCount(0);
+
+
+void* operator new(size_t size) {
+	allocCount.fetch_add(1, std::memory_order_relaxed);
+	void* p = malloc(size ? size : 1);
+	if (!p) { throw std::bad_alloc(); }
+	return p;
+}
+
+
+void* operator new[](size_t size) {
+	allocCount.fetch_add(1, std::memory_order_relaxed);
+	void* p = malloc(size ? size : 1);
+	if (!p) { throw std::bad_alloc(); }
+	return p;
+}
+
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+
+// --- ALLOCATIONS ---
+static uint64_t allocations() {
+	return allocCount.load(std::memory_order_relaxed);
+}
+
+#endif
@@ -0,0 +1,261 @@
+/*
+	firmware_bench.cpp - Benchmark of firmware downloads from the controller.
+	
+	Revision 0
+	
+	Features:
+			- A number of clients (threads) fetch the firmware image of a node
+				from the controller at the same time, as the nodes do when many
+				of them are told to upgrade at once.
+			- Clients rejected with a 503 retry after the time given in the
+				Retry-After header. The nodes back off further with each retry.
+			- Reports the aggregate download throughput, the number of 503
+				responses and the time until each client had its image.
+			- Meanwhile, requests the control API every 100 ms and reports
+				their latency and failures, which show whether the downloads
+				take the server threads the API needs.
+	
+	Notes:
+			- The UID has to have a firmware image assigned in the controller.
+			- The benchmark reads as fast as the network allows, while the nodes
+				download at the pace of their flash writes, so the server is
+				busier here than it would be with the same number of nodes.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <limits>
+#include <cstdlib>
+
+#include <Poco/Net/HTTPClientSession.h>
+#include <Poco/Net/HTTPRequest.h>
+#include <Poco/Net/HTTPResponse.h>
+#include <Poco/Exception.h>
+
+#include "sarge.h"
+
+using namespace Poco::Net;
+
+
+// Outcome of one client.
+struct ClientResult {
+	bool done;
+	uint64_t bytes;
+	uint32_t rejected;		// 503 responses.
+	uint32_t errors;		// Other failed attempts.
+	double seconds;			// Until the image was downloaded.
+	
+	ClientResult() : done(false), bytes(0), rejected(0), errors(0), seconds(0) { }
+};
+
+
+// Latencies (ms) and failures of the API requests made during the downloads.
+struct ProbeResult {
+	std::vector<double> latencies;
+	uint32_t rejected;
+	uint32_t errors;
+	
+	ProbeResult() : rejected(0), errors(0) { }
+};
+
+
+// --- PROBE ---
+// Request 'path' every 100 ms until 'stop' is set.
+static void probe(const std::string &host, uint16_t port, const std::string &path,
+									std::atomic<bool> &stop, ProbeResult &result) {
+	while (!stop) {
+		std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+		try {
+			HTTPClientSession session(host, port);
+			session.setTimeout(Poco::Timespan(30, 0));
+			HTTPRequest request(HTTPRequest::HTTP_GET, path, HTTPMessage::HTTP_1_1);
+			session.sendRequest(request);
+			HTTPResponse response;
+			std::istream &rs = session.receiveResponse(response);
+			rs.ignore(std::numeric_limits<std::streamsize>::max());
+			if (response.getStatus() == HTTPResponse::HTTP_SERVICE_UNAVAILABLE) { ++result.rejected; }
+			else if (response.getStatus() >= 300) { ++result.errors; }
+			else {
+				result.latencies.push_back(std::chrono::duration<double, std::milli>(
+										std::chrono::steady_clock::now() - t).count());
+			}
+		}
+		catch (Poco::Exception &exc) {
+			++result.errors;
+		}
+		
+		std::this_thread::sleep_until(t + std::chrono::milliseconds(100));
+	}
+}
+
+
+// --- PRINT SERVER METRICS ---
+// Print the controller's figures on its HTTP server threads and connections.
+static void printServerMetrics(const std::string &host, uint16_t port) {
+	try {
+		HTTPClientSession session(host, port);
+		HTTPRequest request(HTTPRequest::HTTP_GET, "/metrics", HTTPMessage::HTTP_1_1);
+		session.sendRequest(request);
+		HTTPResponse response;
+		std::istream &rs = session.receiveResponse(response);
+		std::string line;
+		while (std::getline(rs, line)) {
+			if (line.compare(0, 17, "bmac_http_threads") == 0 || 
+					line.compare(0, 36, "bmac_http_max_concurrent_connections") == 0) {
+				std::cout << "  " << line << "\n";
+			}
+		}
+	}
+	catch (Poco::Exception &exc) {
+		std::cerr << "Failed to read the server metrics: " << exc.displayText() << std::endl;
+	}
+}
+
+
+// --- DOWNLOAD ---
+// Fetch the image, retrying up to 'retries' times.
+static void download(const std::string &host, uint16_t port, const std::string &path,
+					uint32_t retries, std::chrono::steady_clock::time_point start,
+					ClientResult &result) {
+	std::vector<char> buffer(65536);
+	for (uint32_t attempt = 0; attempt <= retries; ++attempt) {
+		uint32_t retryAfter = 1;
+		try {
+			HTTPClientSession session(host, port);
+			session.setTimeout(Poco::Timespan(120, 0));
+			HTTPRequest request(HTTPRequest::HTTP_GET, path, HTTPMessage::HTTP_1_1);
+			session.sendRequest(request);
+			HTTPResponse response;
+			std::istream &rs = session.receiveResponse(response);
+			if (response.getStatus() == HTTPResponse::HTTP_OK) {
+				uint64_t bytes = 0;
+				while (rs.read(buffer.data(), buffer.size()) || rs.gcount() > 0) { 
+					bytes += rs.gcount(); 
+				}
+				
+				if (response.hasContentLength() &&
+						bytes != (uint64_t) response.getContentLength64()) {
+					++result.errors;
+					continue;
+				}
+				
+				result.done = true;
+				result.bytes = bytes;
+				result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+																			start).count();
+				return;
+			}
+			
+			if (response.getStatus() == HTTPResponse::HTTP_SERVICE_UNAVAILABLE) {
+				++result.rejected;
+				if (response.has("Retry-After")) { 
+					retryAfter = atoi(response.get("Retry-After").c_str()); 
+				}
+			}
+			else {
+				++result.errors;
+			}
+		}
+		catch (Poco::Exception &exc) {
+			++result.errors;
+		}
+		
+		std::this_thread::sleep_for(std::chrono::seconds(retryAfter));
+	}
+}
+
+
+int main(int argc, char* argv[]) {
+	Sarge sarge;
+	sarge.setArgument("h", "help", "Get this help message.", false);
+	sarge.setArgument("s", "server", "Controller, host:port (default: localhost:8080).", true);
+	sarge.setArgument("u", "uid", "UID of a node with a firmware image assigned.", true);
+	sarge.setArgument("c", "clients", "Number of concurrent clients (default: 500).", true);
+	sarge.setArgument("r", "retries", "Retries per client after a failed attempt (default: 20).", true);
+	sarge.setArgument("a", "api", "API path requested during the downloads (default: /cc/).", true);
+	sarge.setDescription("Benchmark of concurrent firmware downloads from the controller.");
+	sarge.setUsage("firmware_bench -u <uid> <options>");
+	
+	std::string value;
+	if (!sarge.parseArguments(argc, argv) || sarge.exists("help") || !sarge.getFlag("uid", value)) {
+		sarge.printHelp();
+		return sarge.exists("help") ? 0 : 1;
+	}
+	
+	std::string path = "/ota.php?uid=" + value;
+	std::string server = sarge.getFlag("server", value) ? value : "localhost:8080";
+	uint32_t clients = sarge.getFlag("clients", value) ? atoi(value.c_str()) : 500;
+	uint32_t retries = sarge.getFlag("retries", value) ? atoi(value.c_str()) : 20;
+	std::string api = sarge.getFlag("api", value) ? value : "/cc/";
+	if (clients == 0) {
+		std::cerr << "The number of clients must be larger than 0." << std::endl;
+		return 1;
+	}
+	
+	std::string host = server.substr(0, server.find(':'));
+	uint16_t port = (server.find(':') != std::string::npos) ?
+								atoi(server.c_str() + server.find(':') + 1) : 8080;
+	
+	std::cout << clients << " clients downloading " << path << " from " << server << "...\n";
+	
+	std::vector<ClientResult> results(clients);
+	std::vector<std::thread> threads;
+	ProbeResult probed;
+	std::atomic<bool> stop(false);
+	std::thread prober(probe, host, port, api, std::ref(stop), std::ref(probed));
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < clients; ++i) {
+		threads.push_back(std::thread(download, host, port, path, retries, start,
+																	std::ref(results[i])));
+	}
+	
+	for (unsigned int i = 0; i < threads.size(); ++i) { threads[i].join(); }
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	stop = true;
+	prober.join();
+	
+	uint64_t bytes = 0;
+	uint32_t done = 0;
+	uint32_t rejected = 0;
+	uint32_t errors = 0;
+	std::vector<double> times;
+	for (unsigned int i = 0; i < results.size(); ++i) {
+		bytes += results[i].bytes;
+		rejected += results[i].rejected;
+		errors += results[i].errors;
+		if (results[i].done) {
+			++done;
+			times.push_back(results[i].seconds);
+		}
+	}
+	
+	std::cout << done << " of " << clients << " clients downloaded " << bytes / 1048576.0
+				<< " MB in " << elapsed << " s: " << bytes / 1048576.0 / elapsed << " MB/s.\n";
+	std::cout << "Responses: " << rejected << " busy (503), " << errors << " errors.\n";
+	if (!times.empty()) {
+		std::sort(times.begin(), times.end());
+		std::cout << "Time to complete: p50 " << times[times.size() / 2] << " s, p99 "
+					<< times[times.size() * 99 / 100] << " s, max " << times.back() << " s.\n";
+	}
+	
+	std::vector<double> &lat = probed.latencies;
+	std::cout << api << " during the downloads: " << lat.size() << " answered, " << probed.rejected
+				<< " busy (503), " << probed.errors << " errors";
+	if (!lat.empty()) {
+		std::sort(lat.begin(), lat.end());
+		std::cout << ", p50 " << lat[lat.size() / 2] << " ms, p99 " << lat[lat.size() * 99 / 100]
+					<< " ms, max " << lat.back() << " ms";
+	}
+	
+	std::cout << ".\nServer:\n";
+	printServerMetrics(host, port);
+	return (done == clients) ? 0 : 1;
+}
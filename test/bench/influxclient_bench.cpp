@@ -0,0 +1,127 @@
+/*
+	influxclient_bench.cpp - Request rate benchmark for the shared Influx client.
+	
+	Revision 0
+	
+	Features:
+			- A number of threads share one InfluxClient and send writes (or
+				queries) as fast as they can, as the timer, MQTT and HTTP threads
+				of the controller do.
+			- Reports the request rate, the p50/p99 latency per request and the
+				client's statistics: failures, reconnects and sessions used.
+	
+	Notes:
+			- Meant to be run against the mock InfluxDB server (influx_mock in
+				test/influxmock), optionally with added latency, so that the
+				effect of the pool size shows. A pool of 1 session corresponds
+				to the single, serialised session used before.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include "influxclient.h"
+#include "sarge.h"
+
+
+int main(int argc, char* argv[]) {
+	Sarge sarge;
+	sarge.setArgument("h", "help", "Get this help message.", false);
+	sarge.setArgument("m", "mock", "InfluxDB server, host:port (default: localhost:8086).", true);
+	sarge.setArgument("c", "callers", "Number of concurrent callers (default: 16).", true);
+	sarge.setArgument("s", "sessions", "Size of the client's session pool (default: 4).", true);
+	sarge.setArgument("d", "duration", "Seconds to run for (default: 10).", true);
+	sarge.setArgument("p", "points", "Points per write (default: 1).", true);
+	sarge.setArgument("q", "query", "Send queries instead of writes.", false);
+	sarge.setDescription("Request rate benchmark for the shared Influx client.");
+	sarge.setUsage("influxclient_bench <options>");
+	
+	if (!sarge.parseArguments(argc, argv) || sarge.exists("help")) {
+		sarge.printHelp();
+		return sarge.exists("help") ? 0 : 1;
+	}
+	
+	std::string value;
+	std::string mock = sarge.getFlag("mock", value) ? value : "localhost:8086";
+	uint32_t callers = sarge.getFlag("callers", value) ? atoi(value.c_str()) : 16;
+	uint32_t sessions = sarge.getFlag("sessions", value) ? atoi(value.c_str()) : 4;
+	uint32_t duration = sarge.getFlag("duration", value) ? atoi(value.c_str()) : 10;
+	uint32_t points = sarge.getFlag("points", value) ? atoi(value.c_str()) : 1;
+	bool query = sarge.exists("query");
+	if (callers == 0 || sessions == 0 || points == 0) {
+		std::cerr << "Callers, sessions and points must be larger than 0." << std::endl;
+		return 1;
+	}
+	
+	std::string host = mock.substr(0, mock.find(':'));
+	int port = (mock.find(':') != std::string::npos) ? atoi(mock.c_str() + mock.find(':') + 1) : 8086;
+	InfluxClient influx(host, port, "bench", false, sessions);
+	
+	std::cout << callers << " callers sending " << (query ? "queries" : "writes") << " to " << mock
+				<< " over " << sessions << " sessions for " << duration << " s...\n";
+	
+	// Each caller keeps its own latencies (us), merged at the end.
+	std::vector<std::vector<uint32_t> > latencies(callers);
+	std::atomic<uint64_t> failed(0);
+	std::atomic<bool> stop(false);
+	std::vector<std::thread> threads;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (uint32_t c = 0; c < callers; ++c) {
+		threads.push_back(std::thread([&, c]() {
+			std::string lines;
+			char buf[96];
+			for (uint32_t i = 0; i < points; ++i) {
+				snprintf(buf, sizeof(buf), "benchclient,location=caller%u value=%u\n", c, i);
+				lines += buf;
+			}
+			
+			std::string result;
+			std::vector<uint32_t> &lat = latencies[c];
+			while (!stop) {
+				std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+				InfluxStatus res = query ? influx.query("SELECT last(\"value\") FROM \"benchclient\"",
+																					result) :
+											influx.write(lines);
+				lat.push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+										std::chrono::steady_clock::now() - t).count());
+				if (res != INFLUX_OK) { ++failed; }
+			}
+		}));
+	}
+	
+	std::this_thread::sleep_for(std::chrono::seconds(duration));
+	stop = true;
+	for (unsigned int i = 0; i < threads.size(); ++i) { threads[i].join(); }
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	
+	std::vector<uint32_t> all;
+	for (unsigned int i = 0; i < latencies.size(); ++i) {
+		all.insert(all.end(), latencies[i].begin(), latencies[i].end());
+	}
+	
+	if (all.empty()) {
+		std::cerr << "No requests completed." << std::endl;
+		return 1;
+	}
+	
+	std::sort(all.begin(), all.end());
+	InfluxStats stats = influx.getStats();
+	std::cout << all.size() << " requests in " << elapsed << " s: " << (uint64_t) (all.size() / elapsed)
+				<< " req/s, " << (uint64_t) (all.size() * points / elapsed) << " points/s.\n";
+	std::cout << "Latency: p50 " << all[all.size() / 2] / 1000.0 << " ms, p99 "
+				<< all[all.size() * 99 / 100] / 1000.0 << " ms.\n";
+	std::cout << "Failed: " << failed << " (" << stats.shortCircuits << " short-circuited), "
+				<< stats.reconnects << " reconnects, " << stats.sessions << " sessions.\n";
+	
+	return 0;
+}
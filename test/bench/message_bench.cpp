@@ -0,0 +1,172 @@
+/*
+	message_bench.cpp - Microbenchmark of the MQTT message hot paths.
+	
+	Revision 0
+	
+	Features:
+			- Measures ns/message and heap allocations/message of turning an
+				MQTT message into a line of line protocol, before and after
+				mapping straight from the message buffers:
+				* forwarder: the controller's Listener::messageHandler(), which
+					built the line from substr() copies and concatenations, and
+					now appends into a reused per-thread buffer.
+				* bridge: influx_mqtt's on_message(), which copied topic and
+					payload into new strings, looked the series name up in a
+					map and built the line from substr() copies, and now maps
+					the buffers with the compiled TopicMapper into reused
+					strings.
+	
+	Notes:
+			- The 'before' variants are copies of the code as it was, kept here
+				for comparison.
+			- Only the formatting is measured, not the queue, the deduplication
+				or the write to InfluxDB.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+
+#include "alloccount.h"
+#include "mapper.h"
+
+
+// Topic, as it arrives in the mosquitto message, and payloads.
+static const char* topic = "nsa/temperature";
+static std::vector<std::string> payloads;
+
+// Keeps the compiler from optimising the work away.
+static volatile size_t sink;
+
+
+// --- FORWARDER BEFORE ---
+static void forwarderBefore(const std::string &series, const std::string &payload) {
+	size_t pos = payload.find(";");
+	std::string uid = payload.substr(0, pos);
+	std::string value = payload.substr(pos + 1);
+	std::string influxMsg;
+	influxMsg = series;
+	influxMsg += ",location=" + uid;
+	influxMsg += " value=" + value;
+	sink = influxMsg.length();
+}
+
+
+// --- FORWARDER AFTER ---
+static void forwarderAfter(const std::string &series, const std::string &payload) {
+	size_t pos = payload.find(";");
+	static thread_local std::string influxMsg;
+	influxMsg.assign(series);
+	influxMsg.append(",location=", 10);
+	influxMsg.append(payload, 0, pos);
+	influxMsg.append(" value=", 7);
+	influxMsg.append(payload, pos + 1, std::string::npos);
+	sink = influxMsg.length();
+}
+
+
+// --- BRIDGE BEFORE ---
+// The original MtH::on_message(), up to the write: the series name looked up
+// by topic, the line assembled from new strings.
+static void bridgeBefore(std::map<std::string, std::string> &series, const char* payload, 
+																	size_t payloadLen) {
+	std::string t = topic;
+	std::map<std::string, std::string>::iterator it = series.find(t);
+	if (it == series.end()) { return; }
+	
+	std::string p = std::string(payload, payloadLen);
+	size_t pos = p.find(";");
+	if (pos == std::string::npos || pos == 0) { return; }
+	
+	std::string uid = p.substr(0, pos);
+	std::string value = p.substr(pos + 1);
+	std::string line;
+	line = series[t];
+	line += ",location=" + uid;
+	line += " value=" + value;
+	sink = line.length();
+}
+
+
+// --- BRIDGE AFTER ---
+// Topic and payload copied into the reused buffers of a queue slot, mapped into
+// a reused line.
+static void bridgeAfter(const TopicMapper &mapper, const char* payload, size_t payloadLen) {
+	static std::string t;
+	static std::string p;
+	static std::string line;
+	size_t topicLen = strlen(topic);
+	t.assign(topic, topicLen);
+	p.assign(payload, payloadLen);
+	mapper.map(t.data(), t.length(), p.data(), p.length(), line);
+	sink = line.length();
+}
+
+
+// --- RUN ---
+// Run 'fn' for each of 'count' messages, and report the time and allocations
+// per message.
+template <typename F>
+static void run(const char* name, uint64_t count, F fn) {
+	// Warm up, so that reused buffers have grown to size.
+	for (unsigned int i = 0; i < payloads.size(); ++i) { fn(payloads[i]); }
+	
+	uint64_t allocs = allocations();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (uint64_t i = 0; i < count; ++i) {
+		fn(payloads[i % payloads.size()]);
+	}
+	
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() -
+																			start).count();
+	allocs = allocations() - allocs;
+	printf("%-18s %8.1f ns/msg %6.2f allocs/msg\n", name, ns / count, (double) allocs / count);
+}
+
+
+int main(int argc, char* argv[]) {
+	uint64_t count = (argc > 1) ? strtoull(argv[1], 0, 10) : 5000000;
+	if (count == 0) {
+		std::cerr << "Usage: message_bench [messages]" << std::endl;
+		return 1;
+	}
+	
+	// Payloads of the usual '<location>;<value>' format.
+	char buf[64];
+	for (unsigned int i = 0; i < 1000; ++i) {
+		snprintf(buf, sizeof(buf), "a0:20:a6:%02x:%02x:%02x;%.2f", i % 7, i % 13, i,
+																	18.0 + (i % 50) / 10.0);
+		payloads.push_back(buf);
+	}
+	
+	std::string series = "temperature";
+	std::map<std::string, std::string> seriesMap;
+	seriesMap[topic] = series;
+	TopicMapper mapper;
+	std::string error;
+	if (!mapper.addRule("sensors", "nsa/+ {t1},location={p0} value={p1}", error)) {
+		std::cerr << error << std::endl;
+		return 1;
+	}
+	
+	std::cout << count << " messages.\n";
+	run("forwarder before", count, [&series](const std::string &p) { forwarderBefore(series, p); });
+	run("forwarder after", count, [&series](const std::string &p) { forwarderAfter(series, p); });
+	run("bridge before", count, [&seriesMap](const std::string &p) {
+		bridgeBefore(seriesMap, p.data(), p.length());
+	});
+	
+	run("bridge after", count, [&mapper](const std::string &p) {
+		bridgeAfter(mapper, p.data(), p.length());
+	});
+	
+	return 0;
+}
@@ -0,0 +1,150 @@
+/*
+	parser_bench.cpp - Benchmark of the streaming Influx response parser.
+	
+	Revision 0
+	
+	Features:
+			- Compares InfluxParser with the Poco::JSON path the controller used
+				before: copy the response into a string, parse it into a
+				Dynamic::Var tree and index into that.
+			- Two response shapes: a single row (the last temperature of one
+				node) and a single series of 100k rows (a history export).
+			- Reports the time and the heap allocations per parsed response.
+	
+	Notes:
+			- Responses are generated in memory, so no InfluxDB is needed.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "alloccount.h"
+#include "influxparser.h"
+
+#include <Poco/JSON/Parser.h>
+#include <Poco/JSON/Object.h>
+#include <Poco/JSON/Array.h>
+#include <Poco/StreamCopier.h>
+#include <Poco/Exception.h>
+
+using namespace Poco;
+using namespace Poco::JSON;
+
+
+// Keeps the compiler from optimising the work away.
+static volatile double sink;
+
+
+// --- MAKE RESPONSE ---
+// An Influx query response with one series of 'rows' rows.
+static std::string makeResponse(uint32_t rows) {
+	std::string out = "{\"results\":[{\"statement_id\":0,\"series\":[{\"name\":\"temperature\","
+						"\"tags\":{\"location\":\"a0:20:a6:01:02:03\"},\"columns\":[\"time\",\"value\"],"
+						"\"values\":[";
+	char buf[64];
+	for (uint32_t i = 0; i < rows; ++i) {
+		snprintf(buf, sizeof(buf), "%s[\"2026-10-19T%02u:%02u:%02uZ\",%.2f]", (i > 0) ? "," : "",
+										(i / 3600) % 24, (i / 60) % 60, i % 60, 18.0 + (i % 50) / 10.0);
+		out += buf;
+	}
+	
+	out += "]}]}]}\n";
+	return out;
+}
+
+
+// --- PARSE POCO ---
+// As Nodes::updateCurrentTemperatures() did before the streaming parser.
+static bool parsePoco(std::istream &in) {
+	std::string responseStr;
+	StreamCopier::copyToString(in, responseStr);
+	try {
+		Parser parser;
+		Dynamic::Var result = parser.parse(responseStr);
+		Object::Ptr object = result.extract<Object::Ptr>();
+		Array::Ptr results = object->getArray("results");
+		Object::Ptr statement = results->getObject(0);
+		Array::Ptr series = statement->getArray("series");
+		double sum = 0;
+		for (unsigned int s = 0; s < series->size(); ++s) {
+			Object::Ptr serie = series->getObject(s);
+			std::string uid = serie->getObject("tags")->getValue<std::string>("location");
+			Array::Ptr values = serie->getArray("values");
+			for (unsigned int i = 0; i < values->size(); ++i) {
+				Array::Ptr row = values->getArray(i);
+				if (row->size() < 2 || row->isNull(1)) { continue; }
+				sum += row->getElement<float>(1);
+			}
+		}
+		
+		sink = sum;
+	}
+	catch (Exception &exc) {
+		std::cerr << "Poco: " << exc.displayText() << std::endl;
+		return false;
+	}
+	
+	return true;
+}
+
+
+// --- PARSE STREAMING ---
+static bool parseStreaming(std::istream &in) {
+	double sum = 0;
+	InfluxParser parser([&sum](const InfluxSeries &series, const InfluxRow &row) {
+		if (row.size() >= 2 && row[1].isNumber()) { sum += row[1].number; }
+		return true;
+	});
+	
+	if (!parser.parse(in)) {
+		std::cerr << "InfluxParser: " << parser.getError() << std::endl;
+		return false;
+	}
+	
+	sink = sum;
+	return true;
+}
+
+
+// --- RUN ---
+// Parse the response 'count' times, and report the time and allocations per
+// parse.
+static bool run(const char* name, const std::string &response, uint32_t count,
+												bool (*parse)(std::istream &in)) {
+	uint64_t allocs = allocations();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < count; ++i) {
+		std::istringstream in(response);
+		if (!parse(in)) { return false; }
+	}
+	
+	double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() -
+																			start).count();
+	allocs = allocations() - allocs;
+	printf("%-24s %12.1f us/parse %12.1f allocs/parse\n", name, us / count, (double) allocs / count);
+	return true;
+}
+
+
+int main(int argc, char* argv[]) {
+	std::string small = makeResponse(1);
+	std::string large = makeResponse(100000);
+	std::cout << "1 row: " << small.length() << " bytes, 100k rows: " << large.length()
+				<< " bytes.\n";
+	
+	if (!run("1 row, Poco", small, 20000, parsePoco) ||
+			!run("1 row, InfluxParser", small, 20000, parseStreaming) ||
+			!run("100k rows, Poco", large, 10, parsePoco) ||
+			!run("100k rows, InfluxParser", large, 10, parseStreaming)) {
+		return 1;
+	}
+	
+	return 0;
+}
@@ -0,0 +1,322 @@
+/*
+	influx_bench.cpp - End-to-end throughput benchmark for the MQTT to InfluxDB path.
+	
+	Revision 0
+	
+	Features:
+			- Publishes sensor readings at a fixed rate through an MQTT broker,
+				to be written by influx_mqtt or the BMaC controller into the
+				mock InfluxDB server (influx_mock).
+			- Reports the achieved publish rate, sustained throughput at the
+				mock, loss, duplicates and the p50/p99 latency from publishing
+				a message until its point arrives at the mock.
+	
+	Notes:
+			- Payloads have the usual '<location>;<value>' format, with the time
+				of publishing (microseconds since the epoch) as value. These are
+				unique, so that the mock can count distinct points. The mock and
+				this tool have to run on the same host, or on hosts with closely
+				synchronised clocks.
+			- Readings are spread over a number of locations, i.e. series.
+			- With the series sharded over several InfluxDB endpoints, one mock
+				runs per endpoint and their figures are added up. Latencies are
+				those of the slowest mock.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include <mosquittopp.h>
+
+#include <Poco/Net/HTTPClientSession.h>
+#include <Poco/Net/HTTPRequest.h>
+#include <Poco/Net/HTTPResponse.h>
+#include <Poco/JSON/Parser.h>
+#include <Poco/Exception.h>
+#include <Poco/StreamCopier.h>
+
+#include "sarge.h"
+
+using namespace Poco::Net;
+
+
+class BenchClient : public mosqpp::mosquittopp {
+public:
+	volatile bool connected;
+	
+	BenchClient() : mosquittopp("influx_bench"), connected(false) { }
+	void on_connect(int rc) { connected = (rc == 0); }
+	void on_disconnect(int rc) { connected = false; }
+};
+
+
+// --- MOCK REQUEST ---
+// Send a request to the mock server, returning the response body.
+static bool mockRequest(const std::string &host, uint16_t port, const std::string &method,
+															const std::string &path, std::string &body) {
+	try {
+		HTTPClientSession session(host, port);
+		HTTPRequest request(method, path, HTTPMessage::HTTP_1_1);
+		request.setContentLength(0);
+		session.sendRequest(request);
+		HTTPResponse response;
+		std::istream &rs = session.receiveResponse(response);
+		body.clear();
+		Poco::StreamCopier::copyToString(rs, body);
+		return response.getStatus() < 300;
+	}
+	catch (Poco::Exception &exc) {
+		std::cerr << "Mock server: " << exc.displayText() << std::endl;
+		return false;
+	}
+}
+
+
+// Figures reported by the mock server.
+struct MockStats {
+	uint64_t writes;
+	uint64_t failed;
+	uint64_t points;
+	uint64_t distinct;
+	int64_t first;
+	int64_t last;
+	double p50;
+	double p99;
+	uint64_t over;
+};
+
+
+// A mock server.
+struct Mock {
+	std::string host;
+	uint16_t port;
+	MockStats stats;
+};
+
+
+// --- GET STATS ---
+static bool getStats(const std::string &host, uint16_t port, MockStats &stats) {
+	std::string body;
+	if (!mockRequest(host, port, HTTPRequest::HTTP_GET, "/stats", body)) { return false; }
+	try {
+		Poco::JSON::Parser parser;
+		Poco::JSON::Object::Ptr obj = parser.parse(body).extract<Poco::JSON::Object::Ptr>();
+		stats.writes = obj->getValue<uint64_t>("writes");
+		stats.failed = obj->getValue<uint64_t>("failed");
+		stats.points = obj->getValue<uint64_t>("bench_points");
+		stats.distinct = obj->getValue<uint64_t>("bench_distinct");
+		stats.first = obj->getValue<int64_t>("first_ms");
+		stats.last = obj->getValue<int64_t>("last_ms");
+		stats.p50 = obj->getValue<double>("p50_ms");
+		stats.p99 = obj->getValue<double>("p99_ms");
+		stats.over = obj->getValue<uint64_t>("over_60s");
+	}
+	catch (Poco::Exception &exc) {
+		std::cerr << "Invalid stats from mock server: " << exc.displayText() << std::endl;
+		return false;
+	}
+	
+	return true;
+}
+
+
+// --- GET TOTAL STATS ---
+// Fetch the figures of all mock servers and add them up into 'total'.
+static bool getTotalStats(std::vector<Mock> &mocks, MockStats &total) {
+	total = MockStats();
+	total.first = -1;
+	for (unsigned int i = 0; i < mocks.size(); ++i) {
+		MockStats &stats = mocks[i].stats;
+		if (!getStats(mocks[i].host, mocks[i].port, stats)) { return false; }
+		total.writes += stats.writes;
+		total.failed += stats.failed;
+		total.points += stats.points;
+		total.distinct += stats.distinct;
+		total.over += stats.over;
+		if (stats.distinct == 0) { continue; }
+		if (total.first < 0 || stats.first < total.first) { total.first = stats.first; }
+		if (stats.last > total.last) { total.last = stats.last; }
+		if (stats.p50 > total.p50) { total.p50 = stats.p50; }
+		if (stats.p99 > total.p99) { total.p99 = stats.p99; }
+	}
+	
+	if (total.first < 0) { total.first = 0; }
+	return true;
+}
+
+
+// --- NOW US ---
+static uint64_t nowUs() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+						std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+
+int main(int argc, char* argv[]) {
+	Sarge sarge;
+	sarge.setArgument("h", "help", "Get this help message.", false);
+	sarge.setArgument("b", "broker", "MQTT broker host (default: localhost).", true);
+	sarge.setArgument("o", "broker-port", "MQTT broker port (default: 1883).", true);
+	sarge.setArgument("m", "mock", "Mock InfluxDB servers, comma-separated host:port list (default: localhost:8086).", true);
+	sarge.setArgument("p", "replicas", "Copies of each point written, i.e. the replication setting (default: 1).", true);
+	sarge.setArgument("r", "rate", "Messages per second (default: 1000).", true);
+	sarge.setArgument("d", "duration", "Seconds to publish for (default: 10).", true);
+	sarge.setArgument("t", "topic", "Topic to publish on (default: nsa/bench).", true);
+	sarge.setArgument("n", "nodes", "Number of locations to spread readings over (default: 100).", true);
+	sarge.setArgument("q", "qos", "QoS of published messages (default: 0).", true);
+	sarge.setArgument("w", "wait", "Seconds to wait for points to arrive after publishing (default: 10).", true);
+	sarge.setDescription("End-to-end throughput benchmark for the MQTT to InfluxDB path.");
+	sarge.setUsage("influx_bench <options>");
+	
+	if (!sarge.parseArguments(argc, argv) || sarge.exists("help")) {
+		sarge.printHelp();
+		return sarge.exists("help") ? 0 : 1;
+	}
+	
+	std::string value;
+	std::string broker = sarge.getFlag("broker", value) ? value : "localhost";
+	int brokerPort = sarge.getFlag("broker-port", value) ? atoi(value.c_str()) : 1883;
+	std::string mock = sarge.getFlag("mock", value) ? value : "localhost:8086";
+	uint32_t rate = sarge.getFlag("rate", value) ? atoi(value.c_str()) : 1000;
+	uint32_t duration = sarge.getFlag("duration", value) ? atoi(value.c_str()) : 10;
+	std::string topic = sarge.getFlag("topic", value) ? value : "nsa/bench";
+	uint32_t nodes = sarge.getFlag("nodes", value) ? atoi(value.c_str()) : 100;
+	int qos = sarge.getFlag("qos", value) ? atoi(value.c_str()) : 0;
+	uint32_t wait = sarge.getFlag("wait", value) ? atoi(value.c_str()) : 10;
+	uint32_t replicas = sarge.getFlag("replicas", value) ? atoi(value.c_str()) : 1;
+	if (rate == 0 || nodes == 0 || replicas == 0) {
+		std::cerr << "Rate, number of nodes and replicas must be larger than 0." << std::endl;
+		return 1;
+	}
+	
+	std::vector<Mock> mocks;
+	std::istringstream ss(mock);
+	std::string entry;
+	while (std::getline(ss, entry, ',')) {
+		if (entry.empty()) { continue; }
+		Mock m;
+		m.host = entry.substr(0, entry.find(':'));
+		m.port = (entry.find(':') != std::string::npos) ? 
+								atoi(entry.c_str() + entry.find(':') + 1) : 8086;
+		mocks.push_back(m);
+	}
+	
+	if (mocks.empty()) {
+		std::cerr << "No mock server given." << std::endl;
+		return 1;
+	}
+	
+	std::string body;
+	for (unsigned int i = 0; i < mocks.size(); ++i) {
+		if (!mockRequest(mocks[i].host, mocks[i].port, HTTPRequest::HTTP_POST, "/reset", body)) {
+			std::cerr << "Failed to reset the mock server at " << mocks[i].host << ":" 
+						<< mocks[i].port << "." << std::endl;
+			return 1;
+		}
+	}
+	
+	// Connect to the broker.
+	mosqpp::lib_init();
+	BenchClient client;
+	client.connect(broker.c_str(), brokerPort, 60);
+	client.loop_start();
+	for (int i = 0; i < 50 && !client.connected; ++i) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+	
+	if (!client.connected) {
+		std::cerr << "Failed to connect to the broker at " << broker << ":" << brokerPort << "."
+					<< std::endl;
+		return 1;
+	}
+	
+	std::cout << "Publishing " << rate << " msg/s on " << topic << " for " << duration
+				<< " s, over " << nodes << " locations...\n";
+	
+	// Publish at the given rate. Values are the time of publishing, kept unique.
+	uint64_t total = (uint64_t) rate * duration;
+	uint64_t sent = 0;
+	uint64_t failed = 0;
+	uint64_t lastValue = 0;
+	char payload[64];
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	while (sent < total) {
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		uint64_t due = (uint64_t) (elapsed * rate);
+		if (due > total) { due = total; }
+		if (sent >= due) {
+			std::this_thread::sleep_for(std::chrono::microseconds(500));
+			continue;
+		}
+		
+		while (sent < due) {
+			uint64_t now = nowUs();
+			lastValue = (now > lastValue) ? now : lastValue + 1;
+			int len = snprintf(payload, sizeof(payload), "bench%u;%llu", (uint32_t) (sent % nodes),
+																(unsigned long long) lastValue);
+			if (client.publish(0, topic.c_str(), len, payload, qos) != MOSQ_ERR_SUCCESS) {
+				++failed;
+			}
+			
+			++sent;
+		}
+	}
+	
+	double publishTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Published " << sent << " messages in " << publishTime << " s ("
+				<< (uint64_t) (sent / publishTime) << " msg/s), " << failed << " failed.\n";
+	
+	// Wait until all points arrived, or none arrived for a while.
+	uint64_t expected = sent * replicas;
+	MockStats stats;
+	uint64_t lastDistinct = 0;
+	std::chrono::steady_clock::time_point lastProgress = std::chrono::steady_clock::now();
+	while (true) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(500));
+		if (!getTotalStats(mocks, stats)) { return 1; }
+		if (stats.distinct >= expected) { break; }
+		if (stats.distinct != lastDistinct) {
+			lastDistinct = stats.distinct;
+			lastProgress = std::chrono::steady_clock::now();
+		}
+		else if (std::chrono::steady_clock::now() - lastProgress > std::chrono::seconds(wait)) {
+			break;
+		}
+	}
+	
+	client.disconnect();
+	client.loop_stop();
+	mosqpp::lib_cleanup();
+	
+	double span = (stats.last - stats.first) / 1000.0;
+	uint64_t lost = (expected > stats.distinct) ? expected - stats.distinct : 0;
+	std::cout << "Received " << stats.distinct << " points in " << stats.writes << " writes ("
+				<< stats.failed << " failed with errors).\n";
+	if (mocks.size() > 1) {
+		for (unsigned int i = 0; i < mocks.size(); ++i) {
+			const MockStats &s = mocks[i].stats;
+			std::cout << "  " << mocks[i].host << ":" << mocks[i].port << ": " << s.distinct
+						<< " points (" << ((stats.distinct > 0) ? s.distinct * 100.0 / stats.distinct : 0)
+						<< "%), " << s.writes << " writes, p99 " << s.p99 << " ms.\n";
+		}
+	}
+	
+	std::cout << "Lost: " << lost << " (" << ((expected > 0) ? lost * 100.0 / expected : 0)
+				<< "%), duplicates: " << stats.points - stats.distinct << ".\n";
+	std::cout << "Sustained throughput: " << (uint64_t) ((span > 0) ? stats.distinct / span : 0)
+				<< " points/s.\n";
+	std::cout << "Latency: p50 " << stats.p50 << " ms, p99 " << stats.p99 << " ms";
+	if (stats.over > 0) { std::cout << ", " << stats.over << " points over 60 s"; }
+	std::cout << ".\n";
+	
+	return 0;
+}
@@ -0,0 +1,345 @@
+/*
+	influx_mock.cpp - Stand-in for an InfluxDB server, for testing and benchmarking.
+	
+	Revision 0
+	
+	Features:
+			- Implements /write, /query and /ping of the InfluxDB 1.x HTTP API,
+				with configurable latency, error rate, error status and
+				response bodies.
+			- Counts received points and optionally appends them to a file for
+				verification.
+			- For points of the benchmark measurement, whose value is the time
+				the message was published (in microseconds since the epoch),
+				records the ingest latency and counts distinct points, so that
+				loss and duplicates can be determined.
+			- /stats returns these figures as JSON, /reset clears them.
+	
+	Notes:
+			- The latency is added before a request is answered, so each
+				request also occupies one server thread for this long.
+	
+	2026/10/19, Maya Posch
+*/
+
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_set>
+#include <mutex>
+#include <condition_variable>
+#include <random>
+#include <thread>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+
+#include <Poco/Net/HTTPServer.h>
+#include <Poco/Net/HTTPServerParams.h>
+#include <Poco/Net/HTTPRequestHandler.h>
+#include <Poco/Net/HTTPRequestHandlerFactory.h>
+#include <Poco/Net/HTTPServerRequest.h>
+#include <Poco/Net/HTTPServerResponse.h>
+#include <Poco/StreamCopier.h>
+
+#include "sarge.h"
+
+using namespace Poco::Net;
+
+
+// Latencies are counted in buckets of 0.1 ms, up to a minute.
+static const uint32_t latencyBuckets = 600000;
+
+
+struct MockConfig {
+	uint32_t latency;		// ms
+	uint32_t jitter;		// ms
+	double errorRate;
+	HTTPResponse::HTTPStatus errorStatus;
+	std::string errorBody;
+	std::string queryBody;
+	std::string measurement;
+};
+
+
+class MockStats {
+	std::mutex mtx;
+	std::ofstream record;
+	uint64_t writes;
+	uint64_t queries;
+	uint64_t failed;
+	uint64_t points;
+	uint64_t benchPoints;
+	int64_t first;			// ms
+	int64_t last;			// ms
+	std::unordered_set<uint64_t> seen;
+	std::vector<uint32_t> latencies;
+	uint64_t overflow;
+	
+	// --- PERCENTILE ---
+	// Latency (ms) below which the given share of the benchmark points arrived.
+	double percentile(double share) {
+		uint64_t count = benchPoints - overflow;
+		if (count == 0) { return 0; }
+		uint64_t target = (uint64_t) (share * count);
+		uint64_t sum = 0;
+		for (uint32_t i = 0; i < latencyBuckets; ++i) {
+			sum += latencies[i];
+			if (sum > target) { return i / 10.0; }
+		}
+		
+		return latencyBuckets / 10.0;
+	}
+
+public:
+	MockStats() : latencies(latencyBuckets) { reset(); }
+	
+	// --- OPEN ---
+	bool open(const std::string &path) {
+		record.open(path.c_str(), std::ios::app);
+		return record.is_open();
+	}
+	
+	// --- RESET ---
+	void reset() {
+		std::lock_guard<std::mutex> lk(mtx);
+		writes = 0;
+		queries = 0;
+		failed = 0;
+		points = 0;
+		benchPoints = 0;
+		first = 0;
+		last = 0;
+		overflow = 0;
+		seen.clear();
+		std::fill(latencies.begin(), latencies.end(), 0);
+	}
+	
+	void addQuery() { std::lock_guard<std::mutex> lk(mtx); ++queries; }
+	void addFailed() { std::lock_guard<std::mutex> lk(mtx); ++failed; }
+	
+	// --- ADD WRITE ---
+	// Count the points in a write request's body.
+	void addWrite(const std::string &body, const std::string &measurement) {
+		int64_t nowUs = std::chrono::duration_cast<std::chrono::microseconds>(
+							std::chrono::system_clock::now().time_since_epoch()).count();
+		std::lock_guard<std::mutex> lk(mtx);
+		++writes;
+		if (record.is_open()) {
+			record << body;
+			if (!body.empty() && body[body.length() - 1] != '\n') { record << '\n'; }
+		}
+		
+		size_t start = 0;
+		while (start < body.length()) {
+			size_t end = body.find('\n', start);
+			if (end == std::string::npos) { end = body.length(); }
+			if (end == start) { start = end + 1; continue; }
+			++points;
+			
+			// Benchmark points: '<measurement>,location=... value=<time> [timestamp]'.
+			if (body.compare(start, measurement.length(), measurement) == 0 &&
+						(body[start + measurement.length()] == ',' ||
+						body[start + measurement.length()] == ' ')) {
+				size_t pos = body.find(" value=", start);
+				if (pos != std::string::npos && pos < end) {
+					uint64_t sent = strtoull(body.c_str() + pos + 7, 0, 10);
+					++benchPoints;
+					if (first == 0) { first = nowUs / 1000; }
+					last = nowUs / 1000;
+					seen.insert(sent);
+					int64_t latency = (nowUs - (int64_t) sent) / 100;
+					if (latency < 0) { latency = 0; }
+					if (latency >= latencyBuckets) { ++overflow; }
+					else { ++latencies[latency]; }
+				}
+			}
+			
+			start = end + 1;
+		}
+	}
+	
+	// --- TO JSON ---
+	std::string toJson() {
+		std::lock_guard<std::mutex> lk(mtx);
+		std::ostringstream out;
+		out << "{\"writes\":" << writes << ",\"queries\":" << queries << ",\"failed\":" << failed
+			<< ",\"points\":" << points << ",\"bench_points\":" << benchPoints
+			<< ",\"bench_distinct\":" << seen.size() << ",\"first_ms\":" << first
+			<< ",\"last_ms\":" << last << ",\"p50_ms\":" << percentile(0.5)
+			<< ",\"p99_ms\":" << percentile(0.99) << ",\"over_60s\":" << overflow << "}";
+		return out.str();
+	}
+};
+
+
+static MockConfig config;
+static MockStats stats;
+static std::condition_variable sigcv;
+
+
+// --- SIGNAL HANDLER ---
+static void signal_handler(int signal) {
+	sigcv.notify_one();
+}
+
+
+class MockHandler : public HTTPRequestHandler {
+	// --- DELAY ---
+	// Wait for the configured latency, and decide whether to fail the request.
+	bool delayAndFail() {
+		static thread_local std::mt19937 rng(std::random_device{}());
+		uint32_t ms = config.latency;
+		if (config.jitter > 0) { ms += rng() % (config.jitter + 1); }
+		if (ms > 0) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+		return config.errorRate > 0 &&
+				std::uniform_real_distribution<double>(0, 1)(rng) < config.errorRate;
+	}
+	
+	// --- SEND ---
+	void send(HTTPServerResponse &response, HTTPResponse::HTTPStatus status,
+															const std::string &body) {
+		response.setStatus(status);
+		if (body.empty()) {
+			response.setContentLength(0);
+			response.send();
+			return;
+		}
+		
+		response.setContentType("application/json");
+		response.setContentLength(body.length());
+		response.send() << body;
+	}
+
+public:
+	void handleRequest(HTTPServerRequest &request, HTTPServerResponse &response) {
+		std::string path = request.getURI().substr(0, request.getURI().find('?'));
+		std::string body;
+		Poco::StreamCopier::copyToString(request.stream(), body);
+		
+		if (path == "/ping") {
+			send(response, HTTPResponse::HTTP_NO_CONTENT, "");
+		}
+		else if (path == "/write") {
+			if (delayAndFail()) {
+				stats.addFailed();
+				send(response, config.errorStatus, config.errorBody);
+				return;
+			}
+			
+			stats.addWrite(body, config.measurement);
+			send(response, HTTPResponse::HTTP_NO_CONTENT, "");
+		}
+		else if (path == "/query") {
+			if (delayAndFail()) {
+				stats.addFailed();
+				send(response, config.errorStatus, config.errorBody);
+				return;
+			}
+			
+			stats.addQuery();
+			send(response, HTTPResponse::HTTP_OK, config.queryBody);
+		}
+		else if (path == "/stats") {
+			send(response, HTTPResponse::HTTP_OK, stats.toJson());
+		}
+		else if (path == "/reset") {
+			stats.reset();
+			send(response, HTTPResponse::HTTP_NO_CONTENT, "");
+		}
+		else {
+			send(response, HTTPResponse::HTTP_NOT_FOUND, "{\"error\":\"not found\"}");
+		}
+	}
+};
+
+
+class MockHandlerFactory : public HTTPRequestHandlerFactory {
+public:
+	HTTPRequestHandler* createRequestHandler(const HTTPServerRequest &request) {
+		return new MockHandler;
+	}
+};
+
+
+// --- READ FILE ---
+static bool readFile(const std::string &path, std::string &out) {
+	std::ifstream in(path.c_str(), std::ios::binary);
+	if (!in) { return false; }
+	std::ostringstream ss;
+	ss << in.rdbuf();
+	out = ss.str();
+	return true;
+}
+
+
+int main(int argc, char* argv[]) {
+	Sarge sarge;
+	sarge.setArgument("h", "help", "Get this help message.", false);
+	sarge.setArgument("p", "port", "Port to listen on (default: 8086).", true);
+	sarge.setArgument("t", "threads", "Number of server threads (default: 16).", true);
+	sarge.setArgument("l", "latency", "Latency added to each request, in ms (default: 0).", true);
+	sarge.setArgument("j", "jitter", "Maximum random latency added on top, in ms (default: 0).", true);
+	sarge.setArgument("e", "error-rate", "Share of requests to fail, 0 - 1 (default: 0).", true);
+	sarge.setArgument("s", "error-status", "HTTP status of failed requests (default: 503).", true);
+	sarge.setArgument("b", "error-body", "File with the body of failed requests.", true);
+	sarge.setArgument("q", "query-body", "File with the body of query responses.", true);
+	sarge.setArgument("r", "record", "File to append received points to.", true);
+	sarge.setArgument("m", "measurement", "Measurement of benchmark points (default: bench).", true);
+	sarge.setDescription("Stand-in for an InfluxDB server, for testing and benchmarking.");
+	sarge.setUsage("influx_mock <options>");
+	
+	if (!sarge.parseArguments(argc, argv) || sarge.exists("help")) {
+		sarge.printHelp();
+		return sarge.exists("help") ? 0 : 1;
+	}
+	
+	std::string value;
+	uint16_t port = sarge.getFlag("port", value) ? atoi(value.c_str()) : 8086;
+	int threads = sarge.getFlag("threads", value) ? atoi(value.c_str()) : 16;
+	config.latency = sarge.getFlag("latency", value) ? atoi(value.c_str()) : 0;
+	config.jitter = sarge.getFlag("jitter", value) ? atoi(value.c_str()) : 0;
+	config.errorRate = sarge.getFlag("error-rate", value) ? atof(value.c_str()) : 0;
+	config.errorStatus = (HTTPResponse::HTTPStatus) (sarge.getFlag("error-status", value) ?
+															atoi(value.c_str()) : 503);
+	config.errorBody = "{\"error\":\"mock failure\"}";
+	config.queryBody = "{\"results\":[{\"statement_id\":0}]}";
+	config.measurement = sarge.getFlag("measurement", value) ? value : "bench";
+	if (sarge.getFlag("error-body", value) && !readFile(value, config.errorBody)) {
+		std::cerr << "Failed to read " << value << std::endl;
+		return 1;
+	}
+	
+	if (sarge.getFlag("query-body", value) && !readFile(value, config.queryBody)) {
+		std::cerr << "Failed to read " << value << std::endl;
+		return 1;
+	}
+	
+	if (sarge.getFlag("record", value) && !stats.open(value)) {
+		std::cerr << "Failed to open " << value << std::endl;
+		return 1;
+	}
+	
+	HTTPServerParams* params = new HTTPServerParams;
+	params->setMaxQueued(1000);
+	params->setMaxThreads(threads);
+	params->setKeepAlive(true);
+	HTTPServer httpd(new MockHandlerFactory, port, params);
+	httpd.start();
+	
+	std::cout << "Mock InfluxDB listening on port " << port << ", latency " << config.latency
+				<< " ms (+" << config.jitter << "), error rate " << config.errorRate << ".\n";
+	
+	signal(SIGINT, signal_handler);
+	std::mutex sigmutex;
+	std::unique_lock<std::mutex> lk(sigmutex);
+	sigcv.wait(lk);
+	
+	httpd.stop();
+	std::cout << stats.toJson() << std::endl;
+	return 0;
+}